@@ -0,0 +1,147 @@
+//
+//  AsyncLog.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include "AsyncLog.h"
+
+namespace AsyncLog
+{
+    std::atomic<int> level_(QtDebugMsg);
+
+    // A power of two, so positions map to slots with a mask
+    static const size_t CAPACITY = 4096;
+    static const size_t MAX_MESSAGE_LENGTH = 512;
+
+    // Bounded queue of D. Vyukov: a slot's sequence says whether it is free for the producer at that position or filled for the consumer
+    struct Slot
+    {
+        std::atomic<size_t> sequence_;
+        QtMsgType type_;
+        size_t length_;
+        bool truncated_;
+        char text_[MAX_MESSAGE_LENGTH];
+    };
+
+    struct RingBuffer
+    {
+        RingBuffer() : pushPosition_(0), drainPosition_(0), nDropped_(0)
+        {
+            for (size_t i=0; i<CAPACITY; ++i)
+            {
+                slots_[i].sequence_.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        Slot slots_[CAPACITY];
+
+        std::atomic<size_t> pushPosition_;
+
+        // Only the draining thread reads and writes it
+        size_t drainPosition_;
+
+        std::atomic<size_t> nDropped_;
+    };
+
+    static RingBuffer ring;
+
+    void setLevel(int _level)
+    {
+        level_.store(_level, std::memory_order_relaxed);
+    }
+
+    bool push(QtMsgType _type, const char* _text)
+    {
+        size_t position = ring.pushPosition_.load(std::memory_order_relaxed);
+
+        Slot* slot = 0;
+
+        while (true)
+        {
+            slot = &ring.slots_[position & (CAPACITY - 1)];
+
+            intptr_t diff = (intptr_t)slot->sequence_.load(std::memory_order_acquire) - (intptr_t)position;
+
+            if (diff == 0)
+            {
+                // On failure position is reloaded and we try the next free slot
+                if (ring.pushPosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                // The slot a whole lap behind is not drained yet, the buffer is full
+                ring.nDropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                position = ring.pushPosition_.load(std::memory_order_relaxed);
+            }
+        }
+
+        size_t length = std::strlen(_text);
+
+        slot->type_ = _type;
+        slot->truncated_ = length > MAX_MESSAGE_LENGTH;
+
+        if (slot->truncated_)
+        {
+            length = MAX_MESSAGE_LENGTH;
+
+            // The local 8-bit encoding is UTF-8 where we run, a cut in the middle of a character moves back to its first byte
+            while (length > 0 && ((unsigned char)_text[length] & 0xC0) == 0x80)
+            {
+                --length;
+            }
+        }
+
+        slot->length_ = length;
+
+        std::memcpy(slot->text_, _text, slot->length_);
+
+        slot->sequence_.store(position + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    void drain(std::vector<Message>& _messages, size_t _maxMessages, size_t& _nDropped)
+    {
+        _nDropped = ring.nDropped_.exchange(0, std::memory_order_relaxed);
+
+        for (size_t n=0; n<_maxMessages; ++n)
+        {
+            size_t position = ring.drainPosition_;
+
+            Slot& slot = ring.slots_[position & (CAPACITY - 1)];
+
+            if (slot.sequence_.load(std::memory_order_acquire) != position + 1)
+            {
+                break;
+            }
+
+            Message message;
+
+            message.type_ = slot.type_;
+            message.text_ = QString::fromLocal8Bit(slot.text_, slot.length_);
+
+            if (slot.truncated_)
+            {
+                message.text_ += "...";
+            }
+
+            _messages.push_back(message);
+
+            // Free for the producer one lap later
+            slot.sequence_.store(position + CAPACITY, std::memory_order_release);
+
+            ring.drainPosition_ = position + 1;
+        }
+    }
+}
@@ -0,0 +1,53 @@
+//
+//  AsyncLog.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef ASYNCLOG_H
+#define ASYNCLOG_H
+
+#include <atomic>
+#include <vector>
+
+#include <QtGlobal>
+#include <QString>
+#include <QDebug>
+
+// Messages of any thread go into a fixed ring buffer without locking, the log browser takes them out in batches on the GUI thread
+// Messages below the level are dropped before they are formatted when logged through LOG_DEBUG and LOG_WARNING, and in the message handler otherwise
+// Building with QT_NO_DEBUG_OUTPUT removes LOG_DEBUG altogether
+namespace AsyncLog
+{
+    struct Message
+    {
+        QtMsgType type_;
+        QString text_;
+    };
+
+    extern std::atomic<int> level_;
+
+    inline bool enabled(QtMsgType _type)
+    {
+        return (int)_type >= level_.load(std::memory_order_relaxed);
+    }
+
+    // LOG_LEVEL of the config, 0 logs everything, 1 warnings and worse, 2 critical and fatal messages only
+    void setLevel(int _level);
+
+    // Never blocks, a message that does not fit is counted as dropped, long messages are truncated
+    bool push(QtMsgType _type, const char* _text);
+
+    // Take up to _maxMessages in the order they were pushed, _nDropped is the number of messages lost since the last call
+    // Only one thread may take messages out
+    void drain(std::vector<Message>& _messages, size_t _maxMessages, size_t& _nDropped);
+}
+
+#ifdef QT_NO_DEBUG_OUTPUT
+#define LOG_DEBUG() if (true) {} else qDebug()
+#else
+#define LOG_DEBUG() if (!AsyncLog::enabled(QtDebugMsg)) {} else qDebug()
+#endif
+
+#define LOG_WARNING() if (!AsyncLog::enabled(QtWarningMsg)) {} else qWarning()
+
+#endif
@@ -0,0 +1,32 @@
+//
+//  ComputeBackend.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <QDebug>
+#include <QString>
+
+#include "ComputeBackend.h"
+#include "NativeBackend.h"
+
+#ifdef USE_MATLAB
+#include "MatlabBackend.h"
+#endif
+
+ComputeBackend* createComputeBackend(const std::string& _name)
+{
+    if (_name == "MATLAB")
+    {
+#ifdef USE_MATLAB
+        return new MatlabBackend();
+#else
+        qWarning() << "Built without Matlab, the routines run natively";
+#endif
+    }
+    else if (_name != "NATIVE")
+    {
+        qWarning() << "Unknown compute backend " << QString(_name.c_str()) << ", the routines run natively";
+    }
+
+    return new NativeBackend();
+}
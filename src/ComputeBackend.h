@@ -0,0 +1,47 @@
+//
+//  ComputeBackend.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef COMPUTEBACKEND_H
+#define COMPUTEBACKEND_H
+
+#include <string>
+#include <vector>
+
+// A named matrix of a backend workspace, stored column after column as Matlab stores it
+struct ComputeMatrix
+{
+    std::vector<double> data_;
+    int nRows_ = 0;
+    int nColumns_ = 0;
+    std::string name_;
+};
+
+// Where the numerical routines of the exploration run: matrices are put in a workspace by name, a routine reads and writes workspace matrices, and results are read back by name
+// Routines, with the matrices they read and write:
+//   "pca"     descriptors (n x p) -> deformation_basis (p x 2), projected_descriptors (n x 2), the two leading principal components and the scores along them
+//   "mds"     descriptors (n x p) -> projected_descriptors (n x 2), cmdscale of the pairwise distances
+//   "cluster" projected_descriptors (n x 2) -> clustCent (c x 2), point2cluster (n x 1, counted from 1), nofClusters (1 x 1), mean shift clusters sorted on decreasing population
+class ComputeBackend
+{
+public:
+
+    virtual ~ComputeBackend() { }
+
+    virtual const char* name() const = 0;
+
+    // Copy _matrix into the workspace under its name, replacing what was there
+    virtual bool putMatrix(const ComputeMatrix& _matrix) = 0;
+
+    virtual bool runRoutine(const std::string& _routine) = 0;
+
+    // Fill _matrix with the workspace matrix named _matrix.name_
+    virtual bool getMatrix(ComputeMatrix& _matrix) = 0;
+};
+
+// The backend named by COMPUTE_BACKEND of the config, NATIVE or MATLAB, NATIVE when the application was built without Matlab
+// The caller owns it
+ComputeBackend* createComputeBackend(const std::string& _name);
+
+#endif
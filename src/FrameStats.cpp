@@ -0,0 +1,118 @@
+//
+//  FrameStats.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+#include "FrameStats.h"
+
+FrameStats::FrameStats(int _historySize) : historySize_(std::max(1, _historySize)), pendingPickMs_(0.0), nPendingPicks_(0)
+{
+}
+
+void FrameStats::beginFrame()
+{
+    currentFrame() = FrameSample();
+
+    frameStart_ = std::chrono::steady_clock::now();
+}
+
+void FrameStats::endFrame()
+{
+    FrameSample sample = currentFrame();
+
+    sample.frameMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart_).count();
+    sample.pickMs_ = pendingPickMs_;
+    sample.nPicks_ = nPendingPicks_;
+
+    pendingPickMs_ = 0.0;
+    nPendingPicks_ = 0;
+
+    history_.push_back(sample);
+
+    if (history_.size() > historySize_)
+    {
+        history_.pop_front();
+    }
+}
+
+void FrameStats::addPick(double _ms)
+{
+    pendingPickMs_ += _ms;
+    nPendingPicks_++;
+}
+
+const std::deque<FrameSample>& FrameStats::history() const
+{
+    return history_;
+}
+
+std::vector<int> FrameStats::histogram(int _nBins, double _binMs) const
+{
+    std::vector<int> bins(std::max(1, _nBins), 0);
+
+    std::deque<FrameSample>::const_iterator itSample(history_.begin()), historyEnd(history_.end());
+
+    for (; itSample!=historyEnd; ++itSample)
+    {
+        int bin = std::min<int>(bins.size() - 1, (int)(itSample->frameMs_ / _binMs));
+
+        bins[bin]++;
+    }
+
+    return bins;
+}
+
+double FrameStats::frameMsPercentile(double _p) const
+{
+    if (history_.empty())
+    {
+        return 0.0;
+    }
+
+    std::vector<double> times;
+
+    times.reserve(history_.size());
+
+    std::deque<FrameSample>::const_iterator itSample(history_.begin()), historyEnd(history_.end());
+
+    for (; itSample!=historyEnd; ++itSample)
+    {
+        times.push_back(itSample->frameMs_);
+    }
+
+    int k = std::min<int>(times.size() - 1, (int)(_p * times.size()));
+
+    std::nth_element(times.begin(), times.begin() + k, times.end());
+
+    return times[k];
+}
+
+bool FrameStats::saveCsv(const QString& _filename) const
+{
+    QFile file(_filename);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        qCritical() << "Could not open file " << _filename;
+        return false;
+    }
+
+    QTextStream out(&file);
+
+    out << "frame,frame_ms,pick_ms,picks,shapes,parts,triangles,draw_calls\n";
+
+    for (size_t i=0; i<history_.size(); ++i)
+    {
+        const FrameSample& sample = history_[i];
+
+        out << (qulonglong)i << "," << sample.frameMs_ << "," << sample.pickMs_ << "," << sample.nPicks_ << "," << sample.nShapes_ << "," << sample.nParts_ << "," << sample.nTriangles_ << "," << sample.nDrawCalls_ << "\n";
+    }
+
+    return out.status() == QTextStream::Ok;
+}
@@ -0,0 +1,86 @@
+//
+//  FrameStats.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <deque>
+#include <vector>
+#include <chrono>
+
+#include <QString>
+
+// What went into drawing one frame of a viewer
+// The times are those of the CPU issuing the GL calls, without a glFinish, so a frame that is slow on the GPU shows up in the next ones
+struct FrameSample
+{
+    double frameMs_ = 0.0;
+
+    // Picks run from mouse events between frames, their time is added to the next frame
+    double pickMs_ = 0.0;
+    int nPicks_ = 0;
+
+    int nShapes_ = 0;
+    int nParts_ = 0;
+    long long nTriangles_ = 0;
+
+    // glBegin/glEnd pairs and glDraw* calls
+    int nDrawCalls_ = 0;
+};
+
+// Counters of the frame being drawn, the shapes add to them as they draw
+// Drawing only happens on the GUI thread and one viewer at a time, so a single set serves all viewers
+inline FrameSample& currentFrame()
+{
+    static FrameSample frame;
+    return frame;
+}
+
+inline void countDrawCalls(int _nCalls, long long _nTriangles)
+{
+    FrameSample& frame = currentFrame();
+
+    frame.nDrawCalls_ += _nCalls;
+    frame.nTriangles_ += _nTriangles;
+}
+
+// Rolling history of the frames of a viewer
+class FrameStats
+{
+public:
+
+    explicit FrameStats(int _historySize = 300);
+
+    // Reset the counters of currentFrame() and start timing
+    void beginFrame();
+
+    // Time the frame and move it into the history
+    void endFrame();
+
+    void addPick(double _ms);
+
+    const std::deque<FrameSample>& history() const;
+
+    // Frame times of the history in _nBins bins of _binMs, the last bin also counts all slower frames
+    std::vector<int> histogram(int _nBins, double _binMs) const;
+
+    // _p in [0, 1] of the frame times of the history
+    double frameMsPercentile(double _p) const;
+
+    // One line per frame of the history, oldest first
+    bool saveCsv(const QString& _filename) const;
+
+private:
+
+    std::deque<FrameSample> history_;
+    size_t historySize_;
+
+    std::chrono::steady_clock::time_point frameStart_;
+
+    double pendingPickMs_;
+    int nPendingPicks_;
+};
+
+#endif
@@ -0,0 +1,312 @@
+//
+//  IncrementalPCA.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <cmath>
+
+#include <QDebug>
+
+#include "IncrementalPCA.h"
+#include "LinearAlgebra.h"
+
+IncrementalPCA::IncrementalPCA(int _maxRank) : maxRank_(std::max(_maxRank, 1)), count_(0), dimension_(0)
+{
+}
+
+void IncrementalPCA::reset()
+{
+    count_ = 0;
+    dimension_ = 0;
+
+    mean_.clear();
+    singularValues_.clear();
+    variances_.clear();
+    components_.clear();
+}
+
+bool IncrementalPCA::add(const std::vector<double>& _data, int _nRows, int _nColumns)
+{
+    if (_nRows <= 0 || _nColumns <= 0 || _data.size() != (size_t)_nRows * _nColumns || (count_ > 0 && _nColumns != dimension_))
+    {
+        qCritical() << "Cannot add " << _nRows << " x " << _nColumns << " values to a PCA of " << count_ << " descriptors with " << dimension_ << " values each";
+        return false;
+    }
+
+    if (count_ == 0)
+    {
+        dimension_ = _nColumns;
+        mean_.assign(dimension_, 0.0);
+    }
+
+    const int p = dimension_;
+
+    std::vector<double> batchMean(p, 0.0);
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        for (int j=0; j<p; ++j)
+        {
+            batchMean[j] += _data[(size_t)i * p + j];
+        }
+    }
+
+    for (int j=0; j<p; ++j)
+    {
+        batchMean[j] /= _nRows;
+    }
+
+    // The old components scaled by their singular values, the centred batch, and the row that accounts for the shift of the mean
+    const int rank = components_.size();
+    const int nStacked = rank + _nRows + (count_ > 0 ? 1 : 0);
+
+    std::vector<double> stacked((size_t)nStacked * p);
+
+    for (int c=0; c<rank; ++c)
+    {
+        for (int j=0; j<p; ++j)
+        {
+            stacked[(size_t)c * p + j] = singularValues_[c] * components_[c][j];
+        }
+    }
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        for (int j=0; j<p; ++j)
+        {
+            stacked[(size_t)(rank + i) * p + j] = _data[(size_t)i * p + j] - batchMean[j];
+        }
+    }
+
+    if (count_ > 0)
+    {
+        const double shift = std::sqrt((double)count_ * _nRows / (count_ + _nRows));
+
+        for (int j=0; j<p; ++j)
+        {
+            stacked[(size_t)(nStacked - 1) * p + j] = shift * (batchMean[j] - mean_[j]);
+        }
+    }
+
+    // The right singular vectors of the stacked rows, through the smaller of its two Gram matrices
+    std::vector<double> values, vectors;
+    std::vector< std::vector<double> > directions;
+
+    if (nStacked < p)
+    {
+        std::vector<double> gram((size_t)nStacked * nStacked, 0.0);
+
+        for (int a=0; a<nStacked; ++a)
+        {
+            for (int b=a; b<nStacked; ++b)
+            {
+                double d = 0.0;
+
+                for (int j=0; j<p; ++j)
+                {
+                    d += stacked[(size_t)a * p + j] * stacked[(size_t)b * p + j];
+                }
+
+                gram[a * nStacked + b] = gram[b * nStacked + a] = d;
+            }
+        }
+
+        symmetricEigen(nStacked, gram, values, vectors);
+
+        // v = M' u / sigma
+        for (int k=0; k<nStacked; ++k)
+        {
+            std::vector<double> v(p, 0.0);
+
+            const double sigma = std::sqrt(std::max(values[k], 0.0));
+
+            if (sigma > 0.0)
+            {
+                for (int a=0; a<nStacked; ++a)
+                {
+                    const double u = vectors[k * nStacked + a] / sigma;
+
+                    for (int j=0; j<p; ++j)
+                    {
+                        v[j] += u * stacked[(size_t)a * p + j];
+                    }
+                }
+            }
+
+            directions.push_back(v);
+        }
+    }
+    else
+    {
+        std::vector<double> scatter((size_t)p * p, 0.0);
+
+        for (int a=0; a<nStacked; ++a)
+        {
+            const double* row = &stacked[(size_t)a * p];
+
+            for (int j=0; j<p; ++j)
+            {
+                for (int l=j; l<p; ++l)
+                {
+                    scatter[j * p + l] += row[j] * row[l];
+                }
+            }
+        }
+
+        for (int j=0; j<p; ++j)
+        {
+            for (int l=0; l<j; ++l)
+            {
+                scatter[j * p + l] = scatter[l * p + j];
+            }
+        }
+
+        symmetricEigen(p, scatter, values, vectors);
+
+        for (int k=0; k<p; ++k)
+        {
+            directions.push_back(std::vector<double>(vectors.begin() + k * p, vectors.begin() + (k + 1) * p));
+        }
+    }
+
+    for (int j=0; j<p; ++j)
+    {
+        mean_[j] = (count_ * mean_[j] + _nRows * batchMean[j]) / (count_ + _nRows);
+    }
+
+    count_ += _nRows;
+
+    singularValues_.clear();
+    variances_.clear();
+    components_.clear();
+
+    const double largest = values.empty() ? 0.0 : values[0];
+
+    for (int k=0; k<values.size() && components_.size() < maxRank_; ++k)
+    {
+        if (!(values[k] > 1e-12 * largest) || !(values[k] > 0.0))
+        {
+            break;
+        }
+
+        std::vector<double>& v = directions[k];
+
+        // The sign of a singular vector is arbitrary, point its largest entry up so the components do not flip from batch to batch
+        const int largestEntry = std::max_element(v.begin(), v.end(), [](double _a, double _b) { return std::fabs(_a) < std::fabs(_b); }) - v.begin();
+
+        if (v[largestEntry] < 0.0)
+        {
+            for (int j=0; j<p; ++j)
+            {
+                v[j] = -v[j];
+            }
+        }
+
+        singularValues_.push_back(std::sqrt(values[k]));
+        variances_.push_back(count_ > 1 ? values[k] / (count_ - 1) : 0.0);
+        components_.push_back(v);
+    }
+
+    return true;
+}
+
+int IncrementalPCA::count() const
+{
+    return count_;
+}
+
+int IncrementalPCA::dimension() const
+{
+    return dimension_;
+}
+
+const std::vector<double>& IncrementalPCA::mean() const
+{
+    return mean_;
+}
+
+const std::vector<double>& IncrementalPCA::variances() const
+{
+    return variances_;
+}
+
+const std::vector< std::vector<double> >& IncrementalPCA::components() const
+{
+    return components_;
+}
+
+double IncrementalPCA::planeVariance(const std::vector<double>& _a, const std::vector<double>& _b) const
+{
+    if (_a.size() != dimension_ || _b.size() != dimension_)
+    {
+        return 0.0;
+    }
+
+    // Orthonormal directions of the plane by Gram-Schmidt, a degenerate plane is the line of _a
+    std::vector<double> e1(_a), e2(_b);
+
+    double norm1 = 0.0;
+
+    for (int j=0; j<dimension_; ++j)
+    {
+        norm1 += e1[j] * e1[j];
+    }
+
+    norm1 = std::sqrt(norm1);
+
+    if (norm1 == 0.0)
+    {
+        std::swap(e1, e2);
+        e2.assign(dimension_, 0.0);
+
+        for (int j=0; j<dimension_; ++j)
+        {
+            norm1 += e1[j] * e1[j];
+        }
+
+        norm1 = std::sqrt(norm1);
+
+        if (norm1 == 0.0)
+        {
+            return 0.0;
+        }
+    }
+
+    double d12 = 0.0;
+
+    for (int j=0; j<dimension_; ++j)
+    {
+        e1[j] /= norm1;
+        d12 += e1[j] * e2[j];
+    }
+
+    double norm2 = 0.0;
+
+    for (int j=0; j<dimension_; ++j)
+    {
+        e2[j] -= d12 * e1[j];
+        norm2 += e2[j] * e2[j];
+    }
+
+    norm2 = std::sqrt(norm2);
+
+    const bool plane = (norm2 > 1e-12 * norm1);
+
+    double variance = 0.0;
+
+    for (int c=0; c<components_.size(); ++c)
+    {
+        double c1 = 0.0, c2 = 0.0;
+
+        for (int j=0; j<dimension_; ++j)
+        {
+            c1 += components_[c][j] * e1[j];
+            c2 += components_[c][j] * e2[j];
+        }
+
+        variance += variances_[c] * (c1 * c1 + (plane ? c2 * c2 / (norm2 * norm2) : 0.0));
+    }
+
+    return variance;
+}
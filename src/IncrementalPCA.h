@@ -0,0 +1,58 @@
+//
+//  IncrementalPCA.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef INCREMENTALPCA_H
+#define INCREMENTALPCA_H
+
+#include <vector>
+
+// Principal components of descriptors that arrive batch after batch, the descriptors themselves are not kept
+// Every batch updates the running mean and a truncated SVD of the centred descriptors, as in the incremental PCA of Ross et al.
+class IncrementalPCA
+{
+public:
+
+    // Only the _maxRank strongest components are carried from one batch to the next
+    explicit IncrementalPCA(int _maxRank = 8);
+
+    void reset();
+
+    // Add the _nRows x _nColumns row major descriptors, every batch must have as many columns as the first one
+    bool add(const std::vector<double>& _data, int _nRows, int _nColumns);
+
+    // Descriptors added since the last reset
+    int count() const;
+
+    int dimension() const;
+
+    const std::vector<double>& mean() const;
+
+    // Variances along the components, largest first
+    const std::vector<double>& variances() const;
+
+    // Unit directions of the components, in the order of their variances
+    const std::vector< std::vector<double> >& components() const;
+
+    // Variance of the descriptors within the plane spanned by two directions that do not have to be orthogonal, as far as the kept components tell
+    double planeVariance(const std::vector<double>& _a, const std::vector<double>& _b) const;
+
+private:
+
+    int maxRank_;
+
+    int count_;
+
+    int dimension_;
+
+    std::vector<double> mean_;
+
+    std::vector<double> singularValues_;
+
+    std::vector<double> variances_;
+
+    std::vector< std::vector<double> > components_;
+};
+
+#endif
@@ -0,0 +1,103 @@
+//
+//  LRUCache.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// Small key-value cache that drops the least recently used entry once it holds more than its capacity
+template <typename Key, typename Value>
+class LRUCache
+{
+public:
+
+    explicit LRUCache(size_t _capacity = 1)
+    {
+        capacity_ = _capacity;
+    }
+
+    void setCapacity(size_t _capacity)
+    {
+        capacity_ = _capacity;
+        trim();
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    size_t size() const
+    {
+        return entries_.size();
+    }
+
+    // 0 if the key is not cached, otherwise the entry becomes the most recently used one
+    // The pointer stays valid until the entry is dropped
+    const Value* find(const Key& _key)
+    {
+        typename Index::iterator it = index_.find(_key);
+
+        if (it == index_.end())
+        {
+            return 0;
+        }
+
+        entries_.splice(entries_.begin(), entries_, it->second);
+
+        return &it->second->second;
+    }
+
+    void insert(const Key& _key, const Value& _value)
+    {
+        typename Index::iterator it = index_.find(_key);
+
+        if (it != index_.end())
+        {
+            it->second->second = _value;
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return;
+        }
+
+        entries_.push_front(std::make_pair(_key, _value));
+        index_[_key] = entries_.begin();
+
+        trim();
+    }
+
+    void clear()
+    {
+        entries_.clear();
+        index_.clear();
+    }
+
+private:
+
+    typedef std::list< std::pair<Key, Value> > Entries;
+    typedef std::unordered_map<Key, typename Entries::iterator> Index;
+
+    void trim()
+    {
+        while (entries_.size() > capacity_)
+        {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+    }
+
+
+    // DATA
+    Entries entries_; // most recently used first
+
+    Index index_;
+
+    size_t capacity_;
+};
+
+#endif
@@ -0,0 +1,352 @@
+//
+//  LinearAlgebra.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "LinearAlgebra.h"
+
+static double dot(int _n, const double* _x, const double* _y)
+{
+    double sum = 0.0;
+
+    for (int i=0; i<_n; ++i)
+    {
+        sum += _x[i] * _y[i];
+    }
+
+    return sum;
+}
+
+// Remove the components of _w along the first _nBasis vectors of _basis, twice, which is enough to keep the basis orthogonal to working precision
+static void orthogonalise(int _n, const std::vector<double>& _basis, int _nBasis, double* _w)
+{
+    for (int pass=0; pass<2; ++pass)
+    {
+        for (int i=0; i<_nBasis; ++i)
+        {
+            const double* q = &_basis[(size_t)i * _n];
+
+            double c = dot(_n, _w, q);
+
+            for (int k=0; k<_n; ++k)
+            {
+                _w[k] -= c * q[k];
+            }
+        }
+    }
+}
+
+void symmetricEigen(int _n, std::vector<double>& _a, std::vector<double>& _values, std::vector<double>& _vectors)
+{
+    // Columns of v are the eigenvectors
+    std::vector<double> v(_n * _n, 0.0);
+
+    for (int i=0; i<_n; ++i)
+    {
+        v[i * _n + i] = 1.0;
+    }
+
+    for (int sweep=0; sweep<100; ++sweep)
+    {
+        double offDiagonal = 0.0, diagonal = 0.0;
+
+        for (int p=0; p<_n; ++p)
+        {
+            diagonal += _a[p * _n + p] * _a[p * _n + p];
+
+            for (int q=p+1; q<_n; ++q)
+            {
+                offDiagonal += _a[p * _n + q] * _a[p * _n + q];
+            }
+        }
+
+        if (offDiagonal <= std::numeric_limits<double>::epsilon() * std::numeric_limits<double>::epsilon() * diagonal || offDiagonal == 0.0)
+        {
+            break;
+        }
+
+        for (int p=0; p<_n; ++p)
+        {
+            for (int q=p+1; q<_n; ++q)
+            {
+                const double apq = _a[p * _n + q];
+
+                if (apq == 0.0)
+                {
+                    continue;
+                }
+
+                // The rotation that zeroes a_pq, as in Numerical Recipes
+                const double theta = (_a[q * _n + q] - _a[p * _n + p]) / (2.0 * apq);
+                const double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                const double c = 1.0 / std::sqrt(t * t + 1.0);
+                const double s = t * c;
+
+                for (int k=0; k<_n; ++k)
+                {
+                    const double akp = _a[k * _n + p], akq = _a[k * _n + q];
+
+                    _a[k * _n + p] = c * akp - s * akq;
+                    _a[k * _n + q] = s * akp + c * akq;
+                }
+
+                for (int k=0; k<_n; ++k)
+                {
+                    const double apk = _a[p * _n + k], aqk = _a[q * _n + k];
+
+                    _a[p * _n + k] = c * apk - s * aqk;
+                    _a[q * _n + k] = s * apk + c * aqk;
+                }
+
+                for (int k=0; k<_n; ++k)
+                {
+                    const double vkp = v[k * _n + p], vkq = v[k * _n + q];
+
+                    v[k * _n + p] = c * vkp - s * vkq;
+                    v[k * _n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    std::vector<int> order(_n);
+
+    for (int i=0; i<_n; ++i)
+    {
+        order[i] = i;
+    }
+
+    std::sort(order.begin(), order.end(), [&](int _i, int _j) { return _a[_i * _n + _i] > _a[_j * _n + _j]; });
+
+    _values.resize(_n);
+    _vectors.resize(_n * _n);
+
+    for (int j=0; j<_n; ++j)
+    {
+        _values[j] = _a[order[j] * _n + order[j]];
+
+        for (int i=0; i<_n; ++i)
+        {
+            _vectors[j * _n + i] = v[i * _n + order[j]];
+        }
+    }
+}
+
+bool lanczosEigen(int _n, const MatrixVectorProduct& _product, int _nEigen, std::vector<double>& _values, std::vector<double>& _vectors, int _basisSize, int _maxProducts, double _tolerance, unsigned long long _seed)
+{
+    _values.clear();
+    _vectors.clear();
+
+    if (_n <= 0 || _nEigen <= 0)
+    {
+        return false;
+    }
+
+    _nEigen = std::min(_nEigen, _n);
+
+    int maxSize = (_basisSize > 0) ? _basisSize : std::max(2 * _nEigen + 40, 4 * _nEigen);
+    maxSize = std::min(std::max(maxSize, _nEigen + 2), _n);
+
+    // Ritz vectors kept over a restart
+    const int nKept = std::max(_nEigen, maxSize / 2);
+
+    const int maxProducts = std::max((_maxProducts > 0) ? _maxProducts : 20 * maxSize, maxSize);
+
+    std::mt19937_64 generator(_seed);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    std::vector<double> basis;
+    basis.reserve((size_t)maxSize * _n);
+
+    // Projection of the matrix on the basis, tridiagonal until the first restart and an arrowhead in its top left corner after it
+    std::vector<double> h(maxSize * maxSize, 0.0);
+
+    std::vector<double> q(_n), w(_n);
+
+    for (int i=0; i<_n; ++i)
+    {
+        q[i] = uniform(generator);
+    }
+
+    double norm = std::sqrt(dot(_n, q.data(), q.data()));
+
+    for (int i=0; i<_n; ++i)
+    {
+        q[i] /= norm;
+    }
+
+    basis.insert(basis.end(), q.begin(), q.end());
+
+    int size = 1;
+
+    // Largest entry of the projection so far, the scale for the breakdown test
+    double scale = 0.0;
+
+    bool converged = false;
+
+    std::vector<double> ritzValues, ritzVectors;
+
+    for (int nProducts=1; ; ++nProducts)
+    {
+        const int j = size - 1;
+
+        _product(&basis[(size_t)j * _n], w.data());
+
+        // Gram-Schmidt twice, the coefficients of both passes add up to column j of the projection
+        std::vector<double> coefficients(size, 0.0);
+
+        for (int pass=0; pass<2; ++pass)
+        {
+            for (int i=0; i<size; ++i)
+            {
+                const double* qi = &basis[(size_t)i * _n];
+
+                double c = dot(_n, w.data(), qi);
+
+                for (int k=0; k<_n; ++k)
+                {
+                    w[k] -= c * qi[k];
+                }
+
+                coefficients[i] += c;
+            }
+        }
+
+        for (int i=0; i<size; ++i)
+        {
+            h[i * maxSize + j] = coefficients[i];
+            h[j * maxSize + i] = coefficients[i];
+        }
+
+        double b = std::sqrt(dot(_n, w.data(), w.data()));
+
+        scale = std::max(scale, std::max(std::fabs(coefficients[j]), b));
+
+        const bool breakdown = (b <= 1e-13 * scale);
+        const bool full = (size == maxSize);
+        const bool outOfProducts = (nProducts >= maxProducts);
+
+        if (size >= _nEigen && (size % 5 == 0 || breakdown || full || outOfProducts))
+        {
+            std::vector<double> t(size * size);
+
+            for (int r=0; r<size; ++r)
+            {
+                for (int c=0; c<size; ++c)
+                {
+                    t[r * size + c] = h[r * maxSize + c];
+                }
+            }
+
+            symmetricEigen(size, t, ritzValues, ritzVectors);
+
+            double largest = 0.0;
+
+            for (int i=0; i<size; ++i)
+            {
+                largest = std::max(largest, std::fabs(ritzValues[i]));
+            }
+
+            // The residual of a Ritz pair is b times the last component of its eigenvector of the projection
+            converged = true;
+
+            for (int i=0; i<_nEigen && converged; ++i)
+            {
+                converged = std::fabs(b * ritzVectors[i * size + size - 1]) <= _tolerance * std::max(largest, std::numeric_limits<double>::min());
+            }
+
+            converged = converged || breakdown;
+
+            if (converged || outOfProducts || (full && nKept >= size))
+            {
+                break;
+            }
+
+            if (full)
+            {
+                // Thick restart: carry on from the best Ritz vectors, the projection on them is diagonal and the next vector couples to all of them
+                std::vector<double> kept((size_t)nKept * _n, 0.0);
+
+                for (int r=0; r<nKept; ++r)
+                {
+                    double* v = &kept[(size_t)r * _n];
+
+                    for (int i=0; i<size; ++i)
+                    {
+                        const double s = ritzVectors[r * size + i];
+                        const double* qi = &basis[(size_t)i * _n];
+
+                        for (int k=0; k<_n; ++k)
+                        {
+                            v[k] += s * qi[k];
+                        }
+                    }
+                }
+
+                basis.swap(kept);
+
+                std::fill(h.begin(), h.end(), 0.0);
+
+                for (int r=0; r<nKept; ++r)
+                {
+                    h[r * maxSize + r] = ritzValues[r];
+                }
+
+                size = nKept;
+            }
+        }
+
+        if (breakdown)
+        {
+            // The space is invariant before it holds enough eigenvectors, carry on from a new direction orthogonal to it
+            for (int i=0; i<_n; ++i)
+            {
+                w[i] = uniform(generator);
+            }
+
+            orthogonalise(_n, basis, size, w.data());
+
+            norm = std::sqrt(dot(_n, w.data(), w.data()));
+        }
+        else
+        {
+            norm = b;
+        }
+
+        for (int i=0; i<_n; ++i)
+        {
+            q[i] = w[i] / norm;
+        }
+
+        basis.insert(basis.end(), q.begin(), q.end());
+        ++size;
+    }
+
+    const int nFound = std::min(_nEigen, size);
+
+    _values.assign(ritzValues.begin(), ritzValues.begin() + nFound);
+    _vectors.assign((size_t)nFound * _n, 0.0);
+
+    for (int j=0; j<nFound; ++j)
+    {
+        double* v = &_vectors[(size_t)j * _n];
+
+        for (int i=0; i<size; ++i)
+        {
+            const double s = ritzVectors[j * size + i];
+            const double* qi = &basis[(size_t)i * _n];
+
+            for (int k=0; k<_n; ++k)
+            {
+                v[k] += s * qi[k];
+            }
+        }
+    }
+
+    return converged && nFound == _nEigen;
+}
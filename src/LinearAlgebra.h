@@ -0,0 +1,28 @@
+//
+//  LinearAlgebra.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef LINEARALGEBRA_H
+#define LINEARALGEBRA_H
+
+#include <vector>
+#include <functional>
+
+// The few dense eigen solvers the embeddings need, so that they do not have to go through MATLAB
+// Eigenvectors are returned one after the other, component i of eigenvector j is _vectors[j * n + i]
+
+// _product(x, y) sets y = A x for a symmetric n x n matrix A that is never formed explicitly
+typedef std::function<void(const double*, double*)> MatrixVectorProduct;
+
+// All eigenpairs of the symmetric n x n row major matrix _a by cyclic Jacobi rotations, largest eigenvalue first
+// Meant for small matrices, _a is overwritten
+void symmetricEigen(int _n, std::vector<double>& _a, std::vector<double>& _values, std::vector<double>& _vectors);
+
+// The _nEigen algebraically largest eigenpairs of a symmetric n x n matrix, largest first, by Lanczos iterations with full reorthogonalisation
+// The Krylov space holds up to _basisSize vectors (0 picks a size from _nEigen), when it is full it is thick restarted from its best Ritz vectors, so memory stays at _basisSize vectors of n
+// Stops once the Ritz pairs are converged to _tolerance relative to the largest eigenvalue, or after _maxProducts products (0 means 20 times the basis size)
+// Returns false if the pairs did not converge, the best ones found are returned anyway
+bool lanczosEigen(int _n, const MatrixVectorProduct& _product, int _nEigen, std::vector<double>& _values, std::vector<double>& _vectors, int _basisSize = 0, int _maxProducts = 0, double _tolerance = 1e-8, unsigned long long _seed = 1);
+
+#endif
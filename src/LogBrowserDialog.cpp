@@ -13,6 +13,8 @@
 
 #include "LogBrowserDialog.h"
 
+#include <limits>
+
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QTextBrowser>
@@ -24,6 +26,29 @@
 #include <QTextStream>
 #include <QCloseEvent>
 #include <QKeyEvent>
+#include <QTimer>
+
+#include "AsyncLog.h"
+
+static const int FLUSH_INTERVAL_MS = 100;
+static const size_t MAX_MESSAGES_PER_FLUSH = 500;
+
+static QString formatMessage(QtMsgType type, const QString &msg)
+{
+    switch (type) {
+        case QtWarningMsg:
+            return QObject::tr("-- WARNING: %1").arg(msg);
+            
+        case QtCriticalMsg:
+            return QObject::tr("-- CRITICAL: %1").arg(msg);
+            
+        case QtFatalMsg:
+            return QObject::tr("-- FATAL: %1").arg(msg);
+            
+        default:
+            return msg;
+    }
+}
 
 LogBrowserDialog::LogBrowserDialog(QWidget *parent)
 : QWidget(parent)
@@ -52,6 +77,10 @@ LogBrowserDialog::LogBrowserDialog(QWidget *parent)
     buttonLayout->addWidget(saveButton);
     connect(saveButton, SIGNAL(clicked()), this, SLOT(save()));
     
+    flushTimer = new QTimer(this);
+    flushTimer->setInterval(FLUSH_INTERVAL_MS);
+    connect(flushTimer, SIGNAL(timeout()), this, SLOT(flushMessages()));
+    flushTimer->start();
 }
 
 
@@ -63,28 +92,48 @@ LogBrowserDialog::~LogBrowserDialog()
 
 void LogBrowserDialog::outputMessage(QtMsgType type, const QString &msg)
 {
-    switch (type) {
-        case QtDebugMsg:
-            browser->append(msg);
-            break;
-            
-        case QtWarningMsg:
-            browser->append(tr("-- WARNING: %1").arg(msg));
-            break;
-            
-        case QtCriticalMsg:
-            browser->append(tr("-- CRITICAL: %1").arg(msg));
-            break;
-            
-        case QtFatalMsg:
-            browser->append(tr("-- FATAL: %1").arg(msg));
-            break;
+    browser->append(formatMessage(type, msg));
+}
+
+
+void LogBrowserDialog::flushMessages()
+{
+    appendQueuedMessages(MAX_MESSAGES_PER_FLUSH);
+}
+
+
+void LogBrowserDialog::appendQueuedMessages(size_t maxMessages)
+{
+    std::vector<AsyncLog::Message> messages;
+    size_t nDropped = 0;
+    
+    AsyncLog::drain(messages, maxMessages, nDropped);
+    
+    if (messages.empty() && nDropped == 0)
+    {
+        return;
     }
+    
+    QStringList lines;
+    
+    if (nDropped > 0)
+    {
+        lines << tr("-- WARNING: %1 messages were dropped, the log could not keep up").arg((qulonglong)nDropped);
+    }
+    
+    for (size_t i=0; i<messages.size(); ++i)
+    {
+        lines << formatMessage(messages[i].type_, messages[i].text_);
+    }
+    
+    browser->append(lines.join("\n"));
 }
 
 
 void LogBrowserDialog::save()
 {
+    // Whatever is still queued goes into the file as well
+    appendQueuedMessages(std::numeric_limits<size_t>::max());
     
     QString saveFileName("full-log.txt");
     
@@ -19,6 +19,7 @@
 
 class QTextBrowser;
 class QPushButton;
+class QTimer;
 
 class LogBrowserDialog : public QWidget
 {
@@ -32,6 +33,8 @@ public:
 public slots:
     void outputMessage( QtMsgType type, const QString &msg );
     
+    // Append what the message handler queued in AsyncLog since the last call, as a single block of text
+    void flushMessages();
 
     void save();
     
@@ -40,9 +43,14 @@ protected:
     virtual void keyPressEvent( QKeyEvent *e );
     virtual void closeEvent( QCloseEvent *e );
     
+    void appendQueuedMessages(size_t maxMessages);
+    
     QTextBrowser *browser;
     QPushButton *clearButton;
     QPushButton *saveButton;
+    
+    // Appending is limited to a batch every interval, so a burst of messages does not keep the GUI thread busy
+    QTimer *flushTimer;
 };
 
 #endif // DIALOG_H
@@ -0,0 +1,261 @@
+//
+//  MDS.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <QDebug>
+
+#include "MDS.h"
+#include "LinearAlgebra.h"
+#include "WorkStealingPool.h"
+
+// Rows of a matrix handled by one task of the pool
+static const int MDS_BLOCK_SIZE = 256;
+
+static int nBlocks(int _n)
+{
+    return (_n + MDS_BLOCK_SIZE - 1) / MDS_BLOCK_SIZE;
+}
+
+// Squared distances of the rows [_begin, _end) of _data to row _from
+static void squaredDistances(const std::vector<double>& _data, int _nColumns, int _from, int _begin, int _end, double* _distances)
+{
+    const double* from = &_data[(size_t)_from * _nColumns];
+
+    for (int i=_begin; i<_end; ++i)
+    {
+        const double* row = &_data[(size_t)i * _nColumns];
+
+        double d = 0.0;
+
+        for (int c=0; c<_nColumns; ++c)
+        {
+            d += (row[c] - from[c]) * (row[c] - from[c]);
+        }
+
+        _distances[i] = d;
+    }
+}
+
+bool computeMDS(const std::vector<double>& _data, int _nRows, int _nColumns, std::vector<double>& _embedding, const MDSOptions& _options)
+{
+    const int nDims = _options.nDims_;
+
+    if (_nRows <= 0 || nDims <= 0 || _data.size() != (size_t)_nRows * _nColumns)
+    {
+        qCritical() << "Cannot compute MDS of " << _nRows << " x " << _nColumns << " values in " << nDims << " dimensions";
+        return false;
+    }
+
+    _embedding.assign((size_t)_nRows * nDims, 0.0);
+
+    if (_nRows == 1)
+    {
+        return true;
+    }
+
+    WorkStealingPool pool(_options.nThreads_);
+
+    const bool classical = (_nRows <= _options.maxClassical_);
+
+    // Row l holds the squared distances of every point to landmark l
+    std::vector<double> distances;
+    std::vector<int> landmarks;
+
+    if (classical)
+    {
+        distances.resize((size_t)_nRows * _nRows);
+
+        for (int i=0; i<_nRows; ++i)
+        {
+            landmarks.push_back(i);
+        }
+
+        pool.run(_nRows, [&](int _row, int _worker)
+        {
+            squaredDistances(_data, _nColumns, _row, 0, _nRows, &distances[(size_t)_row * _nRows]);
+        });
+    }
+    else
+    {
+        const int maxLandmarks = std::min(std::max(_options.nLandmarks_, nDims + 1), _nRows);
+
+        distances.reserve((size_t)maxLandmarks * _nRows);
+
+        // Squared distance of every point to its closest landmark, the next landmark is the farthest point
+        std::vector<double> closest(_nRows, std::numeric_limits<double>::max());
+
+        std::mt19937_64 generator(_options.seed_);
+
+        int next = generator() % _nRows;
+
+        while ((int)landmarks.size() < maxLandmarks)
+        {
+            landmarks.push_back(next);
+
+            distances.resize(distances.size() + _nRows);
+
+            double* row = &distances[distances.size() - _nRows];
+
+            pool.run(nBlocks(_nRows), [&](int _block, int _worker)
+            {
+                const int begin = _block * MDS_BLOCK_SIZE;
+                const int end = std::min(_nRows, begin + MDS_BLOCK_SIZE);
+
+                squaredDistances(_data, _nColumns, next, begin, end, row);
+
+                for (int i=begin; i<end; ++i)
+                {
+                    closest[i] = std::min(closest[i], row[i]);
+                }
+            });
+
+            next = std::max_element(closest.begin(), closest.end()) - closest.begin();
+
+            // Every point sits on a landmark, more landmarks would only repeat them
+            if (closest[next] == 0.0)
+            {
+                break;
+            }
+        }
+    }
+
+    const int nLandmarks = landmarks.size();
+
+    // Distances between the landmarks, the full matrix for classical MDS
+    std::vector<double> landmarkDistances;
+
+    if (!classical)
+    {
+        landmarkDistances.resize(nLandmarks * nLandmarks);
+
+        for (int a=0; a<nLandmarks; ++a)
+        {
+            for (int b=0; b<nLandmarks; ++b)
+            {
+                landmarkDistances[a * nLandmarks + b] = distances[(size_t)a * _nRows + landmarks[b]];
+            }
+        }
+    }
+
+    const double* dLL = classical ? distances.data() : landmarkDistances.data();
+
+    // The landmark matrix is symmetric, so its row means are its column means as well
+    std::vector<double> means(nLandmarks, 0.0);
+    double grandMean = 0.0;
+
+    for (int a=0; a<nLandmarks; ++a)
+    {
+        for (int b=0; b<nLandmarks; ++b)
+        {
+            means[a] += dLL[(size_t)a * nLandmarks + b];
+        }
+
+        means[a] /= nLandmarks;
+        grandMean += means[a];
+    }
+
+    grandMean /= nLandmarks;
+
+    // B = -1/2 J D J with the centring matrix J, applied without forming B
+    MatrixVectorProduct product = [&](const double* _x, double* _y)
+    {
+        double sumX = 0.0, meansX = 0.0;
+
+        for (int b=0; b<nLandmarks; ++b)
+        {
+            sumX += _x[b];
+            meansX += means[b] * _x[b];
+        }
+
+        pool.run(nBlocks(nLandmarks), [&](int _block, int _worker)
+        {
+            const int end = std::min(nLandmarks, (_block + 1) * MDS_BLOCK_SIZE);
+
+            for (int a=_block * MDS_BLOCK_SIZE; a<end; ++a)
+            {
+                const double* row = dLL + (size_t)a * nLandmarks;
+
+                double dX = 0.0;
+
+                for (int b=0; b<nLandmarks; ++b)
+                {
+                    dX += row[b] * _x[b];
+                }
+
+                _y[a] = -0.5 * (dX - means[a] * sumX - meansX + grandMean * sumX);
+            }
+        });
+    };
+
+    std::vector<double> values, vectors;
+
+    if (!lanczosEigen(nLandmarks, product, std::min(nDims, nLandmarks), values, vectors, 0, 0, 1e-8, _options.seed_))
+    {
+        qWarning() << "MDS eigenvectors did not fully converge";
+    }
+
+    // Dimensions with no positive eigenvalue are left at zero, as cmdscale does not return them either
+    std::vector<double> scales(values.size(), 0.0);
+
+    for (int d=0; d<values.size(); ++d)
+    {
+        if (values[d] > 1e-12 * std::max(values[0], 0.0) && values[d] > 0.0)
+        {
+            scales[d] = 1.0 / std::sqrt(values[d]);
+        }
+    }
+
+    if (classical)
+    {
+        // The points are the landmarks, their coordinates are the scaled eigenvectors
+        for (int d=0; d<values.size(); ++d)
+        {
+            const double scale = (scales[d] > 0.0) ? std::sqrt(values[d]) : 0.0;
+
+            for (int i=0; i<_nRows; ++i)
+            {
+                _embedding[(size_t)i * nDims + d] = scale * vectors[(size_t)d * nLandmarks + i];
+            }
+        }
+    }
+    else
+    {
+        // Every point is placed by its distances to the landmarks, y_d = -1/2 v_d (delta - means) / sqrt(lambda_d)
+        pool.run(nBlocks(_nRows), [&](int _block, int _worker)
+        {
+            const int end = std::min(_nRows, (_block + 1) * MDS_BLOCK_SIZE);
+
+            for (int i=_block * MDS_BLOCK_SIZE; i<end; ++i)
+            {
+                for (int d=0; d<values.size(); ++d)
+                {
+                    if (scales[d] == 0.0)
+                    {
+                        continue;
+                    }
+
+                    const double* v = &vectors[(size_t)d * nLandmarks];
+
+                    double y = 0.0;
+
+                    for (int a=0; a<nLandmarks; ++a)
+                    {
+                        y += v[a] * (distances[(size_t)a * _nRows + i] - means[a]);
+                    }
+
+                    _embedding[(size_t)i * nDims + d] = -0.5 * scales[d] * y;
+                }
+            }
+        });
+    }
+
+    qDebug() << (classical ? "Classical" : "Landmark") << " MDS of " << _nRows << " points with " << nLandmarks << " landmarks done" ;
+
+    return true;
+}
@@ -0,0 +1,33 @@
+//
+//  MDS.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef MDS_H
+#define MDS_H
+
+#include <vector>
+
+struct MDSOptions
+{
+    int nDims_ = 2;
+
+    // Up to this many points get classical MDS on the full distance matrix, larger sets go through landmarks
+    int maxClassical_ = 2000;
+
+    // Landmarks for the larger sets, memory is O(N nLandmarks_)
+    int nLandmarks_ = 256;
+
+    // Picks the first landmark, the others are the points farthest from the landmarks chosen before them
+    unsigned long long seed_ = 1;
+
+    // 0 means one per hardware thread
+    int nThreads_ = 0;
+};
+
+// Embed the rows of the _nRows x _nColumns row major _data in _options.nDims_ dimensions so that their Euclidean distances are kept as well as possible
+// This is what MATLAB's cmdscale(pdist(data)) gives for small sets, for larger ones it is the landmark MDS of de Silva and Tenenbaum, which places every point by its distances to the landmarks
+// _embedding is _nRows x nDims_ row major, dimensions the distances do not fill are left at zero
+bool computeMDS(const std::vector<double>& _data, int _nRows, int _nColumns, std::vector<double>& _embedding, const MDSOptions& _options = MDSOptions());
+
+#endif
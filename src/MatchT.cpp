@@ -88,7 +88,7 @@ template <typename M> void MatchT<M>::setPoints(const std::vector<MeshPoint>& _p
     points_ = _points;
 }
 
-template <typename M> const QString& MatchT<M>::meshFilename()
+template <typename M> const QString& MatchT<M>::meshFilename() const
 {
     return meshFilename_;
 }
@@ -323,6 +323,8 @@ template <typename M> bool MatchT<M>::open(const char *_filename)
     
     fclose(file);
     
+    updateGroupingKeys();
+    
     return true;
 }
 
@@ -452,6 +454,8 @@ template <typename M> bool MatchT<M>::open(const QString& _values)
         label_ = lineList.at(ind).toInt();
     }
     
+    updateGroupingKeys();
+    
     return true;
 }
 
@@ -561,6 +565,8 @@ template <typename M> void MatchT<M>::normaliseMeshToTemplate()
         ShapeT<M>::mesh_.set_point(vIt, (scaleFactor*(ShapeT<M>::mesh_.point(vIt) - meshCentroid_)));
     }
     
+    ShapeT<M>::geometryChanged();
+    
     normalised_ = true;
 }
 
@@ -574,6 +580,8 @@ template <typename M> void MatchT<M>::alignMeshToTemplate()
         ShapeT<M>::mesh_.set_point(vIt, mv(alignMtx_, ShapeT<M>::mesh_.point(vIt)) );
     }
     
+    ShapeT<M>::geometryChanged();
+    
     aligned_ = true;
 }
 
@@ -735,6 +743,8 @@ template <typename M> void MatchT<M>::draw(const std::string& _drawMode) const
                 glMaterialfv(_f, _m, &color[0]);
                 
                 cPart.partShape_.draw(_drawMode);
+                
+                currentFrame().nParts_++;
             }
             else
             {
@@ -769,6 +779,8 @@ template <typename M> void MatchT<M>::draw(const std::string& _drawMode) const
                         glMaterialfv(_f, _m, &color[0]);
 
                         itPart->partShape_.draw(_drawMode);
+                        
+                        currentFrame().nParts_++;
                     }
                 }
             }
@@ -827,6 +839,9 @@ template <typename M> void MatchT<M>::draw_point(const MeshPoint& cPoint) const
     
     glutSolidSphere(0.01, 32, 32);
     
+    // glut draws a strip or a fan per stack
+    countDrawCalls(32, 2 * 32 * 32);
+    
     glPopMatrix();
 }
 
@@ -864,6 +879,8 @@ template <typename M> void MatchT<M>::draw_part(const Part& cPart) const
     
     glutSolidCube(1);
     
+    countDrawCalls(1, 12);
+    
     glPopMatrix();
     
 }
@@ -1296,6 +1313,8 @@ template <typename M> void MatchT<M>::split()
     {
         typename ShapeT<M>::Mesh& cMesh = partsIt->partShape_.mesh();
         
+        partsIt->partShape_.geometryChanged();
+        
         cMesh.request_face_normals();
         cMesh.request_vertex_normals();
         cMesh.update_face_normals();
@@ -1515,13 +1534,15 @@ template <typename M> bool MatchT<M>::openPartMeshIfNotOpened(Part& _cPart)
     
     if( cMesh.n_vertices() == 0 )
     {
+        TRACE_SPAN("MatchT::openPartMeshIfNotOpened");
+        
         QString partMeshName = meshFilename_+QString(".p%1.off").arg(_cPart.partID_);
         
-        qWarning() << "Selected part's mesh was not loaded before, loading mesh now from: " << partMeshName ;
+        LOG_DEBUG() << "Selected part's mesh was not loaded before, loading mesh now from: " << partMeshName ;
         
         _cPart.partShape_.setFilename(partMeshName);
         
-        if( !_cPart.partShape_.openMesh(partMeshName.toStdString().c_str()) )
+        if( !openPartMesh(_cPart, partMeshName) )
         {
             qCritical() << "Cannot read mesh from file: " << partMeshName;
             return false;
@@ -1539,6 +1560,16 @@ template <typename M> bool MatchT<M>::openPartMeshIfNotOpened(Part& _cPart)
 }
 
 
+template <typename M> bool MatchT<M>::openPartMesh(Part& _cPart, const QString& _partMeshName)
+{
+    if (PartMeshFile::isUpToDate(_partMeshName) && _cPart.partShape_.openBinaryMesh(PartMeshFile::binaryFilename(_partMeshName)))
+    {
+        return true;
+    }
+    
+    return _cPart.partShape_.openMesh(_partMeshName.toStdString().c_str());
+}
+
 template <typename M> void MatchT<M>::openPartMeshes()
 {
     typename std::vector<Part>::iterator pIt(parts_.begin()), pEnd(parts_.end());
@@ -1552,7 +1583,7 @@ template <typename M> void MatchT<M>::openPartMeshes()
         
         pIt->partShape_.setFilename(partMeshName);
         
-        if( pIt->partShape_.openMesh(partMeshName.toStdString().c_str()) )
+        if( openPartMesh(*pIt, partMeshName) )
         {
             segmented_ = true;
         }
@@ -1598,3 +1629,52 @@ template <typename M> void MatchT<M>::setHoveredPartID(int _hoveredPartID)
 {
     hoveredPartID_ = _hoveredPartID;
 }
+
+template <typename M> void MatchT<M>::setFilename(const QString& _filename)
+{
+    ShapeT<M>::setFilename(_filename);
+    
+    updateGroupingKeys();
+}
+
+template <typename M> const QString& MatchT<M>::shortName() const
+{
+    return shortName_;
+}
+
+template <typename M> uint64_t MatchT<M>::partSignature() const
+{
+    return partSignature_;
+}
+
+template <typename M> void MatchT<M>::updateGroupingKeys()
+{
+    const QString& fname = ShapeT<M>::filename_;
+    
+    // Same as filename_.split("/").last().split(".").first(), without building the intermediate lists
+    int start = fname.lastIndexOf('/') + 1;
+    int end = fname.indexOf('.', start);
+    
+    shortName_ = (end < 0) ? fname.mid(start) : fname.mid(start, end - start);
+    
+    // FNV-1a over the (partID, partType) sequence, parts are kept in the order they were read so the sequence is canonical
+    uint64_t h = 14695981039346656037ULL;
+    
+    typename std::vector<Part>::const_iterator pIt(parts_.begin()), pEnd(parts_.end());
+    
+    for (; pIt != pEnd; ++pIt)
+    {
+        uint32_t vals[2] = { (uint32_t)pIt->partID_, (uint32_t)pIt->partType_ };
+        
+        for (int v=0; v<2; ++v)
+        {
+            for (int b=0; b<4; ++b)
+            {
+                h ^= (vals[v] >> (8*b)) & 0xff;
+                h *= 1099511628211ULL;
+            }
+        }
+    }
+    
+    partSignature_ = h;
+}
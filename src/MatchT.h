@@ -14,6 +14,7 @@
 #include <QHBoxLayout>
 
 #include <unordered_map>
+#include <cstdint>
 
 #include <XForm.h>
 
@@ -128,7 +129,7 @@ public:
     
     void setPoints(const std::vector<MeshPoint>& _points);
     
-    const QString& meshFilename();
+    const QString& meshFilename() const;
     
     void setMeshFilename(const QString& _filename);
     
@@ -202,8 +203,23 @@ public:
     
     void setHoveredPartID(int _hoveredPartID);
     
+    // The cached short name follows the filename, also when it is set through a Shape
+    virtual void setFilename(const QString& _filename);
+    
+    // Short name of the match (filename without directory and extension), cached at load
+    const QString& shortName() const;
+    
+    // 64-bit hash of the ordered (partID, partType) pairs, matches with the same parts share a signature
+    uint64_t partSignature() const;
+    
+    // Recompute the short name and part signature, call after changing the filename or the parts
+    void updateGroupingKeys();
+    
 private:
     
+    // Read a part mesh from its binary copy when that is up to date, from the OFF file otherwise
+    bool openPartMesh(Part& _cPart, const QString& _partMeshName);
+    
     void normaliseMeshToTemplate();
 
     void alignMeshToTemplate();
@@ -259,6 +275,10 @@ private:
     bool colorOverride_ = false;
     
     int hoveredPartID_ = -1;
+    
+    QString shortName_;
+    
+    uint64_t partSignature_ = 0;
 };
 
 //=============================================================================
@@ -0,0 +1,197 @@
+//
+//  MatlabBackend.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <cstring>
+
+#include <QDebug>
+#include <QString>
+
+#include "MatlabBackend.h"
+#include "global.h"
+
+MatlabBackend::MatlabBackend() : matlabEngine_(0)
+{
+}
+
+MatlabBackend::~MatlabBackend()
+{
+    if (matlabEngine_)
+    {
+        engClose(matlabEngine_);
+    }
+}
+
+const char* MatlabBackend::name() const
+{
+    return "MATLAB";
+}
+
+bool MatlabBackend::openEngine()
+{
+    if (matlabEngine_)
+    {
+        return true;
+    }
+
+    if (!(matlabEngine_ = engOpen(MATLAB_APP_PATH.c_str())))
+    {
+        qCritical() << "Can't start MATLAB engine" ;
+        return false;
+    }
+
+    engSetVisible(matlabEngine_, true);
+
+    std::string code("addpath('");
+    code += MATLAB_FILE_PATH;
+    code += "');";
+
+    engEvalString(matlabEngine_, code.c_str());
+
+    return true;
+}
+
+bool MatlabBackend::putMatrix(const ComputeMatrix& _matrix)
+{
+    if (!openEngine())
+    {
+        return false;
+    }
+
+    if (_matrix.data_.size() != (size_t)_matrix.nRows_ * _matrix.nColumns_)
+    {
+        qCritical() << "Matrix " << QString(_matrix.name_.c_str()) << " claims " << _matrix.nRows_ << " x " << _matrix.nColumns_ << " values but holds " << (int)_matrix.data_.size();
+        return false;
+    }
+
+    // Both are column major, a single copy into the array and engPutVariable sends it to the engine, after which the array can go
+    mxArray* array = mxCreateDoubleMatrix(_matrix.nRows_, _matrix.nColumns_, mxREAL);
+
+    if (!_matrix.data_.empty())
+    {
+        std::memcpy(mxGetPr(array), _matrix.data_.data(), _matrix.data_.size() * sizeof(double));
+    }
+
+    bool ok = (engPutVariable(matlabEngine_, _matrix.name_.c_str(), array) == 0);
+
+    mxDestroyArray(array);
+
+    if (!ok)
+    {
+        qCritical() << "Could not send " << QString(_matrix.name_.c_str()) << " to Matlab!";
+    }
+
+    return ok;
+}
+
+bool MatlabBackend::runRoutine(const std::string& _routine)
+{
+    if (!openEngine())
+    {
+        return false;
+    }
+
+    std::string code;
+
+    if (_routine == "pca")
+    {
+        code = "descriptors(find(isinf(descriptors) == 1)) = 0; \
+                descriptors(find(isnan(descriptors) == 1)) = 0; \
+                [coefs,pr_desc] = princomp(descriptors); \
+                deformation_basis = coefs(:,1:2); \
+                projected_descriptors = pr_desc(:,1:2); ";
+    }
+    else if (_routine == "mds")
+    {
+        code = "diss = pdist(descriptors); \
+                [pr_desc,eigvalues] = cmdscale(diss); \
+                projected_descriptors = pr_desc(:,1:2); ";
+    }
+    else if (_routine == "cluster")
+    {
+        code = "fraction = 0.05; \
+                bandwidth = .25*compute_spread(projected_descriptors, fraction);  \
+                [clustCent,point2cluster,clustMembsCell] = MeanShiftCluster(projected_descriptors',bandwidth); \
+                point2cluster = point2cluster'; \
+                clustCent = clustCent'; \
+                nofClusters = size(clustCent,1); \
+                [clustCent, point2cluster] = sortClusters(clustCent,point2cluster,nofClusters); ";
+    }
+    else
+    {
+        qCritical() << "Unknown routine " << QString(_routine.c_str());
+        return false;
+    }
+
+    // engEvalString only fails when the engine is gone, errors in the code are caught and their message read back
+    std::string wrapped = "shapesynth_error = ''; try, " + code + " catch e, shapesynth_error = e.message; end";
+
+    if (engEvalString(matlabEngine_, wrapped.c_str()) != 0)
+    {
+        qCritical() << "The MATLAB engine stopped while running " << QString(_routine.c_str());
+
+        engClose(matlabEngine_);
+        matlabEngine_ = 0;
+
+        return false;
+    }
+
+    mxArray* error = engGetVariable(matlabEngine_, "shapesynth_error");
+
+    bool ok = true;
+
+    if (error && mxGetNumberOfElements(error) > 0)
+    {
+        char* message = mxArrayToString(error);
+
+        qCritical() << "Matlab failed to run " << QString(_routine.c_str()) << ": " << message;
+
+        mxFree(message);
+
+        ok = false;
+    }
+
+    if (error)
+    {
+        mxDestroyArray(error);
+    }
+
+    return ok;
+}
+
+bool MatlabBackend::getMatrix(ComputeMatrix& _matrix)
+{
+    if (!openEngine())
+    {
+        return false;
+    }
+
+    mxArray* array = engGetVariable(matlabEngine_, _matrix.name_.c_str());
+
+    if (!array)
+    {
+        qCritical() << "No variable " << QString(_matrix.name_.c_str()) << " in the Matlab workspace!";
+        return false;
+    }
+
+    if (!mxIsDouble(array) || mxIsComplex(array))
+    {
+        qCritical() << "Matlab variable " << QString(_matrix.name_.c_str()) << " is not a real double matrix!";
+
+        mxDestroyArray(array);
+        return false;
+    }
+
+    // The size comes with the array, no need to ask Matlab for it
+    _matrix.nRows_ = mxGetM(array);
+    _matrix.nColumns_ = mxGetN(array);
+
+    const double* data = mxGetPr(array);
+
+    _matrix.data_.assign(data, data + (size_t)_matrix.nRows_ * _matrix.nColumns_);
+
+    mxDestroyArray(array);
+
+    return true;
+}
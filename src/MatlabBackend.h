@@ -0,0 +1,40 @@
+//
+//  MatlabBackend.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef MATLABBACKEND_H
+#define MATLABBACKEND_H
+
+#include "engine.h"
+#include "matrix.h"
+
+#include "ComputeBackend.h"
+
+// The routines run by the scripts in MATLAB_FILE_PATH on a Matlab engine, which is opened on first use and closed with the backend
+// Variables stay in the Matlab workspace from one routine to the next, they are overwritten rather than cleared
+class MatlabBackend : public ComputeBackend
+{
+public:
+
+    MatlabBackend();
+
+    ~MatlabBackend();
+
+    const char* name() const;
+
+    bool putMatrix(const ComputeMatrix& _matrix);
+
+    bool runRoutine(const std::string& _routine);
+
+    bool getMatrix(ComputeMatrix& _matrix);
+
+private:
+
+    // Open the engine and add the scripts to its path, if not done already
+    bool openEngine();
+
+    Engine* matlabEngine_;
+};
+
+#endif
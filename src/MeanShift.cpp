@@ -0,0 +1,381 @@
+//
+//  MeanShift.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <QDebug>
+
+#include "MeanShift.h"
+#include "RowCloud.h"
+#include "WorkStealingPool.h"
+
+// Bins of the histogram of the distances, hist uses 10 when it is not told otherwise
+static const int SPREAD_BINS = 10;
+
+// Rows of the first point of a pair handled by one task of the pool
+static const int SPREAD_BLOCK_SIZE = 64;
+
+// A mean that has not settled after this many shifts is taken as it is, the flat kernel converges in far fewer
+static const int MEAN_SHIFT_MAX_ITERATIONS = 1000;
+
+static double squaredDistance(const double* _a, const double* _b, int _nDims)
+{
+    double d = 0.0;
+
+    for (int k=0; k<_nDims; ++k)
+    {
+        const double dk = _a[k] - _b[k];
+        d += dk * dk;
+    }
+
+    return d;
+}
+
+static double pointDistance(const double* _a, const double* _b, int _nDims)
+{
+    return std::sqrt(squaredDistance(_a, _b, _nDims));
+}
+
+double distanceSpread(const std::vector<double>& _points, int _nPoints, int _nDims, double _fraction, int _nThreads, int _maxPoints, unsigned long long _seed)
+{
+    if (_nPoints < 2 || _nDims <= 0 || _points.size() != (size_t)_nPoints * _nDims)
+    {
+        return 0.0;
+    }
+
+    if (_maxPoints >= 2 && _nPoints > _maxPoints)
+    {
+        // The first _maxPoints of a partial shuffle are a uniform sample without repetition
+        std::mt19937_64 generator(_seed);
+
+        std::vector<int> indices(_nPoints);
+
+        for (int i=0; i<_nPoints; ++i)
+        {
+            indices[i] = i;
+        }
+
+        std::vector<double> sample((size_t)_maxPoints * _nDims);
+
+        for (int i=0; i<_maxPoints; ++i)
+        {
+            std::uniform_int_distribution<int> pick(i, _nPoints - 1);
+
+            std::swap(indices[i], indices[pick(generator)]);
+
+            std::copy(&_points[(size_t)indices[i] * _nDims], &_points[(size_t)indices[i] * _nDims] + _nDims, &sample[(size_t)i * _nDims]);
+        }
+
+        return distanceSpread(sample, _maxPoints, _nDims, _fraction, _nThreads);
+    }
+
+    const int nBlocks = (_nPoints + SPREAD_BLOCK_SIZE - 1) / SPREAD_BLOCK_SIZE;
+
+    WorkStealingPool pool(_nThreads);
+
+    // The n (n - 1) / 2 distances are not kept, the first pass finds their range and the second fills the histogram
+    std::vector<double> blockMin(nBlocks, std::numeric_limits<double>::max());
+    std::vector<double> blockMax(nBlocks, -std::numeric_limits<double>::max());
+
+    pool.run(nBlocks, [&](int _block, int _worker)
+    {
+        const int end = std::min(_nPoints, (_block + 1) * SPREAD_BLOCK_SIZE);
+
+        for (int i=_block * SPREAD_BLOCK_SIZE; i<end; ++i)
+        {
+            for (int j=i+1; j<_nPoints; ++j)
+            {
+                const double d = squaredDistance(&_points[(size_t)i * _nDims], &_points[(size_t)j * _nDims], _nDims);
+
+                blockMin[_block] = std::min(blockMin[_block], d);
+                blockMax[_block] = std::max(blockMax[_block], d);
+            }
+        }
+    });
+
+    // The first pass compares squared distances
+    double minDistance = std::sqrt(*std::min_element(blockMin.begin(), blockMin.end()));
+    double maxDistance = std::sqrt(*std::max_element(blockMax.begin(), blockMax.end()));
+
+    // hist spreads equal values over bins of unit width around them
+    if (minDistance == maxDistance)
+    {
+        minDistance -= SPREAD_BINS / 2 + 0.5;
+        maxDistance += SPREAD_BINS / 2 - 0.5;
+    }
+
+    const double binWidth = (maxDistance - minDistance) / SPREAD_BINS;
+
+    std::vector<long long> blockCounts((size_t)nBlocks * SPREAD_BINS, 0);
+
+    pool.run(nBlocks, [&](int _block, int _worker)
+    {
+        long long* counts = &blockCounts[(size_t)_block * SPREAD_BINS];
+
+        const int end = std::min(_nPoints, (_block + 1) * SPREAD_BLOCK_SIZE);
+
+        for (int i=_block * SPREAD_BLOCK_SIZE; i<end; ++i)
+        {
+            for (int j=i+1; j<_nPoints; ++j)
+            {
+                const double d = pointDistance(&_points[(size_t)i * _nDims], &_points[(size_t)j * _nDims], _nDims);
+
+                // A distance on the edge of two bins counts in the upper one, the largest in the last
+                const int bin = std::min(SPREAD_BINS - 1, std::max(0, (int)std::floor((d - minDistance) / binWidth)));
+
+                ++counts[bin];
+            }
+        }
+    });
+
+    std::vector<long long> counts(SPREAD_BINS, 0);
+
+    for (int b=0; b<nBlocks; ++b)
+    {
+        for (int k=0; k<SPREAD_BINS; ++k)
+        {
+            counts[k] += blockCounts[(size_t)b * SPREAD_BINS + k];
+        }
+    }
+
+    const double threshold = _fraction * ((double)_nPoints * (_nPoints - 1) / 2.0);
+
+    // The second bin when every bin holds enough of the distances, as compute_spread does
+    int index = 1;
+
+    for (int k=0; k<SPREAD_BINS; ++k)
+    {
+        if (counts[k] < threshold)
+        {
+            index = k;
+            break;
+        }
+    }
+
+    return minDistance + (index + 0.5) * binWidth;
+}
+
+bool meanShiftCluster(const std::vector<double>& _points, int _nPoints, int _nDims, double _bandwidth, std::vector<double>& _centres, std::vector<int>& _labels, unsigned long long _seed)
+{
+    _centres.clear();
+    _labels.clear();
+
+    if (_nPoints <= 0 || _nDims <= 0 || _points.size() != (size_t)_nPoints * _nDims || !(_bandwidth > 0.0))
+    {
+        qCritical() << "Cannot cluster " << _nPoints << " points of " << _nDims << " dimensions with bandwidth " << _bandwidth;
+        return false;
+    }
+
+    RowCloud cloud(_points, _nDims);
+    RowTree tree(_nDims, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(10 /* max leaf */));
+    tree.buildIndex();
+
+    const double bandSq = _bandwidth * _bandwidth;
+    const double stopThresh = 1e-3 * _bandwidth;
+
+    std::mt19937_64 generator(_seed);
+
+    std::vector<bool> visited(_nPoints, false);
+
+    // Every point votes for the clusters whose means passed over it, once per shift
+    std::vector< std::vector<int> > clusterVotes;
+    std::vector<int> thisClusterVotes(_nPoints, 0);
+
+    std::vector<int> initPoints(_nPoints);
+
+    for (int i=0; i<_nPoints; ++i)
+    {
+        initPoints[i] = i;
+    }
+
+    std::vector< std::pair<size_t, double> > inRange;
+    nanoflann::SearchParams params;
+    params.sorted = false;
+
+    std::vector<double> mean(_nDims), oldMean(_nDims);
+
+    while (!initPoints.empty())
+    {
+        std::uniform_int_distribution<int> pick(0, initPoints.size() - 1);
+
+        const int start = initPoints[pick(generator)];
+
+        std::copy(&_points[(size_t)start * _nDims], &_points[(size_t)(start + 1) * _nDims], mean.begin());
+
+        std::fill(thisClusterVotes.begin(), thisClusterVotes.end(), 0);
+
+        for (int it=0; it<MEAN_SHIFT_MAX_ITERATIONS; ++it)
+        {
+            // Points strictly within the bandwidth, as the squared distances are
+            tree.radiusSearch(mean.data(), bandSq, inRange, params);
+
+            if (inRange.empty())
+            {
+                break;
+            }
+
+            oldMean = mean;
+
+            std::fill(mean.begin(), mean.end(), 0.0);
+
+            for (size_t r=0; r<inRange.size(); ++r)
+            {
+                const int p = inRange[r].first;
+
+                ++thisClusterVotes[p];
+                visited[p] = true;
+
+                for (int k=0; k<_nDims; ++k)
+                {
+                    mean[k] += _points[(size_t)p * _nDims + k];
+                }
+            }
+
+            for (int k=0; k<_nDims; ++k)
+            {
+                mean[k] /= inRange.size();
+            }
+
+            if (pointDistance(mean.data(), oldMean.data(), _nDims) < stopThresh)
+            {
+                break;
+            }
+        }
+
+        // A mean within half the bandwidth of an earlier cluster is merged with it
+        int mergeWith = -1;
+
+        for (int c=0; c<clusterVotes.size(); ++c)
+        {
+            if (pointDistance(mean.data(), &_centres[(size_t)c * _nDims], _nDims) < _bandwidth / 2.0)
+            {
+                mergeWith = c;
+                break;
+            }
+        }
+
+        if (mergeWith >= 0)
+        {
+            for (int k=0; k<_nDims; ++k)
+            {
+                _centres[(size_t)mergeWith * _nDims + k] = 0.5 * (mean[k] + _centres[(size_t)mergeWith * _nDims + k]);
+            }
+
+            for (int i=0; i<_nPoints; ++i)
+            {
+                clusterVotes[mergeWith][i] += thisClusterVotes[i];
+            }
+        }
+        else
+        {
+            _centres.insert(_centres.end(), mean.begin(), mean.end());
+            clusterVotes.push_back(thisClusterVotes);
+        }
+
+        initPoints.clear();
+
+        for (int i=0; i<_nPoints; ++i)
+        {
+            if (!visited[i])
+            {
+                initPoints.push_back(i);
+            }
+        }
+    }
+
+    // A point belongs to the cluster with the most votes, the first of them on a tie
+    _labels.assign(_nPoints, 0);
+
+    for (int i=0; i<_nPoints; ++i)
+    {
+        for (int c=1; c<clusterVotes.size(); ++c)
+        {
+            if (clusterVotes[c][i] > clusterVotes[_labels[i]][i])
+            {
+                _labels[i] = c;
+            }
+        }
+    }
+
+    return true;
+}
+
+void sortClusters(std::vector<double>& _centres, int _nDims, std::vector<int>& _labels)
+{
+    const int nClusters = _centres.size() / _nDims;
+
+    std::vector<int> population(nClusters, 0);
+
+    for (size_t i=0; i<_labels.size(); ++i)
+    {
+        ++population[_labels[i]];
+    }
+
+    std::vector<int> order(nClusters);
+
+    for (int c=0; c<nClusters; ++c)
+    {
+        order[c] = c;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&population](int _a, int _b) { return population[_a] > population[_b]; });
+
+    std::vector<int> newLabel(nClusters);
+    std::vector<double> centres(_centres.size());
+
+    for (int c=0; c<nClusters; ++c)
+    {
+        newLabel[order[c]] = c;
+
+        std::copy(&_centres[(size_t)order[c] * _nDims], &_centres[(size_t)order[c] * _nDims] + _nDims, &centres[(size_t)c * _nDims]);
+    }
+
+    _centres.swap(centres);
+
+    for (size_t i=0; i<_labels.size(); ++i)
+    {
+        _labels[i] = newLabel[_labels[i]];
+    }
+}
+
+bool clusterEmbedding(const std::vector<double>& _points, int _nPoints, int _nDims, std::vector<double>& _centres, std::vector<int>& _labels, const MeanShiftOptions& _options)
+{
+    if (_nPoints <= 0 || _nDims <= 0 || _points.size() != (size_t)_nPoints * _nDims)
+    {
+        qCritical() << "Cannot cluster " << _nPoints << " points of " << _nDims << " dimensions";
+        return false;
+    }
+
+    const double bandwidth = _options.bandwidthScale_ * distanceSpread(_points, _nPoints, _nDims, _options.fraction_, _options.nThreads_, _options.spreadSamplePoints_, _options.seed_);
+
+    // Points that all coincide, or a single one, leave no bandwidth to work with and make one cluster
+    if (!(bandwidth > 0.0))
+    {
+        _centres.assign(_nDims, 0.0);
+        _labels.assign(_nPoints, 0);
+
+        for (int i=0; i<_nPoints; ++i)
+        {
+            for (int k=0; k<_nDims; ++k)
+            {
+                _centres[k] += _points[(size_t)i * _nDims + k] / _nPoints;
+            }
+        }
+
+        return true;
+    }
+
+    if (!meanShiftCluster(_points, _nPoints, _nDims, bandwidth, _centres, _labels, _options.seed_))
+    {
+        return false;
+    }
+
+    sortClusters(_centres, _nDims, _labels);
+
+    return true;
+}
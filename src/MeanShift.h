@@ -0,0 +1,43 @@
+//
+//  MeanShift.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef MEANSHIFT_H
+#define MEANSHIFT_H
+
+#include <vector>
+
+struct MeanShiftOptions
+{
+    // The spread of the points is the first bin of the histogram of their distances that holds fewer than this fraction of them
+    double fraction_ = 0.05;
+
+    // The bandwidth of the kernel over the spread
+    double bandwidthScale_ = 0.25;
+
+    // Larger sets take their spread from this many of their points picked at random, all n (n - 1) / 2 distances would cost more than the clustering, 0 uses every point
+    int spreadSamplePoints_ = 2000;
+
+    // Picks the points the means start from
+    unsigned long long seed_ = 1;
+
+    // 0 means one per hardware thread
+    int nThreads_ = 0;
+};
+
+// compute_spread of the Matlab files: the centre of the first of the 10 bins of the histogram of all pairwise distances between the rows of _points that holds fewer than _fraction of the distances
+// With more than _maxPoints points (0 for no limit) the histogram is that of _maxPoints of them picked with _seed, which has the same shape in expectation
+double distanceSpread(const std::vector<double>& _points, int _nPoints, int _nDims, double _fraction, int _nThreads = 0, int _maxPoints = 0, unsigned long long _seed = 1);
+
+// Mean shift clustering of the rows of the _nPoints x _nDims row major _points with a flat kernel of radius _bandwidth, as MeanShiftCluster of the Matlab files does it
+// _centres is nClusters x _nDims row major, _labels gives the cluster of every point, counted from 0
+bool meanShiftCluster(const std::vector<double>& _points, int _nPoints, int _nDims, double _bandwidth, std::vector<double>& _centres, std::vector<int>& _labels, unsigned long long _seed = 1);
+
+// sortClusters of the Matlab files: renumber the clusters on decreasing population, clusters of the same population keep their order
+void sortClusters(std::vector<double>& _centres, int _nDims, std::vector<int>& _labels);
+
+// The three of them as the exploration clusters its embedding, the bandwidth is _options.bandwidthScale_ times the spread of the points
+bool clusterEmbedding(const std::vector<double>& _points, int _nPoints, int _nDims, std::vector<double>& _centres, std::vector<int>& _labels, const MeanShiftOptions& _options = MeanShiftOptions());
+
+#endif
@@ -77,6 +77,8 @@ using namespace Qt;
 
 template <typename M> void MeshViewerWidgetT<M>::draw_scene(const std::string& _draw_mode)
 {
+    TRACE_SPAN("MeshViewerWidget::draw_scene");
+    
     //std::cout << "MeshViewerWidgetT enter drawing" << std::endl;
     
     typename std::vector<Shape*>::iterator shapes_it(shapes_.begin()), shapes_end(shapes_.end());
@@ -86,6 +88,8 @@ template <typename M> void MeshViewerWidgetT<M>::draw_scene(const std::string& _
         return;
     }
     
+    currentFrame().nShapes_ += shapes_.size();
+    
     // Draw the global axes first
 //    glDisable(GL_LIGHTING);
 //    glBegin(GL_LINES);
@@ -0,0 +1,221 @@
+//
+//  NativeBackend.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <cmath>
+
+#include <QDebug>
+#include <QString>
+
+#include "NativeBackend.h"
+#include "RandomisedSVD.h"
+#include "MDS.h"
+#include "MeanShift.h"
+#include "global.h"
+
+const char* NativeBackend::name() const
+{
+    return "NATIVE";
+}
+
+bool NativeBackend::putMatrix(const ComputeMatrix& _matrix)
+{
+    if (_matrix.nRows_ < 0 || _matrix.nColumns_ < 0 || _matrix.data_.size() != (size_t)_matrix.nRows_ * _matrix.nColumns_)
+    {
+        qCritical() << "Matrix " << QString(_matrix.name_.c_str()) << " claims " << _matrix.nRows_ << " x " << _matrix.nColumns_ << " values but holds " << (int)_matrix.data_.size();
+        return false;
+    }
+
+    workspace_[_matrix.name_] = _matrix;
+
+    return true;
+}
+
+bool NativeBackend::runRoutine(const std::string& _routine)
+{
+    if (_routine == "pca")
+    {
+        return runPCA();
+    }
+    else if (_routine == "mds")
+    {
+        return runMDS();
+    }
+    else if (_routine == "cluster")
+    {
+        return runClustering();
+    }
+
+    qCritical() << "Unknown routine " << QString(_routine.c_str());
+    return false;
+}
+
+bool NativeBackend::getMatrix(ComputeMatrix& _matrix)
+{
+    std::map<std::string, ComputeMatrix>::const_iterator it = workspace_.find(_matrix.name_);
+
+    if (it == workspace_.end())
+    {
+        qCritical() << "No matrix " << QString(_matrix.name_.c_str()) << " in the workspace!";
+        return false;
+    }
+
+    _matrix = it->second;
+
+    return true;
+}
+
+bool NativeBackend::rowMajor(const std::string& _name, std::vector<double>& _rows, int& _nRows, int& _nColumns) const
+{
+    std::map<std::string, ComputeMatrix>::const_iterator it = workspace_.find(_name);
+
+    if (it == workspace_.end() || it->second.nRows_ == 0 || it->second.nColumns_ == 0)
+    {
+        qCritical() << "No matrix " << QString(_name.c_str()) << " in the workspace!";
+        return false;
+    }
+
+    const ComputeMatrix& m = it->second;
+
+    _nRows = m.nRows_;
+    _nColumns = m.nColumns_;
+
+    _rows.resize(m.data_.size());
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        for (int j=0; j<_nColumns; ++j)
+        {
+            double value = m.data_[i + (size_t)j * _nRows];
+
+            _rows[(size_t)i * _nColumns + j] = std::isfinite(value) ? value : 0.0;
+        }
+    }
+
+    return true;
+}
+
+void NativeBackend::setRowMajor(const std::string& _name, const std::vector<double>& _rows, int _nRows, int _nColumns)
+{
+    ComputeMatrix& m = workspace_[_name];
+
+    m.name_ = _name;
+    m.nRows_ = _nRows;
+    m.nColumns_ = _nColumns;
+    m.data_.resize((size_t)_nRows * _nColumns);
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        for (int j=0; j<_nColumns; ++j)
+        {
+            m.data_[i + (size_t)j * _nRows] = _rows[(size_t)i * _nColumns + j];
+        }
+    }
+}
+
+bool NativeBackend::runPCA()
+{
+    std::vector<double> descriptors;
+    int nRows = 0, nColumns = 0;
+
+    if (!rowMajor("descriptors", descriptors, nRows, nColumns))
+    {
+        return false;
+    }
+
+    std::vector<double> mean, components, variances;
+
+    if (!principalComponents(descriptors, nRows, nColumns, 2, mean, components, variances))
+    {
+        return false;
+    }
+
+    // The components are the rows of components, they are the columns of the basis
+    std::vector<double> basis((size_t)nColumns * 2);
+    std::vector<double> projected((size_t)nRows * 2, 0.0);
+
+    for (int j=0; j<nColumns; ++j)
+    {
+        basis[2 * j] = components[j];
+        basis[2 * j + 1] = components[nColumns + j];
+    }
+
+    for (int i=0; i<nRows; ++i)
+    {
+        for (int j=0; j<nColumns; ++j)
+        {
+            double c = descriptors[(size_t)i * nColumns + j] - mean[j];
+
+            projected[2 * i] += c * basis[2 * j];
+            projected[2 * i + 1] += c * basis[2 * j + 1];
+        }
+    }
+
+    setRowMajor("deformation_basis", basis, nColumns, 2);
+    setRowMajor("projected_descriptors", projected, nRows, 2);
+
+    return true;
+}
+
+bool NativeBackend::runMDS()
+{
+    std::vector<double> descriptors;
+    int nRows = 0, nColumns = 0;
+
+    if (!rowMajor("descriptors", descriptors, nRows, nColumns))
+    {
+        return false;
+    }
+
+    // The same switch to landmarks as the embedding of the exploration widget
+    MDSOptions options;
+    options.maxClassical_ = MDS_MAX_CLASSICAL;
+    options.nLandmarks_ = MDS_LANDMARKS;
+
+    std::vector<double> embedding;
+
+    if (!computeMDS(descriptors, nRows, nColumns, embedding, options))
+    {
+        return false;
+    }
+
+    setRowMajor("projected_descriptors", embedding, nRows, 2);
+
+    return true;
+}
+
+bool NativeBackend::runClustering()
+{
+    std::vector<double> points;
+    int nPoints = 0, nDims = 0;
+
+    if (!rowMajor("projected_descriptors", points, nPoints, nDims))
+    {
+        return false;
+    }
+
+    std::vector<double> centres;
+    std::vector<int> labels;
+
+    if (!clusterEmbedding(points, nPoints, nDims, centres, labels))
+    {
+        return false;
+    }
+
+    const int nClusters = centres.size() / nDims;
+
+    // Cluster numbers count from 1 as they do in Matlab
+    std::vector<double> point2cluster(nPoints);
+
+    for (int i=0; i<nPoints; ++i)
+    {
+        point2cluster[i] = labels[i] + 1;
+    }
+
+    setRowMajor("clustCent", centres, nClusters, nDims);
+    setRowMajor("point2cluster", point2cluster, nPoints, 1);
+    setRowMajor("nofClusters", std::vector<double>(1, nClusters), 1, 1);
+
+    return true;
+}
@@ -0,0 +1,43 @@
+//
+//  NativeBackend.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef NATIVEBACKEND_H
+#define NATIVEBACKEND_H
+
+#include <map>
+
+#include "ComputeBackend.h"
+
+// The routines of the exploration in process, with RandomisedSVD, MDS and MeanShift, so it runs where Matlab is not installed
+class NativeBackend : public ComputeBackend
+{
+public:
+
+    const char* name() const;
+
+    bool putMatrix(const ComputeMatrix& _matrix);
+
+    bool runRoutine(const std::string& _routine);
+
+    bool getMatrix(ComputeMatrix& _matrix);
+
+private:
+
+    // Row major copy of a workspace matrix, infinite and NaN values are taken as 0 as the Matlab code does
+    bool rowMajor(const std::string& _name, std::vector<double>& _rows, int& _nRows, int& _nColumns) const;
+
+    // Store the _nRows x _nColumns row major _rows under _name
+    void setRowMajor(const std::string& _name, const std::vector<double>& _rows, int _nRows, int _nColumns);
+
+    bool runPCA();
+
+    bool runMDS();
+
+    bool runClustering();
+
+    std::map<std::string, ComputeMatrix> workspace_;
+};
+
+#endif
@@ -0,0 +1,574 @@
+//
+//  OffReader.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <cmath>
+#include <cstring>
+
+#include <QFile>
+#include <QByteArray>
+#include <QDebug>
+
+#include "OffReader.h"
+
+namespace
+{
+
+// What the keyword at the top of the file says about the vertex lines
+struct OffHeader
+{
+    bool textureCoords_ = false;
+    bool colours_ = false;
+    bool normals_ = false;
+    bool binary_ = false;
+};
+
+inline bool isSpace(char _c)
+{
+    return _c == ' ' || _c == '\t' || _c == '\n' || _c == '\r' || _c == '\v' || _c == '\f';
+}
+
+inline bool isDigit(char _c)
+{
+    return _c >= '0' && _c <= '9';
+}
+
+// Whitespace, line breaks and comments
+void skipSpace(const char*& _p, const char* _end)
+{
+    while (_p < _end)
+    {
+        if (isSpace(*_p))
+        {
+            ++_p;
+        }
+        else if (*_p == '#')
+        {
+            while (_p < _end && *_p != '\n')
+            {
+                ++_p;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+// Values we do not keep (colours), up to the end of the line
+void skipLine(const char*& _p, const char* _end)
+{
+    while (_p < _end && *_p != '\n')
+    {
+        ++_p;
+    }
+}
+
+bool parseUnsigned(const char*& _p, const char* _end, unsigned int& _value)
+{
+    skipSpace(_p, _end);
+
+    if (_p < _end && *_p == '+')
+    {
+        ++_p;
+    }
+
+    if (_p == _end || !isDigit(*_p))
+    {
+        return false;
+    }
+
+    unsigned long long value = 0;
+
+    for (; _p < _end && isDigit(*_p); ++_p)
+    {
+        value = value * 10 + (*_p - '0');
+
+        if (value > 0xffffffffull)
+        {
+            return false;
+        }
+    }
+
+    _value = (unsigned int)value;
+
+    return true;
+}
+
+// Decimal and scientific notation with a '.' whatever the locale, no inf or nan
+bool parseFloat(const char*& _p, const char* _end, float& _value)
+{
+    static const double powersOf10[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    skipSpace(_p, _end);
+
+    bool negative = false;
+
+    if (_p < _end && (*_p == '-' || *_p == '+'))
+    {
+        negative = (*_p == '-');
+        ++_p;
+    }
+
+    // Up to 19 significant digits fit in the mantissa, the rest only move the exponent
+    unsigned long long mantissa = 0;
+    int nDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+
+    for (; _p < _end && isDigit(*_p); ++_p)
+    {
+        hasDigits = true;
+
+        if (nDigits < 19)
+        {
+            mantissa = mantissa * 10 + (*_p - '0');
+            nDigits += (mantissa != 0);
+        }
+        else
+        {
+            ++exponent;
+        }
+    }
+
+    if (_p < _end && *_p == '.')
+    {
+        ++_p;
+
+        for (; _p < _end && isDigit(*_p); ++_p)
+        {
+            hasDigits = true;
+
+            if (nDigits < 19)
+            {
+                mantissa = mantissa * 10 + (*_p - '0');
+                nDigits += (mantissa != 0);
+                --exponent;
+            }
+        }
+    }
+
+    if (!hasDigits)
+    {
+        return false;
+    }
+
+    if (_p < _end && (*_p == 'e' || *_p == 'E'))
+    {
+        const char* p = _p + 1;
+
+        bool negativeExponent = false;
+
+        if (p < _end && (*p == '-' || *p == '+'))
+        {
+            negativeExponent = (*p == '-');
+            ++p;
+        }
+
+        if (p < _end && isDigit(*p))
+        {
+            int e = 0;
+
+            for (; p < _end && isDigit(*p); ++p)
+            {
+                if (e < 10000)
+                {
+                    e = e * 10 + (*p - '0');
+                }
+            }
+
+            exponent += negativeExponent ? -e : e;
+
+            _p = p;
+        }
+    }
+
+    double value = (double)mantissa;
+
+    if (mantissa != 0 && exponent != 0)
+    {
+        if (exponent > 0 && exponent <= 22)
+        {
+            value *= powersOf10[exponent];
+        }
+        else if (exponent < 0 && exponent >= -22)
+        {
+            value /= powersOf10[-exponent];
+        }
+        else
+        {
+            value *= pow(10.0, exponent);
+        }
+    }
+
+    _value = (float)(negative ? -value : value);
+
+    return true;
+}
+
+// [ST][C][N]OFF, optionally followed by BINARY on the same line
+bool parseHeader(const char*& _p, const char* _end, OffHeader& _header)
+{
+    skipSpace(_p, _end);
+
+    const char* keyword = _p;
+
+    while (_p < _end && !isSpace(*_p))
+    {
+        ++_p;
+    }
+
+    const char* k = keyword;
+
+    if (_p - k >= 2 && k[0] == 'S' && k[1] == 'T')
+    {
+        _header.textureCoords_ = true;
+        k += 2;
+    }
+
+    if (k < _p && *k == 'C')
+    {
+        _header.colours_ = true;
+        ++k;
+    }
+
+    if (k < _p && *k == 'N')
+    {
+        _header.normals_ = true;
+        ++k;
+    }
+
+    // 4OFF and nOFF have points of other dimensions
+    if (_p - k != 3 || std::strncmp(k, "OFF", 3) != 0)
+    {
+        return false;
+    }
+
+    // Rest of the header line
+    while (_p < _end && (*_p == ' ' || *_p == '\t'))
+    {
+        ++_p;
+    }
+
+    if (_end - _p >= 6 && std::strncmp(_p, "BINARY", 6) == 0)
+    {
+        _header.binary_ = true;
+
+        skipLine(_p, _end);
+
+        if (_p < _end)
+        {
+            ++_p;
+        }
+    }
+
+    return true;
+}
+
+// Add the fan of a polygon, false if it refers to a vertex that does not exist
+inline bool addPolygon(const unsigned int* _indices, unsigned int _nIndices, unsigned int _nVertices, std::vector<unsigned int>& _triangles)
+{
+    for (unsigned int i=0; i<_nIndices; ++i)
+    {
+        if (_indices[i] >= _nVertices)
+        {
+            return false;
+        }
+    }
+
+    for (unsigned int i=1; i+1<_nIndices; ++i)
+    {
+        _triangles.push_back(_indices[0]);
+        _triangles.push_back(_indices[i]);
+        _triangles.push_back(_indices[i+1]);
+    }
+
+    return true;
+}
+
+bool parseAscii(const char* _p, const char* _end, const OffHeader& _header, OffData& _data)
+{
+    unsigned int nVertices = 0, nFaces = 0, nEdges = 0;
+
+    if (!parseUnsigned(_p, _end, nVertices) || !parseUnsigned(_p, _end, nFaces) || !parseUnsigned(_p, _end, nEdges))
+    {
+        return false;
+    }
+
+    // Every value takes at least a digit and a separator, the last one may end the file, counts the rest cannot hold come from a corrupt or truncated header
+    const unsigned long long nValuesPerVertex = _header.normals_ ? 6 : 3;
+
+    if (2 * (nValuesPerVertex * nVertices + nFaces) > (unsigned long long)(_end - _p) + 1)
+    {
+        return false;
+    }
+
+    _data.points_.resize(3 * (size_t)nVertices);
+
+    if (_header.normals_)
+    {
+        _data.normals_.resize(3 * (size_t)nVertices);
+    }
+
+    float* point = _data.points_.empty() ? 0 : &_data.points_[0];
+    float* normal = _data.normals_.empty() ? 0 : &_data.normals_[0];
+
+    for (unsigned int v=0; v<nVertices; ++v, point += 3)
+    {
+        if (!parseFloat(_p, _end, point[0]) || !parseFloat(_p, _end, point[1]) || !parseFloat(_p, _end, point[2]))
+        {
+            return false;
+        }
+
+        if (_header.normals_)
+        {
+            if (!parseFloat(_p, _end, normal[0]) || !parseFloat(_p, _end, normal[1]) || !parseFloat(_p, _end, normal[2]))
+            {
+                return false;
+            }
+
+            normal += 3;
+        }
+
+        // Colours come next and may have 3 or 4 values, texture coordinates last
+        if (_header.colours_ || _header.textureCoords_)
+        {
+            skipLine(_p, _end);
+        }
+    }
+
+    _data.triangles_.reserve(3 * (size_t)nFaces);
+
+    std::vector<unsigned int> indices;
+
+    for (unsigned int f=0; f<nFaces; ++f)
+    {
+        unsigned int nIndices = 0;
+
+        if (!parseUnsigned(_p, _end, nIndices))
+        {
+            return false;
+        }
+
+        indices.resize(nIndices);
+
+        for (unsigned int i=0; i<nIndices; ++i)
+        {
+            if (!parseUnsigned(_p, _end, indices[i]))
+            {
+                return false;
+            }
+        }
+
+        if (nIndices > 0 && !addPolygon(&indices[0], nIndices, nVertices, _data.triangles_))
+        {
+            return false;
+        }
+
+        // Face colours
+        skipLine(_p, _end);
+    }
+
+    return true;
+}
+
+inline unsigned int readUInt32(const unsigned char* _p, bool _bigEndian)
+{
+    if (_bigEndian)
+    {
+        return ((unsigned int)_p[0] << 24) | ((unsigned int)_p[1] << 16) | ((unsigned int)_p[2] << 8) | (unsigned int)_p[3];
+    }
+
+    return ((unsigned int)_p[3] << 24) | ((unsigned int)_p[2] << 16) | ((unsigned int)_p[1] << 8) | (unsigned int)_p[0];
+}
+
+inline float readFloat32(const unsigned char* _p, bool _bigEndian)
+{
+    unsigned int bits = readUInt32(_p, _bigEndian);
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(float));
+
+    return value;
+}
+
+// The format asks for big endian, but some writers use the byte order of the machine, so the order whose counts fit in the file is taken
+bool parseBinary(const char* _p, const char* _end, const OffHeader& _header, OffData& _data)
+{
+    if (_header.colours_ || _header.textureCoords_)
+    {
+        return false;
+    }
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(_p);
+    const unsigned char* end = reinterpret_cast<const unsigned char*>(_end);
+
+    if (end - p < 12)
+    {
+        return false;
+    }
+
+    const int nFloatsPerVertex = _header.normals_ ? 6 : 3;
+
+    bool bigEndian = true;
+
+    unsigned long long nVertices = 0, nFaces = 0;
+
+    for (int order=0; order<2; ++order)
+    {
+        bigEndian = (order == 0);
+
+        nVertices = readUInt32(p, bigEndian);
+        nFaces = readUInt32(p + 4, bigEndian);
+
+        // Every face takes at least its size, three indices and its number of colour values
+        // Counts the file cannot hold are rejected here, before anything is allocated for them
+        unsigned long long minSize = 12 + nVertices * nFloatsPerVertex * 4 + nFaces * 20;
+
+        if (minSize <= (unsigned long long)(end - p))
+        {
+            break;
+        }
+
+        if (order == 1)
+        {
+            return false;
+        }
+    }
+
+    p += 12;
+
+    _data.points_.resize(3 * nVertices);
+
+    if (_header.normals_)
+    {
+        _data.normals_.resize(3 * nVertices);
+    }
+
+    for (unsigned long long v=0; v<nVertices; ++v)
+    {
+        for (int i=0; i<3; ++i, p += 4)
+        {
+            _data.points_[3 * v + i] = readFloat32(p, bigEndian);
+        }
+
+        if (_header.normals_)
+        {
+            for (int i=0; i<3; ++i, p += 4)
+            {
+                _data.normals_[3 * v + i] = readFloat32(p, bigEndian);
+            }
+        }
+    }
+
+    _data.triangles_.reserve(3 * nFaces);
+
+    std::vector<unsigned int> indices;
+
+    for (unsigned long long f=0; f<nFaces; ++f)
+    {
+        if (end - p < 4)
+        {
+            return false;
+        }
+
+        unsigned int nIndices = readUInt32(p, bigEndian);
+        p += 4;
+
+        if ((unsigned long long)(end - p) < 4ull * nIndices + 4)
+        {
+            return false;
+        }
+
+        indices.resize(nIndices);
+
+        for (unsigned int i=0; i<nIndices; ++i, p += 4)
+        {
+            indices[i] = readUInt32(p, bigEndian);
+        }
+
+        if (nIndices > 0 && !addPolygon(&indices[0], nIndices, nVertices, _data.triangles_))
+        {
+            return false;
+        }
+
+        unsigned int nColours = readUInt32(p, bigEndian);
+        p += 4;
+
+        if ((unsigned long long)(end - p) < 4ull * nColours)
+        {
+            return false;
+        }
+
+        p += 4 * nColours;
+    }
+
+    return true;
+}
+
+}
+
+bool parseOff(const char* _begin, size_t _size, OffData& _data)
+{
+    _data.clear();
+
+    const char* p = _begin;
+    const char* end = _begin + _size;
+
+    OffHeader header;
+
+    if (!parseHeader(p, end, header))
+    {
+        return false;
+    }
+
+    bool ok = header.binary_ ? parseBinary(p, end, header, _data) : parseAscii(p, end, header, _data);
+
+    if (!ok)
+    {
+        _data.clear();
+    }
+
+    return ok;
+}
+
+bool readOffFile(const char* _filename, OffData& _data)
+{
+    QFile file(QString::fromLocal8Bit(_filename));
+
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0)
+    {
+        return false;
+    }
+
+    uchar* mapped = file.map(0, file.size());
+
+    bool ok = false;
+
+    if (mapped)
+    {
+        ok = parseOff(reinterpret_cast<const char*>(mapped), file.size(), _data);
+
+        file.unmap(mapped);
+    }
+    else
+    {
+        // Some file systems cannot be mapped
+        QByteArray contents = file.readAll();
+
+        ok = parseOff(contents.constData(), contents.size(), _data);
+    }
+
+    if (!ok)
+    {
+        qDebug() << "Fast OFF reader cannot read " << _filename;
+    }
+
+    return ok;
+}
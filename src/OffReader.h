@@ -0,0 +1,40 @@
+//
+//  OffReader.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef OFFREADER_H
+#define OFFREADER_H
+
+#include <cstddef>
+#include <vector>
+
+// Contents of an OFF file as flat arrays, ready to be added to a mesh in one go
+struct OffData
+{
+    // x, y, z per vertex
+    std::vector<float> points_;
+
+    // Per vertex as well, only filled for NOFF files
+    std::vector<float> normals_;
+
+    // Three vertex indices per triangle, polygons are split into fans
+    std::vector<unsigned int> triangles_;
+
+    void clear()
+    {
+        points_.clear();
+        normals_.clear();
+        triangles_.clear();
+    }
+};
+
+// Read an ASCII or binary OFF file through a memory map
+// Numbers are parsed without going through the C locale, so a locale with a decimal comma does not break the reader
+// Returns false if the file cannot be mapped or uses a variant of OFF that is not handled (colours or texture coordinates in binary files, 4D points), the caller falls back to OpenMesh then
+bool readOffFile(const char* _filename, OffData& _data);
+
+// Same as readOffFile for a file that is already in memory
+bool parseOff(const char* _begin, size_t _size, OffData& _data);
+
+#endif
@@ -0,0 +1,257 @@
+//
+//  PartMeshFile.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDebug>
+
+#include "PartMeshFile.h"
+
+static const char PART_MESH_MAGIC[4] = { 'S', 'S', 'P', 'M' };
+
+// 2 records the part mesh it was converted from, 3 drops the bounding box nothing read
+static const unsigned int PART_MESH_VERSION = 3;
+
+static qint64 pointsOffset()
+{
+    return sizeof(PartMeshFile::Header);
+}
+
+static qint64 trianglesOffset(const PartMeshFile::Header& _header)
+{
+    return pointsOffset() + 3 * sizeof(float) * (qint64)_header.nVertices_;
+}
+
+static qint64 normalsOffset(const PartMeshFile::Header& _header)
+{
+    return trianglesOffset(_header) + 3 * sizeof(unsigned int) * (qint64)_header.nTriangles_;
+}
+
+static qint64 fileSize(const PartMeshFile::Header& _header)
+{
+    qint64 size = normalsOffset(_header);
+
+    if (_header.flags_ & PartMeshFile::HAS_NORMALS)
+    {
+        size += 3 * sizeof(short) * (qint64)_header.nVertices_;
+    }
+
+    return size;
+}
+
+PartMeshFile::PartMeshFile()
+{
+    data_ = 0;
+    size_ = 0;
+}
+
+PartMeshFile::~PartMeshFile()
+{
+    close();
+}
+
+bool PartMeshFile::open(const QString& _filename)
+{
+    close();
+
+    file_.setFileName(_filename);
+
+    if (!file_.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    size_ = file_.size();
+
+    if (size_ < (qint64)sizeof(Header))
+    {
+        qWarning() << "Part mesh file " << _filename << " is too short";
+        close();
+        return false;
+    }
+
+    data_ = file_.map(0, size_);
+
+    if (!data_)
+    {
+        qWarning() << "Cannot map part mesh file " << _filename;
+        close();
+        return false;
+    }
+
+    const Header& h = header();
+
+    if (std::memcmp(h.magic_, PART_MESH_MAGIC, sizeof(PART_MESH_MAGIC)) != 0 || h.version_ != PART_MESH_VERSION || fileSize(h) != size_)
+    {
+        qWarning() << "Part mesh file " << _filename << " was not written by this version or on a machine with another byte order";
+        close();
+        return false;
+    }
+
+    const unsigned int* t = triangles();
+
+    for (size_t i=0; i<3 * (size_t)h.nTriangles_; ++i)
+    {
+        if (t[i] >= h.nVertices_)
+        {
+            qWarning() << "Part mesh file " << _filename << " has a triangle with vertex " << t[i] << " out of " << h.nVertices_;
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void PartMeshFile::close()
+{
+    if (data_)
+    {
+        file_.unmap(const_cast<uchar*>(data_));
+        data_ = 0;
+    }
+
+    if (file_.isOpen())
+    {
+        file_.close();
+    }
+
+    size_ = 0;
+}
+
+bool PartMeshFile::isOpen() const
+{
+    return data_ != 0;
+}
+
+const PartMeshFile::Header& PartMeshFile::header() const
+{
+    return *reinterpret_cast<const Header*>(data_);
+}
+
+const float* PartMeshFile::points() const
+{
+    return reinterpret_cast<const float*>(data_ + pointsOffset());
+}
+
+const unsigned int* PartMeshFile::triangles() const
+{
+    return reinterpret_cast<const unsigned int*>(data_ + trianglesOffset(header()));
+}
+
+const short* PartMeshFile::normals() const
+{
+    if (!(header().flags_ & HAS_NORMALS))
+    {
+        return 0;
+    }
+
+    return reinterpret_cast<const short*>(data_ + normalsOffset(header()));
+}
+
+bool PartMeshFile::write(const QString& _filename, const float* _points, size_t _nVertices, const unsigned int* _triangles, size_t _nTriangles, const float* _normals, qint64 _sourceSize, qint64 _sourceModified)
+{
+    // Zeroed first so the padding between the fields does not carry stack contents into the file
+    Header h;
+    std::memset(&h, 0, sizeof(Header));
+
+    std::memcpy(h.magic_, PART_MESH_MAGIC, sizeof(PART_MESH_MAGIC));
+    h.version_ = PART_MESH_VERSION;
+    h.nVertices_ = _nVertices;
+    h.nTriangles_ = _nTriangles;
+    h.flags_ = _normals ? HAS_NORMALS : 0;
+    h.sourceSize_ = _sourceSize;
+    h.sourceModified_ = _sourceModified;
+
+    QFile file(_filename);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qCritical() << "Cannot write part mesh file " << _filename;
+        return false;
+    }
+
+    bool ok = file.write(reinterpret_cast<const char*>(&h), sizeof(Header)) == sizeof(Header);
+
+    ok = ok && file.write(reinterpret_cast<const char*>(_points), 3 * sizeof(float) * _nVertices) == (qint64)(3 * sizeof(float) * _nVertices);
+
+    ok = ok && file.write(reinterpret_cast<const char*>(_triangles), 3 * sizeof(unsigned int) * _nTriangles) == (qint64)(3 * sizeof(unsigned int) * _nTriangles);
+
+    if (ok && _normals)
+    {
+        std::vector<short> packed(3 * _nVertices);
+
+        for (size_t i=0; i<packed.size(); ++i)
+        {
+            packed[i] = (short)floor(std::max(-1.0f, std::min(1.0f, _normals[i])) * 32767.0f + 0.5f);
+        }
+
+        ok = file.write(reinterpret_cast<const char*>(packed.data()), sizeof(short) * packed.size()) == (qint64)(sizeof(short) * packed.size());
+    }
+
+    if (!ok)
+    {
+        qCritical() << "Writing part mesh file " << _filename << " failed";
+        file.close();
+        file.remove();
+    }
+
+    return ok;
+}
+
+QString PartMeshFile::binaryFilename(const QString& _offFilename)
+{
+    QString filename = _offFilename;
+
+    if (filename.endsWith(".off", Qt::CaseInsensitive))
+    {
+        filename.chop(4);
+    }
+
+    return filename + ".bin";
+}
+
+void PartMeshFile::sourceStamp(const QString& _offFilename, qint64& _size, qint64& _modified)
+{
+    QFileInfo offInfo(_offFilename);
+
+    _size = offInfo.size();
+    _modified = offInfo.lastModified().toMSecsSinceEpoch();
+}
+
+bool PartMeshFile::isUpToDate(const QString& _offFilename)
+{
+    QFile file(binaryFilename(_offFilename));
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    Header h;
+
+    if (file.read(reinterpret_cast<char*>(&h), sizeof(Header)) != sizeof(Header) || std::memcmp(h.magic_, PART_MESH_MAGIC, sizeof(PART_MESH_MAGIC)) != 0 || h.version_ != PART_MESH_VERSION)
+    {
+        return false;
+    }
+
+    // Without the part mesh the binary file is all there is
+    if (!QFileInfo(_offFilename).exists())
+    {
+        return true;
+    }
+
+    qint64 size = 0;
+    qint64 modified = 0;
+
+    sourceStamp(_offFilename, size, modified);
+
+    return size == h.sourceSize_ && modified == h.sourceModified_;
+}
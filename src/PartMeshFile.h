@@ -0,0 +1,90 @@
+//
+//  PartMeshFile.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef PARTMESHFILE_H
+#define PARTMESHFILE_H
+
+#include <cstddef>
+
+#include <QFile>
+#include <QString>
+
+// Binary copy of a part mesh "<mesh>.pN.off", written next to it as "<mesh>.pN.bin" by shapesynth-convert
+// The file is the header followed by the float positions, the triangle indices and optionally the vertex normals packed in three shorts, all in the byte order of the machine that wrote it
+// It is mapped and used as it is, there is nothing to parse
+class PartMeshFile
+{
+public:
+
+    struct Header
+    {
+        char magic_[4];
+
+        unsigned int version_;
+
+        unsigned int nVertices_;
+
+        unsigned int nTriangles_;
+
+        unsigned int flags_;
+
+        // Size and modification time (ms since the epoch) of the part mesh it was converted from, 0 if unknown
+        qint64 sourceSize_;
+
+        qint64 sourceModified_;
+    };
+
+    enum Flags
+    {
+        HAS_NORMALS = 0x01
+    };
+
+    PartMeshFile();
+
+    ~PartMeshFile();
+
+    // Map the file, false if it cannot be mapped or its header does not match its size
+    bool open(const QString& _filename);
+
+    void close();
+
+    bool isOpen() const;
+
+    const Header& header() const;
+
+    const float* points() const;
+
+    const unsigned int* triangles() const;
+
+    // Components scaled to [-32767, 32767], 0 if the file has no normals
+    const short* normals() const;
+
+    static bool write(const QString& _filename, const float* _points, size_t _nVertices, const unsigned int* _triangles, size_t _nTriangles, const float* _normals = 0, qint64 _sourceSize = 0, qint64 _sourceModified = 0);
+
+    // The binary file that goes with a part mesh
+    static QString binaryFilename(const QString& _offFilename);
+
+    // What the header records of the part mesh, taken before it is read so that a rewrite while it is converted leaves the binary file stale
+    static void sourceStamp(const QString& _offFilename, qint64& _size, qint64& _modified);
+
+    // The binary file exists and was converted from the part mesh as it is now, timestamps alone cannot tell apart two writes within a second
+    static bool isUpToDate(const QString& _offFilename);
+
+private:
+
+    // Not copyable, owns the mapping
+    PartMeshFile(const PartMeshFile&);
+    PartMeshFile& operator=(const PartMeshFile&);
+
+
+    // DATA
+    QFile file_;
+
+    const uchar* data_;
+
+    qint64 size_;
+};
+
+#endif
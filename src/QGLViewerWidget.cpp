@@ -67,6 +67,7 @@
 #include <qimage.h>
 #include <qdatetime.h>
 #include <QMouseEvent>
+#include <chrono>
 // --------------------
 #include <QGLViewerWidget.h>
 #include <OpenMesh/Tools/Utils/Timer.hh>
@@ -158,6 +159,8 @@ QGLViewerWidget::init(void)
     b->setChecked(true);
     
     slotChangeShowMode(b);
+    
+    showFrameStats_ = false;
 
 }
 
@@ -277,15 +280,103 @@ QGLViewerWidget::paintGL()
     glMatrixMode( GL_MODELVIEW );
     glLoadMatrixd( modelview_matrix_ );
 
+    frameStats_.beginFrame();
+    
     if (draw_mode_)
     {
         assert(draw_mode_ <= n_draw_modes_);
         draw_scene(draw_mode_names_[draw_mode_-1]);
     }
+    
+    frameStats_.endFrame();
+    
+    if (showFrameStats_)
+    {
+        drawFrameStats();
+    }
+}
+
+void QGLViewerWidget::drawFrameStats()
+{
+    const int nBins = 25;
+    const double binMs = 2.0;
+    
+    std::vector<int> bins = frameStats_.histogram(nBins, binMs);
+    
+    const std::deque<FrameSample>& history = frameStats_.history();
+    
+    int maxCount = std::max(1, *std::max_element(bins.begin(), bins.end()));
+    
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_COLOR_BUFFER_BIT);
+    
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, width(), 0, height(), -1, 1);
+    
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    
+    // Panel in the top left corner, the histogram at its bottom with one bar per bin
+    const float left = 10, top = height() - 10, panelWidth = 260, panelHeight = 190;
+    const float barWidth = (panelWidth - 20) / nBins, barsHeight = 60, barsBottom = top - panelHeight + 10;
+    
+    glColor4f(0.0, 0.0, 0.0, 0.6);
+    glRectf(left, top - panelHeight, left + panelWidth, top);
+    
+    glColor4f(0.3, 0.8, 0.3, 0.9);
+    
+    for (int i=0; i<nBins; ++i)
+    {
+        float x = left + 10 + i * barWidth;
+        
+        glRectf(x, barsBottom, x + barWidth - 1, barsBottom + barsHeight * bins[i] / maxCount);
+    }
+    
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    
+    glPopAttrib();
+    
+    if (history.empty())
+    {
+        return;
+    }
+    
+    // The overlay is drawn after the frame is timed, so it is not part of the times it shows
+    const FrameSample& last = history.back();
+    
+    QStringList lines;
+    
+    lines << QString("Frame: %1 ms, median %2 ms, 95%: %3 ms").arg(last.frameMs_, 0, 'f', 2).arg(frameStats_.frameMsPercentile(0.5), 0, 'f', 2).arg(frameStats_.frameMsPercentile(0.95), 0, 'f', 2);
+    lines << QString("Shapes: %1, parts: %2").arg(last.nShapes_).arg(last.nParts_);
+    lines << QString("Triangles: %1").arg(last.nTriangles_);
+    lines << QString("Draw calls: %1").arg(last.nDrawCalls_);
+    lines << QString("Picks: %1 in %2 ms").arg(last.nPicks_).arg(last.pickMs_, 0, 'f', 2);
+    lines << QString("0 - %1 ms in %2 ms bins").arg(nBins * binMs).arg(binMs);
+    
+    qglColor(Qt::white);
+    
+    for (int i=0; i<lines.size(); ++i)
+    {
+        renderText(20, 30 + 16 * i, lines[i]);
+    }
 }
 
 int QGLViewerWidget::pick(int x, int y)
 {
+    std::chrono::steady_clock::time_point pickStart = std::chrono::steady_clock::now();
+    
     // enable GL context
     makeCurrent();
 
@@ -356,6 +447,8 @@ int QGLViewerWidget::pick(int x, int y)
      */
  	hits = glRenderMode(GL_RENDER);
     
+    frameStats_.addPick(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pickStart).count());
+    
  	/*
      Print a list of the objects
      */
@@ -675,6 +768,8 @@ void QGLViewerWidget::keyPressEvent( QKeyEvent* _event)
             qDebug() << "  Print\tMake snapshot\n";
             qDebug() << "  C\tenable/disable back face culling\n";
             qDebug() << "  F\tenable/disable fog\n";
+            qDebug() << "  G\tshow/hide frame statistics\n";
+            qDebug() << "  Shift G\tsave frame statistics\n";
             qDebug() << "  I\tDisplay information\n";
             qDebug() << "  N\tenable/disable display of vertex normals\n";
             qDebug() << "  Shift N\tenable/disable display of face normals\n";
@@ -709,6 +804,23 @@ void QGLViewerWidget::keyPressEvent( QKeyEvent* _event)
             updateGL();
             break;
             
+        case Key_G:
+            if (_event->modifiers() & ShiftModifier)
+            {
+                QString name = "frame-stats-" + QDateTime::currentDateTime().toString( "yyMMddhhmmss" ) + ".csv";
+                
+                if (frameStats_.saveCsv(name))
+                {
+                    qDebug() << "Frame statistics saved to " << name;
+                }
+            }
+            else
+            {
+                showFrameStats_ = !showFrameStats_;
+                updateGL();
+            }
+            break;
+            
         case Key_I:
             qDebug() << "Scene radius: " << radius_ ;
             qDebug() << "Scene center: " << center_[0] << " " << center_[1] << " " << center_[2];
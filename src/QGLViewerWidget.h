@@ -57,6 +57,8 @@
 #include <vector>
 #include <map>
 
+#include "FrameStats.h"
+
 
 //== FORWARD DECLARATIONS =====================================================
 
@@ -173,6 +175,9 @@ private:
     
     void processHover(int posx, int posy);
     
+    // Histogram of the frame times and the counters of the last frame, drawn over the scene
+    void drawFrameStats();
+    
 protected:
     
     // Qt mouse events
@@ -227,6 +232,11 @@ private:
     OpenMesh::Vec3f  last_point_3D_;
     bool             last_point_ok_;
     
+    
+    // draw statistics of the last frames, G shows them and Shift G saves them
+    FrameStats       frameStats_;
+    bool             showFrameStats_;
+    
 };
 
 
@@ -0,0 +1,358 @@
+//
+//  RandomisedSVD.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <QDebug>
+
+#include "RandomisedSVD.h"
+#include "LinearAlgebra.h"
+#include "WorkStealingPool.h"
+
+// Rows of the matrix handled by one task of the pool
+static const int SVD_BLOCK_SIZE = 1024;
+
+static int nBlocks(int _n)
+{
+    return (_n + SVD_BLOCK_SIZE - 1) / SVD_BLOCK_SIZE;
+}
+
+// _y = (A - 1 c') _x for the _l columns of the _nColumns x _l row major _x, _y is _nRows x _l
+static void multiply(const std::vector<double>& _a, int _nRows, int _nColumns, const std::vector<double>& _centre, const std::vector<double>& _x, int _l, std::vector<double>& _y, WorkStealingPool& _pool)
+{
+    // c' x is the same for every row
+    std::vector<double> centreX(_l, 0.0);
+
+    if (!_centre.empty())
+    {
+        for (int j=0; j<_nColumns; ++j)
+        {
+            for (int c=0; c<_l; ++c)
+            {
+                centreX[c] += _centre[j] * _x[j * _l + c];
+            }
+        }
+    }
+
+    _y.resize((size_t)_nRows * _l);
+
+    _pool.run(nBlocks(_nRows), [&](int _block, int _worker)
+    {
+        const int end = std::min(_nRows, (_block + 1) * SVD_BLOCK_SIZE);
+
+        for (int i=_block * SVD_BLOCK_SIZE; i<end; ++i)
+        {
+            const double* row = &_a[(size_t)i * _nColumns];
+            double* y = &_y[(size_t)i * _l];
+
+            for (int c=0; c<_l; ++c)
+            {
+                y[c] = -centreX[c];
+            }
+
+            for (int j=0; j<_nColumns; ++j)
+            {
+                const double* x = &_x[j * _l];
+
+                for (int c=0; c<_l; ++c)
+                {
+                    y[c] += row[j] * x[c];
+                }
+            }
+        }
+    });
+}
+
+// _z = (A - 1 c')' _y for the _l columns of the _nRows x _l row major _y, _z is _nColumns x _l
+// Every block of rows adds up its own share, the shares are summed in block order so the result does not depend on the scheduling
+static void multiplyTransposed(const std::vector<double>& _a, int _nRows, int _nColumns, const std::vector<double>& _centre, const std::vector<double>& _y, int _l, std::vector<double>& _z, WorkStealingPool& _pool)
+{
+    const int nShares = nBlocks(_nRows);
+
+    std::vector<double> shares((size_t)nShares * _nColumns * _l, 0.0);
+    std::vector<double> sums((size_t)nShares * _l, 0.0);
+
+    _pool.run(nShares, [&](int _block, int _worker)
+    {
+        double* share = &shares[(size_t)_block * _nColumns * _l];
+        double* sum = &sums[(size_t)_block * _l];
+
+        const int end = std::min(_nRows, (_block + 1) * SVD_BLOCK_SIZE);
+
+        for (int i=_block * SVD_BLOCK_SIZE; i<end; ++i)
+        {
+            const double* row = &_a[(size_t)i * _nColumns];
+            const double* y = &_y[(size_t)i * _l];
+
+            for (int j=0; j<_nColumns; ++j)
+            {
+                double* z = share + j * _l;
+
+                for (int c=0; c<_l; ++c)
+                {
+                    z[c] += row[j] * y[c];
+                }
+            }
+
+            for (int c=0; c<_l; ++c)
+            {
+                sum[c] += y[c];
+            }
+        }
+    });
+
+    _z.assign((size_t)_nColumns * _l, 0.0);
+
+    std::vector<double> ySum(_l, 0.0);
+
+    for (int b=0; b<nShares; ++b)
+    {
+        const double* share = &shares[(size_t)b * _nColumns * _l];
+
+        for (size_t e=0; e<_z.size(); ++e)
+        {
+            _z[e] += share[e];
+        }
+
+        for (int c=0; c<_l; ++c)
+        {
+            ySum[c] += sums[(size_t)b * _l + c];
+        }
+    }
+
+    // c 1' y
+    if (!_centre.empty())
+    {
+        for (int j=0; j<_nColumns; ++j)
+        {
+            for (int c=0; c<_l; ++c)
+            {
+                _z[j * _l + c] -= _centre[j] * ySum[c];
+            }
+        }
+    }
+}
+
+// Orthonormalise the _l columns of the _n x _l row major _q by Gram-Schmidt done twice, columns that fall in the span of the ones before them are zeroed
+static void orthonormaliseColumns(std::vector<double>& _q, int _n, int _l)
+{
+    std::vector<double> norms(_l, 0.0);
+
+    for (int c=0; c<_l; ++c)
+    {
+        for (int pass=0; pass<2; ++pass)
+        {
+            for (int d=0; d<c; ++d)
+            {
+                if (norms[d] == 0.0)
+                {
+                    continue;
+                }
+
+                double dot = 0.0;
+
+                for (int i=0; i<_n; ++i)
+                {
+                    dot += _q[(size_t)i * _l + c] * _q[(size_t)i * _l + d];
+                }
+
+                for (int i=0; i<_n; ++i)
+                {
+                    _q[(size_t)i * _l + c] -= dot * _q[(size_t)i * _l + d];
+                }
+            }
+        }
+
+        double norm = 0.0;
+
+        for (int i=0; i<_n; ++i)
+        {
+            norm += _q[(size_t)i * _l + c] * _q[(size_t)i * _l + c];
+        }
+
+        norm = std::sqrt(norm);
+
+        // Norms are only compared to the largest one so far, a zero matrix leaves every column at zero
+        const double largest = *std::max_element(norms.begin(), norms.end());
+
+        if (!(norm > 1e-12 * largest))
+        {
+            norm = 0.0;
+        }
+
+        for (int i=0; i<_n; ++i)
+        {
+            _q[(size_t)i * _l + c] = (norm > 0.0) ? _q[(size_t)i * _l + c] / norm : 0.0;
+        }
+
+        norms[c] = norm;
+    }
+}
+
+bool randomisedSVD(const std::vector<double>& _data, int _nRows, int _nColumns, const std::vector<double>& _centre, int _k, std::vector<double>& _values, std::vector<double>& _vectors, const SVDOptions& _options)
+{
+    _values.clear();
+    _vectors.clear();
+
+    if (_nRows <= 0 || _nColumns <= 0 || _k <= 0 || _data.size() != (size_t)_nRows * _nColumns || (!_centre.empty() && _centre.size() != _nColumns))
+    {
+        qCritical() << "Cannot compute " << _k << " singular vectors of " << _nRows << " x " << _nColumns << " values";
+        return false;
+    }
+
+    const int k = std::min(_k, std::min(_nRows, _nColumns));
+
+    // Width of the sketch, more than min(n, p) columns cannot hold anything more
+    const int l = std::min(k + std::max(_options.oversampling_, 0), std::min(_nRows, _nColumns));
+
+    WorkStealingPool pool(_options.nThreads_);
+
+    std::mt19937_64 generator(_options.seed_);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    std::vector<double> omega((size_t)_nColumns * l);
+
+    for (size_t e=0; e<omega.size(); ++e)
+    {
+        omega[e] = normal(generator);
+    }
+
+    // Q spans the range of A Omega, then of (A A')^q A Omega, orthonormalised after every product so the small singular values do not drown
+    std::vector<double> q, z;
+
+    multiply(_data, _nRows, _nColumns, _centre, omega, l, q, pool);
+    orthonormaliseColumns(q, _nRows, l);
+
+    for (int it=0; it<_options.nPowerIterations_; ++it)
+    {
+        multiplyTransposed(_data, _nRows, _nColumns, _centre, q, l, z, pool);
+        orthonormaliseColumns(z, _nColumns, l);
+
+        multiply(_data, _nRows, _nColumns, _centre, z, l, q, pool);
+        orthonormaliseColumns(q, _nRows, l);
+    }
+
+    // B' = A' Q is _nColumns x l, the singular values of B are those of A restricted to the range found
+    std::vector<double> bt;
+
+    multiplyTransposed(_data, _nRows, _nColumns, _centre, q, l, bt, pool);
+
+    // B B' is l x l, its eigenvectors u give the right singular vectors v = B' u / sigma
+    std::vector<double> gram(l * l, 0.0);
+
+    for (int j=0; j<_nColumns; ++j)
+    {
+        const double* row = &bt[j * l];
+
+        for (int a=0; a<l; ++a)
+        {
+            for (int b=a; b<l; ++b)
+            {
+                gram[a * l + b] += row[a] * row[b];
+            }
+        }
+    }
+
+    for (int a=0; a<l; ++a)
+    {
+        for (int b=0; b<a; ++b)
+        {
+            gram[a * l + b] = gram[b * l + a];
+        }
+    }
+
+    std::vector<double> values, vectors;
+
+    symmetricEigen(l, gram, values, vectors);
+
+    _values.resize(k);
+    _vectors.assign((size_t)k * _nColumns, 0.0);
+
+    for (int j=0; j<k; ++j)
+    {
+        const double sigma = std::sqrt(std::max(values[j], 0.0));
+
+        _values[j] = sigma;
+
+        if (sigma == 0.0)
+        {
+            continue;
+        }
+
+        double* v = &_vectors[(size_t)j * _nColumns];
+
+        for (int i=0; i<_nColumns; ++i)
+        {
+            double s = 0.0;
+
+            for (int a=0; a<l; ++a)
+            {
+                s += bt[i * l + a] * vectors[j * l + a];
+            }
+
+            v[i] = s / sigma;
+        }
+    }
+
+    return true;
+}
+
+bool principalComponents(const std::vector<double>& _data, int _nRows, int _nColumns, int _k, std::vector<double>& _mean, std::vector<double>& _components, std::vector<double>& _variances, const SVDOptions& _options)
+{
+    if (_nRows <= 0 || _nColumns <= 0 || _data.size() != (size_t)_nRows * _nColumns)
+    {
+        qCritical() << "Cannot compute the principal components of " << _nRows << " x " << _nColumns << " values";
+        return false;
+    }
+
+    _mean.assign(_nColumns, 0.0);
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        for (int j=0; j<_nColumns; ++j)
+        {
+            _mean[j] += _data[(size_t)i * _nColumns + j];
+        }
+    }
+
+    for (int j=0; j<_nColumns; ++j)
+    {
+        _mean[j] /= _nRows;
+    }
+
+    std::vector<double> values;
+
+    if (!randomisedSVD(_data, _nRows, _nColumns, _mean, _k, values, _components, _options))
+    {
+        return false;
+    }
+
+    // Fewer rows or columns than _k leave the last components at zero, as princomp does
+    const int found = values.size();
+
+    _components.resize((size_t)_k * _nColumns, 0.0);
+    _variances.assign(_k, 0.0);
+
+    for (int j=0; j<found; ++j)
+    {
+        _variances[j] = (_nRows > 1) ? values[j] * values[j] / (_nRows - 1) : 0.0;
+
+        double* v = &_components[(size_t)j * _nColumns];
+
+        const int largest = std::max_element(v, v + _nColumns, [](double _a, double _b) { return std::fabs(_a) < std::fabs(_b); }) - v;
+
+        if (v[largest] < 0.0)
+        {
+            for (int i=0; i<_nColumns; ++i)
+            {
+                v[i] = -v[i];
+            }
+        }
+    }
+
+    return true;
+}
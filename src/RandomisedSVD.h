@@ -0,0 +1,34 @@
+//
+//  RandomisedSVD.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef RANDOMISEDSVD_H
+#define RANDOMISEDSVD_H
+
+#include <vector>
+
+struct SVDOptions
+{
+    // Extra random directions beyond the requested rank, they make the range found far more likely to hold the leading singular vectors
+    int oversampling_ = 10;
+
+    // Each iteration multiplies by A A' once more, so components with close singular values are still told apart
+    int nPowerIterations_ = 2;
+
+    unsigned long long seed_ = 1;
+
+    // 0 means one per hardware thread
+    int nThreads_ = 0;
+};
+
+// The _k leading singular values and right singular vectors of the _nRows x _nColumns row major matrix _data with _centre subtracted from every row (empty for none)
+// The randomised range finder of Halko, Martinsson and Tropp, the centred matrix is never formed and the products with it run over blocks of rows on a pool of threads
+// Singular values come largest first, component i of singular vector j is _vectors[j * _nColumns + i]
+bool randomisedSVD(const std::vector<double>& _data, int _nRows, int _nColumns, const std::vector<double>& _centre, int _k, std::vector<double>& _values, std::vector<double>& _vectors, const SVDOptions& _options = SVDOptions());
+
+// The _k leading principal components of the rows of _data, as princomp gives them: _mean of the rows, unit _components one after the other and the _variances along them
+// The sign of every component is fixed so that its largest entry is positive
+bool principalComponents(const std::vector<double>& _data, int _nRows, int _nColumns, int _k, std::vector<double>& _mean, std::vector<double>& _components, std::vector<double>& _variances, const SVDOptions& _options = SVDOptions());
+
+#endif
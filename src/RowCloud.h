@@ -0,0 +1,43 @@
+//
+//  RowCloud.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef ROWCLOUD_H
+#define ROWCLOUD_H
+
+#include <vector>
+
+#include "nanoflann.h"
+
+// nanoflann adaptor over rows stored one after the other, as SynthesisEngine::DescriptorCloud
+struct RowCloud
+{
+    const std::vector<double>& data_;
+    const int dim_;
+
+    RowCloud(const std::vector<double>& _data, int _dim) : data_(_data), dim_(_dim) { }
+
+    inline size_t kdtree_get_point_count() const { return data_.size() / dim_; }
+
+    inline double kdtree_distance(const double* p1, const size_t idx_p2, size_t size) const
+    {
+        const double* p2 = &data_[idx_p2 * dim_];
+        double d = 0;
+        for (size_t i=0; i<size; ++i)
+        {
+            const double di = p1[i] - p2[i];
+            d += di*di;
+        }
+        return d;
+    }
+
+    inline double kdtree_get_pt(const size_t idx, int dim) const { return data_[idx * dim_ + dim]; }
+
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX& bb) const { return false; }
+};
+
+typedef nanoflann::KDTreeSingleIndexAdaptor< nanoflann::L2_Adaptor<double, RowCloud>, RowCloud, -1 > RowTree;
+
+#endif
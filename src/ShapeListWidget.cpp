@@ -6,12 +6,105 @@
 #include <iostream>
 
 
+// A file that still cannot be read after this many scans is taken as broken and left alone
+static const int MAX_WATCHED_FILE_ATTEMPTS = 10;
+
 ShapeListWidget::ShapeListWidget(QWidget * parent)
 : QListWidget(parent)
 {
     
     setSelectionMode(QAbstractItemView::MultiSelection );
     
+    watcher_ = new QFileSystemWatcher(this);
+    
+    watchTimer_ = new QTimer(this);
+    watchTimer_->setSingleShot(true);
+    watchTimer_->setInterval(1000);
+    
+    QObject::connect(watcher_, SIGNAL(directoryChanged(const QString&)), watchTimer_, SLOT(start()));
+    QObject::connect(watchTimer_, SIGNAL(timeout()), this, SLOT(slotScanWatchedDirectory()));
+}
+
+void ShapeListWidget::watchDirectory(const QString& _path)
+{
+    QDir dir(_path);
+    
+    if (!dir.exists())
+    {
+        qCritical() << "Cannot watch directory " << _path << " for new matches, it does not exist";
+        return;
+    }
+    
+    if (!watchedDirectory_.isEmpty())
+    {
+        watcher_->removePath(watchedDirectory_);
+    }
+    
+    watchedDirectory_ = dir.absolutePath();
+    watchedFiles_.clear();
+    failedFiles_.clear();
+    
+    QStringList files = dir.entryList(QStringList("*.match"), QDir::Files);
+    
+    for (int i=0; i<files.size(); ++i)
+    {
+        watchedFiles_.insert(files[i]);
+    }
+    
+    watcher_->addPath(watchedDirectory_);
+    
+    qDebug() << "Watching " << watchedDirectory_ << " for new matches" ;
+}
+
+void ShapeListWidget::slotScanWatchedDirectory()
+{
+    QStringList files = QDir(watchedDirectory_).entryList(QStringList("*.match"), QDir::Files, QDir::Name);
+    
+    std::vector<Match*> matches;
+    
+    bool retry = false;
+    
+    for (int i=0; i<files.size(); ++i)
+    {
+        if (watchedFiles_.contains(files[i]))
+        {
+            continue;
+        }
+        
+        Match* match = loadMatchShape(watchedDirectory_ + "/" + files[i], PRELOAD_MODELS);
+        
+        if (match)
+        {
+            watchedFiles_.insert(files[i]);
+            failedFiles_.remove(files[i]);
+            
+            matches.push_back(match);
+        }
+        else if (++failedFiles_[files[i]] >= MAX_WATCHED_FILE_ATTEMPTS)
+        {
+            qWarning() << "Giving up on " << files[i] << " after " << MAX_WATCHED_FILE_ATTEMPTS << " attempts";
+            
+            watchedFiles_.insert(files[i]);
+            failedFiles_.remove(files[i]);
+        }
+        else
+        {
+            retry = true;
+        }
+    }
+    
+    // A file still being written may not change the directory again, so scan once more after the next quiet interval
+    if (retry)
+    {
+        watchTimer_->start();
+    }
+    
+    if (!matches.empty())
+    {
+        qDebug() << "Found " << matches.size() << " new matches in " << watchedDirectory_ ;
+        
+        emit matchShapesAdded(matches);
+    }
 }
 
 
@@ -273,6 +366,22 @@ void ShapeListWidget::openMatchCollection(const QString& _fname, bool _load_mesh
 // /pathtohere/bikes/meshes/
 // /pathtohere/bikes/matches/
 void ShapeListWidget::openMatchShape(const QString& _fname, bool _load_mesh)
+{
+    Match* match = loadMatchShape(_fname, _load_mesh);
+    
+    if (!match)
+    {
+        return;
+    }
+    
+    std::vector<Match*> matches;
+    
+    matches.push_back(match);
+    
+    emit matchShapesAdded(matches);
+}
+
+ShapeListWidget::Match* ShapeListWidget::loadMatchShape(const QString& _fname, bool _load_mesh)
 {
     ShapeListWidgetItem<Match>* slwi = new ShapeListWidgetItem<Match>;
     
@@ -310,14 +419,18 @@ void ShapeListWidget::openMatchShape(const QString& _fname, bool _load_mesh)
 
     QString mesh_fname = fname_split.join("/");
 
+    // A match that cannot be read is left out rather than listed without parts, the folder watch tries it again later
     if (_fname.isEmpty() || !slwi->shape().open(_fname.toStdString().c_str()))
     {
-        qCritical() << "Cannot read match from file: " << _fname;
+        qCritical() << "Cannot read match from file: " << _fname << ", it is not added";
+        delete slwi;
+        return 0;
     }
     
+    // The match is kept without its mesh, as for a collection, the mesh is opened again when it is needed
     OpenMesh::Utils::Timer t;
     t.start();
-    if ( _fname.isEmpty() || (_load_mesh && !slwi->shape().openMesh(mesh_fname.toStdString().c_str())) )
+    if (_load_mesh && !slwi->shape().openMesh(mesh_fname.toStdString().c_str()))
     {
        qCritical() << "Cannot read mesh from file: " << mesh_fname;
     }
@@ -329,11 +442,7 @@ void ShapeListWidget::openMatchShape(const QString& _fname, bool _load_mesh)
     
     this->addItem(slwi);
     
-    std::vector<Match*> matches;
-    
-    matches.push_back(&slwi->shape());
-    
-    emit matchShapesAdded(matches);
+    return &slwi->shape();
 }
 
 void ShapeListWidget::openPlainShape(const QString& _fname, bool _load_mesh)
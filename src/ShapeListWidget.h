@@ -19,6 +19,10 @@
 #include <QDebug>
 
 #include <QDir>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QSet>
+#include <QHash>
 
 #include <OpenMesh/Core/IO/MeshIO.hh>
 #include <OpenMesh/Core/IO/Options.hh>
@@ -52,6 +56,9 @@ public:
     
     void openMatchShape(const QString& _fname, bool _load_mesh);
     
+    // Open new .match files as they appear in the directory and announce them with matchShapesAdded, the files already there are taken as known
+    void watchDirectory(const QString& _path);
+    
     void openPlainShape(const QString& _fname, bool _load_mesh);
     
     // Re-implemented from QListWidget - emits the signal with the currently selected shapes
@@ -64,6 +71,10 @@ public slots:
     void slotAddShapesFromDir();
     
     void slotSaveMatchCollection();
+    
+private slots:
+    
+    void slotScanWatchedDirectory();
    
 signals:
     
@@ -73,7 +84,23 @@ signals:
     
     void matchShapesAdded(const std::vector<Match*>& _matches);
     
-
+private:
+    
+    // Adds the item for the match without announcing it, so several matches can be announced at once
+    // Returns 0 and adds nothing if the match cannot be read, a match whose mesh cannot be read is added without it
+    Match* loadMatchShape(const QString& _fname, bool _load_mesh);
+    
+    QFileSystemWatcher* watcher_;
+    
+    // A copy into the watched directory changes it many times, it is only scanned once it has been quiet for a moment
+    QTimer* watchTimer_;
+    
+    QString watchedDirectory_;
+    
+    QSet<QString> watchedFiles_;
+    
+    // Files that could not be read yet, e.g. still being copied, and how many scans have tried them
+    QHash<QString, int> failedFiles_;
 };
 
 #endif
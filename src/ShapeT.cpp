@@ -49,10 +49,9 @@ template <typename M> bool ShapeT<M>::openMesh(const char* _filename)
     mesh_.request_vertex_normals();
     
     
-    qDebug() << "Loading from file '" << _filename ;
+    LOG_DEBUG() << "Loading from file '" << _filename ;
     
-    OpenMesh::Utils::Timer t1;
-    t1.start();
+    TRACE_SPAN("ShapeT::openMesh");
     
     OpenMesh::IO::Options opt;
     
@@ -61,9 +60,33 @@ template <typename M> bool ShapeT<M>::openMesh(const char* _filename)
     
     indexMap_.clear();
     
+    bool loaded = false;
+    
+    // Part meshes are all OFF files, the generic reader is only needed for the other formats or for OFF variants the fast reader skips
+    if (QString(_filename).endsWith(".off", Qt::CaseInsensitive))
+    {
+        bool vertexNormalsRead = false;
+        
+        loaded = openOffMesh(_filename, vertexNormalsRead);
+        
+        opt = OpenMesh::IO::Options();
+        
+        if (vertexNormalsRead)
+        {
+            opt += OpenMesh::IO::Options::VertexNormal;
+        }
+    }
+    
     //if ( OpenMesh::IO::read_mesh(mesh_, _filename, opt, false, &indexMap_))
-    if ( OpenMesh::IO::read_mesh(mesh_, std::string(_filename), opt, false))
+    if (!loaded)
+    {
+        loaded = OpenMesh::IO::read_mesh(mesh_, std::string(_filename), opt, false);
+    }
+    
+    if (loaded)
     {
+        geometryChanged();
+        
         // Update face and vertex normals
         if ( ! opt.check( OpenMesh::IO::Options::FaceNormal ) )
         {
@@ -82,10 +105,7 @@ template <typename M> bool ShapeT<M>::openMesh(const char* _filename)
             qDebug() << "File provides vertex normals";
         }
         
-        t1.stop();
-        
-        qDebug() << "Mesh loaded in: " << t1.as_string().c_str() ;
-        qDebug() << mesh_.n_vertices() << " vertices, " << mesh_.n_edges() << " edge, " << mesh_.n_faces() << " faces";
+        LOG_DEBUG() << mesh_.n_vertices() << " vertices, " << mesh_.n_edges() << " edge, " << mesh_.n_faces() << " faces";
         
         return true;
     }
@@ -97,6 +117,120 @@ template <typename M> bool ShapeT<M>::openMesh(const char* _filename)
     
 }
 
+template <typename M> bool ShapeT<M>::openOffMesh(const char* _filename, bool& _vertexNormalsRead)
+{
+    OffData data;
+    
+    if (!readOffFile(_filename, data))
+    {
+        return false;
+    }
+    
+    const size_t nVertices = data.points_.size() / 3;
+    
+    std::vector<typename Mesh::VertexHandle> vertices;
+    
+    buildMesh(data.points_.data(), nVertices, data.triangles_.data(), data.triangles_.size() / 3, vertices);
+    
+    _vertexNormalsRead = !data.normals_.empty() && mesh_.has_vertex_normals() && mesh_.n_vertices() == nVertices;
+    
+    if (_vertexNormalsRead)
+    {
+        const float* n = &data.normals_[0];
+        
+        for (size_t v=0; v<nVertices; ++v, n += 3)
+        {
+            mesh_.set_normal(vertices[v], typename Mesh::Normal(n[0], n[1], n[2]));
+        }
+    }
+    
+    return true;
+}
+
+template <typename M> bool ShapeT<M>::openBinaryMesh(const QString& _filename)
+{
+    mesh_.request_face_normals();
+    
+    mesh_.request_vertex_normals();
+    
+    TRACE_SPAN("ShapeT::openBinaryMesh");
+    
+    PartMeshFile file;
+    
+    if (!file.open(_filename))
+    {
+        return false;
+    }
+    
+    const PartMeshFile::Header& header = file.header();
+    
+    std::vector<typename Mesh::VertexHandle> vertices;
+    
+    buildMesh(file.points(), header.nVertices_, file.triangles(), header.nTriangles_, vertices);
+    
+    mesh_.update_face_normals();
+    
+    // The stored normals belong to the vertices of the file, they do not fit if some vertices had to be duplicated
+    const short* n = file.normals();
+    
+    if (n && mesh_.n_vertices() == header.nVertices_)
+    {
+        const float scale = 1.0f / 32767.0f;
+        
+        for (size_t v=0; v<header.nVertices_; ++v, n += 3)
+        {
+            mesh_.set_normal(vertices[v], typename Mesh::Normal(n[0] * scale, n[1] * scale, n[2] * scale));
+        }
+    }
+    else
+    {
+        mesh_.update_vertex_normals();
+    }
+    
+    return true;
+}
+
+template <typename M> void ShapeT<M>::buildMesh(const float* _points, size_t _nVertices, const unsigned int* _triangles, size_t _nTriangles, std::vector<typename Mesh::VertexHandle>& _vertices)
+{
+    mesh_.clear();
+    
+    // A closed triangle mesh has one and a half edges per face
+    mesh_.reserve(_nVertices, _nTriangles * 3 / 2 + 1, _nTriangles);
+    
+    _vertices.resize(_nVertices);
+    
+    const float* p = _points;
+    
+    for (size_t v=0; v<_nVertices; ++v, p += 3)
+    {
+        _vertices[v] = mesh_.add_vertex(typename Mesh::Point(p[0], p[1], p[2]));
+    }
+    
+    const unsigned int* t = _triangles;
+    
+    for (size_t f=0; f<_nTriangles; ++f, t += 3)
+    {
+        typename Mesh::VertexHandle v0 = _vertices[t[0]], v1 = _vertices[t[1]], v2 = _vertices[t[2]];
+        
+        if (v0 == v1 || v1 == v2 || v2 == v0)
+        {
+            continue;
+        }
+        
+        // Faces that would make the mesh non-manifold get copies of their vertices, as the OpenMesh reader does
+        if (!mesh_.add_face(v0, v1, v2).is_valid())
+        {
+            v0 = mesh_.add_vertex(mesh_.point(v0));
+            v1 = mesh_.add_vertex(mesh_.point(v1));
+            v2 = mesh_.add_vertex(mesh_.point(v2));
+            
+            mesh_.add_face(v0, v1, v2);
+        }
+    }
+    
+    geometryChanged();
+}
+
 template <typename M> unsigned int ShapeT<M>::id()
 {
     return id_;
@@ -205,6 +339,8 @@ template <typename M> void ShapeT<M>::draw(const std::string& _drawMode) const
             glVertex3fv( &mesh_.point(fvIt)[0] );
         }
         glEnd();
+        
+        countDrawCalls(1, mesh_.n_faces());
     }
     
     else if (_drawMode == "Solid Flat")
@@ -222,6 +358,8 @@ template <typename M> void ShapeT<M>::draw(const std::string& _drawMode) const
             glVertex3fv( &mesh_.point(fvIt)[0] );
         }
         glEnd();
+        
+        countDrawCalls(1, mesh_.n_faces());
     }
     
     else if (_drawMode == "Solid Smooth")
@@ -244,6 +382,8 @@ template <typename M> void ShapeT<M>::draw(const std::string& _drawMode) const
         }
         glEnd();
         
+        countDrawCalls(1, mesh_.n_faces());
+        
         glDisableClientState(GL_VERTEX_ARRAY);
         glDisableClientState(GL_NORMAL_ARRAY);
     }
@@ -274,6 +414,8 @@ template <typename M> void ShapeT<M>::draw(const std::string& _drawMode) const
         }
         glEnd();
         
+        countDrawCalls(1, mesh_.n_faces());
+        
         glDisableClientState(GL_VERTEX_ARRAY);
         glDisableClientState(GL_NORMAL_ARRAY);
         glDisableClientState(GL_COLOR_ARRAY);
@@ -302,6 +444,8 @@ template <typename M> void ShapeT<M>::draw(const std::string& _drawMode) const
         }
         glEnd();
         
+        countDrawCalls(1, mesh_.n_faces());
+        
         glDisableClientState(GL_VERTEX_ARRAY);
         glDisableClientState(GL_NORMAL_ARRAY);
     }
@@ -332,6 +476,8 @@ template <typename M> void ShapeT<M>::draw(const std::string& _drawMode) const
         }
         glEnd();
         
+        countDrawCalls(1, mesh_.n_faces());
+        
         glDisableClientState(GL_VERTEX_ARRAY);
         glDisableClientState(GL_NORMAL_ARRAY);
     }
@@ -348,6 +494,7 @@ template <typename M> void ShapeT<M>::draw(const std::string& _drawMode) const
         }
         
         glDrawArrays( GL_POINTS, 0, mesh_.n_vertices() );
+        countDrawCalls(1, 0);
         glDisableClientState(GL_VERTEX_ARRAY);
         glDisableClientState(GL_COLOR_ARRAY);
     }
@@ -406,24 +553,20 @@ template <typename M> void ShapeT<M>::drawNormals(const std::string& _normalDraw
 
 template <typename M> void ShapeT<M>::normalise()
 {
+    const Statistics& stats = statistics();
     
-    typename Mesh::VertexIter vIt(mesh_.vertices_begin()), vEnd(mesh_.vertices_end());
-    
-    typename Mesh::Point centroid = meshCentroid();
+    typename Mesh::Point centroid = stats.centroid_;
     
-    for(; vIt!=vEnd; ++vIt)
-    {
-        mesh_.set_point(vIt, mesh_.point(vIt) - centroid);
-    }
+    float scaleFactor = 1.0 / stats.averageRadius_;
     
-    float scaleFactor = 1.0 / averageRadius(centroid);
-    
-    vIt = mesh_.vertices_begin();
+    typename Mesh::VertexIter vIt(mesh_.vertices_begin()), vEnd(mesh_.vertices_end());
     
     for(; vIt!=vEnd; ++vIt)
     {
-        mesh_.set_point(vIt, scaleFactor * mesh_.point(vIt) );
+        mesh_.set_point(vIt, scaleFactor * (mesh_.point(vIt) - centroid) );
     }
+    
+    geometryChanged();
 }
 
 template <typename M> double ShapeT<M>::faceArea(const typename Mesh::FaceHandle& _fH)
@@ -473,30 +616,7 @@ template <typename M> typename M::Point ShapeT<M>::meshCentroid()
 {
     //openMeshIfNotOpened();
     
-    double area = 0.0;
-    
-    typename Mesh::Point centroid(0,0,0);
-    
-    typename Mesh::ConstFaceIter fIt(mesh_.faces_begin()), fEnd(mesh_.faces_end());
-    
-    for(; fIt!=fEnd; ++fIt)
-    {
-        float fArea = faceArea(fIt);
-        
-        // Note: we do not handle the case if face area is zero (face has more than 3 vertices). In this case the face is simply ignored
-        centroid += fArea * faceCentroid(fIt);
-        
-        area += fArea;
-    }
-    
-    if(area == 0.0)
-    {
-        return centroid;
-    }
-    else
-    {
-        return centroid / area;
-    }
+    return statistics().centroid_;
 }
 
 template <typename M> typename M::Point ShapeT<M>::verticesCentroid()
@@ -529,6 +649,13 @@ template <typename M> double ShapeT<M>::averageRadius(const typename Mesh::Point
 {
     //openMeshIfNotOpened();
     
+    const Statistics& stats = statistics();
+    
+    if (_centroid == stats.centroid_)
+    {
+        return stats.averageRadius_;
+    }
+    
     double area = 0.0;
     
     double distance = 0.0;
@@ -555,88 +682,129 @@ template <typename M> double ShapeT<M>::averageRadius(const typename Mesh::Point
     }
 }
 
-template <typename M> typename M::Point ShapeT<M>::getRandomPoint(const std::vector<double>& _areas)
+template <typename M> void ShapeT<M>::getRandomPoints(std::vector<typename Mesh::Point>& _points, int _nPoints, unsigned long long _seed, int _nThreads)
 {
+    SurfaceSampler<M> sampler(mesh_);
     
-    typename Mesh::Point randomPoint(0,0,0);
-    int nF = mesh_.n_faces();
-    
-    if(nF!= _areas.size())
+    if (sampler.isEmpty())
     {
-        qCritical() << "The number of faces in the mesh (" << nF << ") is not the same as the number of entries in the cumulative area distribution! Cannot get random point!" ;
-        return randomPoint;
+        qCritical() << "The mesh has no face with a positive area, cannot get random points!" ;
+        _points.clear();
+        return;
     }
-    //Since the areas array has the cumulative area up to every face, it's safe to assume the last position has the total area of the mesh
-    float totalArea = _areas.at(nF -1);
-    
-    //Get a random number between 0 and the total area
-    double randomArea= random<double>(0.0f,totalArea);
-    float random1 = random<float>(0.0f,1.0f);
-    float random2 = random<float>(0.0f,1.0f);
-    int faceIndex= binarySearch<double>(_areas, randomArea);
     
-    typename Mesh::ConstFaceVertexIter fvIt(mesh_.cfv_iter(mesh_.face_handle(faceIndex)));
+    sampler.sample(std::max(_nPoints, 0), _seed, _points, _nThreads);
+}
+
+template <typename M> typename ShapeT<M>::BBox ShapeT<M>::bbox()
+{
+    return statistics().bbox_;
+}
+
+template <typename M> const typename ShapeT<M>::Statistics& ShapeT<M>::statistics()
+{
+    if (statisticsValid_)
+    {
+        return statistics_;
+    }
     
-    const typename Mesh::Point& p0 = mesh_.point(fvIt);
-    ++fvIt;
-    const typename Mesh::Point& p1 = mesh_.point(fvIt);
-    ++fvIt;
-    const typename Mesh::Point& p2 = mesh_.point(fvIt);
-    ++fvIt;
+    Statistics stats;
     
+    const size_t nVertices = mesh_.n_vertices();
+    const typename Mesh::Point* points = nVertices ? &mesh_.points()[0] : 0;
     
-    float squareRandom1 = sqrt(random1);
+    // Gather the vertex indices of the triangles once, the passes below then only read the contiguous points
+    // Faces with more than 3 vertices have no area, as in faceArea, so they are left out
+    std::vector<int> triangles;
+    triangles.reserve(3 * mesh_.n_faces());
     
-    randomPoint = (1 - squareRandom1)*p0 + squareRandom1*(1-random2)*p1+ squareRandom1*random2*p2;
+    typename Mesh::ConstFaceIter fIt(mesh_.faces_begin()), fEnd(mesh_.faces_end());
     
-    if(fvIt)
+    for (; fIt!=fEnd; ++fIt)
     {
-        // TODO: Handle non-triangle meshes possibly?
-        qWarning() << "Mesh face appears to have more than 3 vertices! Only using the first 3 vertices to get a random point on the face" ;
+        typename Mesh::HalfedgeHandle h0 = mesh_.halfedge_handle(fIt.handle());
+        typename Mesh::HalfedgeHandle h1 = mesh_.next_halfedge_handle(h0);
+        typename Mesh::HalfedgeHandle h2 = mesh_.next_halfedge_handle(h1);
+        
+        if (mesh_.next_halfedge_handle(h2) != h0)
+        {
+            continue;
+        }
+        
+        triangles.push_back(mesh_.to_vertex_handle(h0).idx());
+        triangles.push_back(mesh_.to_vertex_handle(h1).idx());
+        triangles.push_back(mesh_.to_vertex_handle(h2).idx());
     }
     
-    return randomPoint;
-}
-
-template <typename M> void ShapeT<M>::getRandomPoints(std::vector<typename Mesh::Point>& _points, int _nPoints)
-{
+    const size_t nTriangles = triangles.size() / 3;
+    const int* t = triangles.empty() ? 0 : &triangles[0];
     
-    _points.clear();
+    // The sums are spread over four independent partial sums, which keeps the additions from waiting on each other and rounds less on large meshes
+    double area[4] = { 0.0, 0.0, 0.0, 0.0 };
+    double x[4] = { 0.0, 0.0, 0.0, 0.0 };
+    double y[4] = { 0.0, 0.0, 0.0, 0.0 };
+    double z[4] = { 0.0, 0.0, 0.0, 0.0 };
     
-    typename Mesh::ConstFaceIter fIt(mesh_.faces_begin()), fEnd(mesh_.faces_end());
+    // One pass for the box over the points and the area weighted centroid over the triangles, vertices outside any triangle still count for the box
+    const size_t nSteps = std::max(nVertices, nTriangles);
     
-    std::vector<double> cumulativeAreas(0,mesh_.n_faces());
+    for (size_t i=0; i<nSteps; ++i)
+    {
+        if (i < nVertices)
+        {
+            stats.bbox_.min.minimize(points[i]);
+            stats.bbox_.max.maximize(points[i]);
+        }
+        
+        if (i < nTriangles)
+        {
+            const typename Mesh::Point& p0 = points[t[3 * i]];
+            const typename Mesh::Point& p1 = points[t[3 * i + 1]];
+            const typename Mesh::Point& p2 = points[t[3 * i + 2]];
+            
+            const double a = 0.5f * ((p1 - p0) % (p2 - p0)).norm();
+            const typename Mesh::Point c = (p0 + p1 + p2) / 3.0f;
+            
+            const int lane = i & 3;
+            
+            area[lane] += a;
+            x[lane] += a * c[0];
+            y[lane] += a * c[1];
+            z[lane] += a * c[2];
+        }
+    }
     
-    double area = 0.0;
+    stats.area_ = (area[0] + area[1]) + (area[2] + area[3]);
     
-    for(; fIt!=fEnd; ++fIt)
+    if (stats.area_ > 0.0)
     {
-        double fArea = faceArea(fIt);
+        stats.centroid_ = typename Mesh::Point(((x[0] + x[1]) + (x[2] + x[3])) / stats.area_, ((y[0] + y[1]) + (y[2] + y[3])) / stats.area_, ((z[0] + z[1]) + (z[2] + z[3])) / stats.area_);
         
-        area += fArea;
+        // The radius needs the centroid, so it is the one second pass, over the gathered triangles
+        double distance[4] = { 0.0, 0.0, 0.0, 0.0 };
+        
+        for (size_t i=0; i<nTriangles; ++i)
+        {
+            const typename Mesh::Point& p0 = points[t[3 * i]];
+            const typename Mesh::Point& p1 = points[t[3 * i + 1]];
+            const typename Mesh::Point& p2 = points[t[3 * i + 2]];
+            
+            const double a = 0.5f * ((p1 - p0) % (p2 - p0)).norm();
+            
+            distance[i & 3] += a * ((p0 + p1 + p2) / 3.0f - stats.centroid_).norm();
+        }
         
-        cumulativeAreas.push_back(area);
+        stats.averageRadius_ = ((distance[0] + distance[1]) + (distance[2] + distance[3])) / stats.area_;
     }
     
-    for(int i=0;i<_nPoints;i++)
-    {
-        _points.push_back( getRandomPoint(cumulativeAreas) );
-    }
+    statistics_ = stats;
+    statisticsValid_ = true;
+    
+    return statistics_;
 }
 
-template <typename M> typename ShapeT<M>::BBox ShapeT<M>::bbox()
+template <typename M> void ShapeT<M>::geometryChanged()
 {
-    BBox box;
-    
-    typename Mesh::ConstVertexIter vIt(mesh_.vertices_begin());
-    typename Mesh::ConstVertexIter vEnd(mesh_.vertices_end());
-    
-    for ( ; vIt!=vEnd; ++vIt)
-    {
-        box.min.minimize( mesh_.point(vIt));
-        box.max.maximize( mesh_.point(vIt));
-    }
-    
-    return box;
+    statisticsValid_ = false;
 }
 
@@ -13,13 +13,18 @@
 #include <OpenMesh/Core/IO/MeshIO.hh>
 #include <OpenMesh/Core/IO/Options.hh>
 #include <OpenMesh/Core/Utils/GenProg.hh>
-#include <OpenMesh/Tools/Utils/Timer.hh>
 #include <OpenMesh/Core/Mesh/Attributes.hh>
 #include <OpenMesh/Tools/Utils/StripifierT.hh>
 
 #include <QtOpenGL/qgl.h>
 
 #include "utils.h"
+#include "OffReader.h"
+#include "PartMeshFile.h"
+#include "SurfaceSampler.h"
+#include "Trace.h"
+#include "AsyncLog.h"
+#include "FrameStats.h"
 
 
 template <typename M> class ShapeT
@@ -34,6 +39,21 @@ public:
         typename Mesh::Point max = typename Mesh::Point(-std::numeric_limits<typename Mesh::Point::value_type>::max(),-std::numeric_limits<typename Mesh::Point::value_type>::max(),-std::numeric_limits<typename Mesh::Point::value_type>::max());
     };
     
+    // Everything normalise and the viewer need to know about the geometry, see statistics()
+    struct Statistics
+    {
+        // Surface area, faces with more than 3 vertices count as zero
+        double area_ = 0.0;
+        
+        // Area weighted centroid of the faces, the origin if the area is zero
+        typename Mesh::Point centroid_ = typename Mesh::Point(0,0,0);
+        
+        // Area weighted distance of the face centroids to centroid_
+        double averageRadius_ = 0.0;
+        
+        BBox bbox_;
+    };
+    
     ShapeT()
     {
         
@@ -50,6 +70,9 @@ public:
     
     virtual bool openMesh(const char* _filename);
     
+    // Build the mesh from a binary part mesh file written by shapesynth-convert, the normals are taken from the file when it has them
+    bool openBinaryMesh(const QString& _filename);
+    
     virtual void openMeshIfNotOpened();
     
     virtual BBox bbox();
@@ -70,7 +93,7 @@ public:
     
     const Mesh& mesh() const;
     
-    void setFilename(const QString& _filename);
+    virtual void setFilename(const QString& _filename);
     
     const QString& filename() const;
     
@@ -92,12 +115,24 @@ public:
     
     double averageRadius( const typename Mesh::Point& _centroid);
     
-    typename Mesh::Point getRandomPoint(const std::vector<double>& _areas);
+    // Computed the first time it is needed after the geometry changed, from the points and a gathered array of triangle indices
+    const Statistics& statistics();
+    
+    // Anything that moves, adds or removes vertices through mesh() has to call this, the cached statistics are stale otherwise
+    void geometryChanged();
     
-    void getRandomPoints(std::vector<typename Mesh::Point>& _points, int _nPoints);
+    // _nPoints uniform samples on the surface, the same for the same seed (see SurfaceSampler), on _nThreads threads or one per hardware thread if it is not positive
+    void getRandomPoints(std::vector<typename Mesh::Point>& _points, int _nPoints, unsigned long long _seed = 1, int _nThreads = 1);
     
 protected:
     
+    // Build the mesh from an OFF file read by readOffFile, which is much faster than the stream based reader of OpenMesh
+    // _vertexNormalsRead tells if the file provided the vertex normals
+    bool openOffMesh(const char* _filename, bool& _vertexNormalsRead);
+    
+    // Replace the mesh with the given triangles, _vertices gets the handle of every input vertex
+    void buildMesh(const float* _points, size_t _nVertices, const unsigned int* _triangles, size_t _nTriangles, std::vector<typename Mesh::VertexHandle>& _vertices);
+    
     // Data
     
     Mesh mesh_;
@@ -109,6 +144,10 @@ protected:
     unsigned int id_ = -1;
     
     std::map<unsigned int,unsigned int> indexMap_;
+    
+    Statistics statistics_;
+    
+    bool statisticsValid_ = false;
 };
 
 //=============================================================================
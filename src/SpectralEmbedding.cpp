@@ -0,0 +1,504 @@
+//
+//  SpectralEmbedding.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <QDebug>
+
+#include "SpectralEmbedding.h"
+#include "LinearAlgebra.h"
+#include "WorkStealingPool.h"
+#include "RowCloud.h"
+
+// Rows handled by one task of the pool
+static const int SPECTRAL_BLOCK_SIZE = 1024;
+
+static int nBlocks(int _n)
+{
+    return (_n + SPECTRAL_BLOCK_SIZE - 1) / SPECTRAL_BLOCK_SIZE;
+}
+
+struct Edge
+{
+    int from_;
+    int to_;
+    double weight_;
+
+    bool operator<(const Edge& _other) const
+    {
+        return from_ < _other.from_ || (from_ == _other.from_ && to_ < _other.to_);
+    }
+};
+
+// The embedding straight from the eigenvectors, before it is centred and scaled
+static bool laplacianEigenmap(const std::vector<double>& _data, int _nRows, int _nColumns, std::vector<double>& _embedding, const SpectralOptions& _options)
+{
+    const int nDims = _options.nDims_;
+    const int k = std::min(_options.nNeighbours_, _nRows - 1);
+
+    if (_nRows <= nDims + 1 || _nColumns <= 0 || nDims <= 0 || k <= 0 || _data.size() != (size_t)_nRows * _nColumns)
+    {
+        qCritical() << "Cannot compute a spectral embedding of " << _nRows << " x " << _nColumns << " values in " << nDims << " dimensions with " << _options.nNeighbours_ << " neighbours";
+        return false;
+    }
+
+    WorkStealingPool pool(_options.nThreads_);
+
+    RowCloud cloud(_data, _nColumns);
+
+    RowTree tree(_nColumns, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(10 /* max leaf */));
+    tree.buildIndex();
+
+    // The k nearest other points of every point, the point itself comes back from the tree as well
+    std::vector<int> neighbours((size_t)_nRows * k);
+    std::vector<double> distances((size_t)_nRows * k);
+
+    pool.run(nBlocks(_nRows), [&](int _block, int _worker)
+    {
+        std::vector<size_t> index(k + 1);
+        std::vector<double> distance(k + 1);
+
+        const int end = std::min(_nRows, (_block + 1) * SPECTRAL_BLOCK_SIZE);
+
+        for (int i=_block * SPECTRAL_BLOCK_SIZE; i<end; ++i)
+        {
+            nanoflann::KNNResultSet<double> resultSet(k + 1);
+            resultSet.init(&index[0], &distance[0]);
+
+            tree.findNeighbors(resultSet, &_data[(size_t)i * _nColumns], nanoflann::SearchParams(10));
+
+            // Duplicates of the point can come before it
+            for (int n=0, m=0; n<=k && m<k; ++n)
+            {
+                if (index[n] == (size_t)i)
+                {
+                    continue;
+                }
+
+                neighbours[(size_t)i * k + m] = index[n];
+                distances[(size_t)i * k + m] = distance[n];
+                ++m;
+            }
+        }
+    });
+
+    // Local scale of every point, points on top of their neighbours get the average scale
+    std::vector<double> sigma(_nRows);
+    double sigmaSum = 0.0;
+    int nSigma = 0;
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        sigma[i] = std::sqrt(distances[(size_t)i * k + k - 1]);
+
+        if (sigma[i] > 0.0)
+        {
+            sigmaSum += sigma[i];
+            ++nSigma;
+        }
+    }
+
+    const double defaultSigma = nSigma ? sigmaSum / nSigma : 1.0;
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        if (!(sigma[i] > 0.0))
+        {
+            sigma[i] = defaultSigma;
+        }
+    }
+
+    // Both directions of every edge, the duplicates of mutual neighbours are merged below
+    std::vector<Edge> edges;
+    edges.reserve((size_t)_nRows * k * 2);
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        for (int n=0; n<k; ++n)
+        {
+            Edge e;
+            e.from_ = i;
+            e.to_ = neighbours[(size_t)i * k + n];
+            e.weight_ = std::exp(-distances[(size_t)i * k + n] / (sigma[i] * sigma[e.to_]));
+
+            edges.push_back(e);
+
+            std::swap(e.from_, e.to_);
+            edges.push_back(e);
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    // Compressed rows of the weight matrix
+    std::vector<int> rowStart(_nRows + 1, 0);
+    std::vector<int> columns;
+    std::vector<double> weights;
+
+    columns.reserve(edges.size());
+    weights.reserve(edges.size());
+
+    for (size_t e=0; e<edges.size(); ++e)
+    {
+        if (e > 0 && edges[e].from_ == edges[e-1].from_ && edges[e].to_ == edges[e-1].to_)
+        {
+            continue;
+        }
+
+        columns.push_back(edges[e].to_);
+        weights.push_back(edges[e].weight_);
+        rowStart[edges[e].from_ + 1]++;
+    }
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        rowStart[i + 1] += rowStart[i];
+    }
+
+    std::vector<Edge>().swap(edges);
+
+    std::vector<double> invSqrtDegree(_nRows);
+
+    // The eigenvector of the normalised adjacency with eigenvalue 1, projected out so that the solver finds the ones after it
+    std::vector<double> trivial(_nRows);
+    double trivialNorm = 0.0;
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        double degree = 0.0;
+
+        for (int e=rowStart[i]; e<rowStart[i + 1]; ++e)
+        {
+            degree += weights[e];
+        }
+
+        degree = std::max(degree, std::numeric_limits<double>::min());
+
+        invSqrtDegree[i] = 1.0 / std::sqrt(degree);
+        trivial[i] = std::sqrt(degree);
+        trivialNorm += degree;
+    }
+
+    trivialNorm = std::sqrt(trivialNorm);
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        trivial[i] /= trivialNorm;
+    }
+
+    // The smallest eigenvalues of I - D^-1/2 W D^-1/2 are the largest of D^-1/2 W D^-1/2
+    MatrixVectorProduct product = [&](const double* _x, double* _y)
+    {
+        double trivialX = 0.0;
+
+        for (int i=0; i<_nRows; ++i)
+        {
+            trivialX += trivial[i] * _x[i];
+        }
+
+        pool.run(nBlocks(_nRows), [&](int _block, int _worker)
+        {
+            const int end = std::min(_nRows, (_block + 1) * SPECTRAL_BLOCK_SIZE);
+
+            for (int i=_block * SPECTRAL_BLOCK_SIZE; i<end; ++i)
+            {
+                double y = 0.0;
+
+                for (int e=rowStart[i]; e<rowStart[i + 1]; ++e)
+                {
+                    y += weights[e] * invSqrtDegree[columns[e]] * _x[columns[e]];
+                }
+
+                _y[i] = invSqrtDegree[i] * y - trivial[i] * trivialX;
+            }
+        });
+    };
+
+    std::vector<double> values, vectors;
+
+    if (!lanczosEigen(_nRows, product, nDims, values, vectors, _options.basisSize_, _options.maxProducts_, 1e-6, _options.seed_))
+    {
+        qWarning() << "Spectral embedding eigenvectors did not fully converge";
+    }
+
+    if (values.size() != nDims)
+    {
+        qCritical() << "Spectral embedding found " << values.size() << " eigenvectors instead of " << nDims;
+        return false;
+    }
+
+    _embedding.assign((size_t)_nRows * nDims, 0.0);
+
+    // The eigenvectors of the random walk Laplacian, which do not favour points with many close neighbours
+    for (int d=0; d<nDims; ++d)
+    {
+        const double* v = &vectors[(size_t)d * _nRows];
+
+        for (int i=0; i<_nRows; ++i)
+        {
+            _embedding[(size_t)i * nDims + d] = v[i] * invSqrtDegree[i];
+        }
+    }
+
+    qDebug() << "Spectral embedding of " << _nRows << " points with " << columns.size() << " graph edges done, eigenvalues " << 1.0 - values[0] << ", " << (nDims > 1 ? 1.0 - values[1] : 0.0);
+
+    return true;
+}
+
+// Centre every axis, give it unit variance and fix the arbitrary sign of the eigenvector so the same data always gives the same plot
+static void normaliseEmbedding(std::vector<double>& _embedding, int _nRows, int _nDims)
+{
+    for (int d=0; d<_nDims; ++d)
+    {
+        double mean = 0.0, largest = 0.0;
+
+        for (int i=0; i<_nRows; ++i)
+        {
+            const double f = _embedding[(size_t)i * _nDims + d];
+
+            mean += f;
+
+            if (std::fabs(f) > std::fabs(largest))
+            {
+                largest = f;
+            }
+        }
+
+        mean /= _nRows;
+
+        double variance = 0.0;
+
+        for (int i=0; i<_nRows; ++i)
+        {
+            double& f = _embedding[(size_t)i * _nDims + d];
+
+            f -= mean;
+            variance += f * f;
+        }
+
+        double scale = (variance > 0.0) ? 1.0 / std::sqrt(variance / _nRows) : 0.0;
+
+        if (largest < mean)
+        {
+            scale = -scale;
+        }
+
+        for (int i=0; i<_nRows; ++i)
+        {
+            _embedding[(size_t)i * _nDims + d] *= scale;
+        }
+    }
+}
+
+bool computeSpectralEmbedding(const std::vector<double>& _data, int _nRows, int _nColumns, std::vector<double>& _embedding, const SpectralOptions& _options)
+{
+    const int nDims = _options.nDims_;
+
+    if (_nRows <= _options.maxExact_ || _options.maxExact_ <= nDims + 1)
+    {
+        if (!laplacianEigenmap(_data, _nRows, _nColumns, _embedding, _options))
+        {
+            return false;
+        }
+
+        normaliseEmbedding(_embedding, _nRows, nDims);
+
+        return true;
+    }
+
+    // Embed a random sample exactly, its eigenvalues are further apart than those of the whole set so the solver needs far fewer products
+    std::vector<int> order(_nRows);
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        order[i] = i;
+    }
+
+    std::mt19937_64 generator(_options.seed_);
+
+    const int nSample = _options.maxExact_;
+
+    for (int i=0; i<nSample; ++i)
+    {
+        std::swap(order[i], order[i + generator() % (_nRows - i)]);
+    }
+
+    std::vector<double> sample((size_t)nSample * _nColumns);
+
+    for (int s=0; s<nSample; ++s)
+    {
+        std::copy(_data.begin() + (size_t)order[s] * _nColumns, _data.begin() + (size_t)(order[s] + 1) * _nColumns, sample.begin() + (size_t)s * _nColumns);
+    }
+
+    std::vector<double> sampleEmbedding;
+
+    if (!laplacianEigenmap(sample, nSample, _nColumns, sampleEmbedding, _options))
+    {
+        return false;
+    }
+
+    _embedding.assign((size_t)_nRows * nDims, 0.0);
+
+    for (int s=0; s<nSample; ++s)
+    {
+        std::copy(sampleEmbedding.begin() + (size_t)s * nDims, sampleEmbedding.begin() + (size_t)(s + 1) * nDims, _embedding.begin() + (size_t)order[s] * nDims);
+    }
+
+    // The other points are placed at the average of their nearest sample points, weighted as the graph edges would be
+    RowCloud cloud(sample, _nColumns);
+
+    RowTree tree(_nColumns, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(10 /* max leaf */));
+    tree.buildIndex();
+
+    const int k = std::min(_options.nNeighbours_, nSample);
+    const int nRest = _nRows - nSample;
+
+    WorkStealingPool pool(_options.nThreads_);
+
+    pool.run(nBlocks(nRest), [&](int _block, int _worker)
+    {
+        std::vector<size_t> index(k);
+        std::vector<double> distance(k);
+
+        const int end = nSample + std::min(nRest, (_block + 1) * SPECTRAL_BLOCK_SIZE);
+
+        for (int r=nSample + _block * SPECTRAL_BLOCK_SIZE; r<end; ++r)
+        {
+            const int i = order[r];
+
+            nanoflann::KNNResultSet<double> resultSet(k);
+            resultSet.init(&index[0], &distance[0]);
+
+            tree.findNeighbors(resultSet, &_data[(size_t)i * _nColumns], nanoflann::SearchParams(10));
+
+            double* f = &_embedding[(size_t)i * nDims];
+
+            const double sigma2 = distance[k - 1];
+
+            double weightSum = 0.0;
+
+            for (int n=0; n<k; ++n)
+            {
+                const double w = (sigma2 > 0.0) ? std::exp(-distance[n] / sigma2) : (n == 0 ? 1.0 : 0.0);
+
+                for (int d=0; d<nDims; ++d)
+                {
+                    f[d] += w * sampleEmbedding[index[n] * nDims + d];
+                }
+
+                weightSum += w;
+            }
+
+            for (int d=0; d<nDims; ++d)
+            {
+                f[d] /= weightSum;
+            }
+        }
+    });
+
+    normaliseEmbedding(_embedding, _nRows, nDims);
+
+    qDebug() << "Spectral embedding of " << _nRows << " points extended from a sample of " << nSample;
+
+    return true;
+}
+
+bool embeddingBasis(const std::vector<double>& _data, int _nRows, int _nColumns, const std::vector<double>& _embedding, int _nDims, std::vector<double>& _origin, std::vector< std::vector<double> >& _basis)
+{
+    if (_nRows <= 0 || _nDims <= 0 || _data.size() != (size_t)_nRows * _nColumns || _embedding.size() != (size_t)_nRows * _nDims)
+    {
+        return false;
+    }
+
+    _origin.assign(_nColumns, 0.0);
+
+    std::vector<double> embeddingMean(_nDims, 0.0);
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        for (int c=0; c<_nColumns; ++c)
+        {
+            _origin[c] += _data[(size_t)i * _nColumns + c];
+        }
+
+        for (int d=0; d<_nDims; ++d)
+        {
+            embeddingMean[d] += _embedding[(size_t)i * _nDims + d];
+        }
+    }
+
+    for (int c=0; c<_nColumns; ++c)
+    {
+        _origin[c] /= _nRows;
+    }
+
+    for (int d=0; d<_nDims; ++d)
+    {
+        embeddingMean[d] /= _nRows;
+    }
+
+    // Normal equations B (Y'Y) = X'Y of the centred data X and embedding Y
+    std::vector<double> yy(_nDims * _nDims, 0.0);
+    std::vector<double> xy((size_t)_nColumns * _nDims, 0.0);
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        for (int d=0; d<_nDims; ++d)
+        {
+            const double y = _embedding[(size_t)i * _nDims + d] - embeddingMean[d];
+
+            for (int e=0; e<_nDims; ++e)
+            {
+                yy[d * _nDims + e] += y * (_embedding[(size_t)i * _nDims + e] - embeddingMean[e]);
+            }
+
+            for (int c=0; c<_nColumns; ++c)
+            {
+                xy[(size_t)c * _nDims + d] += (_data[(size_t)i * _nColumns + c] - _origin[c]) * y;
+            }
+        }
+    }
+
+    // Pseudo inverse of Y'Y, axes the embedding does not use get no direction
+    std::vector<double> values, vectors;
+
+    symmetricEigen(_nDims, yy, values, vectors);
+
+    std::vector<double> inverse(_nDims * _nDims, 0.0);
+
+    for (int j=0; j<_nDims; ++j)
+    {
+        if (!(values[j] > 1e-12 * std::max(values[0], 0.0)) || !(values[j] > 0.0))
+        {
+            continue;
+        }
+
+        for (int d=0; d<_nDims; ++d)
+        {
+            for (int e=0; e<_nDims; ++e)
+            {
+                inverse[d * _nDims + e] += vectors[j * _nDims + d] * vectors[j * _nDims + e] / values[j];
+            }
+        }
+    }
+
+    _basis.assign(_nDims, std::vector<double>(_nColumns, 0.0));
+
+    for (int d=0; d<_nDims; ++d)
+    {
+        for (int c=0; c<_nColumns; ++c)
+        {
+            for (int e=0; e<_nDims; ++e)
+            {
+                _basis[d][c] += xy[(size_t)c * _nDims + e] * inverse[e * _nDims + d];
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,40 @@
+//
+//  SpectralEmbedding.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef SPECTRALEMBEDDING_H
+#define SPECTRALEMBEDDING_H
+
+#include <vector>
+
+struct SpectralOptions
+{
+    int nDims_ = 2;
+
+    // Neighbours of every point in the graph, the graph is the union of the neighbourhoods so it stays symmetric
+    int nNeighbours_ = 10;
+
+    // Larger sets are embedded through a random sample of this size, the other points are placed from their nearest sample points
+    int maxExact_ = 20000;
+
+    // Vectors the eigen solver keeps, and how many products with the graph matrix it may take, see lanczosEigen
+    int basisSize_ = 60;
+    int maxProducts_ = 3000;
+
+    unsigned long long seed_ = 1;
+
+    // 0 means one per hardware thread
+    int nThreads_ = 0;
+};
+
+// Laplacian eigenmap of the rows of the _nRows x _nColumns row major _data: the smallest non trivial eigenvectors of the normalised Laplacian of their kNN graph
+// Edges are weighted with a Gaussian whose width is the distance to the furthest neighbour of each end (the self tuning weights of Zelnik-Manor and Perona)
+// _embedding is _nRows x nDims_ row major, centred and with unit variance on every axis
+bool computeSpectralEmbedding(const std::vector<double>& _data, int _nRows, int _nColumns, std::vector<double>& _embedding, const SpectralOptions& _options = SpectralOptions());
+
+// Least squares linear map from an embedding back to the data, so a non linear embedding can deform the template like a PCA basis does
+// _origin is the mean of the data and _basis holds one direction of _nColumns values per embedding dimension, the data of a point at y is roughly _origin + sum_d y_d _basis[d]
+bool embeddingBasis(const std::vector<double>& _data, int _nRows, int _nColumns, const std::vector<double>& _embedding, int _nDims, std::vector<double>& _origin, std::vector< std::vector<double> >& _basis);
+
+#endif
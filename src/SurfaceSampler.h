@@ -0,0 +1,277 @@
+//
+//  SurfaceSampler.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef SURFACESAMPLER_H
+#define SURFACESAMPLER_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "WorkStealingPool.h"
+
+// Random numbers that only depend on a seed, a stream and how many numbers the stream has given so far
+// Every stream is independent of the others, so work can be split over threads in any way and still give the same numbers
+class CounterRng
+{
+public:
+
+    CounterRng(unsigned long long _seed, unsigned long long _stream)
+    {
+        key_ = mix(_seed ^ mix(_stream + GOLDEN_GAMMA));
+        counter_ = 0;
+    }
+
+    unsigned long long next()
+    {
+        return mix(key_ + (++counter_) * GOLDEN_GAMMA);
+    }
+
+    // [0, 1) with the 53 bits of a double
+    double uniform()
+    {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // SplitMix64 finaliser
+    static unsigned long long mix(unsigned long long _z)
+    {
+        _z = (_z ^ (_z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        _z = (_z ^ (_z >> 27)) * 0x94d049bb133111ebull;
+        return _z ^ (_z >> 31);
+    }
+
+private:
+
+    static const unsigned long long GOLDEN_GAMMA = 0x9e3779b97f4a7c15ull;
+
+    unsigned long long key_;
+
+    unsigned long long counter_;
+};
+
+// Walker's alias method: after an O(n) setup an index is drawn with probability proportional to its weight from two uniform numbers
+class AliasTable
+{
+public:
+
+    // False if no weight is positive, negative weights count as zero
+    bool build(const std::vector<double>& _weights)
+    {
+        const int n = _weights.size();
+
+        probability_.assign(n, 0.0);
+        alias_.assign(n, 0);
+
+        double sum = 0.0;
+
+        for (int i=0; i<n; ++i)
+        {
+            sum += std::max(_weights[i], 0.0);
+        }
+
+        if (n == 0 || !(sum > 0.0))
+        {
+            probability_.clear();
+            alias_.clear();
+            return false;
+        }
+
+        // Vose's variant, every entry is scaled so that the average is 1
+        std::vector<double> scaled(n);
+        std::vector<int> small, large;
+
+        for (int i=0; i<n; ++i)
+        {
+            scaled[i] = std::max(_weights[i], 0.0) * n / sum;
+
+            if (scaled[i] < 1.0)
+            {
+                small.push_back(i);
+            }
+            else
+            {
+                large.push_back(i);
+            }
+        }
+
+        while (!small.empty() && !large.empty())
+        {
+            int s = small.back();
+            small.pop_back();
+
+            int l = large.back();
+
+            probability_[s] = scaled[s];
+            alias_[s] = l;
+
+            scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+
+            if (scaled[l] < 1.0)
+            {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+
+        // Whatever is left is 1 up to rounding
+        for (int i=0; i<large.size(); ++i)
+        {
+            probability_[large[i]] = 1.0;
+            alias_[large[i]] = large[i];
+        }
+
+        for (int i=0; i<small.size(); ++i)
+        {
+            probability_[small[i]] = 1.0;
+            alias_[small[i]] = small[i];
+        }
+
+        return true;
+    }
+
+    int size() const
+    {
+        return probability_.size();
+    }
+
+    // _u1 and _u2 in [0, 1)
+    int sample(double _u1, double _u2) const
+    {
+        const int n = probability_.size();
+
+        int i = std::min((int)(_u1 * n), n - 1);
+
+        return (_u2 < probability_[i]) ? i : alias_[i];
+    }
+
+private:
+
+    std::vector<double> probability_;
+
+    std::vector<int> alias_;
+};
+
+// Uniform samples on the surface of a triangle mesh
+// The corners of every face are copied into one array and the faces go into an alias table weighted by their area, so a sample costs three random numbers and no search
+// Sample i only depends on the seed and on i, whatever the number of threads
+template <typename M> class SurfaceSampler
+{
+public:
+
+    typedef typename M::Point Point;
+
+    // Faces with more than 3 vertices are sampled on the triangle of their first 3
+    explicit SurfaceSampler(const M& _mesh)
+    {
+        corners_.reserve(3 * _mesh.n_faces());
+
+        std::vector<double> areas;
+        areas.reserve(_mesh.n_faces());
+
+        totalArea_ = 0.0;
+
+        typename M::ConstFaceIter fIt(_mesh.faces_begin()), fEnd(_mesh.faces_end());
+
+        for (; fIt!=fEnd; ++fIt)
+        {
+            typename M::ConstFaceVertexIter fvIt(_mesh.cfv_iter(fIt.handle()));
+
+            const Point& p0 = _mesh.point(fvIt);
+            ++fvIt;
+            const Point& p1 = _mesh.point(fvIt);
+            ++fvIt;
+            const Point& p2 = _mesh.point(fvIt);
+
+            corners_.push_back(p0);
+            corners_.push_back(p1);
+            corners_.push_back(p2);
+
+            double area = 0.5 * ((p1 - p0) % (p2 - p0)).norm();
+
+            areas.push_back(area);
+
+            totalArea_ += area;
+        }
+
+        faces_.build(areas);
+    }
+
+    // The mesh has no face with a positive area, every sample is the origin
+    bool isEmpty() const
+    {
+        return faces_.size() == 0;
+    }
+
+    double totalArea() const
+    {
+        return totalArea_;
+    }
+
+    Point sample(unsigned long long _seed, unsigned long long _index) const
+    {
+        if (isEmpty())
+        {
+            return Point(0, 0, 0);
+        }
+
+        CounterRng rng(_seed, _index);
+
+        const int f = faces_.sample(rng.uniform(), rng.uniform());
+
+        const Point& p0 = corners_[3 * f];
+        const Point& p1 = corners_[3 * f + 1];
+        const Point& p2 = corners_[3 * f + 2];
+
+        // The square root makes the barycentric coordinates uniform over the triangle
+        const float r1 = std::sqrt(rng.uniform());
+        const float r2 = rng.uniform();
+
+        return (1 - r1) * p0 + r1 * (1 - r2) * p1 + r1 * r2 * p2;
+    }
+
+    // Samples [0, _nPoints) of the seed, in blocks on a pool of _nThreads threads, one per hardware thread if _nThreads is not positive
+    void sample(size_t _nPoints, unsigned long long _seed, std::vector<Point>& _points, int _nThreads = 1) const
+    {
+        _points.resize(_nPoints);
+
+        const size_t blockSize = 1 << 16;
+
+        const int nBlocks = (_nPoints + blockSize - 1) / blockSize;
+
+        if (_nThreads == 1 || nBlocks <= 1)
+        {
+            for (size_t i=0; i<_nPoints; ++i)
+            {
+                _points[i] = sample(_seed, i);
+            }
+
+            return;
+        }
+
+        WorkStealingPool pool(_nThreads);
+
+        pool.run(nBlocks, [&](int _block, int _worker)
+        {
+            const size_t end = std::min(_nPoints, (_block + 1) * blockSize);
+
+            for (size_t i=_block * blockSize; i<end; ++i)
+            {
+                _points[i] = sample(_seed, i);
+            }
+        });
+    }
+
+private:
+
+    // 3 per face
+    std::vector<Point> corners_;
+
+    AliasTable faces_;
+
+    double totalArea_;
+};
+
+#endif
@@ -0,0 +1,2419 @@
+//
+//  SynthesisEngine.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDebug>
+
+#include "stdafx.h"
+#include "dataanalysis.h"
+#include "optimization.h"
+
+#include "SynthesisEngine.h"
+#include "RandomisedSVD.h"
+#include "WorkStealingPool.h"
+#include "Trace.h"
+#include "AsyncLog.h"
+
+using namespace alglib;
+
+// Distances are computed in blocks this long before they go through the heap, so the distance loop has no branches and vectorises
+static const int KNN_BLOCK_SIZE = 256;
+
+// The kd-tree is built once per embedding and then answers many queries, its build time is spread over this many of them when calibrating
+static const int KNN_CALIBRATION_QUERIES_PER_INDEX = 64;
+
+static std::atomic<int> bruteForceThresholdOverride(-1);
+
+namespace
+{
+
+// Bytes of mesh files the segmentation workers may hold at once, a worker waits until the others have released enough
+class MemoryBudget
+{
+public:
+
+    explicit MemoryBudget(qint64 _maxBytes) : maxBytes_(_maxBytes), inUse_(0) { }
+
+    // Something larger than the whole budget is let through once nothing else is held
+    void acquire(qint64 _bytes)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        released_.wait(lock, [&]() { return inUse_ == 0 || inUse_ + _bytes <= maxBytes_; });
+
+        inUse_ += _bytes;
+    }
+
+    void release(qint64 _bytes)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            inUse_ -= _bytes;
+        }
+
+        released_.notify_all();
+    }
+
+private:
+
+    std::mutex mutex_;
+    std::condition_variable released_;
+
+    const qint64 maxBytes_;
+    qint64 inUse_;
+};
+
+}
+
+// clear() hands the connectivity back, the assignment replaces the property arrays (points, normals) with empty ones
+// The cached statistics go with the mesh, a reloaded mesh computes them again
+static void releaseMesh(SynthesisEngine::Shape& _shape)
+{
+    _shape.mesh().clear();
+    _shape.mesh() = SynthesisEngine::Shape::Mesh();
+    _shape.geometryChanged();
+}
+
+// saveModel writes to the file in blocks of this size
+static const size_t MODEL_WRITE_BUFFER_SIZE = 1 << 20;
+
+static void appendUInt(std::string& _buffer, size_t _value)
+{
+    char digits[20];
+    int nDigits = 0;
+
+    do
+    {
+        digits[nDigits++] = '0' + _value % 10;
+        _value /= 10;
+    }
+    while (_value);
+
+    while (nDigits)
+    {
+        _buffer += digits[--nDigits];
+    }
+}
+
+// Shortest of 9 significant digits, enough to read the float back exactly, formatted on the stack
+// printf follows LC_NUMERIC, which Qt sets from the environment, so a decimal comma is put back to a point
+static void appendFloat(std::string& _buffer, float _value, char _decimalPoint)
+{
+    char digits[32];
+
+    int nDigits = std::snprintf(digits, sizeof(digits), "%.9g", _value);
+
+    for (int i=0; i<nDigits; ++i)
+    {
+        _buffer += (digits[i] == _decimalPoint) ? '.' : digits[i];
+    }
+}
+
+// Write the buffer once it is full, or whatever is left in it with _final
+static bool flushModelBuffer(QFile& _file, std::string& _buffer, bool _final)
+{
+    if (_buffer.empty() || (!_final && _buffer.size() < MODEL_WRITE_BUFFER_SIZE))
+    {
+        return true;
+    }
+
+    bool ok = _file.write(_buffer.data(), _buffer.size()) == (qint64)_buffer.size();
+
+    _buffer.clear();
+
+    return ok;
+}
+
+// The _k points nearest to (_qx, _qy), nearest first, found by computing all distances and keeping the best in a bounded max-heap
+template <typename T>
+static void bruteForceNearest(const T* _xs, const T* _ys, int _nPoints, T _qx, T _qy, int _k, std::vector<NEAREST_POINT>& _nearest)
+{
+    // (squared distance, index) with the worst kept candidate on top
+    std::vector< std::pair<T, int> > heap;
+    heap.reserve(_k);
+
+    T dist[KNN_BLOCK_SIZE];
+
+    for (int begin = 0; begin < _nPoints; begin += KNN_BLOCK_SIZE)
+    {
+        const int blockSize = std::min(KNN_BLOCK_SIZE, _nPoints - begin);
+
+        const T* xs = _xs + begin;
+        const T* ys = _ys + begin;
+
+        for (int i=0; i<blockSize; ++i)
+        {
+            const T dx = xs[i] - _qx;
+            const T dy = ys[i] - _qy;
+            dist[i] = dx * dx + dy * dy;
+        }
+
+        for (int i=0; i<blockSize; ++i)
+        {
+            if (heap.size() < _k)
+            {
+                heap.push_back(std::make_pair(dist[i], begin + i));
+                std::push_heap(heap.begin(), heap.end());
+            }
+            else if (dist[i] < heap.front().first)
+            {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = std::make_pair(dist[i], begin + i);
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end());
+
+    _nearest.resize(heap.size());
+
+    for (int i=0; i<heap.size(); ++i)
+    {
+        _nearest[i].index_ = heap[i].second;
+        _nearest[i].distance_ = heap[i].first;
+    }
+}
+
+SynthesisEngine::SynthesisEngine() : cloud_(points2D_), descriptorCloud_(descriptors_, descriptorSize_)
+{
+    options_.nofNN_ = NUM_OF_NEAREST_NEIGHBOURS;
+
+    nSymmetryConstraints_ = initConstraints(LOADED_DATASET, templateMatch_.constraints());
+
+    pcaMin_ = OpenMesh::Vec2d(0.0, 0.0);
+    pcaMax_ = OpenMesh::Vec2d(0.0, 0.0);
+}
+
+SynthesisEngine::~SynthesisEngine()
+{
+    if (index_)
+    {
+        delete index_;
+    }
+
+    if (descriptorIndex_)
+    {
+        delete descriptorIndex_;
+    }
+}
+
+SynthesisEngine::Options& SynthesisEngine::options()
+{
+    return options_;
+}
+
+const SynthesisEngine::Options& SynthesisEngine::options() const
+{
+    return options_;
+}
+
+// The collection file without its extension, e.g. /pathtohere/bikes for /pathtohere/bikes.match_coll
+static QString collectionDirectory(const QString& _fname)
+{
+    QStringList dir_split = _fname.split("/");
+
+    QString coll_name = dir_split.last().split(".").first();
+
+    dir_split.removeLast();
+    dir_split.push_back(coll_name);
+
+    return dir_split.join("/");
+}
+
+QString SynthesisEngine::meshDirectory(const QString& _fname)
+{
+    return collectionDirectory(_fname) + "/" + MESH_PATH;
+}
+
+//  Directory structure (e.g. for bikes):
+// /pathtohere/bikes.match_coll
+// /pathtohere/bikes/
+// /pathtohere/bikes/matches/
+// /pathtohere/bikes/MESH_PATH/
+bool SynthesisEngine::openMatchCollection(const QString& _fname, std::vector<Match*>& _matches, bool _loadMesh)
+{
+    QFile file(_fname);
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qCritical() << "Could not open file " << _fname ;
+        return false;
+    }
+
+    QString collDir = collectionDirectory(_fname);
+
+    QString meshDir = meshDirectory(_fname);
+
+    QTextStream in(&file);
+
+    int i = 0;
+
+    while (!in.atEnd())
+    {
+        QString line = in.readLine();
+
+        if (line.isEmpty())
+        {
+            continue;
+        }
+
+        Match* cMatch = new Match;
+
+        if (!cMatch->open(line))
+        {
+            qCritical() << "Cannot read match from string ";
+            delete cMatch;
+            continue;
+        }
+
+        QString m_name = cMatch->filename();
+
+        cMatch->setFilename(collDir + "/matches/" + m_name);
+
+        QString mesh_fname = meshDir + "/" + m_name.split(".").first().append(".off");
+
+        cMatch->setMeshFilename(mesh_fname);
+
+        cMatch->setID(i);
+
+        if (_loadMesh && !cMatch->openMesh(mesh_fname.toStdString().c_str()))
+        {
+            qCritical() << "Cannot read mesh from file: " << mesh_fname;
+        }
+
+        _matches.push_back(cMatch);
+
+        i++;
+    }
+
+    qDebug() << "Reading is done! Matches loaded: " << i ;
+
+    return true;
+}
+
+int SynthesisEngine::groupMatches(std::vector<Match*>& _matches)
+{
+    //First sort the matches according to their name so we always get the same group IDs
+    std::sort(_matches.begin(), _matches.end(), [](const Match* i, const Match* j) { return i->shortName() < j->shortName(); });
+
+    // Group IDs are keyed on the part signature each match computed at load time
+    std::unordered_map< uint64_t, int > groups;
+
+    groups.reserve(_matches.size());
+
+    // First match seen for each group, used to verify signature hits and to print the group contents
+    std::vector<Match*> groupRepresentatives;
+
+    std::vector<Match*>::iterator itMatch(_matches.begin()), matchesEnd(_matches.end());
+
+    int i = 0;
+
+    for (; itMatch != matchesEnd; ++itMatch)
+    {
+        uint64_t signature = (**itMatch).partSignature();
+
+        std::unordered_map< uint64_t, int >::iterator itGroup = groups.find(signature);
+
+        // A signature hit with different parts is a hash collision, probe the next key until we find the right group or a free slot
+        while (itGroup != groups.end() && !sameParts(**itMatch, *groupRepresentatives[itGroup->second]))
+        {
+            qWarning() << "Part signature collision for match " << (**itMatch).shortName();
+            itGroup = groups.find(++signature);
+        }
+
+        if (itGroup == groups.end())
+        {
+            itGroup = groups.insert(std::pair<uint64_t, int>(signature, i++)).first;
+            groupRepresentatives.push_back(*itMatch);
+        }
+
+        (**itMatch).setGroupID( itGroup->second );
+    }
+
+    qDebug() << "There were " << i << " different groups discovered" ;
+
+    for (int g=0; g<groupRepresentatives.size(); ++g)
+    {
+        QString msg;
+
+        msg += "Group ID: ";
+        msg += QString("%1").arg(g);
+        msg += "   ";
+
+        const std::vector<Match::Part>& mParts = groupRepresentatives[g]->parts();
+
+        std::vector<Match::Part>::const_iterator itPart(mParts.begin()), partsEnd(mParts.end());
+
+        for ( ; itPart!=partsEnd; ++itPart)
+        {
+            msg += QString("%1").arg(itPart->partID_);
+            msg += "->";
+            msg += QString("%1").arg(itPart->partType_);
+            msg += " ";
+        }
+        qDebug() << msg;
+    }
+
+    return i;
+}
+
+void SynthesisEngine::assignGroups(const std::vector<Match*>& _grouped, const std::vector<Match*>& _matches)
+{
+    // One match per group is enough to compare against, there are only ever a few groups
+    std::map<int, const Match*> groupRepresentatives;
+
+    std::vector<Match*>::const_iterator itMatch(_grouped.begin()), groupedEnd(_grouped.end());
+
+    for (; itMatch != groupedEnd; ++itMatch)
+    {
+        groupRepresentatives.insert(std::pair<int, const Match*>((**itMatch).groupID(), *itMatch));
+    }
+
+    int nextGroupID = groupRepresentatives.empty() ? 0 : groupRepresentatives.rbegin()->first + 1;
+
+    std::vector<Match*>::const_iterator itNew(_matches.begin()), matchesEnd(_matches.end());
+
+    for (; itNew != matchesEnd; ++itNew)
+    {
+        Match& nMatch = **itNew;
+
+        int groupID = -1;
+
+        std::map<int, const Match*>::const_iterator itGroup(groupRepresentatives.begin()), groupsEnd(groupRepresentatives.end());
+
+        for (; itGroup != groupsEnd; ++itGroup)
+        {
+            if (itGroup->second->partSignature() == nMatch.partSignature() && sameParts(nMatch, *itGroup->second))
+            {
+                groupID = itGroup->first;
+                break;
+            }
+        }
+
+        // Later new matches with the same parts join this one
+        if (groupID < 0)
+        {
+            groupID = nextGroupID++;
+            groupRepresentatives.insert(std::pair<int, const Match*>(groupID, &nMatch));
+        }
+
+        nMatch.setGroupID(groupID);
+    }
+}
+
+bool SynthesisEngine::sameParts(const Match& _match1, const Match& _match2)
+{
+    const std::vector<Match::Part>& parts1 = _match1.parts();
+    const std::vector<Match::Part>& parts2 = _match2.parts();
+
+    if (parts1.size() != parts2.size())
+    {
+        return false;
+    }
+
+    for (int p=0; p<parts1.size(); ++p)
+    {
+        if (parts1[p].partID_ != parts2[p].partID_ || parts1[p].partType_ != parts2[p].partType_)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SynthesisEngine::filterMatches(const std::vector<Match*>& _matches, int _groupID, double _errorThreshold, std::vector<Match*>& _filteredMatches)
+{
+    _filteredMatches.clear();
+
+    int numParts = -1;
+
+    std::vector<Match*>::const_iterator itMatch(_matches.begin()), matchesEnd(_matches.end());
+
+    for ( ; itMatch != matchesEnd; ++itMatch)
+    {
+        if ((**itMatch).groupID() != _groupID || (**itMatch).fitError() > _errorThreshold)
+        {
+            continue;
+        }
+
+        // All matches of a group are expected to have the same number of parts as the first one we find
+        int mnParts = (**itMatch).nparts();
+
+        if (numParts == -1)
+        {
+            numParts = mnParts;
+        }
+
+        if (mnParts != numParts)
+        {
+            qCritical() << QString("One of the matches of group %1 has a different number of parts (%2) than expected (%3). Ignoring it in the filtering!").arg(_groupID).arg(mnParts).arg(numParts);
+            continue;
+        }
+
+        _filteredMatches.push_back(*itMatch);
+    }
+
+    if (_filteredMatches.size() == 0)
+    {
+        qCritical() << QString("No matches found for group ID: %1 and error threshold: %2").arg(_groupID).arg(_errorThreshold);
+        return false;
+    }
+
+    return true;
+}
+
+int SynthesisEngine::initConstraints(DATASET _dataset, std::vector<Match::Constraint>& _constraints)
+{
+    // Each entry is type, part index pair, part ID pair
+    static const int chairConstraints[][5] =
+    {
+        {SYMMETRY, 2,5, 4,7},
+        {SYMMETRY, 3,4, 5,6},
+        {CONTACT, 1,0, 3,2},
+        {CONTACT, 2,0, 4,2},
+        {CONTACT, 3,0, 5,2},
+        {CONTACT, 4,0, 6,2},
+        {CONTACT, 5,0, 7,2}
+    };
+
+    static const int bikeConstraints[][5] =
+    {
+        {SYMMETRY, 2,3, 4,5}
+    };
+
+    static const int planeConstraints[][5] =
+    {
+        {SYMMETRY, 1,2, 3,4},
+        {SYMMETRY, 4,5, 6,7}
+    };
+
+    static const int planeSidConstraints[][5] =
+    {
+        {SYMMETRY, 5,6, 7,8},
+        {SYMMETRY, 3,4, 5,6},
+        {SYMMETRY, 1,2, 3,4},
+        {SYMMETRY, 7,8, 9,10},
+        {SYMMETRY, 9,10, 11,12},
+        {SYMMETRY, 11,12, 13,14},
+        {SYMMETRY, 14,15, 16,17},
+        {SYMMETRY, 16,17, 18,19},
+        {SYMMETRY, 18,19, 20,21},
+        {SYMMETRY, 20,21, 22,23},
+        {SYMMETRY, 22,23, 24,25},
+        {SYMMETRY, 24,25, 26,27},
+        {SYMMETRY, 26,27, 28,29}
+    };
+
+    const int (*table)[5] = 0;
+    int tableSize = 0;
+
+    switch (_dataset)
+    {
+        case CHAIRS:
+        {
+            table = chairConstraints;
+            tableSize = sizeof(chairConstraints) / sizeof(chairConstraints[0]);
+        }
+            break;
+        case BIKES:
+        {
+            table = bikeConstraints;
+            tableSize = sizeof(bikeConstraints) / sizeof(bikeConstraints[0]);
+        }
+            break;
+        case PLANES:
+        {
+            table = planeConstraints;
+            tableSize = sizeof(planeConstraints) / sizeof(planeConstraints[0]);
+        }
+            break;
+        case SID_PLANES:
+        {
+            table = planeSidConstraints;
+            tableSize = sizeof(planeSidConstraints) / sizeof(planeSidConstraints[0]);
+        }
+            break;
+        default:
+            break;
+    }
+
+    int nSymmetries = 0;
+
+    for (int c=0; c<tableSize; ++c)
+    {
+        Match::Constraint con;
+        con.type_ = table[c][0];
+        con.partIndices_ = std::pair<int, int>(table[c][1], table[c][2]);
+        con.partIDs_ = std::pair<int, int>(table[c][3], table[c][4]);
+
+        _constraints.push_back(con);
+
+        if (con.type_ == SYMMETRY)
+        {
+            nSymmetries++;
+        }
+    }
+
+    return nSymmetries;
+}
+
+void SynthesisEngine::setMatches(const std::vector<Match*>& _matches)
+{
+    matches_ = _matches;
+
+    partMeshesPrepared_ = false;
+
+    // The basis belongs to the previous embedding, only the PCA path sets it again through setEmbedding
+    pcaOrigin_.clear();
+    pcaBasis_.clear();
+
+    points2D_.clear();
+
+    if (index_)
+    {
+        delete index_;
+        index_ = 0;
+    }
+
+    pointsX_.clear();
+    pointsY_.clear();
+
+    descriptors_.clear();
+    descriptorSize_ = 0;
+
+    if (descriptorIndex_)
+    {
+        delete descriptorIndex_;
+        descriptorIndex_ = 0;
+    }
+
+    runningPCA_.reset();
+}
+
+const std::vector<SynthesisEngine::Match*>& SynthesisEngine::matches() const
+{
+    return matches_;
+}
+
+int SynthesisEngine::nParamsPerPart() const
+{
+    return options_.calculationMode_ == CALCULATION_MODE_POSITION ? NUM_PARAMS_POS : NUM_PARAMS_BOX;
+}
+
+bool SynthesisEngine::calculatePCA()
+{
+    TRACE_SPAN("SynthesisEngine::calculatePCA");
+
+    int numMatches = matches_.size();
+
+    if (numMatches < 2)
+    {
+        qCritical() << "Need at least two matches to calculate the embedding, got " << numMatches;
+        return false;
+    }
+
+    int nParams = nParamsPerPart();
+
+    int numParameters = nEmbeddedParts(*matches_[0]) * nParams;
+
+    std::vector<double> origin(numParameters, 0.0);
+    std::vector<double> avgScale(numParameters, 0.0);
+
+    std::vector<double> descriptors((size_t)numMatches * numParameters);
+
+    std::vector<double> values(numParameters);
+
+    for (int i=0; i<numMatches; ++i)
+    {
+        if (!matchDescriptor(*matches_[i], values.data(), numParameters))
+        {
+            qCritical() << "Match " << matches_[i]->shortName() << " does not have the same number of parts as the rest of the matches!";
+            return false;
+        }
+
+        for (int j=0; j<numParameters; ++j)
+        {
+            descriptors[(size_t)i * numParameters + j] = values[j];
+        }
+
+        if (options_.calculationMode_ == CALCULATION_MODE_POSITION)
+        {
+            const std::vector<Match::Part>& mParts = matches_[i]->parts();
+
+            for (int p=0, j=0; p<mParts.size(); ++p)
+            {
+                if (!embedsPart(mParts[p]))
+                {
+                    continue;
+                }
+
+                for (int k=0; k<nParams; ++k, ++j)
+                {
+                    avgScale[j] += mParts[p].scale_[k];
+                }
+            }
+        }
+    }
+
+    for (int j=0; j<numParameters; ++j)
+    {
+        avgScale[j] /= (double)numMatches;
+    }
+
+    // Only the two leading directions are shown, a randomised truncated SVD finds them without the full decomposition
+    // PCA origin is the average of all the matches
+    std::vector<double> components, variances;
+
+    if (!principalComponents(descriptors, numMatches, numParameters, 2, origin, components, variances))
+    {
+        qCritical() << "PCA failed for " << numMatches << " matches with " << numParameters << " parameters each";
+        return false;
+    }
+
+    std::vector< std::vector<double> > pcaBasis(2);
+
+    pcaBasis[0].assign(components.begin(), components.begin() + numParameters);
+    pcaBasis[1].assign(components.begin() + numParameters, components.end());
+
+    std::vector<OpenMesh::Vec2f> points2D(numMatches);
+
+    for (int i=0; i<numMatches; ++i)
+    {
+        double x = 0.0;
+        double y = 0.0;
+
+        for (int j=0; j<numParameters; ++j)
+        {
+            double c = descriptors[(size_t)i * numParameters + j] - origin[j];
+            x += c * pcaBasis[0][j];
+            y += c * pcaBasis[1][j];
+        }
+
+        points2D[i] = OpenMesh::Vec2f(x, y);
+    }
+
+    setEmbedding(origin, pcaBasis, avgScale, points2D);
+
+    qDebug() << "Done with PCA for " << numMatches << " matches with " << numParameters << " parameters each";
+
+    return true;
+}
+
+void SynthesisEngine::setEmbedding(const std::vector<double>& _origin, const std::vector< std::vector<double> >& _basis, const std::vector<double>& _avgScale, const std::vector<OpenMesh::Vec2f>& _points2D)
+{
+    pcaOrigin_ = _origin;
+    pcaBasis_ = _basis;
+    avgMatchScale_ = _avgScale;
+
+    setPoints2D(_points2D);
+
+    // Template parts take their IDs from the first match, their boxes are filled in when the template is deformed
+    std::vector<Match::Part>& tmParts = templateMatch_.parts();
+
+    tmParts.clear();
+
+    if (!matches_.empty())
+    {
+        const std::vector<Match::Part>& mParts = matches_[0]->parts();
+
+        std::vector<Match::Part>::const_iterator itPart(mParts.begin()), partsEnd(mParts.end());
+
+        for (; itPart != partsEnd; ++itPart)
+        {
+            if (!embedsPart(*itPart))
+            {
+                continue;
+            }
+
+            Match::Part cPart;
+            cPart.partID_ = itPart->partID_;
+            cPart.partType_ = itPart->partType_;
+            cPart.pos_ = OpenMesh::Vec3d(0,0,0);
+            cPart.scale_ = OpenMesh::Vec3d(0,0,0);
+            cPart.partShape_.setID(cPart.partID_);
+
+            tmParts.push_back(cPart);
+        }
+    }
+
+    templateMatch_.setNparts(tmParts.size());
+
+    if (!pcaOrigin_.empty())
+    {
+        deformTemplate(0.0, 0.0, templateMatch_);
+    }
+
+    buildDescriptorIndex();
+
+    // The running PCA starts from the matches of the full embedding, addMatches carries it on from there
+    runningPCA_.reset();
+
+    int numParameters = pcaOrigin_.size();
+
+    if (numParameters > 0 && !matches_.empty())
+    {
+        std::vector<double> descriptors;
+        descriptors.reserve(matches_.size() * numParameters);
+
+        std::vector<double> values(numParameters);
+
+        int numMatches = 0;
+
+        for (int i=0; i<matches_.size(); ++i)
+        {
+            if (matchDescriptor(*matches_[i], values.data(), numParameters))
+            {
+                descriptors.insert(descriptors.end(), values.begin(), values.end());
+                numMatches++;
+            }
+        }
+
+        if (numMatches > 0)
+        {
+            runningPCA_.add(descriptors, numMatches, numParameters);
+        }
+    }
+}
+
+void SynthesisEngine::setPoints2D(const std::vector<OpenMesh::Vec2f>& _points2D)
+{
+    points2D_ = _points2D;
+
+    pcaMin_ = OpenMesh::Vec2d(std::numeric_limits<double>::max(), std::numeric_limits<double>::max());
+    pcaMax_ = OpenMesh::Vec2d(-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max());
+
+    for (int i=0; i<points2D_.size() && i<matches_.size(); ++i)
+    {
+        matches_[i]->setDescriptor2D(points2D_[i]);
+
+        pcaMin_.minimize(OpenMesh::Vec2d(points2D_[i][0], points2D_[i][1]));
+        pcaMax_.maximize(OpenMesh::Vec2d(points2D_[i][0], points2D_[i][1]));
+    }
+
+    buildIndex();
+}
+
+bool SynthesisEngine::addMatches(const std::vector<Match*>& _matches)
+{
+    int numParameters = pcaOrigin_.size();
+
+    if (pcaBasis_.size() < 2 || numParameters == 0 || pcaBasis_[0].size() != numParameters || pcaBasis_[1].size() != numParameters)
+    {
+        qWarning() << "The embedding has no deformation basis to place new matches with, it has to be recalculated";
+        return false;
+    }
+
+    // The coordinates that reproduce a descriptor best are (B'B)^-1 B' (d - origin), which is the plain projection for the orthonormal PCA basis
+    double g00 = 0.0, g01 = 0.0, g11 = 0.0;
+
+    for (int j=0; j<numParameters; ++j)
+    {
+        g00 += pcaBasis_[0][j] * pcaBasis_[0][j];
+        g01 += pcaBasis_[0][j] * pcaBasis_[1][j];
+        g11 += pcaBasis_[1][j] * pcaBasis_[1][j];
+    }
+
+    double det = g00 * g11 - g01 * g01;
+
+    if (!(std::fabs(det) > 1e-12 * std::max(g00 * g11, std::numeric_limits<double>::min())))
+    {
+        qWarning() << "The deformation basis of the embedding is degenerate, new matches cannot be placed in it";
+        return false;
+    }
+
+    std::vector<double> descriptors;
+    descriptors.reserve(_matches.size() * numParameters);
+
+    std::vector<double> values(numParameters);
+
+    int numAdded = 0;
+
+    for (int i=0; i<_matches.size(); ++i)
+    {
+        if (!matchDescriptor(*_matches[i], values.data(), numParameters))
+        {
+            qWarning() << "Match " << _matches[i]->shortName() << " does not have the same parts as the embedded matches, it is not added to the embedding";
+            continue;
+        }
+
+        double b0 = 0.0, b1 = 0.0;
+
+        for (int j=0; j<numParameters; ++j)
+        {
+            double c = values[j] - pcaOrigin_[j];
+            b0 += c * pcaBasis_[0][j];
+            b1 += c * pcaBasis_[1][j];
+        }
+
+        matches_.push_back(_matches[i]);
+        points2D_.push_back(OpenMesh::Vec2f((g11 * b0 - g01 * b1) / det, (g00 * b1 - g01 * b0) / det));
+
+        descriptors.insert(descriptors.end(), values.begin(), values.end());
+        numAdded++;
+    }
+
+    if (numAdded == 0)
+    {
+        return true;
+    }
+
+    // The part meshes of the new matches are not loaded yet
+    partMeshesPrepared_ = false;
+
+    std::vector<OpenMesh::Vec2f> points2D;
+    points2D.swap(points2D_);
+
+    setPoints2D(points2D);
+
+    buildDescriptorIndex();
+
+    runningPCA_.add(descriptors, numAdded, numParameters);
+
+    // How much of the variance the fixed basis still shows compared to the best plane, a new full embedding is worth it once this drops
+    const std::vector<double>& variances = runningPCA_.variances();
+
+    double best = 0.0;
+
+    for (int c=0; c<2 && c<variances.size(); ++c)
+    {
+        best += variances[c];
+    }
+
+    double shown = runningPCA_.planeVariance(pcaBasis_[0], pcaBasis_[1]);
+
+    qDebug() << "Added " << numAdded << " matches to the embedding of " << matches_.size() << ", its basis shows " << (best > 0.0 ? 100.0 * shown / best : 100.0) << "% of the variance the best plane would" ;
+
+    return true;
+}
+
+const IncrementalPCA& SynthesisEngine::runningPCA() const
+{
+    return runningPCA_;
+}
+
+bool SynthesisEngine::matchDescriptor(const Match& _match, double* _descriptor, int _descriptorSize) const
+{
+    int nParams = nParamsPerPart();
+
+    if (nEmbeddedParts(_match) * nParams != _descriptorSize)
+    {
+        return false;
+    }
+
+    const std::vector<Match::Part>& mParts = _match.parts();
+
+    for (int p=0, j=0; p<mParts.size(); ++p)
+    {
+        const Match::Part& cPart = mParts[p];
+
+        if (!embedsPart(cPart))
+        {
+            continue;
+        }
+
+        double values[6];
+
+        if (options_.calculationMode_ == CALCULATION_MODE_BOUNDING_BOX)
+        {
+            OpenMesh::Vec3f min = cPart.pos_ - cPart.scale_;
+            OpenMesh::Vec3f max = cPart.pos_ + cPart.scale_;
+
+            values[0] = min[0]; values[1] = min[1]; values[2] = min[2];
+            values[3] = max[0]; values[4] = max[1]; values[5] = max[2];
+        }
+        else
+        {
+            values[0] = cPart.pos_[0]; values[1] = cPart.pos_[1]; values[2] = cPart.pos_[2];
+        }
+
+        for (int k=0; k<nParams; ++k, ++j)
+        {
+            double v = values[k];
+
+            // Same as the Matlab code, infinite and undefined values do not contribute
+            if (std::isinf(v) || std::isnan(v))
+            {
+                v = 0.0;
+            }
+
+            _descriptor[j] = v;
+        }
+    }
+
+    return true;
+}
+
+bool SynthesisEngine::embedsPart(const Match::Part& _part) const
+{
+    return options_.partID_ < 0 || options_.partID_ == _part.partID_;
+}
+
+int SynthesisEngine::nEmbeddedParts(const Match& _match) const
+{
+    int n = 0;
+
+    std::vector<Match::Part>::const_iterator itPart(_match.parts().begin()), partsEnd(_match.parts().end());
+
+    for (; itPart != partsEnd; ++itPart)
+    {
+        if (embedsPart(*itPart))
+        {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+void SynthesisEngine::buildIndex()
+{
+    if (index_)
+    {
+        delete index_;
+        index_ = 0;
+    }
+
+    pointsX_.clear();
+    pointsY_.clear();
+
+    if (points2D_.empty())
+    {
+        return;
+    }
+
+    // Small embeddings are searched exhaustively, which is faster than walking a tree and needs no build
+    if (points2D_.size() < bruteForceThreshold())
+    {
+        pointsX_.resize(points2D_.size());
+        pointsY_.resize(points2D_.size());
+
+        for (int i=0; i<points2D_.size(); ++i)
+        {
+            pointsX_[i] = points2D_[i][0];
+            pointsY_[i] = points2D_[i][1];
+        }
+
+        return;
+    }
+
+    // The embedding only changes when the matches do, so the tree is built once and shared by all queries
+    index_ = new KDTree2D(2, cloud_, nanoflann::KDTreeSingleIndexAdaptorParams(10 /* max leaf */));
+    index_->buildIndex();
+}
+
+int SynthesisEngine::bruteForceThreshold()
+{
+    int threshold = bruteForceThresholdOverride;
+
+    if (threshold >= 0)
+    {
+        return threshold;
+    }
+
+    return KNN_BRUTE_FORCE_THRESHOLD;
+}
+
+void SynthesisEngine::setBruteForceThreshold(int _threshold)
+{
+    bruteForceThresholdOverride = _threshold;
+}
+
+int SynthesisEngine::calibrateBruteForceThreshold()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const int nQueries = 32;
+    const int nRepeats = 3;
+    const int maxPoints = 1 << 14;
+
+    const int k = std::max(NUM_OF_NEAREST_NEIGHBOURS, 1);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<num_t> coordinate(-1, 1);
+
+    std::vector<OpenMesh::Vec2f> queries(nQueries);
+
+    for (int q=0; q<nQueries; ++q)
+    {
+        queries[q] = OpenMesh::Vec2f(coordinate(rng), coordinate(rng));
+    }
+
+    std::vector<NEAREST_POINT> nearest;
+    std::vector<size_t> nn_index(k);
+    std::vector<num_t> nn_dist_sqr(k);
+
+    int threshold = maxPoints;
+
+    for (int nPoints = 2 * k; nPoints <= maxPoints; nPoints *= 2)
+    {
+        std::vector<OpenMesh::Vec2f> points(nPoints);
+        std::vector<num_t> xs(nPoints), ys(nPoints);
+
+        for (int i=0; i<nPoints; ++i)
+        {
+            points[i] = OpenMesh::Vec2f(coordinate(rng), coordinate(rng));
+            xs[i] = points[i][0];
+            ys[i] = points[i][1];
+        }
+
+        PointCloud2D cloud(points);
+
+        // Best of a few runs, the first one also pays for the caches
+        double bruteForceTime = std::numeric_limits<double>::max();
+        double treeTime = std::numeric_limits<double>::max();
+
+        for (int r=0; r<nRepeats; ++r)
+        {
+            Clock::time_point start = Clock::now();
+
+            for (int q=0; q<nQueries; ++q)
+            {
+                bruteForceNearest(&xs[0], &ys[0], nPoints, queries[q][0], queries[q][1], k, nearest);
+            }
+
+            bruteForceTime = std::min(bruteForceTime, std::chrono::duration<double>(Clock::now() - start).count() / nQueries);
+
+            start = Clock::now();
+
+            KDTree2D tree(2, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(10 /* max leaf */));
+            tree.buildIndex();
+
+            const double buildTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+            start = Clock::now();
+
+            for (int q=0; q<nQueries; ++q)
+            {
+                nanoflann::KNNResultSet<num_t> resultSet(k);
+                resultSet.init(&nn_index[0], &nn_dist_sqr[0]);
+                tree.findNeighbors(resultSet, &queries[q][0], nanoflann::SearchParams(10));
+            }
+
+            const double queryTime = std::chrono::duration<double>(Clock::now() - start).count() / nQueries;
+
+            treeTime = std::min(treeTime, queryTime + buildTime / KNN_CALIBRATION_QUERIES_PER_INDEX);
+        }
+
+        if (treeTime < bruteForceTime)
+        {
+            threshold = nPoints;
+            break;
+        }
+    }
+
+    qDebug() << "Nearest neighbours are searched exhaustively below " << threshold << " points and with a kd-tree above";
+
+    return threshold;
+}
+
+void SynthesisEngine::buildDescriptorIndex()
+{
+    if (descriptorIndex_)
+    {
+        delete descriptorIndex_;
+        descriptorIndex_ = 0;
+    }
+
+    descriptors_.clear();
+
+    // The template parts follow the embedded parts of the first match, every match has to agree with it
+    descriptorSize_ = templateMatch_.parts().size() * nParamsPerPart();
+
+    int numMatches = matches_.size();
+
+    if (descriptorSize_ == 0 || numMatches == 0)
+    {
+        descriptorSize_ = 0;
+        return;
+    }
+
+    descriptors_.resize(numMatches * descriptorSize_);
+
+    std::vector<double> values(descriptorSize_);
+
+    for (int i=0; i<numMatches; ++i)
+    {
+        if (!matchDescriptor(*matches_[i], values.data(), descriptorSize_))
+        {
+            qCritical() << "Match " << matches_[i]->shortName() << " does not have the same number of parts as the template, no full descriptor search";
+            descriptors_.clear();
+            descriptorSize_ = 0;
+            return;
+        }
+
+        std::copy(values.begin(), values.end(), descriptors_.begin() + i * descriptorSize_);
+    }
+
+    // Built once per set of matches like the 2D tree, queries only read it
+    descriptorIndex_ = new KDTreeFull(descriptorSize_, descriptorCloud_, nanoflann::KDTreeSingleIndexAdaptorParams(10 /* max leaf */));
+    descriptorIndex_->buildIndex();
+}
+
+int SynthesisEngine::descriptorSize() const
+{
+    return descriptorIndex_ ? descriptorSize_ : 0;
+}
+
+const std::vector<double>& SynthesisEngine::pcaOrigin() const
+{
+    return pcaOrigin_;
+}
+
+const std::vector< std::vector<double> >& SynthesisEngine::pcaBasis() const
+{
+    return pcaBasis_;
+}
+
+const std::vector<OpenMesh::Vec2f>& SynthesisEngine::points2D() const
+{
+    return points2D_;
+}
+
+const OpenMesh::Vec2d& SynthesisEngine::pcaMin() const
+{
+    return pcaMin_;
+}
+
+const OpenMesh::Vec2d& SynthesisEngine::pcaMax() const
+{
+    return pcaMax_;
+}
+
+SynthesisEngine::Match& SynthesisEngine::templateMatch()
+{
+    return templateMatch_;
+}
+
+int SynthesisEngine::nSymmetryConstraints() const
+{
+    return nSymmetryConstraints_;
+}
+
+bool SynthesisEngine::deformTemplate(double _lambda1, double _lambda2, Match& _templateMatch) const
+{
+    TRACE_SPAN("SynthesisEngine::deformTemplate");
+
+    int nParams = nParamsPerPart();
+
+    std::vector<Match::Part>& tmParts = _templateMatch.parts();
+
+    if (pcaBasis_.size() != 2 || pcaBasis_[0].size() != pcaBasis_[1].size() || pcaBasis_[0].size() != pcaOrigin_.size() || pcaOrigin_.size() != tmParts.size() * nParams)
+    {
+        qCritical() << "PCA basis size does not agree with PCA origin or template match number of parameters" ;
+        return false;
+    }
+
+    int descriptorSize = pcaOrigin_.size();
+
+    std::vector<double> deformed_origin(descriptorSize);
+
+    for (int i=0; i<descriptorSize; ++i)
+    {
+        deformed_origin[i] = pcaOrigin_[i] + _lambda1 * pcaBasis_[0][i] + _lambda2 * pcaBasis_[1][i];
+    }
+
+    // The basis is orthonormal, so projecting the deformed descriptor back on it gives (_lambda1, _lambda2)
+    _templateMatch.setDescriptor2D(OpenMesh::Vec2f(_lambda1, _lambda2));
+
+    for (int i=0; i<tmParts.size(); ++i)
+    {
+        Match::Part& cPart = tmParts[i];
+
+        if (options_.calculationMode_ == CALCULATION_MODE_BOUNDING_BOX)
+        {
+            OpenMesh::Vec3f min(deformed_origin[i*nParams], deformed_origin[i*nParams+1], deformed_origin[i*nParams+2]);
+            OpenMesh::Vec3f max(deformed_origin[i*nParams+3], deformed_origin[i*nParams+4], deformed_origin[i*nParams+5]);
+
+            cPart.scale_ = (max - min) / 2.0f;
+            cPart.pos_ = min + cPart.scale_;
+        }
+        else
+        {
+            cPart.scale_[0] = avgMatchScale_[i * nParams];
+            cPart.scale_[1] = avgMatchScale_[i * nParams + 1];
+            cPart.scale_[2] = avgMatchScale_[i * nParams + 2];
+
+            cPart.pos_[0] = deformed_origin[i * nParams];
+            cPart.pos_[1] = deformed_origin[i * nParams + 1];
+            cPart.pos_[2] = deformed_origin[i * nParams + 2];
+        }
+    }
+
+    if (options_.preserveConstraints_)
+    {
+        optimizeTemplate(_templateMatch);
+    }
+
+    return true;
+}
+
+void SynthesisEngine::optimizeTemplate(Match& _templateMatch) const
+{
+    TRACE_SPAN("SynthesisEngine::optimizeTemplate");
+
+    std::vector<Match::Part>& tmParts = _templateMatch.parts();
+
+    // The constraints are the same for every deformation of the template, so they are always read from the engine's template
+    const std::vector<Match::Constraint>& tmConstraints = const_cast<Match&>(templateMatch_).constraints();
+
+    std::vector<Match::Constraint>::const_iterator tmConstraintsIt, tmConstraintsEnd(tmConstraints.end());
+
+    int N = tmParts.size() * NUM_PARAMS_BOX;
+
+    if (N == 0)
+    {
+        return;
+    }
+
+    // The optimizer solves for the quadratic function:
+    // f(x) = 1/2*x^tAx + b*x^t, subject to Cx = d;
+    // A is a N*N matrix, b is a 1*N vector,
+    // C is a M*N matrix, d is a M*1 vector
+    // A is 2I (the factor 0.5 is multiplied before) and b is -2x, so we look for the closest boxes that satisfy the constraints
+    // Arrays are on the heap since templates with many parts would need a few hundred KB of stack otherwise
+    real_2d_array A_alglib;
+    A_alglib.setlength(N, N);
+
+    real_1d_array b_alglib;
+    b_alglib.setlength(N);
+
+    for (int i=0; i<N; ++i)
+    {
+        for (int j=0; j<N; ++j)
+        {
+            A_alglib[i][j] = 0.0;
+        }
+
+        A_alglib[i][i] = 2.0;
+    }
+
+    for (int p=0; p<tmParts.size(); ++p)
+    {
+        int i = p * NUM_PARAMS_BOX;
+
+        b_alglib[i]   = -2.0 * tmParts[p].pos_[0];
+        b_alglib[i+1] = -2.0 * tmParts[p].pos_[1];
+        b_alglib[i+2] = -2.0 * tmParts[p].pos_[2];
+        b_alglib[i+3] = -2.0 * tmParts[p].scale_[0];
+        b_alglib[i+4] = -2.0 * tmParts[p].scale_[1];
+        b_alglib[i+5] = -2.0 * tmParts[p].scale_[2];
+    }
+
+    int M = 0;
+
+    // Each symmetry imposes NUM_EQUATIONS_SYMMETRY equations, each contact imposes NUM_EQUATIONS_CONTACT equations
+    for (tmConstraintsIt = tmConstraints.begin(); tmConstraintsIt!=tmConstraintsEnd; ++tmConstraintsIt)
+    {
+        if (tmConstraintsIt->type_ == SYMMETRY)
+        {
+            M+=NUM_EQUATIONS_SYMMETRY;
+        }
+        if (tmConstraintsIt->type_ == CONTACT)
+        {
+            M+=NUM_EQUATIONS_CONTACT;
+        }
+    }
+
+    if (M == 0)
+    {
+        return;
+    }
+
+    // The N+1'th column stores the values of d
+    real_2d_array C_alglib;
+    C_alglib.setlength(M, N+1);
+
+    for (int i=0; i<M; ++i)
+    {
+        for (int j=0; j<N+1; ++j)
+        {
+            C_alglib[i][j] = 0.0;
+        }
+    }
+
+    OpenMesh::Vec3d o(0.0,0.0,0.0); // reflectional symmetry plane center
+
+    OpenMesh::Vec3d n(1.0,0.0,0.0); // reflectional symmetry plane normal
+
+    if (LOADED_DATASET == PLANES)
+    {
+        n = OpenMesh::Vec3d(0.0,1.0,0.0);
+    }
+
+    static const int Q[8][3] =
+    {
+        {1,1,1},
+        {1,-1,1},
+        {-1,-1,1},
+        {-1,1,1},
+        {1,1,-1},
+        {1,-1,-1},
+        {-1,-1,-1},
+        {-1,1,-1}
+    };
+
+    int J = 0;
+
+    for (tmConstraintsIt = tmConstraints.begin(); tmConstraintsIt!=tmConstraintsEnd; ++tmConstraintsIt)
+    {
+        int _index1 = tmConstraintsIt->partIndices_.first * NUM_PARAMS_BOX;
+        int _index2 = tmConstraintsIt->partIndices_.second * NUM_PARAMS_BOX;
+
+        if (_index1 >= N || _index2 >= N)
+        {
+            qWarning() << "Constraint between part indices " << tmConstraintsIt->partIndices_.first << " and " << tmConstraintsIt->partIndices_.second << " is out of range for a template with " << tmParts.size() << " parts";
+            J += (tmConstraintsIt->type_ == SYMMETRY) ? NUM_EQUATIONS_SYMMETRY : NUM_EQUATIONS_CONTACT;
+            continue;
+        }
+
+        if (tmConstraintsIt->type_ == SYMMETRY)
+        {
+            // centers
+            // 1. n*(c_i+c_j) = 2o*n
+            C_alglib[J][_index1 + 0] = n[0]; C_alglib[J][_index2 + 0] = n[0];
+            C_alglib[J][_index1 + 1] = n[1]; C_alglib[J][_index2 + 1] = n[1];
+            C_alglib[J][_index1 + 2] = n[2]; C_alglib[J][_index2 + 2] = n[2];
+            C_alglib[J][N] = 2 * (n|o);
+            J++;
+
+            // 2. nx(c_i-c_j) = 0
+            C_alglib[J][_index1 + 0] = n[2]; C_alglib[J][_index2 + 0] = -n[2]; C_alglib[J][_index1 + 2] = -n[0]; C_alglib[J][_index2 + 2] = n[0];
+            J++;
+            C_alglib[J][_index1 + 1] = n[0]; C_alglib[J][_index2 + 1] = -n[0]; C_alglib[J][_index1 + 0] = -n[1]; C_alglib[J][_index2 + 0] = n[1];
+            J++;
+            C_alglib[J][_index1 + 2] = n[1]; C_alglib[J][_index2 + 2] = -n[1]; C_alglib[J][_index1 + 1] = -n[2]; C_alglib[J][_index2 + 1] = n[2];
+            J++;
+
+            // scales
+            C_alglib[J][_index1 + 3] = 1.0; C_alglib[J][_index2 + 3] = -1.0;
+            J++;
+            C_alglib[J][_index1 + 4] = 1.0; C_alglib[J][_index2 + 4] = -1.0;
+            J++;
+            C_alglib[J][_index1 + 5] = 1.0; C_alglib[J][_index2 + 5] = -1.0;
+            J++;
+        }
+
+        if (tmConstraintsIt->type_ == CONTACT)
+        {
+            // Find the pair of box corners that are closest, the contact keeps them together
+            const Match::Part& part1 = tmParts[ tmConstraintsIt->partIndices_.first ];
+            const Match::Part& part2 = tmParts[ tmConstraintsIt->partIndices_.second ];
+
+            int bestT = 0;
+            int bestR = 0;
+
+            double minDist = std::numeric_limits<double>::max();
+
+            for (int j=0; j<8; ++j)
+            {
+                OpenMesh::Vec3f p = part1.pos_ + OpenMesh::Vec3f(Q[j][0] * part1.scale_[0], Q[j][1] * part1.scale_[1], Q[j][2] * part1.scale_[2]);
+
+                for (int k=0; k<8; ++k)
+                {
+                    OpenMesh::Vec3f q = part2.pos_ + OpenMesh::Vec3f(Q[k][0] * part2.scale_[0], Q[k][1] * part2.scale_[1], Q[k][2] * part2.scale_[2]);
+
+                    double dis = (q - p).norm();
+
+                    if (dis < minDist)
+                    {
+                        minDist = dis;
+                        bestT = j;
+                        bestR = k;
+                    }
+                }
+            }
+
+            C_alglib[J][_index1 + 0] = 1.0; C_alglib[J][_index2 + 0] = -1.0; C_alglib[J][_index1 + 3] = Q[bestT][0]; C_alglib[J][_index2 + 3] = -Q[bestR][0];
+            J++;
+            C_alglib[J][_index1 + 1] = 1.0; C_alglib[J][_index2 + 1] = -1.0; C_alglib[J][_index1 + 4] = Q[bestT][1]; C_alglib[J][_index2 + 4] = -Q[bestR][1];
+            J++;
+            C_alglib[J][_index1 + 2] = 1.0; C_alglib[J][_index2 + 2] = -1.0; C_alglib[J][_index1 + 5] = Q[bestT][2]; C_alglib[J][_index2 + 5] = -Q[bestR][2];
+            J++;
+        }
+    }
+
+    integer_1d_array ct_alglib;
+    ct_alglib.setlength(M);
+
+    for (int i=0; i<M; ++i)
+    {
+        ct_alglib[i] = 0;
+    }
+
+    minqpstate state;
+    minqpreport rep;
+    real_1d_array x_alglib;
+
+    // create solver, set quadratic/linear terms and the linear constraints, then solve with the Cholesky-based QP solver
+    minqpcreate(N, state);
+    minqpsetquadraticterm(state, A_alglib);
+    minqpsetlinearterm(state, b_alglib);
+    minqpsetlc(state, C_alglib, ct_alglib);
+    minqpsetalgocholesky(state);
+    minqpoptimize(state);
+    minqpresults(state, x_alglib, rep);
+
+    if (rep.terminationtype <= 0)
+    {
+        qWarning() << "Template optimisation did not converge, termination type " << (int)rep.terminationtype;
+        return;
+    }
+
+    for (int p=0; p<tmParts.size(); ++p)
+    {
+        int i = p * NUM_PARAMS_BOX;
+
+        tmParts[p].pos_[0] = x_alglib[i];
+        tmParts[p].pos_[1] = x_alglib[i+1];
+        tmParts[p].pos_[2] = x_alglib[i+2];
+
+        tmParts[p].scale_[0] = x_alglib[i+3];
+        tmParts[p].scale_[1] = x_alglib[i+4];
+        tmParts[p].scale_[2] = x_alglib[i+5];
+    }
+}
+
+std::vector<NEAREST_POINT> SynthesisEngine::nearestPoints(double _x, double _y, int _numNeighbors) const
+{
+    TRACE_SPAN("SynthesisEngine::nearestPoints");
+
+    if (options_.fullDescriptorSearch_ && descriptorIndex_)
+    {
+        Match tm;
+
+        tm.setParts(templateMatch_.parts());
+        tm.setNparts(templateMatch_.parts().size());
+
+        if (deformTemplate(_x, _y, tm))
+        {
+            return nearestPoints(tm, _numNeighbors);
+        }
+    }
+
+    std::vector<NEAREST_POINT> nearest(_numNeighbors);
+
+    int nPoints = points2D_.size();
+
+    if (nPoints == 0 || _numNeighbors > nPoints)
+    {
+        qCritical() << "Looking for " << _numNeighbors << " neighbours among " << nPoints << " points is not possible" ;
+        return nearest;
+    }
+
+    if (!index_)
+    {
+        bruteForceNearest(&pointsX_[0], &pointsY_[0], nPoints, (num_t)_x, (num_t)_y, _numNeighbors, nearest);
+        return nearest;
+    }
+
+    std::vector<size_t> nn_index(_numNeighbors);
+    std::vector<num_t> nn_dist_sqr(_numNeighbors);
+
+    num_t p[2] = { (num_t)_x, (num_t)_y };
+
+    nanoflann::KNNResultSet<num_t> resultSet(_numNeighbors);
+
+    resultSet.init(&nn_index[0], &nn_dist_sqr[0]);
+
+    index_->findNeighbors(resultSet, p, nanoflann::SearchParams(10));
+
+    for (int i=0; i<_numNeighbors; ++i)
+    {
+        nearest[i].index_ = nn_index[i];
+        nearest[i].distance_ = nn_dist_sqr[i];
+    }
+
+    return nearest;
+}
+
+std::vector<NEAREST_POINT> SynthesisEngine::nearestPoints(const Match& _templateMatch, int _numNeighbors) const
+{
+    TRACE_SPAN("SynthesisEngine::nearestPoints full descriptor");
+
+    std::vector<NEAREST_POINT> nearest(_numNeighbors);
+
+    int nPoints = descriptorIndex_ ? descriptors_.size() / descriptorSize_ : 0;
+
+    if (!descriptorIndex_ || _numNeighbors > nPoints)
+    {
+        qCritical() << "Looking for " << _numNeighbors << " neighbours among " << nPoints << " full descriptors is not possible" ;
+        return nearest;
+    }
+
+    std::vector<double> values(descriptorSize_);
+
+    if (!matchDescriptor(_templateMatch, values.data(), descriptorSize_))
+    {
+        qCritical() << "Template does not have the parts of the matches, cannot search their full descriptors";
+        return nearest;
+    }
+
+    std::vector<num_t> query(values.begin(), values.end());
+
+    std::vector<size_t> nn_index(_numNeighbors);
+    std::vector<num_t> nn_dist_sqr(_numNeighbors);
+
+    nanoflann::KNNResultSet<num_t> resultSet(_numNeighbors);
+
+    resultSet.init(&nn_index[0], &nn_dist_sqr[0]);
+
+    descriptorIndex_->findNeighbors(resultSet, &query[0], nanoflann::SearchParams(10));
+
+    for (int i=0; i<_numNeighbors; ++i)
+    {
+        nearest[i].index_ = nn_index[i];
+        nearest[i].distance_ = nn_dist_sqr[i];
+    }
+
+    return nearest;
+}
+
+int SynthesisEngine::PartRanking::row(int _partID) const
+{
+    if (_partID < 0 || _partID >= rowOfPartID_.size())
+    {
+        return -1;
+    }
+
+    return rowOfPartID_[_partID];
+}
+
+void SynthesisEngine::PartRanking::clear()
+{
+    partIDs_.clear();
+    rowOfPartID_.clear();
+    depth_ = 0;
+    matchIndices_.clear();
+    scores_.clear();
+}
+
+// The (min, max) corners of a part box, the descriptor partUnaryScore compares
+static inline void packPartBox(const SynthesisEngine::Match::Part& _part, double* _box)
+{
+    OpenMesh::Vec3f bMin = _part.pos_ - _part.scale_;
+    OpenMesh::Vec3f bMax = _part.pos_ + _part.scale_;
+
+    _box[0] = bMin[0];
+    _box[1] = bMin[1];
+    _box[2] = bMin[2];
+    _box[3] = bMax[0];
+    _box[4] = bMax[1];
+    _box[5] = bMax[2];
+}
+
+void SynthesisEngine::rankNeighborParts(const Match& _templateMatch, const std::vector<NEAREST_POINT>& _nearestPoints, PartRanking& _ranking, int _depth) const
+{
+    TRACE_SPAN("SynthesisEngine::rankNeighborParts");
+
+    _ranking.clear();
+
+    const std::vector<Match::Part>& tmParts = _templateMatch.parts();
+
+    int nParts = tmParts.size();
+    int nNeighbours = _nearestPoints.size();
+
+    if (nParts == 0 || nNeighbours == 0)
+    {
+        return;
+    }
+
+    // Pack the template boxes, one row of 6 per part
+    std::vector<double> tmBoxes(nParts * 6);
+
+    for (int r=0; r<nParts; ++r)
+    {
+        int partID = tmParts[r].partID_;
+
+        if (partID < 0)
+        {
+            qCritical() << "Template part has a negative ID " << partID;
+            return;
+        }
+
+        if (partID >= _ranking.rowOfPartID_.size())
+        {
+            _ranking.rowOfPartID_.resize(partID + 1, -1);
+        }
+
+        _ranking.rowOfPartID_[partID] = r;
+        _ranking.partIDs_.push_back(partID);
+
+        packPartBox(tmParts[r], &tmBoxes[r * 6]);
+    }
+
+    // Pack the neighbour boxes part-major, so the score sweep for a part runs over contiguous memory
+    // Every neighbour's parts are visited once, the row lookup replaces searching the template for each part ID
+    std::vector<double> nmBoxes(nParts * nNeighbours * 6, 0.0);
+
+    std::vector<char> hasPart(nParts * nNeighbours, 0);
+
+    std::vector<int> neighbourIndices(nNeighbours, -1);
+
+    for (int n=0; n<nNeighbours; ++n)
+    {
+        int nearestMatchIndex = _nearestPoints[n].index_;
+
+        if (nearestMatchIndex<0 || nearestMatchIndex>=matches_.size())
+        {
+            qCritical() << "Nearest neighbour index is invalid" << nearestMatchIndex;
+            continue;
+        }
+
+        neighbourIndices[n] = nearestMatchIndex;
+
+        Match& nearestMatch = *matches_[nearestMatchIndex];
+
+        std::vector<Match::Part>::iterator itPart(nearestMatch.parts().begin()), partEnd(nearestMatch.parts().end());
+
+        for (; itPart != partEnd; ++itPart)
+        {
+            Match::Part& nmcPart = *itPart;
+
+            int r = _ranking.row(nmcPart.partID_);
+
+            if (r < 0)
+            {
+                continue;
+            }
+
+            // Boxes were already recalculated by preparePartMeshes, and must not be touched while other threads read them
+            if (options_.recalculateBoxes_ && !partMeshesPrepared_)
+            {
+                // We need the part's mesh now, so try to open it, if we fail, then segment the mesh using the naive approach
+                if(!nearestMatch.openPartMeshIfNotOpened(nmcPart))
+                {
+                    nearestMatch.openMeshIfNotOpened();
+                    nearestMatch.split();
+                }
+
+                nmcPart.recalculateBox(nearestMatch.alignMtx());
+            }
+
+            packPartBox(nmcPart, &nmBoxes[(r * nNeighbours + n) * 6]);
+
+            hasPart[r * nNeighbours + n] = 1;
+        }
+    }
+
+    // Score matrix, parts x neighbours
+    std::vector<double> scores(nParts * nNeighbours);
+
+    for (int r=0; r<nParts; ++r)
+    {
+        const double* tmBox = &tmBoxes[r * 6];
+        const double* nmBox = &nmBoxes[r * nNeighbours * 6];
+
+        double* rowScores = &scores[r * nNeighbours];
+
+        for (int n=0; n<nNeighbours; ++n)
+        {
+            double score = 0.0;
+
+            for (int c=0; c<6; ++c)
+            {
+                double d = nmBox[n * 6 + c] - tmBox[c];
+                score += d * d;
+            }
+
+            rowScores[n] = score;
+        }
+
+        for (int n=0; n<nNeighbours; ++n)
+        {
+            if (!hasPart[r * nNeighbours + n] || neighbourIndices[n] < 0)
+            {
+                rowScores[n] = std::numeric_limits<double>::max();
+            }
+        }
+    }
+
+    int depth = (_depth > 0 && _depth < nNeighbours) ? _depth : nNeighbours;
+
+    _ranking.depth_ = depth;
+    _ranking.matchIndices_.resize(nParts * depth);
+    _ranking.scores_.resize(nParts * depth);
+
+    std::vector<int> order(nNeighbours);
+
+    for (int r=0; r<nParts; ++r)
+    {
+        const double* rowScores = &scores[r * nNeighbours];
+
+        for (int n=0; n<nNeighbours; ++n)
+        {
+            order[n] = n;
+        }
+
+        // Ties keep the nearest neighbour order, as the stable sort of the ranking did before
+        std::partial_sort(order.begin(), order.begin() + depth, order.end(), [rowScores](int i, int j) { return rowScores[i] < rowScores[j] || (rowScores[i] == rowScores[j] && i < j); });
+
+        for (int k=0; k<depth; ++k)
+        {
+            int n = order[k];
+
+            bool valid = hasPart[r * nNeighbours + n] && neighbourIndices[n] >= 0;
+
+            _ranking.matchIndices_[r * depth + k] = valid ? neighbourIndices[n] : -1;
+            _ranking.scores_[r * depth + k] = rowScores[n];
+        }
+    }
+}
+
+// The squared norm of the difference of the 6D (min,max) box descriptors of the two parts
+double SynthesisEngine::partUnaryScore(const Match::Part& _tmPart, const Match::Part& _nmcPart)
+{
+    OpenMesh::Vec3f nmMin = _nmcPart.pos_ - _nmcPart.scale_;
+    OpenMesh::Vec3f nmMax = _nmcPart.pos_ + _nmcPart.scale_;
+
+    OpenMesh::Vec3f tmMin = _tmPart.pos_ - _tmPart.scale_;
+    OpenMesh::Vec3f tmMax = _tmPart.pos_ + _tmPart.scale_;
+
+    OpenMesh::Vec6d nmDescriptor(nmMin[0],nmMin[1],nmMin[2],nmMax[0],nmMax[1],nmMax[2]);
+    OpenMesh::Vec6d tmDescriptor(tmMin[0],tmMin[1],tmMin[2],tmMax[0],tmMax[1],tmMax[2]);
+
+    return (nmDescriptor - tmDescriptor).sqrnorm();
+}
+
+bool SynthesisEngine::deformNearestPart(Match::Part& _tmcPart, Match& _nearestMatch, bool _loadIfMissing)
+{
+    TRACE_SPAN("SynthesisEngine::deformNearestPart");
+
+    std::vector<Match::Part>::iterator itPart(_nearestMatch.parts().begin()), partEnd(_nearestMatch.parts().end());
+
+    // We need to find the neighbor's part which has the same part ID with the part we want to deform
+    for (; itPart != partEnd; ++itPart)
+    {
+        Match::Part& nmcPart = *itPart;
+
+        if (nmcPart.partID_ != _tmcPart.partID_)
+        {
+            continue;
+        }
+
+        // We need the part's mesh now, so try to open it, if we fail, then segment the mesh using the naive approach
+        if(_loadIfMissing && !_nearestMatch.openPartMeshIfNotOpened(nmcPart))
+        {
+            _nearestMatch.openMeshIfNotOpened();
+            _nearestMatch.split();
+        }
+
+        const Shape::Mesh& nMesh = nmcPart.partShape_.mesh();
+        Shape::Mesh& tMesh = _tmcPart.partShape_.mesh();
+
+        if(nMesh.n_vertices() == 0)
+        {
+            LOG_WARNING() << "Part " << nmcPart.partID_ << " of " << _nearestMatch.shortName() << " has no vertices";
+            return false;
+        }
+
+        tMesh = nMesh;
+
+        OpenMesh::Vec3f scaleFactor = _tmcPart.scale_ / nmcPart.scale_;
+
+        // Deform the part's mesh vertices using the boxes of the parts
+        Shape::Mesh::VertexIter vIt(tMesh.vertices_begin()), vEnd(tMesh.vertices_end());
+
+        for(; vIt!=vEnd; ++vIt)
+        {
+            OpenMesh::Vec3f transToOrigin = mv(_nearestMatch.alignMtx(), tMesh.point(vIt)) - nmcPart.pos_;
+
+            tMesh.set_point(vIt, transToOrigin * scaleFactor + _tmcPart.pos_);
+        }
+
+        _tmcPart.partShape_.geometryChanged();
+
+        tMesh.request_face_normals();
+        tMesh.request_vertex_normals();
+        tMesh.update_face_normals();
+        tMesh.update_vertex_normals();
+
+        return true;
+    }
+
+    return false;
+}
+
+void SynthesisEngine::choosePart(Match::Part& _tmcPart, int _symmetricPartID, Synthesis& _synthesis) const
+{
+    int partID = _tmcPart.partID_;
+
+    const PartRanking& ranking = _synthesis.ranking_;
+
+    int row = ranking.row(partID);
+
+    if (row < 0 || ranking.depth_ == 0)
+    {
+        qCritical() << "No ranked neighbours for part ID " << partID;
+        return;
+    }
+
+    int symmetricRow = _symmetricPartID >= 0 ? ranking.row(_symmetricPartID) : -1;
+
+    // Walk down the ranking until a neighbour's part mesh can be deformed
+    for (int r=0; r<ranking.depth_; ++r)
+    {
+        std::pair<int, double> candidate(ranking.matchIndex(row, r), ranking.score(row, r));
+
+        // Symmetric parts take the neighbour that fits either of them best, so both sides end up coming from the same shape
+        if (symmetricRow >= 0 && ranking.score(symmetricRow, r) < candidate.second)
+        {
+            candidate = std::pair<int, double>(ranking.matchIndex(symmetricRow, r), ranking.score(symmetricRow, r));
+        }
+
+        if (options_.forcedNeighborIndex_ >= 0 && options_.forcedNeighborIndex_ < matches_.size())
+        {
+            candidate.first = options_.forcedNeighborIndex_;
+        }
+
+        // Neighbours without the part are ranked last
+        if (candidate.first < 0)
+        {
+            continue;
+        }
+
+        if (candidate.first >= matches_.size())
+        {
+            qCritical() << "Nearest neighbour index is invalid" << candidate.first;
+            continue;
+        }
+
+        if (deformNearestPart(_tmcPart, *matches_[candidate.first], !partMeshesPrepared_))
+        {
+            _synthesis.chosen_[partID] = candidate;
+            _synthesis.chosenRank_[partID] = r;
+            return;
+        }
+    }
+
+    qWarning() << "All neighbor part meshes for part ID " << partID << " were empty, aborting deformation!";
+}
+
+void SynthesisEngine::preparePartMeshes()
+{
+    TRACE_SPAN("SynthesisEngine::preparePartMeshes");
+
+    std::vector<Match*>::iterator itMatch(matches_.begin()), matchesEnd(matches_.end());
+
+    for (; itMatch != matchesEnd; ++itMatch)
+    {
+        Match& cMatch = **itMatch;
+
+        std::vector<Match::Part>::iterator itPart(cMatch.parts().begin()), partEnd(cMatch.parts().end());
+
+        bool splitDone = false;
+
+        for (; itPart != partEnd; ++itPart)
+        {
+            // Same fallback as deformNearestPart, segment the whole mesh once if a part mesh cannot be opened
+            if (!cMatch.openPartMeshIfNotOpened(*itPart) && !splitDone)
+            {
+                cMatch.openMeshIfNotOpened();
+                cMatch.split();
+                splitDone = true;
+            }
+
+            if (options_.recalculateBoxes_)
+            {
+                itPart->recalculateBox(cMatch.alignMtx());
+            }
+        }
+    }
+
+    partMeshesPrepared_ = true;
+}
+
+bool SynthesisEngine::partMeshesPrepared() const
+{
+    return partMeshesPrepared_;
+}
+
+void SynthesisEngine::invalidatePartMeshes()
+{
+    partMeshesPrepared_ = false;
+}
+
+bool SynthesisEngine::synthesize(double _x, double _y, Synthesis& _synthesis) const
+{
+    TRACE_SPAN("SynthesisEngine::synthesize");
+
+    _synthesis.point_ = OpenMesh::Vec2f(_x, _y);
+    _synthesis.ranking_.clear();
+    _synthesis.chosen_.clear();
+    _synthesis.chosenRank_.clear();
+    _synthesis.nnUsed_ = 0;
+
+    int nofNN = std::min<int>(options_.nofNN_, matches_.size());
+
+    if (nofNN <= 0)
+    {
+        qCritical() << "No matches to synthesise from";
+        return false;
+    }
+
+    // Deform the template boxes
+    Match& tm = _synthesis.templateMatch_;
+
+    tm.setParts(templateMatch_.parts());
+    tm.setNparts(templateMatch_.parts().size());
+
+    if (!deformTemplate(_x, _y, tm))
+    {
+        return false;
+    }
+
+    // The template is already deformed, so the full descriptor search does not have to deform it again
+    if (options_.fullDescriptorSearch_ && descriptorIndex_)
+    {
+        _synthesis.nearestPoints_ = nearestPoints(tm, nofNN);
+    }
+    else
+    {
+        _synthesis.nearestPoints_ = nearestPoints(_x, _y, nofNN);
+    }
+
+    // The model starts off as the deformed template, each part then gets its mesh from one of the neighbours
+    Match& model = _synthesis.model_;
+
+    xform ident;
+
+    model.setAlignMtx(ident);
+    model.setNparts(tm.nparts());
+    model.setDescriptor2D(tm.descriptor2D());
+    model.setParts(tm.parts());
+    model.setSegmented(true);
+    model.points().clear();
+    model.setNpnts(0);
+
+    std::vector<Match::Part>& cParts = model.parts();
+
+    std::vector<Match::Part>::iterator partIt(cParts.begin()), partEnd(cParts.end());
+
+    // Rank the neighbours for all the parts at once
+    rankNeighborParts(tm, _synthesis.nearestPoints_, _synthesis.ranking_);
+
+    const std::vector<Match::Constraint>& tmConstraints = const_cast<Match&>(templateMatch_).constraints();
+
+    // Pick the top ranked neighbour for each part and enforce symmetries
+    for (partIt = cParts.begin(); partIt!=partEnd; ++partIt)
+    {
+        int symmetricPartID = -1;
+
+        if (options_.preserveConstraints_)
+        {
+            std::vector<Match::Constraint>::const_iterator tmConstraintsIt(tmConstraints.begin()), tmConstraintsEnd(tmConstraints.end());
+
+            for (; tmConstraintsIt!=tmConstraintsEnd; ++tmConstraintsIt)
+            {
+                if (tmConstraintsIt->type_ != SYMMETRY)
+                {
+                    continue;
+                }
+
+                if (tmConstraintsIt->partIDs_.first == partIt->partID_)
+                {
+                    symmetricPartID = tmConstraintsIt->partIDs_.second;
+                    break;
+                }
+
+                if (tmConstraintsIt->partIDs_.second == partIt->partID_)
+                {
+                    symmetricPartID = tmConstraintsIt->partIDs_.first;
+                    break;
+                }
+            }
+        }
+
+        choosePart(*partIt, symmetricPartID, _synthesis);
+    }
+
+    std::unordered_map<int, int> countNeighbors;
+
+    std::unordered_map<int, std::pair<int, double> >::const_iterator chosenIt(_synthesis.chosen_.begin()), chosenEnd(_synthesis.chosen_.end());
+
+    for (; chosenIt!=chosenEnd; ++chosenIt)
+    {
+        countNeighbors[chosenIt->second.first]++;
+    }
+
+    _synthesis.nnUsed_ = countNeighbors.size();
+
+    return _synthesis.chosen_.size() == cParts.size();
+}
+
+bool SynthesisEngine::saveModel(const Match& _model, const QString& _filename, MODEL_FORMAT _format)
+{
+    std::vector<const Shape::Mesh*> meshes;
+
+    const std::vector<Match::Part>& cParts = _model.parts();
+
+    std::vector<Match::Part>::const_iterator partIt(cParts.begin()), partEnd(cParts.end());
+
+    for (; partIt!=partEnd; ++partIt)
+    {
+        meshes.push_back(&partIt->partShape_.mesh());
+    }
+
+    return writeMeshes(meshes, _filename, _format);
+}
+
+bool SynthesisEngine::writeMeshes(const std::vector<const Shape::Mesh*>& _meshes, const QString& _filename, MODEL_FORMAT _format)
+{
+    std::vector<const Shape::Mesh*>::const_iterator meshIt(_meshes.begin()), meshEnd(_meshes.end());
+
+    size_t nVertices = 0, nFaces = 0;
+
+    for (; meshIt!=meshEnd; ++meshIt)
+    {
+        nVertices += (*meshIt)->n_vertices();
+        nFaces += (*meshIt)->n_faces();
+    }
+
+    QFile file(_filename);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qCritical() << "Could not write mesh " << _filename;
+        return false;
+    }
+
+    const bool binary = (_format == MODEL_FORMAT_PLY);
+
+    // The binary PLY is written in the byte order of the machine, so the points can be copied as they are
+    const unsigned int one = 1;
+    const bool littleEndian = (*reinterpret_cast<const unsigned char*>(&one) == 1);
+
+    std::string buffer;
+    buffer.reserve(MODEL_WRITE_BUFFER_SIZE + 1024);
+
+    if (binary)
+    {
+        buffer += "ply\n";
+        buffer += littleEndian ? "format binary_little_endian 1.0\n" : "format binary_big_endian 1.0\n";
+        buffer += "element vertex ";
+        appendUInt(buffer, nVertices);
+        buffer += "\nproperty float x\nproperty float y\nproperty float z\n";
+        buffer += "element face ";
+        appendUInt(buffer, nFaces);
+        buffer += "\nproperty list uchar int vertex_indices\nend_header\n";
+    }
+    else
+    {
+        buffer += "OFF\n";
+        appendUInt(buffer, nVertices);
+        buffer += " ";
+        appendUInt(buffer, nFaces);
+        buffer += " 0\n";
+    }
+
+    const char decimalPoint = *std::localeconv()->decimal_point;
+
+    bool ok = true;
+
+    // All vertices come before all faces, so the meshes are walked twice
+    for (meshIt = _meshes.begin(); meshIt!=meshEnd && ok; ++meshIt)
+    {
+        const Shape::Mesh& cMesh = **meshIt;
+
+        const Shape::Mesh::Point* points = cMesh.n_vertices() ? cMesh.points() : 0;
+
+        for (size_t v=0; v<cMesh.n_vertices() && ok; ++v)
+        {
+            if (binary)
+            {
+                buffer.append(reinterpret_cast<const char*>(&points[v][0]), 3 * sizeof(float));
+            }
+            else
+            {
+                for (int i=0; i<3; ++i)
+                {
+                    appendFloat(buffer, points[v][i], decimalPoint);
+                    buffer += (i < 2) ? ' ' : '\n';
+                }
+            }
+
+            ok = flushModelBuffer(file, buffer, false);
+        }
+    }
+
+    size_t vertexOffset = 0;
+
+    // Reused for every face
+    std::vector<int> indices;
+
+    for (meshIt = _meshes.begin(); meshIt!=meshEnd && ok; ++meshIt)
+    {
+        const Shape::Mesh& cMesh = **meshIt;
+
+        Shape::Mesh::ConstFaceIter fIt(cMesh.faces_begin()), fEnd(cMesh.faces_end());
+
+        for (; fIt!=fEnd && ok; ++fIt)
+        {
+            indices.clear();
+
+            Shape::Mesh::ConstFaceVertexIter fvIt = cMesh.cfv_iter(fIt.handle());
+
+            for (; fvIt; ++fvIt)
+            {
+                indices.push_back(fvIt.handle().idx() + vertexOffset);
+            }
+
+            if (binary)
+            {
+                // The PLY header gives the valence a single byte
+                if (indices.size() > 255)
+                {
+                    qCritical() << "Cannot write a face of " << indices.size() << " vertices to " << _filename;
+                    ok = false;
+                    break;
+                }
+
+                buffer += (char)indices.size();
+                buffer.append(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(int));
+            }
+            else
+            {
+                appendUInt(buffer, indices.size());
+
+                for (size_t i=0; i<indices.size(); ++i)
+                {
+                    buffer += ' ';
+                    appendUInt(buffer, indices[i]);
+                }
+
+                buffer += '\n';
+            }
+
+            ok = flushModelBuffer(file, buffer, false);
+        }
+
+        vertexOffset += cMesh.n_vertices();
+    }
+
+    ok = ok && flushModelBuffer(file, buffer, true);
+
+    if (!ok)
+    {
+        qCritical() << "Could not write mesh " << _filename;
+        file.close();
+        file.remove();
+        return false;
+    }
+
+    return true;
+}
+
+bool SynthesisEngine::partMeshesUpToDate(const Match& _match)
+{
+    QFileInfo meshInfo(_match.meshFilename());
+
+    const std::vector<Match::Part>& cParts = _match.parts();
+
+    std::vector<Match::Part>::const_iterator partIt(cParts.begin()), partEnd(cParts.end());
+
+    for (; partIt!=partEnd; ++partIt)
+    {
+        if (partIt->partType_ == 0)
+        {
+            continue;
+        }
+
+        QFileInfo partInfo(_match.meshFilename() + QString(".p%1.off").arg(partIt->partID_));
+
+        if (!partInfo.exists() || (meshInfo.exists() && partInfo.lastModified() < meshInfo.lastModified()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SynthesisEngine::segmentMatches(const std::vector<Match*>& _matches, const SegmentationOptions& _options, SegmentationStats& _stats)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    _stats = SegmentationStats();
+
+    Clock::time_point start = Clock::now();
+
+    MemoryBudget budget(_options.maxInFlightBytes_);
+
+    std::mutex statsMutex;
+
+    WorkStealingPool pool(_options.nThreads_);
+
+    pool.run(_matches.size(), [&](int _match, int _worker)
+    {
+        Match& cMatch = *_matches[_match];
+
+        if (_options.skipUpToDate_ && partMeshesUpToDate(cMatch))
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            _stats.nSkipped_++;
+            return;
+        }
+
+        const QString& meshFilename = cMatch.meshFilename();
+
+        qint64 bytesRead = QFileInfo(meshFilename).size();
+
+        budget.acquire(bytesRead);
+
+        Clock::time_point stageStart = Clock::now();
+
+        // The match mesh itself, MatchT::openMesh would only open the part meshes with the usual config
+        bool ok = cMatch.Shape::openMesh(meshFilename.toLocal8Bit());
+
+        double loadSeconds = std::chrono::duration<double>(Clock::now() - stageStart).count();
+
+        double splitSeconds = 0.0, writeSeconds = 0.0;
+
+        qint64 bytesWritten = 0;
+
+        if (ok)
+        {
+            stageStart = Clock::now();
+
+            cMatch.split();
+
+            splitSeconds = std::chrono::duration<double>(Clock::now() - stageStart).count();
+
+            stageStart = Clock::now();
+
+            std::vector<Match::Part>::iterator partIt(cMatch.parts().begin()), partEnd(cMatch.parts().end());
+
+            for (; partIt!=partEnd && ok; ++partIt)
+            {
+                if (partIt->partType_ == 0)
+                {
+                    continue;
+                }
+
+                QString partMeshName = meshFilename + QString(".p%1.off").arg(partIt->partID_);
+
+                std::vector<const Shape::Mesh*> meshes(1, &partIt->partShape_.mesh());
+
+                ok = writeMeshes(meshes, partMeshName, MODEL_FORMAT_OFF);
+
+                bytesWritten += QFileInfo(partMeshName).size();
+            }
+
+            writeSeconds = std::chrono::duration<double>(Clock::now() - stageStart).count();
+        }
+        else
+        {
+            qCritical() << "Cannot read mesh from file: " << meshFilename;
+        }
+
+        releaseMesh(cMatch);
+
+        std::vector<Match::Part>::iterator partIt(cMatch.parts().begin()), partEnd(cMatch.parts().end());
+
+        for (; partIt!=partEnd; ++partIt)
+        {
+            releaseMesh(partIt->partShape_);
+        }
+
+        budget.release(bytesRead);
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+
+        if (ok)
+        {
+            _stats.nSegmented_++;
+        }
+        else
+        {
+            _stats.nFailed_++;
+        }
+
+        _stats.loadSeconds_ += loadSeconds;
+        _stats.splitSeconds_ += splitSeconds;
+        _stats.writeSeconds_ += writeSeconds;
+        _stats.bytesRead_ += bytesRead;
+        _stats.bytesWritten_ += bytesWritten;
+    });
+
+    _stats.wallSeconds_ = std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void SynthesisEngine::printSegmentationStats(const SegmentationStats& _stats, QTextStream& _out)
+{
+    const double megabyte = 1024.0 * 1024.0;
+
+    _out << "Segmented " << _stats.nSegmented_ << " matches in " << _stats.wallSeconds_ << " s, " << _stats.nSkipped_ << " were up to date, " << _stats.nFailed_ << " failed\n";
+
+    if (_stats.nSegmented_ + _stats.nFailed_ == 0)
+    {
+        return;
+    }
+
+    if (_stats.wallSeconds_ > 0.0)
+    {
+        _out << "Overall: " << (_stats.nSegmented_ + _stats.nFailed_) / _stats.wallSeconds_ << " matches/s\n";
+    }
+
+    if (_stats.loadSeconds_ > 0.0)
+    {
+        _out << "Load: " << _stats.loadSeconds_ << " s, " << _stats.bytesRead_ / megabyte / _stats.loadSeconds_ << " MB/s per thread\n";
+    }
+
+    if (_stats.splitSeconds_ > 0.0)
+    {
+        _out << "Split: " << _stats.splitSeconds_ << " s, " << _stats.nSegmented_ / _stats.splitSeconds_ << " matches/s per thread\n";
+    }
+
+    if (_stats.writeSeconds_ > 0.0)
+    {
+        _out << "Write: " << _stats.writeSeconds_ << " s, " << _stats.bytesWritten_ / megabyte / _stats.writeSeconds_ << " MB/s per thread\n";
+    }
+}
+
+QString SynthesisEngine::modelExtension(MODEL_FORMAT _format)
+{
+    return (_format == MODEL_FORMAT_PLY) ? ".ply" : ".off";
+}
+
+void SynthesisEngine::saveSynthesisLog(const Synthesis& _synthesis, QTextStream& _out) const
+{
+    _out << "Number of neighbors chosen: " << _synthesis.nnUsed_ << "\n";
+    _out << "Number of independent parts: " << (int)_synthesis.model_.parts().size() - nSymmetryConstraints_ << "\n";
+    _out << "Location: " << _synthesis.point_[0] << " , " << _synthesis.point_[1] << "\n";
+
+    const std::vector<Match::Part>& cParts = _synthesis.model_.parts();
+
+    std::vector<Match::Part>::const_iterator partIt(cParts.begin()), partEnd(cParts.end());
+
+    for (; partIt!=partEnd; ++partIt)
+    {
+        std::unordered_map<int, std::pair<int, double> >::const_iterator chosenIt = _synthesis.chosen_.find(partIt->partID_);
+
+        if (chosenIt == _synthesis.chosen_.end())
+        {
+            qCritical() << "CANNOT SAVE STATS FOR Part id: " << partIt->partID_ << " nearest neighbor index is invalid!!";
+            continue;
+        }
+
+        _out << "Part ID: " << partIt->partID_ << " , " << matches_[chosenIt->second.first]->filename().split("/").last() << " , " << chosenIt->second.second << "\n";
+    }
+}
@@ -0,0 +1,373 @@
+//
+//  SynthesisEngine.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef SYNTHESISENGINE_H
+#define SYNTHESISENGINE_H
+
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+
+#include <QString>
+#include <QTextStream>
+
+#include "nanoflann.h"
+
+#include "ShapeT.h"
+#include "MatchT.h"
+#include "global.h"
+#include "IncrementalPCA.h"
+
+// The synthesis pipeline without any widget state: embed a set of matches in 2D with PCA, deform the template at a point of the embedding, pick the best neighbour part for every template part, enforce the template constraints and save the resulting mesh
+// Everything that depends on the selected point lives in a Synthesis object, so the engine itself only holds the embedding of the current set of matches
+class SynthesisEngine
+{
+public:
+
+    typedef ShapeT<TriangleMesh> Shape;
+    typedef MatchT<TriangleMesh> Match;
+
+    struct Options
+    {
+        int nofNN_ = 10;
+        int calculationMode_ = CALCULATION_MODE_BOUNDING_BOX;
+        bool preserveConstraints_ = true;
+        bool recalculateBoxes_ = false; // recompute the neighbour part boxes from their meshes before scoring them
+        int forcedNeighborIndex_ = -1; // if valid, every part is taken from this match
+        int partID_ = -1; // if valid, only the part with this ID is embedded, the template then has this single part
+        bool fullDescriptorSearch_ = false; // find the nearest neighbours of the deformed template in the full descriptor space instead of the 2D embedding
+    };
+
+    struct SegmentationOptions
+    {
+        int nThreads_ = 0; // one per hardware thread if not positive
+        qint64 maxInFlightBytes_ = 512ll << 20; // meshes whose files add up to more than this are not held at the same time, a larger mesh still goes through on its own
+        bool skipUpToDate_ = true; // leave matches whose part meshes are all newer than their mesh
+    };
+
+    // Stage times are summed over the worker threads, so they can add up to more than the wall time
+    struct SegmentationStats
+    {
+        int nSegmented_ = 0;
+        int nSkipped_ = 0;
+        int nFailed_ = 0;
+        double loadSeconds_ = 0.0;
+        double splitSeconds_ = 0.0;
+        double writeSeconds_ = 0.0;
+        double wallSeconds_ = 0.0;
+        qint64 bytesRead_ = 0;
+        qint64 bytesWritten_ = 0;
+    };
+
+    // Nearest neighbours of a point ranked on their unary score, for every template part at once
+    // Row r holds the part partIDs_[r], entry (r, k) is the neighbour ranked k-th for that part, so cycling through a part's options is a lookup
+    struct PartRanking
+    {
+        std::vector<int> partIDs_;
+
+        // Part ID -> row, -1 if the template has no part with that ID
+        std::vector<int> rowOfPartID_;
+
+        // Ranks per part
+        int depth_ = 0;
+
+        // partIDs_.size() x depth_, row major. A neighbour without the part has match index -1 and the largest score
+        std::vector<int> matchIndices_;
+        std::vector<double> scores_;
+
+        // -1 if the part is not ranked
+        int row(int _partID) const;
+
+        int matchIndex(int _row, int _rank) const { return matchIndices_[_row * depth_ + _rank]; }
+
+        double score(int _row, int _rank) const { return scores_[_row * depth_ + _rank]; }
+
+        void clear();
+    };
+
+    // Everything computed for a single point of the embedding
+    struct Synthesis
+    {
+        OpenMesh::Vec2f point_;
+
+        // Deformed (and optimised if constraints are preserved) template boxes
+        Match templateMatch_;
+
+        // Template boxes carrying the deformed neighbour part meshes
+        Match model_;
+
+        std::vector<NEAREST_POINT> nearestPoints_;
+
+        // The nearest neighbours ranked for every part
+        PartRanking ranking_;
+
+        // Part ID -> (match index, unary score) of the neighbour the part was taken from
+        std::unordered_map<int, std::pair<int, double> > chosen_;
+
+        // Part ID -> position in the ranking the chosen neighbour was taken at, later than 0 if better ranked part meshes could not be loaded
+        std::unordered_map<int, int> chosenRank_;
+
+        int nnUsed_ = 0;
+    };
+
+    SynthesisEngine();
+
+    ~SynthesisEngine();
+
+    Options& options();
+
+    const Options& options() const;
+
+    // Read a .match_coll file without any widgets, see ShapeListWidget::openMatchCollection for the expected directory structure
+    static bool openMatchCollection(const QString& _fname, std::vector<Match*>& _matches, bool _loadMesh = false);
+
+    // The directory of the part meshes of a .match_coll file, <collection without extension>/MESH_PATH
+    static QString meshDirectory(const QString& _fname);
+
+    // Sort the matches on their name and give matches with the same parts the same group ID
+    static int groupMatches(std::vector<Match*>& _matches);
+
+    // Give each of _matches the group ID of the matches of _grouped with the same parts, or a new group ID after theirs, as groupMatches would have
+    static void assignGroups(const std::vector<Match*>& _grouped, const std::vector<Match*>& _matches);
+
+    static bool sameParts(const Match& _match1, const Match& _match2);
+
+    // Keep the matches of a group whose fit error is below the threshold and that have the same number of parts as the first one kept
+    static bool filterMatches(const std::vector<Match*>& _matches, int _groupID, double _errorThreshold, std::vector<Match*>& _filteredMatches);
+
+    // Number of symmetry constraints added
+    static int initConstraints(DATASET _dataset, std::vector<Match::Constraint>& _constraints);
+
+    // Matches to embed, the engine does not own them
+    void setMatches(const std::vector<Match*>& _matches);
+
+    const std::vector<Match*>& matches() const;
+
+    // Embed the matches in 2D with PCA, fills in the PCA basis and origin, the 2D descriptor of each match and the undeformed template
+    bool calculatePCA();
+
+    // Use an embedding computed elsewhere, e.g. by Matlab
+    void setEmbedding(const std::vector<double>& _origin, const std::vector< std::vector<double> >& _basis, const std::vector<double>& _avgScale, const std::vector<OpenMesh::Vec2f>& _points2D);
+
+    // Use 2D points without a deformation basis (e.g. from MDS), only the nearest neighbour queries work on such an embedding
+    void setPoints2D(const std::vector<OpenMesh::Vec2f>& _points2D);
+
+    // Add matches to the embedding without recalculating it, they are placed by projecting their descriptors on the deformation basis so the points already embedded keep their coordinates
+    // Fails if the embedding has no deformation basis, matches whose parts do not agree with the embedded ones are left out
+    bool addMatches(const std::vector<Match*>& _matches);
+
+    // PCA of the descriptors of all the embedded matches, kept up to date by addMatches while the deformation basis stays that of the last full embedding
+    const IncrementalPCA& runningPCA() const;
+
+    const std::vector<double>& pcaOrigin() const;
+
+    const std::vector< std::vector<double> >& pcaBasis() const;
+
+    const std::vector<OpenMesh::Vec2f>& points2D() const;
+
+    const OpenMesh::Vec2d& pcaMin() const;
+
+    const OpenMesh::Vec2d& pcaMax() const;
+
+    // Undeformed template, its parts are set up by calculatePCA and its constraints by initConstraints
+    Match& templateMatch();
+
+    int nSymmetryConstraints() const;
+
+    // Deform the template along the first two PCA directions, _lambda1 and _lambda2 are coordinates in the embedding
+    bool deformTemplate(double _lambda1, double _lambda2, Match& _templateMatch) const;
+
+    // Move the template boxes as little as possible so that they satisfy the template constraints
+    void optimizeTemplate(Match& _templateMatch) const;
+
+    // Indices of the _numNeighbors matches nearest to (_x, _y) in the embedding
+    // With fullDescriptorSearch_ the template is deformed to (_x, _y) and its neighbours are searched in the full descriptor space
+    std::vector<NEAREST_POINT> nearestPoints(double _x, double _y, int _numNeighbors) const;
+
+    // Indices of the _numNeighbors matches whose full descriptor (the boxes of all embedded parts) is nearest to that of the given template
+    std::vector<NEAREST_POINT> nearestPoints(const Match& _templateMatch, int _numNeighbors) const;
+
+    // Size of the full descriptor, 0 if there is no full descriptor index
+    int descriptorSize() const;
+
+    // Embeddings with fewer points than this are searched exhaustively instead of through the kd-tree
+    // KNN_BRUTE_FORCE_THRESHOLD of the config unless it has been set explicitly
+    static int bruteForceThreshold();
+
+    // A negative threshold goes back to the config, takes effect the next time the embedding is set
+    static void setBruteForceThreshold(int _threshold);
+
+    // Time the exhaustive search against the kd-tree on growing sets of random points and return the size from which the tree wins
+    // Takes a few hundred milliseconds, so it is left to shapesynth-bench rather than run when the first embedding is set
+    static int calibrateBruteForceThreshold();
+
+    // Rank the nearest neighbours on how well each of their parts fits the template part with the same ID, for all template parts in one sweep
+    // Only the best _depth neighbours are kept per part, all of them if _depth is not positive
+    void rankNeighborParts(const Match& _templateMatch, const std::vector<NEAREST_POINT>& _nearestPoints, PartRanking& _ranking, int _depth = -1) const;
+
+    static double partUnaryScore(const Match::Part& _tmPart, const Match::Part& _nmcPart);
+
+    // Copy the mesh of the neighbour's part with the same ID as the template part and deform it into the template part's box
+    // If _loadIfMissing is false the neighbour is only read, a part without a mesh is reported as a failure
+    static bool deformNearestPart(Match::Part& _tmcPart, Match& _nearestMatch, bool _loadIfMissing = true);
+
+    // Load the part meshes of all the matches (and recalculate their boxes if the options ask for it) up front
+    // Afterwards synthesize only reads the matches, so it can be called from several threads at once, each with its own Synthesis
+    void preparePartMeshes();
+
+    bool partMeshesPrepared() const;
+
+    // The part meshes of the matches were replaced or released behind the engine's back, preparePartMeshes has to run again before synthesising on several threads
+    void invalidatePartMeshes();
+
+    // Run the whole pipeline for one point of the embedding
+    bool synthesize(double _x, double _y, Synthesis& _synthesis) const;
+
+    // Write the part meshes of the synthesised model to one file as a triangle soup, the vertex indices of every part offset by the vertices of the parts before it
+    static bool saveModel(const Match& _model, const QString& _filename, MODEL_FORMAT _format = MODEL_FORMAT_OFF);
+
+    // File extension of saved models, with the dot
+    static QString modelExtension(MODEL_FORMAT _format);
+
+    // Write the chosen neighbour and score of every part, in the format of the synthesised model log
+    void saveSynthesisLog(const Synthesis& _synthesis, QTextStream& _out) const;
+
+    // Load, split and write the part meshes "<mesh>.pN.off" of every match on a pool of threads
+    // The mesh and part meshes of a match are released once they are written, the parts are read back from the new files when needed
+    static void segmentMatches(const std::vector<Match*>& _matches, const SegmentationOptions& _options, SegmentationStats& _stats);
+
+    // All part meshes of the match exist and are newer than its mesh
+    static bool partMeshesUpToDate(const Match& _match);
+
+    static void printSegmentationStats(const SegmentationStats& _stats, QTextStream& _out);
+
+private:
+
+    typedef OpenMesh::Vec2f::value_type num_t;
+
+    // nanoflann adaptor over the 2D points of the embedding
+    struct PointCloud2D
+    {
+        const std::vector<OpenMesh::Vec2f>& pts_;
+
+        PointCloud2D(const std::vector<OpenMesh::Vec2f>& _pts) : pts_(_pts) { }
+
+        inline size_t kdtree_get_point_count() const { return pts_.size(); }
+
+        inline num_t kdtree_distance(const num_t* p1, const size_t idx_p2, size_t size) const
+        {
+            const num_t d0 = p1[0] - pts_[idx_p2][0];
+            const num_t d1 = p1[1] - pts_[idx_p2][1];
+            return d0*d0 + d1*d1;
+        }
+
+        inline num_t kdtree_get_pt(const size_t idx, int dim) const { return pts_[idx][dim]; }
+
+        template <class BBOX>
+        bool kdtree_get_bbox(BBOX& bb) const { return false; }
+    };
+
+    typedef nanoflann::KDTreeSingleIndexAdaptor< nanoflann::L2_Simple_Adaptor<num_t, PointCloud2D>, PointCloud2D, 2 > KDTree2D;
+
+    // nanoflann adaptor over the full descriptors of the matches, stored row after row
+    struct DescriptorCloud
+    {
+        const std::vector<num_t>& data_;
+        const int& dim_;
+
+        DescriptorCloud(const std::vector<num_t>& _data, const int& _dim) : data_(_data), dim_(_dim) { }
+
+        inline size_t kdtree_get_point_count() const { return dim_ > 0 ? data_.size() / dim_ : 0; }
+
+        inline num_t kdtree_distance(const num_t* p1, const size_t idx_p2, size_t size) const
+        {
+            const num_t* p2 = &data_[idx_p2 * dim_];
+            num_t d = 0;
+            for (size_t i=0; i<size; ++i)
+            {
+                const num_t di = p1[i] - p2[i];
+                d += di*di;
+            }
+            return d;
+        }
+
+        inline num_t kdtree_get_pt(const size_t idx, int dim) const { return data_[idx * dim_ + dim]; }
+
+        template <class BBOX>
+        bool kdtree_get_bbox(BBOX& bb) const { return false; }
+    };
+
+    // The dimension is only known once the matches are, 6 or 3 values per embedded part
+    typedef nanoflann::KDTreeSingleIndexAdaptor< nanoflann::L2_Adaptor<num_t, DescriptorCloud>, DescriptorCloud, -1 > KDTreeFull;
+
+    // Pick the neighbour to take a part from, trying the next ranked neighbour if its part mesh cannot be loaded
+    void choosePart(Match::Part& _tmcPart, int _symmetricPartID, Synthesis& _synthesis) const;
+
+    void buildIndex();
+
+    void buildDescriptorIndex();
+
+    // Write the meshes to one file as a triangle soup, the vertex indices of every mesh offset by the vertices of the meshes before it
+    static bool writeMeshes(const std::vector<const Shape::Mesh*>& _meshes, const QString& _filename, MODEL_FORMAT _format);
+
+    // Box values of the embedded parts of a match, the descriptor the PCA works on, false if the match has a different number of embedded parts
+    bool matchDescriptor(const Match& _match, double* _descriptor, int _descriptorSize) const;
+
+    int nParamsPerPart() const;
+
+    bool embedsPart(const Match::Part& _part) const;
+
+    int nEmbeddedParts(const Match& _match) const;
+
+    // Not copyable, the kd-trees keep references to points2D_ and descriptors_
+    SynthesisEngine(const SynthesisEngine&);
+    SynthesisEngine& operator=(const SynthesisEngine&);
+
+
+    // DATA
+    Options options_;
+
+    std::vector<Match*> matches_;
+
+    std::vector<double> pcaOrigin_;
+
+    std::vector< std::vector<double> > pcaBasis_;
+
+    std::vector<double> avgMatchScale_;
+
+    std::vector<OpenMesh::Vec2f> points2D_;
+
+    OpenMesh::Vec2d pcaMin_;
+
+    OpenMesh::Vec2d pcaMax_;
+
+    Match templateMatch_;
+
+    int nSymmetryConstraints_ = 0;
+
+    PointCloud2D cloud_;
+
+    KDTree2D* index_ = 0;
+
+    // Coordinates of points2D_ in separate arrays for the exhaustive search, empty when the kd-tree is used
+    std::vector<num_t> pointsX_;
+
+    std::vector<num_t> pointsY_;
+
+    std::vector<num_t> descriptors_;
+
+    int descriptorSize_ = 0;
+
+    DescriptorCloud descriptorCloud_;
+
+    KDTreeFull* descriptorIndex_ = 0;
+
+    // Set by the exploration worker, read on the GUI thread
+    std::atomic<bool> partMeshesPrepared_{false};
+
+    IncrementalPCA runningPCA_;
+};
+
+#endif
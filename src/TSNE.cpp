@@ -0,0 +1,608 @@
+//
+//  TSNE.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <QDebug>
+
+#include "TSNE.h"
+#include "WorkStealingPool.h"
+#include "RowCloud.h"
+
+// Points handled by one task of the pool
+static const int TSNE_BLOCK_SIZE = 512;
+
+// Points closer than the cells this deep down are kept together in one leaf
+static const int TSNE_MAX_DEPTH = 48;
+
+static int nBlocks(int _n)
+{
+    return (_n + TSNE_BLOCK_SIZE - 1) / TSNE_BLOCK_SIZE;
+}
+
+// Quadtree over the layout, every cell knows how many points it holds and their centre of mass
+// Nodes are stored in the order they are created, so the children of a node always come after it
+class QuadTree
+{
+public:
+
+    void build(const std::vector<double>& _y, int _n)
+    {
+        nodes_.clear();
+        nodes_.reserve(2 * _n);
+        next_.assign(_n, -1);
+        y_ = &_y;
+
+        double minX = std::numeric_limits<double>::max(), minY = minX;
+        double maxX = -minX, maxY = -minX;
+
+        for (int i=0; i<_n; ++i)
+        {
+            minX = std::min(minX, _y[2 * i]);
+            maxX = std::max(maxX, _y[2 * i]);
+            minY = std::min(minY, _y[2 * i + 1]);
+            maxY = std::max(maxY, _y[2 * i + 1]);
+        }
+
+        const double half = 0.5 * std::max(maxX - minX, maxY - minY) * (1.0 + 1e-6) + std::numeric_limits<double>::min();
+
+        addNode(-1, 0.5 * (minX + maxX), 0.5 * (minY + maxY), half);
+
+        for (int i=0; i<_n; ++i)
+        {
+            insert(i);
+        }
+
+        for (size_t n=0; n<nodes_.size(); ++n)
+        {
+            Node& node = nodes_[n];
+
+            for (int j=node.first_; j>=0; j=next_[j])
+            {
+                node.count_++;
+                node.comX_ += _y[2 * j];
+                node.comY_ += _y[2 * j + 1];
+            }
+        }
+
+        // Children come after their parent, so walking backwards every node is complete before it is added to its parent
+        for (size_t n=nodes_.size()-1; n>0; --n)
+        {
+            const Node& node = nodes_[n];
+            Node& parent = nodes_[node.parent_];
+
+            parent.count_ += node.count_;
+            parent.comX_ += node.comX_;
+            parent.comY_ += node.comY_;
+        }
+
+        for (size_t n=0; n<nodes_.size(); ++n)
+        {
+            if (nodes_[n].count_ > 0)
+            {
+                nodes_[n].comX_ /= nodes_[n].count_;
+                nodes_[n].comY_ /= nodes_[n].count_;
+            }
+        }
+    }
+
+    // Repulsion of all the other points on point _i, sum_j q_ij^2 (y_i - y_j) with the unnormalised q_ij = 1 / (1 + |y_i - y_j|^2), and sum_j q_ij
+    void repulsion(int _i, double _theta2, double& _fx, double& _fy, double& _sumQ) const
+    {
+        const std::vector<double>& y = *y_;
+
+        const double xi = y[2 * _i];
+        const double yi = y[2 * _i + 1];
+
+        int stack[4 * (TSNE_MAX_DEPTH + 1)];
+        int top = 0;
+
+        stack[top++] = 0;
+
+        while (top > 0)
+        {
+            const Node& node = nodes_[stack[--top]];
+
+            if (node.count_ == 0)
+            {
+                continue;
+            }
+
+            if (!node.internal_)
+            {
+                // Leaves are summed point by point so that point _i does not repel itself
+                for (int j=node.first_; j>=0; j=next_[j])
+                {
+                    if (j == _i)
+                    {
+                        continue;
+                    }
+
+                    const double dx = xi - y[2 * j];
+                    const double dy = yi - y[2 * j + 1];
+                    const double q = 1.0 / (1.0 + dx * dx + dy * dy);
+
+                    _sumQ += q;
+                    _fx += q * q * dx;
+                    _fy += q * q * dy;
+                }
+
+                continue;
+            }
+
+            const double dx = xi - node.comX_;
+            const double dy = yi - node.comY_;
+            const double d2 = dx * dx + dy * dy;
+
+            // The half width of the cell, as in the reference implementation of van der Maaten, so theta means the same as there
+            if (node.half_ * node.half_ < _theta2 * d2)
+            {
+                const double q = 1.0 / (1.0 + d2);
+                const double mq = node.count_ * q;
+
+                _sumQ += mq;
+                _fx += mq * q * dx;
+                _fy += mq * q * dy;
+            }
+            else
+            {
+                for (int c=0; c<4; ++c)
+                {
+                    if (node.child_[c] >= 0)
+                    {
+                        stack[top++] = node.child_[c];
+                    }
+                }
+            }
+        }
+    }
+
+private:
+
+    struct Node
+    {
+        double cx_;
+        double cy_;
+        double half_;
+
+        int parent_;
+        int child_[4];
+
+        // Points of a leaf, chained through next_
+        int first_;
+
+        int count_;
+        double comX_;
+        double comY_;
+
+        bool internal_;
+    };
+
+    int addNode(int _parent, double _cx, double _cy, double _half)
+    {
+        Node node;
+        node.cx_ = _cx;
+        node.cy_ = _cy;
+        node.half_ = _half;
+        node.parent_ = _parent;
+        node.child_[0] = node.child_[1] = node.child_[2] = node.child_[3] = -1;
+        node.first_ = -1;
+        node.count_ = 0;
+        node.comX_ = 0.0;
+        node.comY_ = 0.0;
+        node.internal_ = false;
+
+        nodes_.push_back(node);
+
+        return nodes_.size() - 1;
+    }
+
+    // Child of node _n that point _i falls in, created if needed
+    int child(int _n, int _i)
+    {
+        const std::vector<double>& y = *y_;
+
+        const bool right = (y[2 * _i] >= nodes_[_n].cx_);
+        const bool up = (y[2 * _i + 1] >= nodes_[_n].cy_);
+        const int quadrant = (right ? 1 : 0) + (up ? 2 : 0);
+
+        if (nodes_[_n].child_[quadrant] < 0)
+        {
+            const double half = 0.5 * nodes_[_n].half_;
+
+            // addNode can move the nodes, so no reference is held over it
+            const int c = addNode(_n, nodes_[_n].cx_ + (right ? half : -half), nodes_[_n].cy_ + (up ? half : -half), half);
+
+            nodes_[_n].child_[quadrant] = c;
+        }
+
+        return nodes_[_n].child_[quadrant];
+    }
+
+    void insert(int _i)
+    {
+        int n = 0;
+
+        for (int depth=0; ; )
+        {
+            if (nodes_[n].internal_)
+            {
+                n = child(n, _i);
+                ++depth;
+                continue;
+            }
+
+            if (nodes_[n].first_ < 0 || depth >= TSNE_MAX_DEPTH)
+            {
+                next_[_i] = nodes_[n].first_;
+                nodes_[n].first_ = _i;
+                return;
+            }
+
+            // Split the leaf, its point moves down and _i carries on from the same node
+            const int old = nodes_[n].first_;
+
+            nodes_[n].first_ = -1;
+            nodes_[n].internal_ = true;
+
+            const int c = child(n, old);
+
+            nodes_[c].first_ = old;
+        }
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<int> next_;
+
+    const std::vector<double>* y_;
+};
+
+// Joint probabilities p_ij of the input points as a symmetric sparse matrix in compressed rows, they add up to 1
+// Every point only gets affinities to its nearest neighbours, with a Gaussian whose width gives them the requested perplexity
+static bool inputAffinities(const std::vector<double>& _data, int _nRows, int _nColumns, double _perplexity, WorkStealingPool& _pool, std::vector<int>& _rowStart, std::vector<int>& _columns, std::vector<double>& _p)
+{
+    const int k = std::min(_nRows - 1, (int)(3.0 * _perplexity));
+
+    const double targetEntropy = std::log(std::min(_perplexity, (double)k));
+
+    RowCloud cloud(_data, _nColumns);
+
+    RowTree tree(_nColumns, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(10 /* max leaf */));
+    tree.buildIndex();
+
+    // Conditional probabilities p_j|i of the k nearest other points of every point, sorted by neighbour
+    std::vector<int> neighbours((size_t)_nRows * k);
+    std::vector<double> conditional((size_t)_nRows * k);
+
+    _pool.run(nBlocks(_nRows), [&](int _block, int _worker)
+    {
+        std::vector<size_t> index(k + 1);
+        std::vector<double> distance(k + 1);
+        std::vector< std::pair<int, double> > row(k);
+
+        const int end = std::min(_nRows, (_block + 1) * TSNE_BLOCK_SIZE);
+
+        for (int i=_block * TSNE_BLOCK_SIZE; i<end; ++i)
+        {
+            nanoflann::KNNResultSet<double> resultSet(k + 1);
+            resultSet.init(&index[0], &distance[0]);
+
+            tree.findNeighbors(resultSet, &_data[(size_t)i * _nColumns], nanoflann::SearchParams(10));
+
+            // Duplicates of the point can come before it
+            for (int n=0, m=0; n<=k && m<k; ++n)
+            {
+                if (index[n] == (size_t)i)
+                {
+                    continue;
+                }
+
+                row[m].first = index[n];
+                row[m].second = distance[n];
+                ++m;
+            }
+
+            // Distances are taken from the nearest one, the exponentials then cannot all underflow
+            const double nearest = row[0].second;
+
+            double beta = 1.0;
+            double lower = 0.0, upper = std::numeric_limits<double>::max();
+
+            double* p = &conditional[(size_t)i * k];
+
+            // Bisection on the precision of the Gaussian, the entropy of the row decreases as beta grows
+            for (int iteration=0; iteration<200; ++iteration)
+            {
+                double sum = 0.0, weightedDistance = 0.0;
+
+                for (int n=0; n<k; ++n)
+                {
+                    p[n] = std::exp(-beta * (row[n].second - nearest));
+                    sum += p[n];
+                    weightedDistance += p[n] * (row[n].second - nearest);
+                }
+
+                const double entropy = std::log(sum) + beta * weightedDistance / sum;
+
+                for (int n=0; n<k; ++n)
+                {
+                    p[n] /= sum;
+                }
+
+                if (std::fabs(entropy - targetEntropy) < 1e-5)
+                {
+                    break;
+                }
+
+                if (entropy > targetEntropy)
+                {
+                    lower = beta;
+                    beta = (upper == std::numeric_limits<double>::max()) ? 2.0 * beta : 0.5 * (beta + upper);
+                }
+                else
+                {
+                    upper = beta;
+                    beta = 0.5 * (beta + lower);
+                }
+            }
+
+            for (int n=0; n<k; ++n)
+            {
+                row[n].second = p[n];
+            }
+
+            std::sort(row.begin(), row.end());
+
+            for (int n=0; n<k; ++n)
+            {
+                neighbours[(size_t)i * k + n] = row[n].first;
+                p[n] = row[n].second;
+            }
+        }
+    });
+
+    // The transpose of the conditional probabilities, its rows come out sorted as the rows are walked in order
+    std::vector<int> transposeStart(_nRows + 1, 0);
+
+    for (size_t e=0; e<neighbours.size(); ++e)
+    {
+        transposeStart[neighbours[e] + 1]++;
+    }
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        transposeStart[i + 1] += transposeStart[i];
+    }
+
+    std::vector<int> transposeColumns(neighbours.size());
+    std::vector<double> transposeP(neighbours.size());
+    std::vector<int> fill(transposeStart.begin(), transposeStart.end() - 1);
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        for (int n=0; n<k; ++n)
+        {
+            const int j = neighbours[(size_t)i * k + n];
+
+            transposeColumns[fill[j]] = i;
+            transposeP[fill[j]] = conditional[(size_t)i * k + n];
+            fill[j]++;
+        }
+    }
+
+    // p_ij = (p_j|i + p_i|j) / 2n, merging every row with the same row of the transpose
+    _rowStart.assign(_nRows + 1, 0);
+    _columns.clear();
+    _p.clear();
+    _columns.reserve(2 * neighbours.size());
+    _p.reserve(2 * neighbours.size());
+
+    const double normalisation = 0.5 / _nRows;
+
+    for (int i=0; i<_nRows; ++i)
+    {
+        int a = 0;
+        int b = transposeStart[i];
+
+        const int* row = &neighbours[(size_t)i * k];
+        const double* p = &conditional[(size_t)i * k];
+
+        while (a < k || b < transposeStart[i + 1])
+        {
+            const int ja = (a < k) ? row[a] : _nRows;
+            const int jb = (b < transposeStart[i + 1]) ? transposeColumns[b] : _nRows;
+
+            double value = 0.0;
+
+            if (ja <= jb)
+            {
+                value += p[a++];
+            }
+
+            if (jb <= ja)
+            {
+                value += transposeP[b++];
+            }
+
+            _columns.push_back(std::min(ja, jb));
+            _p.push_back(normalisation * value);
+        }
+
+        _rowStart[i + 1] = _columns.size();
+    }
+
+    return true;
+}
+
+// Centre the layout and give it unit average squared distance from the centre, the same for both axes so that its shape is kept
+static void normaliseLayout(const std::vector<double>& _y, int _n, std::vector<double>& _layout)
+{
+    double meanX = 0.0, meanY = 0.0;
+
+    for (int i=0; i<_n; ++i)
+    {
+        meanX += _y[2 * i];
+        meanY += _y[2 * i + 1];
+    }
+
+    meanX /= _n;
+    meanY /= _n;
+
+    double spread = 0.0;
+
+    for (int i=0; i<_n; ++i)
+    {
+        spread += (_y[2 * i] - meanX) * (_y[2 * i] - meanX) + (_y[2 * i + 1] - meanY) * (_y[2 * i + 1] - meanY);
+    }
+
+    const double scale = (spread > 0.0) ? 1.0 / std::sqrt(spread / _n) : 0.0;
+
+    _layout.resize(2 * _n);
+
+    for (int i=0; i<_n; ++i)
+    {
+        _layout[2 * i] = scale * (_y[2 * i] - meanX);
+        _layout[2 * i + 1] = scale * (_y[2 * i + 1] - meanY);
+    }
+}
+
+bool computeTSNE(const std::vector<double>& _data, int _nRows, int _nColumns, std::vector<double>& _embedding, const TSNEOptions& _options)
+{
+    if (_nRows <= 2 || _nColumns <= 0 || !(_options.perplexity_ > 0.0) || _data.size() != (size_t)_nRows * _nColumns)
+    {
+        qCritical() << "Cannot compute a t-SNE embedding of " << _nRows << " x " << _nColumns << " values with perplexity " << _options.perplexity_;
+        return false;
+    }
+
+    WorkStealingPool pool(_options.nThreads_);
+
+    // Perplexities above a third of the other points would need more neighbours than there are
+    const double perplexity = std::min(_options.perplexity_, (_nRows - 1) / 3.0);
+
+    std::vector<int> rowStart, columns;
+    std::vector<double> p;
+
+    if (!inputAffinities(_data, _nRows, _nColumns, std::max(perplexity, 1.0), pool, rowStart, columns, p))
+    {
+        return false;
+    }
+
+    const int n = _nRows;
+
+    const double learningRate = (_options.learningRate_ > 0.0) ? _options.learningRate_ : std::max(n / std::max(_options.exaggeration_, 1.0), 200.0);
+    const double theta2 = _options.theta_ * _options.theta_;
+
+    std::mt19937_64 generator(_options.seed_);
+    std::normal_distribution<double> normal(0.0, 1e-4);
+
+    std::vector<double> y(2 * n);
+
+    for (int i=0; i<2*n; ++i)
+    {
+        y[i] = normal(generator);
+    }
+
+    std::vector<double> attraction(2 * n), repulsion(2 * n);
+    std::vector<double> update(2 * n, 0.0), gains(2 * n, 1.0);
+    std::vector<double> blockSumQ(nBlocks(n));
+    std::vector<double> layout;
+
+    QuadTree tree;
+
+    int iteration = 0;
+
+    for ( ; iteration<_options.nIterations_; ++iteration)
+    {
+        const bool early = (iteration < _options.exaggerationIterations_);
+
+        const double exaggeration = early ? _options.exaggeration_ : 1.0;
+        const double momentum = early ? 0.5 : 0.8;
+
+        tree.build(y, n);
+
+        // Both halves of the gradient of every point only read the layout, so the points are independent
+        pool.run(nBlocks(n), [&](int _block, int _worker)
+        {
+            const int end = std::min(n, (_block + 1) * TSNE_BLOCK_SIZE);
+
+            double sumQ = 0.0;
+
+            for (int i=_block * TSNE_BLOCK_SIZE; i<end; ++i)
+            {
+                double fx = 0.0, fy = 0.0;
+
+                for (int e=rowStart[i]; e<rowStart[i + 1]; ++e)
+                {
+                    const int j = columns[e];
+
+                    const double dx = y[2 * i] - y[2 * j];
+                    const double dy = y[2 * i + 1] - y[2 * j + 1];
+                    const double pq = p[e] / (1.0 + dx * dx + dy * dy);
+
+                    fx += pq * dx;
+                    fy += pq * dy;
+                }
+
+                attraction[2 * i] = exaggeration * fx;
+                attraction[2 * i + 1] = exaggeration * fy;
+
+                fx = fy = 0.0;
+
+                tree.repulsion(i, theta2, fx, fy, sumQ);
+
+                repulsion[2 * i] = fx;
+                repulsion[2 * i + 1] = fy;
+            }
+
+            blockSumQ[_block] = sumQ;
+        });
+
+        // Summed in block order so that the result does not depend on the scheduling
+        double sumQ = 0.0;
+
+        for (size_t b=0; b<blockSumQ.size(); ++b)
+        {
+            sumQ += blockSumQ[b];
+        }
+
+        const double invSumQ = (sumQ > 0.0) ? 1.0 / sumQ : 0.0;
+
+        // Gradient step with the per coordinate gains of Jacobs' delta-bar-delta rule
+        pool.run(nBlocks(2 * n), [&](int _block, int _worker)
+        {
+            const int end = std::min(2 * n, (_block + 1) * TSNE_BLOCK_SIZE);
+
+            for (int c=_block * TSNE_BLOCK_SIZE; c<end; ++c)
+            {
+                const double gradient = attraction[c] - repulsion[c] * invSumQ;
+
+                gains[c] = ((gradient > 0.0) != (update[c] > 0.0)) ? gains[c] + 0.2 : std::max(gains[c] * 0.8, 0.01);
+
+                update[c] = momentum * update[c] - learningRate * gains[c] * gradient;
+                y[c] += update[c];
+            }
+        });
+
+        if (_options.progress_ && _options.progressInterval_ > 0 && (iteration + 1) % _options.progressInterval_ == 0 && iteration + 1 < _options.nIterations_)
+        {
+            normaliseLayout(y, n, layout);
+
+            if (!_options.progress_(iteration + 1, layout))
+            {
+                ++iteration;
+                break;
+            }
+        }
+    }
+
+    normaliseLayout(y, n, _embedding);
+
+    qDebug() << "t-SNE of " << n << " points with " << columns.size() << " input affinities done after " << iteration << " iterations" ;
+
+    return true;
+}
@@ -0,0 +1,47 @@
+//
+//  TSNE.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef TSNE_H
+#define TSNE_H
+
+#include <vector>
+#include <functional>
+
+// Called with the iteration and the current layout, scaled as the final one is, returning false stops the optimisation early
+// It runs on the thread that called computeTSNE
+typedef std::function<bool(int, const std::vector<double>&)> TSNEProgress;
+
+struct TSNEOptions
+{
+    // Effective number of neighbours of every point, the input affinities only look at the 3 * perplexity nearest ones
+    double perplexity_ = 30.0;
+
+    // Barnes-Hut accuracy, a quadtree cell is taken as a single point when its half width over its distance is below theta, 0 is exact
+    double theta_ = 0.5;
+
+    int nIterations_ = 1000;
+
+    // The attractions are multiplied by exaggeration_ for the first exaggerationIterations_, so that the clusters form before they spread out
+    int exaggerationIterations_ = 250;
+    double exaggeration_ = 12.0;
+
+    // 0 picks max(n / exaggeration_, 200), which scales to large sets where the usual 200 converges far too slowly
+    double learningRate_ = 0.0;
+
+    unsigned long long seed_ = 1;
+
+    // 0 means one per hardware thread
+    int nThreads_ = 0;
+
+    // Iterations between calls of progress_
+    int progressInterval_ = 25;
+    TSNEProgress progress_;
+};
+
+// Barnes-Hut t-SNE of the rows of the _nRows x _nColumns row major _data into the plane, O(n log n) per iteration
+// _embedding is _nRows x 2 row major, centred and with unit average squared distance from the centre
+bool computeTSNE(const std::vector<double>& _data, int _nRows, int _nColumns, std::vector<double>& _embedding, const TSNEOptions& _options = TSNEOptions());
+
+#endif
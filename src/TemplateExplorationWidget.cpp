@@ -4,11 +4,29 @@
 // Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
 
 
+#include <cmath>
+#include <algorithm>
+
+#include <QtConcurrentRun>
+#include <QApplication>
+#include <QEventLoop>
+
 #include "TemplateExplorationWidget.h"
+#include "Trace.h"
+#include "AsyncLog.h"
 
 
 using namespace nanoflann;
 
+// Hover previews are updated at most this often, about once per display refresh
+static const int HOVER_REFRESH_MSEC = 16;
+
+// The hovered point is snapped to a grid of this many cells along each axis of the embedding
+static const int HOVER_GRID_RESOLUTION = 256;
+
+// Number of deformed templates kept for the hover previews
+static const int HOVER_CACHE_SIZE = 64;
+
 // This is the "dataset to kd-tree" adaptor class:
 // It takes any dataset of
 template <typename Derived>
@@ -59,52 +77,6 @@ struct VectorMeshPointAdaptor
 }; // end of VectorMeshPointAdaptor
 
 
-template <typename Derived>
-struct VectorMatchDescriptor2DAdaptor
-{
-	typedef typename OpenMesh::Vec2f::value_type coord_t;
-    
-	const Derived &obj; //!< A const ref to the data set origin
-    
-	/// The constructor that sets the data set source
-	VectorMatchDescriptor2DAdaptor(const Derived &obj_) : obj(obj_) { }
-    
-	/// CRTP helper method
-	inline const Derived& derived() const { return obj; }
-    
-	// Must return the number of data points
-	inline size_t kdtree_get_point_count() const { return derived().size(); }
-    
-	// Returns the distance between the vector "p1[0:size-1]" and the data point with index "idx_p2" stored in the class:
-	inline coord_t kdtree_distance(const coord_t *p1, const size_t idx_p2,size_t size) const
-	{
-		const typename OpenMesh::Vec2f& pnt = derived().at(idx_p2)->descriptor2D();
-        
-		const coord_t d0=p1[0]-pnt[0];
-		const coord_t d1=p1[1]-pnt[1];
-		return d0*d0+d1*d1;
-	}
-    
-	// Returns the dim'th component of the idx'th point in the class:
-	// Since this is inlined and the "dim" argument is typically an immediate value, the
-	//  "if/else's" are actually solved at compile time.
-	inline coord_t kdtree_get_pt(const size_t idx, int dim) const
-	{
-		const typename OpenMesh::Vec2f& pnt = derived().at(idx)->descriptor2D();
-        
-		if (dim==0) return pnt[0];
-		else return pnt[1];
-	}
-    
-	// Optional bounding-box computation: return false to default to a standard bbox computation loop.
-	//   Return true if the BBOX was already computed by the class and returned in "bb" so it can be avoided to redo it again.
-	//   Look at bb.size() to find out the expected dimensionality (e.g. 2 or 3 for point clouds)
-	template <class BBOX>
-	bool kdtree_get_bbox(BBOX &bb) const { return false; }
-    
-}; // end of VectorMatchDescriptor2DAdaptor
-
-
 TemplateExplorationWidget::TemplateExplorationWidget(QWidget* pParent)
 {
 	//setFixedWidth(180);
@@ -548,6 +520,11 @@ TemplateExplorationWidget::TemplateExplorationWidget(QWidget* pParent)
 
     exploScenarioLayout->addWidget(chkColorOverride_);
     
+    chkFullDescriptorNN_ = new QCheckBox("Full descriptor NN");
+    chkFullDescriptorNN_->setToolTip("Find the nearest neighbours of the deformed template in the full box space instead of the 2D embedding");
+    
+    exploScenarioLayout->addWidget(chkFullDescriptorNN_);
+    
     lnEdtForceNeighbor_ = new QLineEdit(" ");
     lnEdtForceNeighbor_->setVisible(false);
     exploScenarioLayout->addWidget(lnEdtForceNeighbor_);
@@ -610,6 +587,7 @@ TemplateExplorationWidget::TemplateExplorationWidget(QWidget* pParent)
     QObject::connect(btnChangeSelectedPoint_, SIGNAL(clicked()), this, SLOT(slotManuallyChangeSelectedPoint()));
     
     QObject::connect(chkConstraints_, SIGNAL(toggled(bool)), this, SLOT(slotToggleConstraints()));
+    QObject::connect(chkFullDescriptorNN_, SIGNAL(toggled(bool)), this, SLOT(slotToggleFullDescriptorNN(bool)));
     
     QObject::connect(chkColorOverride_, SIGNAL(toggled(bool)), this, SLOT(slotToggleSingleColor()));
     
@@ -640,48 +618,42 @@ TemplateExplorationWidget::TemplateExplorationWidget(QWidget* pParent)
     
     deformedNearestMatches_ = new Match[nofNN_];
     
-    switch (LOADED_DATASET)
-    {
-        case CHAIRS:
-        {
-            initChairConstraints();
-        }
-            break;
-        case BIKES:
-        {
-            initBikeConstraints();
-        }
-            break;
-        case HELICOPTERS:
-        {
-            initHelicopterConstraints();
-        }
-            break;
-        case PLANES:
-        {
-            initPlaneConstraints();
-        }
-            break;
-        case SID_PLANES:
-        {
-            initPlaneSidConstraints();
-        }
-            break;
-        default:
-        {
-            
-        }
-            break;
-    }
+    nSymmetryConstraints_ = SynthesisEngine::initConstraints(LOADED_DATASET, templateMatch_.constraints());
 
     preserveConstraints_ = true;
     
+    explorationWatcher_ = new QFutureWatcher< std::shared_ptr<ExplorationJob> >(this);
+    
+    QObject::connect(explorationWatcher_, SIGNAL(finished()), this, SLOT(slotExplorationDataReady()));
+    
+    hoverTimer_ = new QTimer(this);
+    hoverTimer_->setSingleShot(true);
+    hoverTimer_->setInterval(HOVER_REFRESH_MSEC);
+    
+    QObject::connect(hoverTimer_, SIGNAL(timeout()), this, SLOT(slotUpdateHoverPreview()));
+    
+    hoverWatcher_ = new QFutureWatcher< std::shared_ptr<HoverJob> >(this);
+    
+    QObject::connect(hoverWatcher_, SIGNAL(finished()), this, SLOT(slotHoverTemplateReady()));
+    
+    // The t-SNE worker emits it from its own thread
+    QObject::connect(this, SIGNAL(tsneLayoutChanged()), this, SLOT(slotShowTSNEProgress()), Qt::QueuedConnection);
+    
+    hoverCache_.setCapacity(HOVER_CACHE_SIZE);
+    
+    syncEngineOptions();
+    
     slotSetFitErrorThreshold(QString("%1").arg(FIT_ERROR));
     selectedFitErrorThreshold_ = FIT_ERROR;
 }
 
 TemplateExplorationWidget::~TemplateExplorationWidget()
 {
+    // The workers read the engine and the matches, so they must be done before they go
+    waitForExplorationData();
+    
+    invalidateHoverCache();
+    
     if (nearestPoints_)
     {
         delete [] nearestPoints_;
@@ -883,11 +855,11 @@ void TemplateExplorationWidget::slotSaveMatchDescriptorsToFile()
     
     QTextStream out(&file);
 
-    std::vector< std::vector<double> >::iterator pcaBasisIt(pcaBasis_.begin()), pcaBasisEnd(pcaBasis_.end());
+    std::vector< std::vector<double> >::const_iterator pcaBasisIt(engine_.pcaBasis().begin()), pcaBasisEnd(engine_.pcaBasis().end());
     for (; pcaBasisIt!= pcaBasisEnd; ++pcaBasisIt)
     {
-        std::vector<double>& cBasis = *pcaBasisIt;
-        std::vector<double>::iterator cBasisIt(cBasis.begin()), cBasisEnd(cBasis.end());
+        const std::vector<double>& cBasis = *pcaBasisIt;
+        std::vector<double>::const_iterator cBasisIt(cBasis.begin()), cBasisEnd(cBasis.end());
         
         for (; cBasisIt!=cBasisEnd; ++cBasisIt)
         {
@@ -896,7 +868,7 @@ void TemplateExplorationWidget::slotSaveMatchDescriptorsToFile()
         out << "\n";
     }
     
-    std::vector<double>::iterator pcaOriginIt(pcaOrigin_.begin()), pcaOriginEnd(pcaOrigin_.end());
+    std::vector<double>::const_iterator pcaOriginIt(engine_.pcaOrigin().begin()), pcaOriginEnd(engine_.pcaOrigin().end());
     
     for (; pcaOriginIt!= pcaOriginEnd; ++pcaOriginIt)
     {
@@ -955,6 +927,21 @@ void TemplateExplorationWidget::slotChangeNearestNeighbourLevel(int _level)
 
 void TemplateExplorationWidget::slotAddMatches(const std::vector<Match*>& _matches)
 {
+    if (tsneRunning_)
+    {
+        tsneDeferredMatches_.insert(tsneDeferredMatches_.end(), _matches.begin(), _matches.end());
+        return;
+    }
+    
+    // Matches that arrive while an embedding is shown join it, otherwise (e.g. the collection loaded at startup) the groups are shown again
+    bool embeddingShown = (explorationMode_ != SHOW_GROUPS && !filteredMatches_.empty() && !engine_.points2D().empty());
+    
+    // The group IDs in the files may not be those of the current grouping, so new matches that join an embedding are grouped like the rest
+    if (embeddingShown)
+    {
+        SynthesisEngine::assignGroups(matches_, _matches);
+    }
+    
     int mSizeBefore = matches_.size();
     int nmSize = _matches.size();
     matches_.insert( matches_.end(), _matches.begin(), _matches.end() );
@@ -970,8 +957,13 @@ void TemplateExplorationWidget::slotAddMatches(const std::vector<Match*>& _match
     // For the new matches that have been added, add an entry mapping their name to their index in the match_ vector
     for( int i = mSizeBefore; i < mSizeAfter ; i++)
     {
-        QString matchName = matches_[i]->filename().split("/").last().split(".").first();
-        matchNameToMatchIndex_[matchName.toStdString()] = i;
+        matchNameToMatchIndex_[matches_[i]->shortName().toStdString()] = i;
+    }
+    
+    if (embeddingShown)
+    {
+        addMatchesToEmbedding(_matches);
+        return;
     }
     
     TIMELOG->append(QString("%1 : collection_loaded").arg((qlonglong)QDateTime::currentMSecsSinceEpoch()));
@@ -980,72 +972,104 @@ void TemplateExplorationWidget::slotAddMatches(const std::vector<Match*>& _match
     updateClusterView();
 }
 
-void TemplateExplorationWidget::slotGroupMatches()
-{
-    groupMatches();
-}
-
-void TemplateExplorationWidget::groupMatches()
+void TemplateExplorationWidget::addMatchesToEmbedding(const std::vector<Match*>& _matches)
 {
-    //First sort the matches according to their name so we always get the same group IDs
-    std::sort(matches_.begin(),matches_.end(),CompareMatchesFunctor);
-
-    typedef std::vector< std::pair<int, int> > PartIDsTypes;
-
-    std::map< PartIDsTypes, int > groups;
-
-    std::vector<Match*>::iterator itMatch(matches_.begin()), matchesEnd(matches_.end());
-
-    int i = 0;
+    int numParts = filteredMatches_[0]->nparts();
     
-    for (; itMatch != matchesEnd; ++itMatch)
-	{
-        PartIDsTypes cGroup;
-
-        const std::vector<Match::Part>& mParts = (**itMatch).parts();
-        
-        std::vector<Match::Part>::const_iterator itPart(mParts.begin()), partsEnd(mParts.end());
-        
-        for ( ; itPart != partsEnd; ++itPart)
-        {
-            cGroup.push_back(std::pair<int, int>(itPart->partID_, itPart->partType_) );
-        }
-
-        if( groups.count(cGroup) != 1 ) //findGroup == groupsEnd)
+    std::vector<Match*> accepted;
+    
+    std::vector<Match*>::const_iterator itMatch(_matches.begin()), matchesEnd(_matches.end());
+    
+    for ( ; itMatch != matchesEnd; ++itMatch)
+    {
+        // As in filterMatches, without a part ID all the matches embedded together have the same number of parts
+        if (matchPassesFilter(**itMatch, selectedTemplateID_, selectedGroupID_, selectedPartID_, selectedFitErrorThreshold_) && (selectedPartID_ >= 0 || (**itMatch).nparts() == numParts))
         {
-            groups[cGroup] = i++;
+            accepted.push_back(*itMatch);
         }
-
-        (**itMatch).setGroupID( groups[cGroup] );
-
     }
-
-    qDebug() << "There were " << i << " different groups discovered" ;
-
-    std::map< PartIDsTypes, int >::iterator itGroups, groupsEnd(groups.end());
-
-    for (itGroups= groups.begin(); itGroups!=groupsEnd; ++itGroups)
+    
+    if (accepted.empty())
+    {
+        qDebug() << "None of the " << _matches.size() << " new matches belong to the shown embedding" ;
+        return;
+    }
+    
+    waitForExplorationData();
+    
+    invalidateHoverCache();
+    
+    int numBefore = engine_.matches().size();
+    
+    if (!engine_.addMatches(accepted))
+    {
+        qWarning() << "Recalculate the embedding to see the new matches in it" ;
+        return;
+    }
+    
+    const std::vector<Match*>& embedded = engine_.matches();
+    
+    int numNew = embedded.size() - numBefore;
+    
+    for (int i=numBefore; i<embedded.size(); ++i)
     {
-        QString msg;
+        Match& nMatch = *embedded[i];
         
-        msg += "Group ID: ";
-        msg += QString("%1").arg(itGroups->second);
-        msg += "   ";
+        const OpenMesh::Vec2f& pos = nMatch.descriptor2D();
         
-        const PartIDsTypes& cGroup = itGroups->first;
+        // A new match joins the cluster of the nearest match that was already embedded, enough neighbours are asked for to get past the other new ones
+        std::vector<NEAREST_POINT> nearest = engine_.nearestPoints(pos[0], pos[1], std::min<int>(numNew + 1, embedded.size()));
         
-        PartIDsTypes::const_iterator itPartIDsTypes(cGroup.begin()), cIDsTypesEnd(cGroup.end());
-
-        for ( ; itPartIDsTypes!=cIDsTypesEnd; ++itPartIDsTypes)
+        int lbl = -1;
+        
+        for (int n=0; n<nearest.size(); ++n)
+        {
+            if (nearest[n].index_ >= 0 && nearest[n].index_ < numBefore)
+            {
+                lbl = embedded[nearest[n].index_]->label();
+                break;
+            }
+        }
+        
+        nMatch.setLabel(lbl);
+        
+        if (lbl >= 0 && lbl < clusterPopulation_.size())
         {
-            msg += QString("%1").arg(itPartIDsTypes->first);
-            msg += "->";
-            msg += QString("%1").arg(itPartIDsTypes->second);
-            msg += " ";
+            clusterPopulation_[lbl]++;
         }
-       qDebug() << msg;
+        
+        pcaMin_.minimize(OpenMesh::Vec2d(pos[0], pos[1]));
+        pcaMax_.maximize(OpenMesh::Vec2d(pos[0], pos[1]));
+        
+        filteredMatches_.push_back(&nMatch);
+    }
+    
+    qDebug() << "Placed " << numNew << " new matches in the embedding for template ID:" << selectedTemplateID_ << " group ID:" << selectedGroupID_ << " part ID: " << selectedPartID_ ;
+    
+    setPlotPoints();
+    
+    if (CREATE_QWTPLOTW)
+    {
+        emit plotPointsChanged();
     }
+}
+
+void TemplateExplorationWidget::slotGroupMatches()
+{
+    groupMatches();
+}
 
+void TemplateExplorationWidget::groupMatches()
+{
+    SynthesisEngine::groupMatches(matches_);
+    
+    // Sorting moved the matches around, so the name to index lookup has to follow
+    matchNameToMatchIndex_.clear();
+    
+    for (int m=0; m<matches_.size(); ++m)
+    {
+        matchNameToMatchIndex_[matches_[m]->shortName().toStdString()] = m;
+    }
 }
 
 void TemplateExplorationWidget::readNormalizationFile(const QString& _filename)
@@ -1080,7 +1104,7 @@ void TemplateExplorationWidget::readNormalizationFile(const QString& _filename)
         
         if(matchNameToMatchIndex_.count(name.toStdString())!=1)
         {
-            qWarning() << "Ignoring match name: " << name << " because it was not found in the collection!" ;
+            LOG_WARNING() << "Ignoring match name: " << name << " because it was not found in the collection!" ;
             continue;
         }
         Match& cMatch = *matches_[ matchNameToMatchIndex_[name.toStdString()] ];
@@ -1089,7 +1113,7 @@ void TemplateExplorationWidget::readNormalizationFile(const QString& _filename)
        
         cMatch.setMeshAvgRadius( lineList.at(4).toDouble() );
 
-        qDebug() << "Match name: " << name << " was mapped to match index: " << matchNameToMatchIndex_[name.toStdString()] ;
+        LOG_DEBUG() << "Match name: " << name << " was mapped to match index: " << matchNameToMatchIndex_[name.toStdString()] ;
 
         count++;
     }
@@ -1128,34 +1152,12 @@ bool TemplateExplorationWidget::filterMatches(int _templateID, int _groupID, int
     //Go through the matches to find the number of matches that fit the template/group/part/error filter
     for ( ; itMatch != matchesEnd; ++itMatch)
 	{
-        if( (_templateID >= 0 && (**itMatch).templateID() != _templateID) || (_groupID >= 0 && (**itMatch).groupID() != _groupID) || (**itMatch).fitError() > _errorThreshold || (_labelID >= 0 && (**itMatch).label() != _labelID))
+        if( !matchPassesFilter(**itMatch, _templateID, _groupID, _partID, _errorThreshold) || (_labelID >= 0 && (**itMatch).label() != _labelID))
         {
             continue;
         }
 
-        if(_partID >= 0)
-        {
-            bool ignore = true;
-
-            const std::vector<Match::Part>& mParts = (**itMatch).parts();
-            
-            std::vector<Match::Part>::const_iterator itPart(mParts.begin()), partsEnd(mParts.end());
-            
-            for ( ; itPart != partsEnd; ++itPart)
-            {
-                if (_partID == itPart->partID_ && itPart->partType_ != 0)
-                {
-                    ignore = false;
-                    break;
-                }
-            }
-            
-            if(ignore)
-            {
-                continue;
-            }
-        }
-        else
+        if(_partID < 0)
         {
             // First time we find a valid match with the template ID and group ID we are looking for, so store its number of parts so we can then assume all other matches with
             // the same template ID and group ID will have the same number of parts
@@ -1185,6 +1187,33 @@ bool TemplateExplorationWidget::filterMatches(int _templateID, int _groupID, int
     return true;
 }
 
+bool TemplateExplorationWidget::matchPassesFilter(const Match& _match, int _templateID, int _groupID, int _partID, double _errorThreshold) const
+{
+    if( (_templateID >= 0 && _match.templateID() != _templateID) || (_groupID >= 0 && _match.groupID() != _groupID) || _match.fitError() > _errorThreshold)
+    {
+        return false;
+    }
+
+    if(_partID < 0)
+    {
+        return true;
+    }
+
+    const std::vector<Match::Part>& mParts = _match.parts();
+    
+    std::vector<Match::Part>::const_iterator itPart(mParts.begin()), partsEnd(mParts.end());
+    
+    for ( ; itPart != partsEnd; ++itPart)
+    {
+        if (_partID == itPart->partID_ && itPart->partType_ != 0)
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
 void TemplateExplorationWidget::slotCalculateMDS()
 {
     if( !filterMatches(selectedTemplateID_,selectedGroupID_,selectedPartID_,selectedFitErrorThreshold_,selectedLabelID_) )
@@ -1231,6 +1260,10 @@ void TemplateExplorationWidget::slotCalculatePCA()
 
 bool TemplateExplorationWidget::calculateMDS()
 {
+    waitForExplorationData();
+    
+    invalidateHoverCache();
+    
     std::vector<Match*>::iterator itMatch(filteredMatches_.begin()), fMatchesEnd(filteredMatches_.end());
 
     int numMatches = filteredMatches_.size();
@@ -1243,78 +1276,62 @@ bool TemplateExplorationWidget::calculateMDS()
     // Can safely assume there are matches to embed and their descriptors are all of the same dimensions
     int numParameters = filteredMatches_[0]->descriptor().size();
     
-    // Create in and out variables vectors
-    std::vector<Matlab::MatlabVariable> ins;
-    ins.push_back(Matlab::MatlabVariable());
+    ComputeMatrix descriptors;
     
-    ins[0].nRows_ = numMatches; //numMatches_;
-    ins[0].nColumns_ = numParameters; //numParameters_;
-    ins[0].name_ = "descriptors";
-    ins[0].data_ = new double[ins[0].nRows_ * ins[0].nColumns_];
-    
-    std::vector<Matlab::MatlabVariable> outs;
-    outs.push_back(Matlab::MatlabVariable());
+    descriptors.nRows_ = numMatches;
+    descriptors.nColumns_ = numParameters;
+    descriptors.name_ = "descriptors";
+    descriptors.data_.resize((size_t)numMatches * numParameters);
     
-    outs[0].nRows_ = 0;
-    outs[0].nColumns_ = 0;
-    outs[0].name_ = "projected_descriptors";
-    outs[0].data_ = 0;
-    
-    unsigned int i = 0;
-    unsigned int j = 0;
+    int i = 0;
 
-    //Fill the ins[0].data_ array with data
+    //Fill the descriptors column by column, as the backend stores them
     for ( ; itMatch != fMatchesEnd; ++itMatch)
 	{
-        j=0;
-        
-        const std::vector<Match::Part>& mParts = (**itMatch).parts();
-        
-        std::vector<Match::Part>::const_iterator itPart(mParts.begin()), partsEnd(mParts.end());
-        
         const std::vector<float>& cDesc = (**itMatch).descriptor();
         
-        std::vector<float>::const_iterator descIt(cDesc.begin()), descEnd(cDesc.end());
+        if (cDesc.size() != numParameters)
+        {
+            qCritical() << "Match " << (**itMatch).shortName() << " has " << cDesc.size() << " descriptor values instead of " << numParameters << ", cannot calculate MDS!";
+            return false;
+        }
         
-        for (; descIt!=descEnd; ++descIt)
+        for (int j=0; j<numParameters; ++j)
         {
-            ins[0].data_[i + j*ins[0].nRows_] = *descIt;
-            j++;
+            descriptors.data_[i + (size_t)j * numMatches] = cDesc[j];
         }
         
         i++;
     }
     
-    qDebug() << "Passing " << numMatches << " matches (rows) with " << numParameters << " parameters (columns) each to Matlab!" ;
-
-    std::string code("diss = pdist(descriptors); [pr_desc,eigvalues] = cmdscale(diss); projected_descriptors = pr_desc(:,1:2);");
+    ComputeMatrix projected;
+    projected.name_ = "projected_descriptors";
     
-    Matlab::runCode(ins, outs, code);
-
-    qDebug() << "Matlab part is done-returning to C++!" ;
-
-    if(outs[0].nRows_ != numMatches || outs[0].nColumns_ != 2)
+    qDebug() << "MDS of " << numMatches << " matches with the " << computeBackend().name() << " backend" ;
+    
+    if (!computeBackend().putMatrix(descriptors) || !computeBackend().runRoutine("mds") || !computeBackend().getMatrix(projected))
     {
-        qCritical() << "Something is wrong! Projected descriptors and deformation basis number of rows and columns do not match the expected!" ;
+        qCritical() << "Could not calculate MDS!" ;
         return false;
     }
-        
-    i = 0;
-
-    itMatch = filteredMatches_.begin();
     
-    //For all matches belonging to the template selected, copy the projected_descriptor values
-    for ( ; itMatch != fMatchesEnd; ++itMatch)
-	{
-        OpenMesh::Vec2f prDes(0.0,0.0);
-        
-        prDes[0] = outs[0].data_[i];                   // First column
-        prDes[1] = outs[0].data_[i + outs[0].nRows_];  // Second column
-        
-        (**itMatch).setDescriptor2D(prDes);
-        
-        i++;
+    if (projected.nRows_ != numMatches || projected.nColumns_ < 2)
+    {
+        qCritical() << "MDS returned " << projected.nRows_ << " x " << projected.nColumns_ << " projected descriptors for " << numMatches << " matches!" ;
+        return false;
+    }
+    
+    std::vector<OpenMesh::Vec2f> points2D(numMatches);
+    
+    for (i=0; i<numMatches; ++i)
+    {
+        points2D[i][0] = projected.data_[i];
+        points2D[i][1] = projected.data_[i + numMatches];
     }
+    
+    // MDS has no deformation basis, the engine only gets the points for the nearest neighbour queries
+    engine_.setMatches(filteredMatches_);
+    engine_.setPoints2D(points2D);
 
     qDebug() << "Done with MDS for template ID:" << selectedTemplateID_ << " group ID:" << selectedGroupID_ << " part ID: " << selectedPartID_ << " error threshold: " << selectedFitErrorThreshold_ ;
 
@@ -1322,85 +1339,319 @@ bool TemplateExplorationWidget::calculateMDS()
 
 }
 
-bool TemplateExplorationWidget::calculatePCA()
+ComputeBackend& TemplateExplorationWidget::computeBackend()
 {
-    std::vector<Match*>::iterator itMatch(filteredMatches_.begin()), fMatchesEnd(filteredMatches_.end());
-    
-    int numMatches = filteredMatches_.size();
-    
-    if (numMatches==0)
+    if (!computeBackend_)
     {
-        qCritical() << "No matches to calculate embedding!";
-        return false;
+        computeBackend_.reset(createComputeBackend(COMPUTE_BACKEND));
     }
     
-    // Kind of a hack to reset the number of neighbours if the cluster gets too small, hope it doesn't crash
-    if (numMatches < nofNN_)
+    return *computeBackend_;
+}
+
+// Backend matrices are stored column after column, the native embeddings want the matches row after row
+static void rowMajorDescriptors(const ComputeMatrix& _descriptors, std::vector<double>& _rows)
+{
+    _rows.resize((size_t)_descriptors.nRows_ * _descriptors.nColumns_);
+    
+    for (int i=0; i<_descriptors.nRows_; ++i)
     {
-        nofNN_ = numMatches;
-        lnEdtNofNN_->blockSignals(true);
-        lnEdtNofNN_->setText(QString("%1").arg(nofNN_));
-        lnEdtNofNN_->blockSignals(false);
+        for (int j=0; j<_descriptors.nColumns_; ++j)
+        {
+            double value = _descriptors.data_[i + j*_descriptors.nRows_];
+            
+            // As the PCA code does in Matlab
+            _rows[(size_t)i * _descriptors.nColumns_ + j] = std::isfinite(value) ? value : 0.0;
+        }
     }
+}
+
+// Add a native 2D embedding and its deformation basis to _ins as if princomp had produced them, so the backend only clusters them
+static void addEmbeddingInputs(std::vector<ComputeMatrix>& _ins, const std::vector<double>& _embedding, const std::vector< std::vector<double> >& _basis, int _numMatches, int _numParameters)
+{
+    _ins.push_back(ComputeMatrix());
     
-    // Can safely assume there are matches to embed and their descriptors are all of the same dimensions
-    int numParameters = filteredMatches_[0]->descriptor().size();
+    ComputeMatrix& projected = _ins.back();
     
-    std::vector<Matlab::MatlabVariable> ins;
-    ins.push_back(Matlab::MatlabVariable());
+    projected.nRows_ = _numMatches;
+    projected.nColumns_ = 2;
+    projected.name_ = "projected_descriptors";
+    projected.data_.resize((size_t)projected.nRows_ * projected.nColumns_);
     
-    ins[0].nRows_ = numMatches;
-    ins[0].nColumns_ = numParameters;
-    ins[0].name_ = "descriptors";
-    ins[0].data_ = new double[ins[0].nRows_ * ins[0].nColumns_];
+    for (int i=0; i<_numMatches; ++i)
+    {
+        projected.data_[i] = _embedding[2 * i];
+        projected.data_[i + _numMatches] = _embedding[2 * i + 1];
+    }
+    
+    _ins.push_back(ComputeMatrix());
+    
+    ComputeMatrix& deformationBasis = _ins.back();
+    
+    deformationBasis.nRows_ = _numParameters;
+    deformationBasis.nColumns_ = 2;
+    deformationBasis.name_ = "deformation_basis";
+    deformationBasis.data_.resize((size_t)deformationBasis.nRows_ * deformationBasis.nColumns_);
+    
+    for (int j=0; j<_numParameters; ++j)
+    {
+        deformationBasis.data_[j] = _basis[0][j];
+        deformationBasis.data_[j + _numParameters] = _basis[1][j];
+    }
+}
+
+bool TemplateExplorationWidget::calculateSpectralEmbedding(std::vector<ComputeMatrix>& _ins, int _numMatches, int _numParameters)
+{
+    std::vector<double> descriptors;
+    
+    rowMajorDescriptors(_ins[0], descriptors);
+    
+    std::vector<double> embedding;
+    std::vector<double> origin;
+    std::vector< std::vector<double> > basis;
+    
+    if (!computeSpectralEmbedding(descriptors, _numMatches, _numParameters, embedding) || !embeddingBasis(descriptors, _numMatches, _numParameters, embedding, 2, origin, basis))
+    {
+        qCritical() << "Cannot calculate the spectral embedding!";
+        return false;
+    }
+    
+    addEmbeddingInputs(_ins, embedding, basis, _numMatches, _numParameters);
+    
+    return true;
+}
+
+bool TemplateExplorationWidget::calculatePrincipalComponents(std::vector<ComputeMatrix>& _ins, int _numMatches, int _numParameters)
+{
+    _ins.resize(3);
     
-    std::vector<Matlab::MatlabVariable> outs;
-    outs.push_back(Matlab::MatlabVariable());
+    _ins[1].name_ = "projected_descriptors";
+    _ins[2].name_ = "deformation_basis";
     
-    outs[0].nRows_ = 0;
-    outs[0].nColumns_ = 0;
-    outs[0].name_ = "projected_descriptors";
-    outs[0].data_ = 0;
+    qDebug() << "PCA of " << _numMatches << " matches with " << _numParameters << " parameters with the " << computeBackend().name() << " backend" ;
     
-    outs.push_back(Matlab::MatlabVariable());
+    if (!computeBackend().putMatrix(_ins[0]) || !computeBackend().runRoutine("pca") || !computeBackend().getMatrix(_ins[1]) || !computeBackend().getMatrix(_ins[2]))
+    {
+        qCritical() << "Cannot calculate the principal components!";
+        return false;
+    }
     
-    outs[1].nRows_ = 0;
-    outs[1].nColumns_ = 0;
-    outs[1].name_ = "deformation_basis";
-    outs[1].data_ = 0;
+    return true;
+}
+
+bool TemplateExplorationWidget::runTSNE(const std::vector<double>* _descriptors, int _numMatches, int _numParameters, std::vector<double>* _embedding)
+{
+    TSNEOptions options;
+    options.perplexity_ = TSNE_PERPLEXITY;
+    options.nIterations_ = TSNE_ITERATIONS;
     
-    outs.push_back(Matlab::MatlabVariable());
+    options.progress_ = [this](int _iteration, const std::vector<double>& _layout)
+    {
+        {
+            QMutexLocker locker(&tsneMutex_);
+            tsneLayout_ = _layout;
+            tsneIteration_ = _iteration;
+        }
+        
+        // Queued to the GUI thread, several layouts in a row only cost one plot update
+        emit tsneLayoutChanged();
+        
+        return !tsneCancelled_.load();
+    };
     
-    outs[2].nRows_ = 0;
-    outs[2].nColumns_ = 0;
-    outs[2].name_ = "clustCent";
-    outs[2].data_ = 0;
+    return computeTSNE(*_descriptors, _numMatches, _numParameters, *_embedding, options);
+}
 
-    outs.push_back(Matlab::MatlabVariable());
+bool TemplateExplorationWidget::calculateTSNEEmbedding(std::vector<ComputeMatrix>& _ins, int _numMatches, int _numParameters)
+{
+    std::vector<double> descriptors;
     
-    outs[3].nRows_ = 0;
-    outs[3].nColumns_ = 0;
-    outs[3].name_ = "nofClusters";
-    outs[3].data_ = 0;
+    rowMajorDescriptors(_ins[0], descriptors);
     
-    outs.push_back(Matlab::MatlabVariable());
+    // The progress overwrites the layout and the labels, they are put back if the run does not finish
+    std::vector<OpenMesh::Vec2f> previousLayout(filteredMatches_.size());
+    std::vector<int> previousLabels(filteredMatches_.size());
     
-    outs[4].nRows_ = 0;
-    outs[4].nColumns_ = 0;
-    outs[4].name_ = "point2cluster";
-    outs[4].data_ = 0;
+    // The previous clusters mean nothing for the new layout, it is drawn in one colour until it is clustered
+    for (size_t i=0; i<filteredMatches_.size(); ++i)
+    {
+        previousLayout[i] = filteredMatches_[i]->descriptor2D();
+        previousLabels[i] = filteredMatches_[i]->label();
+        
+        filteredMatches_[i]->setLabel(0);
+    }
     
+    std::vector<double> embedding;
     
-	// TODO: Temp: Compute distance in 3D space
-    //std::vector< std::vector<double> > matchDescriptors;
+    QFutureWatcher<bool> watcher;
+    QEventLoop loop;
+    
+    QObject::connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+    
+    QProgressDialog progress(tr("Calculating the t-SNE embedding..."), tr("Cancel"), 0, TSNE_ITERATIONS, this);
+    progress.setWindowModality(Qt::ApplicationModal);
+    progress.setMinimumDuration(0);
+    progress.setAutoClose(false);
+    progress.setAutoReset(false);
+    
+    QObject::connect(&progress, SIGNAL(canceled()), this, SLOT(slotCancelTSNE()));
+    
+    tsneRunning_ = true;
+    tsneCancelled_ = false;
+    tsneProgress_ = &progress;
+    
+    progress.setValue(0);
+    
+    watcher.setFuture(QtConcurrent::run(this, &TemplateExplorationWidget::runTSNE, &descriptors, _numMatches, _numParameters, &embedding));
+    
+    // Keep drawing while the worker runs, filteredMatches_ and the engine must not change under it
+    // The dialog holds back user input, and the folder watch and the hover slots wait for tsneRunning_ to clear
+    loop.exec();
+    
+    tsneProgress_ = 0;
+    tsneRunning_ = false;
     
-    pcaOrigin_.clear();
-    pcaBasis_.clear();
+    if (!tsneDeferredMatches_.empty())
+    {
+        QTimer::singleShot(0, this, SLOT(slotAddDeferredMatches()));
+    }
+    
+    std::vector<double> origin;
+    std::vector< std::vector<double> > basis;
+    
+    if (tsneCancelled_)
+    {
+        qWarning() << "The t-SNE embedding was cancelled";
+    }
+    else if (!watcher.result() || !embeddingBasis(descriptors, _numMatches, _numParameters, embedding, 2, origin, basis))
+    {
+        qCritical() << "Cannot calculate the t-SNE embedding!";
+    }
+    else
+    {
+        addEmbeddingInputs(_ins, embedding, basis, _numMatches, _numParameters);
+        
+        return true;
+    }
+    
+    // The engine still holds the previous embedding, the plot has to agree with it
+    for (size_t i=0; i<filteredMatches_.size(); ++i)
+    {
+        filteredMatches_[i]->setDescriptor2D(previousLayout[i]);
+        filteredMatches_[i]->setLabel(previousLabels[i]);
+    }
+    
+    setPlotPoints();
+    
+    if (CREATE_QWTPLOTW)
+    {
+        emit plotPointsChanged();
+    }
+    
+    return false;
+}
+
+void TemplateExplorationWidget::slotShowTSNEProgress()
+{
+    std::vector<double> layout;
+    int iteration = 0;
+    
+    {
+        QMutexLocker locker(&tsneMutex_);
+        layout.swap(tsneLayout_);
+        iteration = tsneIteration_;
+    }
+    
+    // Already shown, or left over from a t-SNE that has finished since
+    if (!tsneRunning_ || layout.size() != 2 * filteredMatches_.size())
+    {
+        return;
+    }
+    
+    if (tsneProgress_)
+    {
+        tsneProgress_->setValue(iteration);
+    }
+    
+    for (size_t i=0; i<filteredMatches_.size(); ++i)
+    {
+        filteredMatches_[i]->setDescriptor2D(OpenMesh::Vec2f(layout[2 * i], layout[2 * i + 1]));
+    }
+    
+    setPlotPoints();
+    
+    if (CREATE_QWTPLOTW)
+    {
+        emit plotPointsChanged();
+    }
+}
+
+void TemplateExplorationWidget::slotCancelTSNE()
+{
+    tsneCancelled_ = true;
+}
 
-	avgMatchScale_.clear();
+void TemplateExplorationWidget::slotAddDeferredMatches()
+{
+    std::vector<Match*> deferred;
+    
+    deferred.swap(tsneDeferredMatches_);
+    
+    if (!deferred.empty())
+    {
+        slotAddMatches(deferred);
+    }
+}
 
-    templateMatch_.parts().clear();
-    templateMatch_.setNparts(0);
+bool TemplateExplorationWidget::calculatePCA()
+{
+    TRACE_SPAN("TemplateExplorationWidget::calculatePCA");
+    
+    waitForExplorationData();
+    
+    invalidateHoverCache();
+    
+    std::vector<Match*>::iterator itMatch(filteredMatches_.begin()), fMatchesEnd(filteredMatches_.end());
+    
+    int numMatches = filteredMatches_.size();
+    
+    if (numMatches==0)
+    {
+        qCritical() << "No matches to calculate embedding!";
+        return false;
+    }
+    
+    // Kind of a hack to reset the number of neighbours if the cluster gets too small, hope it doesn't crash
+    if (numMatches < nofNN_)
+    {
+        nofNN_ = numMatches;
+        lnEdtNofNN_->blockSignals(true);
+        lnEdtNofNN_->setText(QString("%1").arg(nofNN_));
+        lnEdtNofNN_->blockSignals(false);
+    }
+    
+    // Can safely assume there are matches to embed and their descriptors are all of the same dimensions
+    int numParameters = filteredMatches_[0]->descriptor().size();
+    
+    std::vector<ComputeMatrix> ins(1);
+    
+    ins[0].nRows_ = numMatches;
+    ins[0].nColumns_ = numParameters;
+    ins[0].name_ = "descriptors";
+    ins[0].data_.resize((size_t)ins[0].nRows_ * ins[0].nColumns_);
+    
+    std::vector<ComputeMatrix> outs(3);
+    
+    outs[0].name_ = "clustCent";
+    outs[1].name_ = "nofClusters";
+    outs[2].name_ = "point2cluster";
+    
+    
+	// TODO: Temp: Compute distance in 3D space
+    //std::vector< std::vector<double> > matchDescriptors;
+    
+    std::vector<double> pcaOrigin(numParameters, 0.0);
+    std::vector<double> avgMatchScale(numParameters, 0.0);
     
     representativeIndex_.clear();
     clusterPopulation_.clear();
@@ -1408,12 +1659,6 @@ bool TemplateExplorationWidget::calculatePCA()
     selectedPoint_[0] = -std::numeric_limits<float>::max();
     selectedPoint_[1] = -std::numeric_limits<float>::max();
     
-    for (int i=0; i<numParameters; i++)
-    {
-        pcaOrigin_.push_back(0.0f);
-		avgMatchScale_.push_back(0.0f);
-    }
-
     unsigned int i = 0;
     unsigned int j = 0;
 
@@ -1435,20 +1680,6 @@ bool TemplateExplorationWidget::calculatePCA()
                 continue;
             }
             
-            // Hack just to initialise the part IDs of the parts of the templateMatch (copy the IDs of the first match)
-            if(i==0)
-            {
-                Match::Part cPart;
-                cPart.partID_ = itPart->partID_;
-                cPart.partType_ = itPart->partType_;
-                cPart.pos_ = OpenMesh::Vec3d(0,0,0);
-                cPart.scale_ = OpenMesh::Vec3d(0,0,0);
-                cPart.partShape_.setID(cPart.partID_);
-                
-                templateMatch_.parts().push_back(cPart);
-                // Will fill out the pos and scale for every part later after we find the average values for the pos and scale
-            }
-            
             switch (calculationMode_)
 			{
 				case CALCULATION_MODE_BOUNDING_BOX:
@@ -1460,40 +1691,40 @@ bool TemplateExplorationWidget::calculatePCA()
 						max = itPart->pos_ + itPart->scale_;
 
                         ins[0].data_[i + j*ins[0].nRows_] = min[0]; // 1st-7th-13th etc column
-                        pcaOrigin_[j] += min[0];
+                        pcaOrigin[j] += min[0];
 						j++;
 						ins[0].data_[i + j*ins[0].nRows_] = min[1]; // 2nd-8th-14th etc column
-                        pcaOrigin_[j] += min[1];
+                        pcaOrigin[j] += min[1];
 						j++;
 						ins[0].data_[i + j*ins[0].nRows_] = min[2];
-                        pcaOrigin_[j] += min[2];
+                        pcaOrigin[j] += min[2];
 						j++;
 						ins[0].data_[i + j*ins[0].nRows_] = max[0];
-                        pcaOrigin_[j] += max[0];
+                        pcaOrigin[j] += max[0];
 						j++;
 						ins[0].data_[i + j*ins[0].nRows_] = max[1];
-                        pcaOrigin_[j] += max[1];
+                        pcaOrigin[j] += max[1];
 						j++;
 						ins[0].data_[i + j*ins[0].nRows_] = max[2];
-                        pcaOrigin_[j] += max[2];
+                        pcaOrigin[j] += max[2];
 						j++;
 					}
 					break;
 				case CALCULATION_MODE_POSITION:
 					{
 						ins[0].data_[i + j*ins[0].nRows_] = itPart->pos_[0];
-						pcaOrigin_[j] += itPart->pos_[0];
-						avgMatchScale_[j] += itPart->scale_[0];
+						pcaOrigin[j] += itPart->pos_[0];
+						avgMatchScale[j] += itPart->scale_[0];
 						j++;
                         
 						ins[0].data_[i + j*ins[0].nRows_] = itPart->pos_[1];
-						pcaOrigin_[j] += itPart->pos_[1];
-						avgMatchScale_[j] += itPart->scale_[1];
+						pcaOrigin[j] += itPart->pos_[1];
+						avgMatchScale[j] += itPart->scale_[1];
 						j++;
                         
 						ins[0].data_[i + j*ins[0].nRows_] = itPart->pos_[2];
-						pcaOrigin_[j] += itPart->pos_[2];
-						avgMatchScale_[j] += itPart->scale_[2];
+						pcaOrigin[j] += itPart->pos_[2];
+						avgMatchScale[j] += itPart->scale_[2];
 						j++;
 					}
 					break;
@@ -1502,46 +1733,59 @@ bool TemplateExplorationWidget::calculatePCA()
         i++;
     }
 
-    qDebug() << "Passing " << numMatches << " matches (rows) with " << numParameters << " parameters (columns) each to Matlab!" ;
-
-    std::string code("addpath('");
+    // PCA runs on the backend, the other embeddings are computed here as if princomp had produced them
+    if(EMBEDDING_MODE == PCA)
+    {
+        if (!calculatePrincipalComponents(ins, numMatches, numParameters))
+        {
+            return false;
+        }
+    }
+    else if(EMBEDDING_MODE == FAST_SPECTRAL)
+    {
+        if (!calculateSpectralEmbedding(ins, numMatches, numParameters))
+        {
+            return false;
+        }
+    }
+    else if(EMBEDDING_MODE == TSNE)
+    {
+        if (!calculateTSNEEmbedding(ins, numMatches, numParameters))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        qCritical() << "Unknown embedding mode " << EMBEDDING_MODE ;
+        return false;
+    }
     
-    code +=MATLAB_FILE_PATH;
-    code += "');";
+    // The basis stays here, only the embedding is sent to be clustered
+    const ComputeMatrix& projected = ins[1];
+    const ComputeMatrix& basis = ins[2];
     
-    if(EMBEDDING_MODE == PCA)
+    qDebug() << "Clustering " << numMatches << " matches with the " << computeBackend().name() << " backend" ;
+    
+    if (!computeBackend().putMatrix(projected) || !computeBackend().runRoutine("cluster") || !computeBackend().getMatrix(outs[0]) || !computeBackend().getMatrix(outs[1]) || !computeBackend().getMatrix(outs[2]))
     {
-        code += "descriptors(find(isinf(descriptors) == 1)) = 0; \
-                 descriptors(find(isnan(descriptors) == 1)) = 0; \
-                 [coefs,pr_desc] = princomp(descriptors); \
-                 deformation_basis = coefs(:,1:2); \
-                 projected_descriptors = pr_desc(:,1:2); \
-                 fraction = 0.05; \
-                 bandwidth = .25*compute_spread(projected_descriptors, fraction);  \
-                 [clustCent,point2cluster,clustMembsCell] = MeanShiftCluster(projected_descriptors',bandwidth); \
-                 point2cluster = point2cluster'; \
-                 clustCent = clustCent'; \
-                 nofClusters = size(clustCent,1); \
-                 [clustCent, point2cluster] = sortClusters(clustCent,point2cluster,nofClusters); ";
-    }
-
-    Matlab::runCode(ins, outs, code);
-   
-    qDebug() << "Matlab part is done-returning to C++!" ;
+        qCritical() << "Could not cluster the embedding!" ;
+        return false;
+    }
 
-    if(outs[0].nRows_!=numMatches || outs[0].nColumns_!=2 || outs[1].nRows_ != numParameters || outs[1].nColumns_ != 2)
+    if(projected.nRows_!=numMatches || projected.nColumns_!=2 || basis.nRows_ != numParameters || basis.nColumns_ != 2)
     {
         qCritical() << "Something is wrong! Projected descriptors and deformation basis number of rows and columns do not match the expected!" ;
         return false;
     }
-    //outs[3] holds the number of clusters so should be a 1x1 array
-    if (outs[3].nColumns_!=1 || outs[3].nRows_!=1 || outs[2].nRows_ != outs[3].data_[0] || outs[2].nColumns_!=2 || outs[4].nRows_!= numMatches || outs[4].nColumns_!=1)
+    //outs[1] holds the number of clusters so should be a 1x1 array
+    if (outs[1].nColumns_!=1 || outs[1].nRows_!=1 || outs[0].nRows_ != outs[1].data_[0] || outs[0].nColumns_!=2 || outs[2].nRows_!= numMatches || outs[2].nColumns_!=1)
     {
         qCritical() << "Number of clusters is not a 1x1 array or number of cluster centroids do not match the number of clusters!" ;
         return false;
     }
     
-    int numClusters = outs[3].data_[0];
+    int numClusters = outs[1].data_[0];
     currentNumClusters_ = numClusters;
     
     if (numClusters<=0)
@@ -1560,70 +1804,24 @@ bool TemplateExplorationWidget::calculatePCA()
     // Copy the cluster centroids
     for (int n=0; n<numClusters; n++)
     {
-        clusterCentroids[n][0] = outs[2].data_[n];                   // First column
-        clusterCentroids[n][1] = outs[2].data_[n + outs[2].nRows_];  // Second column
+        clusterCentroids[n][0] = outs[0].data_[n];                   // First column
+        clusterCentroids[n][1] = outs[0].data_[n + outs[0].nRows_];  // Second column
     }
     
-    // outs[1].data_ holds first two eigenvectors from the PCA
-    std::vector<double> basis_1;
-    std::vector<double> basis_2;
+    // basis.data_ holds first two eigenvectors from the PCA
+    std::vector< std::vector<double> > pcaBasis(2);
     
     // Copy the deformation basis values so we can use them to deform the template later
     for (int j=0; j<numParameters; j++)
     {
-        basis_1.push_back(outs[1].data_[j]);
-        basis_2.push_back(outs[1].data_[j+outs[1].nRows_]);
+        pcaBasis[0].push_back(basis.data_[j]);
+        pcaBasis[1].push_back(basis.data_[j+basis.nRows_]);
 
         // PCA origin is the average of all the selected matches
-        pcaOrigin_[j] /= (double)numMatches;
+        pcaOrigin[j] /= (double)numMatches;
 
-		avgMatchScale_[j] /= (double)numMatches;
+		avgMatchScale[j] /= (double)numMatches;
     }
-    
-    pcaBasis_.push_back(basis_1);
-    pcaBasis_.push_back(basis_2);
-
-    // Fill the template match parts with values
-    templateMatch_.setNparts( templateMatch_.parts().size() );
-
-	switch (calculationMode_)
-	{
-		case CALCULATION_MODE_BOUNDING_BOX:
-			{
-                for (int j=0; j<templateMatch_.nparts(); j++)
-				{
-                    Match::Part& cPart = templateMatch_.parts().at(j);
-                    
-					OpenMesh::Vec3f min(pcaOrigin_[j*NUM_PARAMS_BOX],
-                                        pcaOrigin_[j*NUM_PARAMS_BOX+1],
-                                        pcaOrigin_[j*NUM_PARAMS_BOX+2]);
-                    
-					OpenMesh::Vec3f max(pcaOrigin_[j*NUM_PARAMS_BOX+3],
-                                        pcaOrigin_[j*NUM_PARAMS_BOX+4],
-                                        pcaOrigin_[j*NUM_PARAMS_BOX+5]);
-
-					cPart.scale_ = (max - min) / 2.0f;
-					cPart.pos_ = min + cPart.scale_;
-				}
-			}
-			break;
-		case CALCULATION_MODE_POSITION:
-			{
-				for (int j=0; j<templateMatch_.nparts(); j++)
-				{
-					Match::Part& cPart = templateMatch_.parts().at(j);
-
-					cPart.scale_[0] = avgMatchScale_[j * NUM_PARAMS_POS];
-					cPart.scale_[1] = avgMatchScale_[j * NUM_PARAMS_POS + 1];
-					cPart.scale_[2] = avgMatchScale_[j * NUM_PARAMS_POS + 2];
-
-					cPart.pos_[0] = pcaOrigin_[j * NUM_PARAMS_POS];
-					cPart.pos_[1] = pcaOrigin_[j * NUM_PARAMS_POS + 1];
-					cPart.pos_[2] = pcaOrigin_[j * NUM_PARAMS_POS + 2];
-				}
-			}
-			break;
-	}
 
     pcaMin_ = OpenMesh::Vec2d(std::numeric_limits<double>::max(),std::numeric_limits<double>::max());
 
@@ -1645,12 +1843,12 @@ bool TemplateExplorationWidget::calculatePCA()
     //For all matches belonging to the template selected, copy the projected_descriptor values
     for ( ; itMatch != fMatchesEnd; ++itMatch)
 	{
-        int lbl = outs[4].data_[i]-1;
+        int lbl = outs[2].data_[i]-1;
         
         OpenMesh::Vec2f prDes(0.0,0.0);
         
-        prDes[0] = outs[0].data_[i];                   // First column
-        prDes[1] = outs[0].data_[i + outs[0].nRows_];  // Second column
+        prDes[0] = projected.data_[i];                   // First column
+        prDes[1] = projected.data_[i + projected.nRows_];  // Second column
         
         (**itMatch).setLabel(lbl);
         
@@ -1723,7 +1921,7 @@ bool TemplateExplorationWidget::calculatePCA()
     {
         clusterCentroidsVerify[n] /= clusterPopulation_[n];
         
-        qDebug() << "Cluster " << n << " centroid from Matlab was " << clusterCentroids[n][0] << ", " << clusterCentroids[n][1] << " from C++ it was" << clusterCentroidsVerify[n][0] << ", " << clusterCentroidsVerify[n][1];
+        qDebug() << "Cluster " << n << " centroid from the backend was " << clusterCentroids[n][0] << ", " << clusterCentroids[n][1] << " from C++ it was" << clusterCentroidsVerify[n][0] << ", " << clusterCentroidsVerify[n][1];
         
         qDebug() << "Cluster " << n << " population is " << clusterPopulation_[n];
         
@@ -1861,7 +2059,7 @@ bool TemplateExplorationWidget::calculatePCA()
         {
             clusterCentroidsVerify[n] /= clusterPopulation_[n];
             
-            qDebug() << "Cluster " << n << " centroid from Matlab was " << clusterCentroids[n][0] << ", " << clusterCentroids[n][1] << " from C++ it was" << clusterCentroidsVerify[n][0] << ", " << clusterCentroidsVerify[n][1];
+            qDebug() << "Cluster " << n << " centroid from the backend was " << clusterCentroids[n][0] << ", " << clusterCentroids[n][1] << " from C++ it was" << clusterCentroidsVerify[n][0] << ", " << clusterCentroidsVerify[n][1];
             
             qDebug() << "Cluster " << n << " population is " << clusterPopulation_[n];
         }
@@ -1870,6 +2068,24 @@ bool TemplateExplorationWidget::calculatePCA()
     }
     
     std::cout << "PCA min: " << pcaMin_ << " PCA max: " << pcaMax_ << std::endl;
+    
+    // Hand the embedding of the matches that survived the cluster deletion to the engine, it sets up the template parts from the first match
+    std::vector<OpenMesh::Vec2f> points2D;
+    
+    for (itMatch = filteredMatches_.begin(); itMatch != filteredMatches_.end(); ++itMatch)
+    {
+        points2D.push_back((**itMatch).descriptor2D());
+    }
+    
+    engine_.options().partID_ = selectedPartID_;
+    
+    syncEngineOptions();
+    
+    engine_.setMatches(filteredMatches_);
+    engine_.setEmbedding(pcaOrigin, pcaBasis, avgMatchScale, points2D);
+    
+    templateMatch_.setParts(engine_.templateMatch().parts());
+    templateMatch_.setNparts(templateMatch_.parts().size());
 
     return true;
 }
@@ -1935,95 +2151,10 @@ void TemplateExplorationWidget::slotDeformTemplate(double _lambda1, double _lamb
 {
     qDebug() << "Deform template: " << _lambda1 << ", " << _lambda2;
     
-	int nParamsPerPart = 0;
-
-	switch (calculationMode_)
-	{
-		case CALCULATION_MODE_BOUNDING_BOX:
-        {
-            nParamsPerPart = NUM_PARAMS_BOX;
-        }
-			break;
-		case CALCULATION_MODE_POSITION:
-        {
-            nParamsPerPart = NUM_PARAMS_POS;
-        }
-			break;
-	}
-
-    if(pcaBasis_.size() != 2 || pcaBasis_.at(0).size() != pcaBasis_.at(1).size() || pcaBasis_.at(0).size() != pcaOrigin_.size() || pcaBasis_.at(0).size() != templateMatch_.parts().size()*nParamsPerPart)
-    {
-        qCritical() << "PCA basis size does not agree with PCA origin or template match number of parameters" ;
-        return;
-    }
-
-    std::vector<double> deformed_origin;
-
-    int descriptorSize = pcaOrigin_.size();
-
-    for (int i=0; i < descriptorSize; i++)
-    {
-        double def_i = pcaOrigin_.at(i) + _lambda1 * pcaBasis_.at(0).at(i) + _lambda2 * pcaBasis_.at(1).at(i); // pcaBasis[0][i] is the coordinate of the first eigenvector
-
-        deformed_origin.push_back(def_i);
-    }
-
-    double coord_x = 0.0;
-    double coord_y = 0.0;
-
-    // Find the projection of the deformed template descriptor on the 2D PCA space
-    for (int i =0; i < descriptorSize; i++)
-    {
-        coord_x += (deformed_origin.at(i) - pcaOrigin_.at(i) ) * pcaBasis_.at(0).at(i);
-        coord_y += (deformed_origin.at(i) - pcaOrigin_.at(i) ) * pcaBasis_.at(1).at(i);
-    }
-
-    // Store them in templateMatch
-    templateMatch_.setDescriptor2D(OpenMesh::Vec2f(coord_x,coord_y));
+    syncEngineOptions();
     
-    switch (calculationMode_)
-	{
-		case CALCULATION_MODE_BOUNDING_BOX:
-			{
-				for (int i=0; i<templateMatch_.nparts(); i++)
-				{
-                    Match::Part& cPart = templateMatch_.parts().at(i);
-                    
-					OpenMesh::Vec3f min(deformed_origin.at(i*nParamsPerPart),
-                                        deformed_origin.at(i*nParamsPerPart+1),
-                                        deformed_origin.at(i*nParamsPerPart+2));
-					
-                    OpenMesh::Vec3f max(deformed_origin.at(i*nParamsPerPart+3),
-                                        deformed_origin.at(i*nParamsPerPart+4),
-                                        deformed_origin.at(i*nParamsPerPart+5));
-
-					cPart.scale_ = (max - min) / 2.0f;
-					cPart.pos_ = min + cPart.scale_;
-				}
-			}
-			break;
-		case CALCULATION_MODE_POSITION:
-			{
-				for (int i=0; i<templateMatch_.nparts(); i++)
-				{
-                    Match::Part& cPart = templateMatch_.parts().at(i);
-
-					cPart.scale_[0] = avgMatchScale_[i * nParamsPerPart];
-					cPart.scale_[1] = avgMatchScale_[i * nParamsPerPart + 1];
-					cPart.scale_[2] = avgMatchScale_[i * nParamsPerPart + 2];
-
-					cPart.pos_[0] = deformed_origin[i * nParamsPerPart];
-					cPart.pos_[1] = deformed_origin[i * nParamsPerPart + 1];
-					cPart.pos_[2] = deformed_origin[i * nParamsPerPart + 2];
-				}
-			}
-			break;
-	}
-
-    if (preserveConstraints_)
-    {
-        slotOptimizeTemplate();
-    }
+    // The engine checks the PCA basis against the template and optimises the template if the constraints are preserved
+    engine_.deformTemplate(_lambda1, _lambda2, templateMatch_);
 }
 
 void TemplateExplorationWidget::slotChangeSelectedMatch(int _newIndex)
@@ -2294,75 +2425,20 @@ void TemplateExplorationWidget::slotChangeCalculationMode(int _calculationMode)
 			}
 			break;
 	}
+    
+    syncEngineOptions();
 }
 
-int TemplateExplorationWidget::getNearestPoint(int _level, double x, double y)
+void TemplateExplorationWidget::slotDeformKNearestMatches(double posx, double posy)
 {
-	double minDistance = std::numeric_limits<double>::max();
-	double threshold = 0.0;
-	int index = 0;
-	int nearestIndex = -1;
 
+    slotDeformTemplate(posx, posy);
 
-	if (_level > 0)
+    // Deform nearest neighbours according to the deformed template
+	for (int i = 0; i < nofNN_; ++i)
 	{
-		threshold = nearestPoints_[_level - 1].distance_;
-	}
-
-    std::vector<Match*>::iterator itMatch(filteredMatches_.begin()), fMatchesEnd(filteredMatches_.end());
-    
-	for (; itMatch != fMatchesEnd; ++itMatch)
-	{
-        const OpenMesh::Vec2f& pos = (**itMatch).descriptor2D();
-        
-		double cx = x - pos[0];
-		double cy = y - pos[1];
-		double distance = cx * cx + cy * cy;
-
-		if (_level == 0)
-		{
-			if (distance < minDistance)
-			{
-				minDistance = distance;
-				nearestPoints_[_level].index_ = index;
-				nearestPoints_[_level].distance_ = distance;
-			}
-		}
-		else if (_level > 0)
-		{
-			bool isSkip = false;
-			for (int i = 0; i < _level; ++i)
-			{
-				if (index == nearestPoints_[i].index_)
-				{
-					isSkip = true;
-				}
-			}
-
-			if (!isSkip && distance < minDistance && distance >= threshold)
-			{
-				minDistance = distance;
-				nearestPoints_[_level].index_ = index;
-				nearestPoints_[_level].distance_ = distance;
-			}
-		}
-
-		++index;
-	}
-
-	return nearestPoints_[_level].index_;
-}
-
-void TemplateExplorationWidget::slotDeformKNearestMatches(double posx, double posy)
-{
-
-    slotDeformTemplate(posx, posy);
-
-    // Deform nearest neighbours according to the deformed template
-	for (int i = 0; i < nofNN_; ++i)
-	{
-        //SetMesh(m_NearestPoints[i]._Index);
-		slotDeformNearestMatch(i);
+        //SetMesh(m_NearestPoints[i]._Index);
+		slotDeformNearestMatch(i);
 	}
 
 }
@@ -2413,9 +2489,12 @@ void TemplateExplorationWidget::slotDeformNearestMatch(int _level)
     
     std::vector<Match::Part>::iterator dnmPartsIt(dnmParts.begin()), dnmPartsEnd(dnmParts.end());
     
+    // Once the part meshes are prepared the exploration worker may be reading them, so only load here before that
+    bool loadIfMissing = mayLoadPartMeshes();
+    
     for (; dnmPartsIt!=dnmPartsEnd; ++dnmPartsIt)
     {
-        deformNearestPart(*dnmPartsIt, nearestMatch);
+        SynthesisEngine::deformNearestPart(*dnmPartsIt, nearestMatch, loadIfMissing);
     }
     
     return;
@@ -2639,6 +2718,8 @@ void TemplateExplorationWidget::slotInterpolateSelected(int _lerp)
 void TemplateExplorationWidget::slotChangeSelectedPoint( double _posx, double _posy)
 {
     
+    TRACE_SPAN("TemplateExplorationWidget::slotChangeSelectedPoint");
+    
     OpenMesh::Vec2f selectedPoint(_posx,_posy);
     
     if (selectedPoint_ == selectedPoint)
@@ -2652,34 +2733,13 @@ void TemplateExplorationWidget::slotChangeSelectedPoint( double _posx, double _p
     
     qDebug() << "Point clicked: " << selectedPoint_[0] << ", " << selectedPoint[1];
     
-    // Get nearest neighbours
-    // used to check a checkbox to use ann, now we just use it by default
-    if(1) //chkBoxUseANN_->isChecked())
-    {
-        qDebug() << "Using ANN to find nearest neighbours";
-        if (nearestPoints_)
-        {
-            delete [] nearestPoints_;
-        }
-        
-        nearestPoints_ = getNearestPoint(_posx, _posy, nofNN_); //NUM_OF_NEAREST_NEIGHBOURS);
-    }
-	else
+    // Get nearest neighbours, the engine picks between an exhaustive search and its kd-tree depending on the size of the embedding
+    if (nearestPoints_)
     {
-        qDebug() << "Using exhaustive search to find nearest neighbours";
-        
-        if (nearestPoints_)
-        {
-            delete [] nearestPoints_;
-        }
-        
-        nearestPoints_ = new NEAREST_POINT[nofNN_];
-        
-        for (int i = 0; i < nofNN_; ++i) //NUM_OF_NEAREST_NEIGHBOURS; ++i)
-        {
-            getNearestPoint(i, _posx, _posy);
-        }
+        delete [] nearestPoints_;
     }
+    
+    nearestPoints_ = getNearestPoint(_posx, _posy, nofNN_);
 
     // Add some random indices as well, for the SHOW_PART_OPTIONS and SHOW_MATCHES_SUPERIMPOSED modes
     randomNeighbourIndices_.clear();
@@ -2700,6 +2760,18 @@ void TemplateExplorationWidget::slotChangeSelectedPoint( double _posx, double _p
     // Selected point has changed so we reset the validity of the template match and the deformed nearest matches so they will be recalculated
     resetDataState();
     
+    if (isExplorationModeAsync(explorationMode_))
+    {
+        // The plot shows the new point right away, the viewport follows when the synthesis for the latest point is done
+        requestExplorationData();
+        
+        updateGUI(explorationMode_);
+        
+        updatePlot(explorationMode_);
+        
+        return;
+    }
+    
     computeExplorationData(explorationMode_);
     
     // No need to update the gui here
@@ -2711,6 +2783,188 @@ void TemplateExplorationWidget::slotChangeSelectedPoint( double _posx, double _p
     
 }
 
+bool TemplateExplorationWidget::isExplorationModeAsync(int _explorationMode) const
+{
+    // Without a PCA basis (e.g. after MDS) the template cannot be deformed, computeExplorationData then ranks the parts against the undeformed template
+    if (engine_.pcaBasis().empty())
+    {
+        return false;
+    }
+    
+    return _explorationMode == SHOW_CLUSTERS || _explorationMode == SHOW_CLUSTER || _explorationMode == SHOW_DEFORMED_PART_OPTIONS;
+}
+
+void TemplateExplorationWidget::requestExplorationData()
+{
+    explorationGeneration_++;
+    
+    // A running synthesis cannot be interrupted, but its result will be dropped and the latest point started as soon as it finishes
+    if (explorationWatcher_->isRunning())
+    {
+        qDebug() << "Synthesis in progress, superseded by generation " << explorationGeneration_;
+        explorationPending_ = true;
+        return;
+    }
+    
+    startExplorationJob();
+}
+
+void TemplateExplorationWidget::startExplorationJob()
+{
+    syncEngineOptions();
+    
+    // The first job after the matches change loads every part mesh on the worker, the GUI stays responsive meanwhile
+    bool preparePartMeshes = !engine_.partMeshesPrepared();
+    
+    explorationWatcher_->setFuture(QtConcurrent::run(this, &TemplateExplorationWidget::runExplorationJob, (double)selectedPoint_[0], (double)selectedPoint_[1], explorationGeneration_, preparePartMeshes));
+}
+
+std::shared_ptr<TemplateExplorationWidget::ExplorationJob> TemplateExplorationWidget::runExplorationJob(double _x, double _y, int _generation, bool _preparePartMeshes)
+{
+    std::shared_ptr<ExplorationJob> job(new ExplorationJob);
+    
+    job->generation_ = _generation;
+    
+    if (_preparePartMeshes)
+    {
+        engine_.preparePartMeshes();
+    }
+    
+    job->ok_ = engine_.synthesize(_x, _y, job->synthesis_);
+    
+    return job;
+}
+
+bool TemplateExplorationWidget::mayLoadPartMeshes() const
+{
+    return !engine_.partMeshesPrepared() && !explorationWatcher_->isRunning();
+}
+
+void TemplateExplorationWidget::slotExplorationDataReady()
+{
+    std::shared_ptr<ExplorationJob> job = explorationWatcher_->result();
+    
+    if (!job || job->generation_ != explorationGeneration_)
+    {
+        // A newer point was selected while this one was being synthesised
+        if (explorationPending_)
+        {
+            explorationPending_ = false;
+            startExplorationJob();
+        }
+        return;
+    }
+    
+    if (!job->ok_)
+    {
+        qWarning() << "Synthesis failed for point " << job->synthesis_.point_[0] << ", " << job->synthesis_.point_[1];
+    }
+    
+    applySynthesis(job->synthesis_);
+    
+    updateGUI(explorationMode_);
+    
+    updatePlot(explorationMode_);
+    
+    updateViewport(explorationMode_);
+}
+
+void TemplateExplorationWidget::waitForExplorationData()
+{
+    // Whatever the worker is doing now belongs to an older request
+    explorationGeneration_++;
+    
+    explorationPending_ = false;
+    
+    explorationWatcher_->waitForFinished();
+}
+
+void TemplateExplorationWidget::applySynthesis(const SynthesisEngine::Synthesis& _synthesis)
+{
+    templateMatch_.setParts(_synthesis.templateMatch_.parts());
+    templateMatch_.setNparts(templateMatch_.parts().size());
+    templateMatch_.setDescriptor2D(_synthesis.templateMatch_.descriptor2D());
+    
+    dataState_.templateValid = true;
+    
+    xform ident;
+    
+    deformedNearestOption_.setAlignMtx(ident);
+    
+    deformedNearestOption_.setGroupID(selectedGroupID_);
+    
+    deformedNearestOption_.setNparts(templateMatch_.nparts());
+    
+    deformedNearestOption_.setTemplateID(selectedTemplateID_);
+    
+    deformedNearestOption_.setDescriptor2D(templateMatch_.descriptor2D());
+    
+    deformedNearestOption_.parts().clear();
+    
+    deformedNearestOption_.setParts(_synthesis.model_.parts());
+    
+    // Same as computeExplorationData, the individual part meshes are rendered
+    deformedNearestOption_.setSegmented(true);
+    
+    deformedNearestOption_.points().clear();
+    
+    // The rankings and the chosen positions in them are what the next/previous part option buttons and the model log work from
+    nnRanking_ = _synthesis.ranking_;
+    
+    nnChosen_.clear();
+    
+    partClicks_.clear();
+    
+    std::unordered_map<int, std::pair<int, double> >::const_iterator chosenIt(_synthesis.chosen_.begin()), chosenEnd(_synthesis.chosen_.end());
+    
+    for (; chosenIt!=chosenEnd; ++chosenIt)
+    {
+        nnChosen_[chosenIt->first] = chosenIt->second.first;
+        
+        nnPartScoreVectorIndex_[chosenIt->first] = _synthesis.chosenRank_.at(chosenIt->first);
+    }
+    
+    nIndependentParts_ = deformedNearestOption_.parts().size() - nSymmetryConstraints_;
+    
+    emit nIndependentPartsChanged(QString("No of independent parts: %1").arg(nIndependentParts_));
+    
+    nnUsed_ = _synthesis.nnUsed_;
+    
+    emit nnUsedChanged(QString("No of neighbors used: %1").arg(nnUsed_));
+    
+    dataState_.deformedPartOptionsValid = true;
+    
+    TIMELOG->append(QString("%1 : deformed_model top_ranked").arg((qlonglong)QDateTime::currentMSecsSinceEpoch()));
+}
+
+void TemplateExplorationWidget::syncEngineOptions()
+{
+    SynthesisEngine::Options options = engine_.options();
+    
+    options.nofNN_ = nofNN_;
+    options.calculationMode_ = calculationMode_;
+    options.preserveConstraints_ = preserveConstraints_;
+    options.recalculateBoxes_ = recalculateBoxes_;
+    options.fullDescriptorSearch_ = fullDescriptorNN_;
+    
+    // The widget has always treated 0 (an empty line edit) as no forced neighbour
+    options.forcedNeighborIndex_ = forcedNeighborIndex_ > 0 ? forcedNeighborIndex_ : -1;
+    
+    const SynthesisEngine::Options& current = engine_.options();
+    
+    if (options.nofNN_ == current.nofNN_ && options.calculationMode_ == current.calculationMode_ && options.preserveConstraints_ == current.preserveConstraints_ && options.recalculateBoxes_ == current.recalculateBoxes_ && options.fullDescriptorSearch_ == current.fullDescriptorSearch_ && options.forcedNeighborIndex_ == current.forcedNeighborIndex_)
+    {
+        return;
+    }
+    
+    // The workers read the options, and the cached hover templates were deformed with the old ones
+    waitForExplorationData();
+    
+    invalidateHoverCache();
+    
+    engine_.options() = options;
+}
+
 
 
 // This method computes the data we need to display, depending on the exploration mode passed as parameter (the current exploration mode could be used to avoid using a parameter at all) but lets make it a bit more flexible in case we need to call it in other contexts as well)
@@ -2720,6 +2974,10 @@ void TemplateExplorationWidget::slotChangeSelectedPoint( double _posx, double _p
 void TemplateExplorationWidget::computeExplorationData(int _explorationMode)
 {
     qDebug() << "Computing exploration data.." ;
+    
+    // Computing here supersedes whatever the worker is still synthesising
+    waitForExplorationData();
+    
     iview = -1;
     if(selectedPoint_ == OpenMesh::Vec2f(-std::numeric_limits<float>::max(),-std::numeric_limits<float>::max()))
     {
@@ -2842,7 +3100,7 @@ void TemplateExplorationWidget::computeExplorationData(int _explorationMode)
             {
                 if(chkNN_->isChecked())
                 {
-                    deformNearestMatches(1);
+                    deformNearestMatches(1, nearestNeighbourLevel_);
                 }
                 else
                 {
@@ -2907,19 +3165,12 @@ void TemplateExplorationWidget::computeExplorationData(int _explorationMode)
                 
                 std::vector<Match::Part>::iterator partIt(cParts.begin()), partEnd(cParts.end());
                 
-                nnIndexPartScoreSorted_.clear();
-                
                 nnChosen_.clear();
                 
                 partClicks_.clear();
                 
-                // Do a pass to rank all the neighbors based on their unary score per part
-                for (; partIt!=partEnd; ++partIt)
-                {
-                    rankNeighborPartsUnary(partIt->partID_);
-                }
-                
-                partIt = cParts.begin();
+                // Rank all the neighbors based on their unary score for every part at once
+                rankNeighborParts();
                 
                 // Check if the part is involved in any symmetry constraints
                 std::vector<Match::Constraint>& tmConstraints = templateMatch_.constraints();
@@ -3049,13 +3300,11 @@ void TemplateExplorationWidget::computeExplorationData(int _explorationMode)
                 
                 std::vector<Match::Part>::iterator partIt(cParts.begin()), partEnd(cParts.end());
                 
-                nnIndexPartScoreSorted_.clear();
+                rankNeighborParts();
                 
                 // Do a pass to RANDOMLY select a shape from which to pick each part
                 for (; partIt!=partEnd; ++partIt)
                 {
-                    rankNeighborPartsUnary(partIt->partID_);
-                    
                     nnPartScoreVectorIndex_[partIt->partID_] = 0;
                     
                     showPartDeformationOption(partIt->partID_, -1,true);
@@ -4240,55 +4489,14 @@ void TemplateExplorationWidget::slotSelectCluster(bool _checked)
 
 NEAREST_POINT* TemplateExplorationWidget::getNearestPoint(double _x, double _y, int _numNeighbors)
 {
-    int fmSize = filteredMatches_.size();
-    
-    if (fmSize == 0 || _numNeighbors > fmSize)
-    {
-        qCritical() << "Trying to build a tree with " << fmSize << " looking for " << _numNeighbors << " is not possible" ;
-        NEAREST_POINT* nearestBad = new NEAREST_POINT[_numNeighbors];
-        return nearestBad;
-    }
-    // Build the kd tree
-	typedef VectorMatchDescriptor2DAdaptor< std::vector<Match*> > MD2KD;
-    
-	const MD2KD md2kd( filteredMatches_ ); // The adaptor
+    TRACE_SPAN("TemplateExplorationWidget::getNearestPoint");
     
-	// construct a kd-tree index:
-	typedef KDTreeSingleIndexAdaptor<
-    L2_Simple_Adaptor<OpenMesh::Vec2f::value_type, MD2KD > ,
-    MD2KD,
-    2 /* dim */
-	> my_kd_tree_t;
-    
-	my_kd_tree_t kdTreeIndex(2 /*dim*/, md2kd, KDTreeSingleIndexAdaptorParams(10 /* max leaf */) );
-	kdTreeIndex.buildIndex();
-    
-    typedef OpenMesh::Vec2f::value_type num_t;
-    
-    const size_t num_results = _numNeighbors;
-    
-    size_t nn_index[_numNeighbors];
-    
-    num_t nn_dist_sqr[_numNeighbors];
-    
-    OpenMesh::Vec2f p;
-    p[0] = _x;
-    p[1] = _y;
-    
-    // Find nearest point inside points
-    nanoflann::KNNResultSet<num_t> resultSet(num_results);
-    
-    resultSet.init(nn_index, nn_dist_sqr);
-    
-    kdTreeIndex.findNeighbors(resultSet, &p[0], nanoflann::SearchParams(10));
+    // The engine searches the embedding of filteredMatches_ exhaustively when it is small and with a kd-tree built once per embedding otherwise
+    std::vector<NEAREST_POINT> nearestPoints = engine_.nearestPoints(_x, _y, _numNeighbors);
     
     NEAREST_POINT* nearest = new NEAREST_POINT[_numNeighbors];
     
-    for (int i=0 ; i < _numNeighbors; ++i)
-    {
-        nearest[i].index_ = nn_index[i];
-        nearest[i].distance_ = nn_dist_sqr[i];
-    }
+    std::copy(nearestPoints.begin(), nearestPoints.end(), nearest);
     
     return nearest;
 }
@@ -4372,17 +4580,34 @@ void TemplateExplorationWidget::slotReadLabels()
 
 void TemplateExplorationWidget::slotSplitMatches()
 {
-    std::vector<Match*>::iterator matchesIt(matches_.begin()), matchesEnd(matches_.end());
+    // The workers read the part meshes that are about to be rewritten
+    waitForExplorationData();
     
-    for (; matchesIt!=matchesEnd; ++matchesIt)
-    {
-        (**matchesIt).openMeshIfNotOpened();
-        
-        (**matchesIt).split();
+    invalidateHoverCache();
     
-        (**matchesIt).savePartMeshes();
-
-    }
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    
+    SynthesisEngine::SegmentationOptions options;
+    
+    SynthesisEngine::SegmentationStats stats;
+    
+    SynthesisEngine::segmentMatches(matches_, options, stats);
+    
+    // The part meshes were released, they are read back from the new files when they are needed
+    engine_.invalidatePartMeshes();
+    
+    QApplication::restoreOverrideCursor();
+    
+    QString report;
+    QTextStream reportStream(&report);
+    
+    SynthesisEngine::printSegmentationStats(stats, reportStream);
+    
+    reportStream.flush();
+    
+    qDebug() << report;
+    
+    TIMELOG->append(QString("%1 : split_matches segmented:%2 skipped:%3 failed:%4").arg((qlonglong)QDateTime::currentMSecsSinceEpoch()).arg(stats.nSegmented_).arg(stats.nSkipped_).arg(stats.nFailed_));
     
     return;
     
@@ -4416,7 +4641,7 @@ void TemplateExplorationWidget::slotSplitMatches()
     }
 }
 
-void TemplateExplorationWidget::deformNearestMatches(int _numNeighbors)
+void TemplateExplorationWidget::deformNearestMatches(int _numNeighbors, int _neighbourLevel)
 {
     
     xform ident;
@@ -4468,9 +4693,9 @@ void TemplateExplorationWidget::deformNearestMatches(int _numNeighbors)
     {
         int neighborIndex = -1;
         
-        if(chkNN_->isChecked())
+        if(_neighbourLevel >= 0)
         {
-            neighborIndex = nearestNeighbourLevel_;
+            neighborIndex = _neighbourLevel;
         }
         else
         {
@@ -4496,7 +4721,8 @@ void TemplateExplorationWidget::deformNearestMatches(int _numNeighbors)
             // If it fails to load the mesh (perhaps didn't find it in the expected location), it will call split on the original mesh to split it using the naive approach
             //nearestMatch.openMeshIfNotOpened(); 
             
-            deformNearestPart(tmcPart, nearestMatch);
+            // Once the part meshes are prepared the exploration worker may be reading them, so it only loads before that
+            SynthesisEngine::deformNearestPart(tmcPart, nearestMatch, mayLoadPartMeshes());
         }
         else
         {
@@ -4507,76 +4733,11 @@ void TemplateExplorationWidget::deformNearestMatches(int _numNeighbors)
 
 }
 
-// Given the template part (deformed option object has already got its parts from the deformed template) we want, and the nearest neighbour from which to get the corresponding part (i.e. the part which has the same part ID), deform the nearest neighbour's mesh and points to match the template part
-bool TemplateExplorationWidget::deformNearestPart(Match::Part& tmcPart, Match& nearestMatch)
-{
-    qDebug() << "Calling deform nearest part" ;
-    
-    std::vector<Match::Part>::iterator itPart(nearestMatch.parts().begin()), partEnd(nearestMatch.parts().end());
-    
-    //int nmPartIndex = -1;
-    
-    // We now need to find the neighbor's part which has the same part ID with the part we want to deform
-    for (int j=0; itPart != partEnd; ++itPart, ++j)
-    {
-        Match::Part& nmcPart = *itPart;
-        
-        if (nmcPart.partID_ == tmcPart.partID_)
-        {
-            // We need the part's mesh now, so try to open it, if we fail, then segment the mesh using the naive approach
-            if(!nearestMatch.openPartMeshIfNotOpened(nmcPart))
-            {
-                //Open the original mesh first and then split
-                nearestMatch.openMeshIfNotOpened();
-                nearestMatch.split();
-            }
-            Shape::Mesh& nMesh = nmcPart.partShape_.mesh();
-            Shape::Mesh& tMesh = tmcPart.partShape_.mesh();
-            
-            if(nMesh.n_vertices() == 0)
-            {
-                //qWarning() << "Nearest match " << (nearestMatch.meshFilename()+QString(".p%1.off").arg(nmcPart.partID_)) << " has 0 vertices";
-                std::cout << "failed to load part for deforming" << std::endl;
-                return false;
-            }
-            
-            tMesh = nMesh;
-            
-            // Deform the part's mesh vertices using the boxes of the parts
-            typename TriangleMesh::VertexIter vIt(tMesh.vertices_begin()), vEnd(tMesh.vertices_end());
-            
-            for(; vIt!=vEnd; ++vIt)
-            {
-                OpenMesh::Vec3f& p_i = tMesh.point(vIt);
-                
-                OpenMesh::Vec3f scaleFactor = tmcPart.scale_ / nmcPart.scale_;
-                OpenMesh::Vec3f transToOrigin = mv(nearestMatch.alignMtx(), p_i) - nmcPart.pos_;
-                OpenMesh::Vec3f scaleToTemplate = transToOrigin * scaleFactor;
-                
-                OpenMesh::Vec3f newpoint = scaleToTemplate + tmcPart.pos_;
-                OpenMesh::Vec3f newpointf(newpoint[0],newpoint[1],newpoint[2]);
-                
-                tMesh.set_point(vIt, newpointf);
-            }
-            
-            tMesh.request_face_normals();
-            tMesh.request_vertex_normals();
-            tMesh.update_face_normals();
-            tMesh.update_vertex_normals();
-            
-            break;
-        }
-        
-    }
-    
-    return true;
-}
-
 void TemplateExplorationWidget::slotShowNextDeformationOption()
 {
     if(chkNN_->isChecked())
     {
-        deformNearestMatches(1);
+        deformNearestMatches(1, nearestNeighbourLevel_);
     }
     else
     {
@@ -4848,34 +5009,13 @@ void TemplateExplorationWidget::slotSetNofNN(const QString& _nofNN)
     nofNN_ = nofnn;
     
     // Get nearest neighbours
-    // used to check a checkbox to use ann, now we just use it by default
-    if(1) //chkBoxUseANN_->isChecked())
-    {
-        qDebug() << "Using ANN to find nearest neighbours";
-        if (nearestPoints_)
-        {
-            delete [] nearestPoints_;
-        }
-        
-        nearestPoints_ = getNearestPoint(selectedPoint_[0], selectedPoint_[1], nofNN_); //NUM_OF_NEAREST_NEIGHBOURS);
-    }
-	else
+    if (nearestPoints_)
     {
-        qDebug() << "Using exhaustive search to find nearest neighbours";
-        
-        if (nearestPoints_)
-        {
-            delete [] nearestPoints_;
-        }
-        
-        nearestPoints_ = new NEAREST_POINT[nofNN_];
-        
-        for (int i = 0; i < nofNN_; ++i) //NUM_OF_NEAREST_NEIGHBOURS; ++i)
-        {
-            getNearestPoint(i, selectedPoint_[0], selectedPoint_[1]);
-        }
+        delete [] nearestPoints_;
     }
     
+    nearestPoints_ = getNearestPoint(selectedPoint_[0], selectedPoint_[1], nofNN_);
+    
     dataState_.deformedPartOptionsValid = false;
     
     // Just to be safe, we delete the flags for the deformed nearest neighbour validity, re-allocate them and set them to false
@@ -4936,134 +5076,42 @@ void TemplateExplorationWidget::slotSetNofNN(const QString& _nofNN)
 }
 
 
-void TemplateExplorationWidget::rankNeighborPartsUnary(unsigned int _partID)
+void TemplateExplorationWidget::rankNeighborParts()
 {
-    std::vector< std::pair<int, double> >& nnScoreSorted = nnIndexPartScoreSorted_[_partID];
-    
-    nnScoreSorted.clear();
+    std::vector<NEAREST_POINT> nearestPoints(nearestPoints_, nearestPoints_ + nofNN_);
     
-    //nnPartScoreVectorIndex_ = -1;
+    engine_.rankNeighborParts(templateMatch_, nearestPoints, nnRanking_);
     
-    if(_partID <=0)
+    // Every part should have a rank for each of the nearest neighbors
+    if (nnRanking_.depth_!=nofNN_)
     {
-        qCritical() << "Picked part ID is " << _partID ;
+        qCritical() << "The nearest neighbors ranked on their unary score ( " << nnRanking_.depth_ << " ) are not as many as the currently selected number of nearest neighbors ( " << nofNN_ << " ). Resulting synthesis suggestions will be invalid!" ;
+        nnRanking_.clear();
         return;
     }
-    // Unfortunately we only know the part ID of the currently selected part, so we need to go through the list of parts of the deformed template and locate the part with this part ID
-    std::vector<Match::Part>::const_iterator tmPartIt(templateMatch_.parts().begin()), tmPartEnd(templateMatch_.parts().end());
     
-    int tmPartIndex = 0;
+    qDebug() << "Currently selected point: " << selectedPoint_[0] << " , " << selectedPoint_[1] ;
     
-    for (int j=0; tmPartIt != tmPartEnd; ++tmPartIt, ++j)
+    for (int r=0; r<nnRanking_.partIDs_.size(); ++r)
     {
-        const Match::Part& tmcPart = *tmPartIt;
+        qDebug() << "Ranking neighbors for part id: " << nnRanking_.partIDs_[r];
         
-        if (tmcPart.partID_ == _partID)
+        for (int i=0; i<nnRanking_.depth_; ++i)
         {
-            break;
-        }
-        
-        tmPartIndex++;
-    }
-    
-
-    for (int i=0; i<nofNN_; ++i)
-    {
-        int nearestMatchIndex = nearestPoints_[i].index_;
-        
-        if (nearestMatchIndex<0 || nearestMatchIndex>=filteredMatches_.size())
-        {
-            qCritical() << "Nearest neighbour index is invalid" << nearestMatchIndex;
-            nnScoreSorted.push_back(std::pair<int, double>(-1,std::numeric_limits<double>::max()));
-            continue;
-        }
-        
-        Match& nearestMatch = *filteredMatches_.at(nearestMatchIndex);
-        
-        std::vector<Match::Part>::iterator itPart(nearestMatch.parts().begin()), partEnd(nearestMatch.parts().end());
-        
-        // Unfortunately we only know the part ID of the currently selected part, so we need to go through the list of parts of the currently evaluated nearest neighbor and locate the part with this part ID
-        for (int j=0; itPart != partEnd; ++itPart, ++j)
-        {
-            Match::Part& nmcPart = *itPart;
+            int nearestMatchIndex = nnRanking_.matchIndex(r, i);
             
-            if (nmcPart.partID_ == _partID)
+            if (nearestMatchIndex<0 || nearestMatchIndex>=filteredMatches_.size())
             {
-                // We now know both the template's part and the nearest neighbor's part, so we can find the unary score
-                const Match::Part& tmPart = templateMatch_.parts().at(tmPartIndex);
-                
-                if (chkRecalculateBoxes_->isChecked())
-                {
-                    // We need the part's mesh now, so try to open it, if we fail, then segment the mesh using the naive approach
-                    if(!nearestMatch.openPartMeshIfNotOpened(nmcPart))
-                    {
-                        // Open the original mesh first and then split
-                        nearestMatch.openMeshIfNotOpened();
-                        nearestMatch.split();
-                    }
-                    
-                    nmcPart.recalculateBox(nearestMatch.alignMtx());
-                }
-                
-                double score = partUnaryScore(tmPart,nmcPart);
-                
-                // Push the score and nearest neighbor index into a vector we can then sort according to score
-                nnScoreSorted.push_back(std::pair<int, double>(nearestMatchIndex,score));
+                qDebug() << "Neighbor " << i << " with index " << nearestMatchIndex << " , name INVALID" << " and score INVALID" << nnRanking_.score(r, i) ;
+            }
+            else
+            {
+                qDebug() << "Neighbor " << i << " with index " << nearestMatchIndex << " , name " << filteredMatches_.at(nearestMatchIndex)->filename().split("/").last() << " and score " << nnRanking_.score(r, i) ;
             }
-
-        }
-    }
-    
-    // Scores vector should have the same size as number of nearest neighbors
-    if (nnScoreSorted.size()!=nofNN_)
-    {
-        qCritical() << "The vector of nearest neighbor indices sorted based on their unary score for part ID " << pickedPartID_ << " does not have the same size ( " << nnScoreSorted.size() << " ) as the currently selected number of nearest neighbors ( " << nofNN_ << " ). Resulting synthesis suggestions will be invalid!" ;
-        nnScoreSorted.clear();
-        return;
-    }
-    
-    std::sort(nnScoreSorted.begin(),nnScoreSorted.end(), ComparePartScoresFunctor);
-    
-    qDebug() << "Currently selected point: " << selectedPoint_[0] << " , " << selectedPoint_[1] ;
-    qDebug() << "Ranking neighbors for part id: " << _partID;
-    
-    for (int i=0; i< nnScoreSorted.size(); ++i)
-    {
-        int nearestMatchIndex = nnScoreSorted[i].first;
-        
-        if (nearestMatchIndex<0 || nearestMatchIndex>=filteredMatches_.size())
-        {
-            qDebug() << "Neighbor " << i << " with index " << nnScoreSorted[i].first << " , name INVALID" << " and score INVALID" << nnScoreSorted[i].second ;
-        }
-        else
-        {
-            qDebug() << "Neighbor " << i << " with index " << nnScoreSorted[i].first << " , name " << filteredMatches_.at(nearestMatchIndex)->filename().split("/").last() << " and score " << nnScoreSorted[i].second ;
         }
     }
-
-}
-
-// Calculate the unary score for two parts
-// In the current setup, tmPart would have been chosen from the deformed template and nmcPart would have been chosen from the currently evaluated nearest neighbor to the deformed template, and they would of course have the same part ID to allow meaningful comparison
-// The function returns the squared norm of the 6D descriptor calculated as the (min,max) coordinates of the boxes of the two parts
-double TemplateExplorationWidget::partUnaryScore(const Match::Part& tmPart, const Match::Part& nmcPart)
-{
-    OpenMesh::Vec3f nmMin = nmcPart.pos_ - nmcPart.scale_;
-    OpenMesh::Vec3f nmMax = nmcPart.pos_ + nmcPart.scale_;
-    
-    OpenMesh::Vec6d nmDescriptor(nmMin[0],nmMin[1],nmMin[2],nmMax[0],nmMax[1],nmMax[2]);
-    
-    OpenMesh::Vec3f tmMin = tmPart.pos_ - tmPart.scale_;
-    OpenMesh::Vec3f tmMax = tmPart.pos_ + tmPart.scale_;
-    
-    OpenMesh::Vec6d tmDescriptor(tmMin[0],tmMin[1],tmMin[2],tmMax[0],tmMax[1],tmMax[2]);
-    
-    double score = (nmDescriptor - tmDescriptor).sqrnorm();
-    
-    return score;
 }
 
-
 void TemplateExplorationWidget::showPartDeformationOption(unsigned int _partID, int _symmetricPartID, bool isForward)
 {
     if (_partID <=0 || nnPartScoreVectorIndex_[_partID]<0)
@@ -5096,31 +5144,39 @@ void TemplateExplorationWidget::showPartDeformationOption(unsigned int _partID,
                 //if(explorationMode_ == SHOW_DEFORMED_PART_OPTIONS)
                 if(explorationMode_ == SHOW_CLUSTERS || explorationMode_ == SHOW_CLUSTER || explorationMode_ == SHOW_DEFORMED_PART_OPTIONS)
                 {
-                    // Get the neighbor according to the sorted index we produced
+                    // Get the neighbor according to the ranking we produced
+                    
+                    int row = nnRanking_.row(_partID);
+                    
+                    int rank = nnPartScoreVectorIndex_[_partID];
                     
-                    std::vector< std::pair<int, double> >& partRank = nnIndexPartScoreSorted_[_partID];
+                    if (row < 0 || rank >= nnRanking_.depth_)
+                    {
+                        qCritical() << "No ranked neighbor " << rank << " for part ID " << _partID;
+                        break;
+                    }
+                    
+                    int symmetricRow = _symmetricPartID>=0 ? nnRanking_.row(_symmetricPartID) : -1;
                     
                     // If a valid symmetric part id was passed as a second argument, get the score for the neighbor of this part and the score for the neighbor of the symmetric part and choose the neighbor with the smallest score
-                    if (_symmetricPartID>=0)
+                    if (symmetricRow>=0)
                     {
-                        std::vector< std::pair<int, double> >& symmetricPartRank = nnIndexPartScoreSorted_[_symmetricPartID];
-                        
-                        double score1 = partRank.at(nnPartScoreVectorIndex_[_partID]).second;
+                        double score1 = nnRanking_.score(row, rank);
                         
-                        double score2 = symmetricPartRank.at(nnPartScoreVectorIndex_[_partID]).second;
+                        double score2 = nnRanking_.score(symmetricRow, rank);
                         
                         if (score1 <= score2)
                         {
-                            nearestMatchIndex = partRank.at(nnPartScoreVectorIndex_[_partID]).first;
+                            nearestMatchIndex = nnRanking_.matchIndex(row, rank);
                         }
                         else
                         {
-                            nearestMatchIndex = symmetricPartRank.at(nnPartScoreVectorIndex_[_partID]).first;
+                            nearestMatchIndex = nnRanking_.matchIndex(symmetricRow, rank);
                         }
                     }
                     else
                     {
-                        nearestMatchIndex = partRank.at(nnPartScoreVectorIndex_[_partID]).first;
+                        nearestMatchIndex = nnRanking_.matchIndex(row, rank);
                     }
                 }
                 
@@ -5145,13 +5201,14 @@ void TemplateExplorationWidget::showPartDeformationOption(unsigned int _partID,
                 
                 Match& nearestMatch = *filteredMatches_.at(nearestMatchIndex);
                 
-                qDebug() << "Nearest neighbor to pick part " << _partID << " from is " << nearestMatchIndex << " with name " << nearestMatch.filename().split("/").last() << " Circular index is " << nnPartScoreVectorIndex_[_partID];
+                LOG_DEBUG() << "Nearest neighbor to pick part " << _partID << " from is " << nearestMatchIndex << " with name " << nearestMatch.filename().split("/").last() << " Circular index is " << nnPartScoreVectorIndex_[_partID];
                 
                 nnChosen_[_partID] = nearestMatchIndex;
                 
                 if(explorationMode_ == SHOW_CLUSTERS || explorationMode_ == SHOW_CLUSTER || explorationMode_ == SHOW_DEFORMED_PART_OPTIONS)
                 {
-                    notDeformed = ! deformNearestPart(tmcPart, nearestMatch);
+                    // Never load while the exploration worker may be reading the prepared part meshes
+                    notDeformed = ! SynthesisEngine::deformNearestPart(tmcPart, nearestMatch, mayLoadPartMeshes());
                     if (notDeformed)
                     {
                         if(isForward)
@@ -5167,7 +5224,7 @@ void TemplateExplorationWidget::showPartDeformationOption(unsigned int _partID,
                                 nnPartScoreVectorIndex_[_partID] = nofNN_ - 1;
                             }
                             
-                            qDebug() << " Circular index for part is " << nnPartScoreVectorIndex_[_partID];
+                            LOG_DEBUG() << " Circular index for part is " << nnPartScoreVectorIndex_[_partID];
                         }
                         
                         if (_symmetricPartID>=0)
@@ -5419,6 +5476,10 @@ void TemplateExplorationWidget::slotChangeRecalculateBoxes(int state)
         qDebug() << "Recalculate boxes policy switched to true!" ;
     }
     
+    recalculateBoxes_ = (state != Qt::Unchecked);
+    
+    syncEngineOptions();
+    
     dataState_.deformedPartOptionsValid = false;
     
     // Really shouldn't do change exploration mode here, but seems I have no other choice
@@ -5437,6 +5498,27 @@ void TemplateExplorationWidget::slotChangeRecalculateBoxes(int state)
 
 
 
+void TemplateExplorationWidget::slotToggleFullDescriptorNN(bool _checked)
+{
+    fullDescriptorNN_ = _checked;
+    
+    syncEngineOptions();
+    
+    qDebug() << "Nearest neighbours are searched in the " << (fullDescriptorNN_ ? "full descriptor space" : "2D embedding");
+    
+    if(selectedPoint_ == OpenMesh::Vec2f(-std::numeric_limits<float>::max(),-std::numeric_limits<float>::max()))
+    {
+        return;
+    }
+    
+    // The neighbours of the selected point change, so select it again to recompute everything that depends on them
+    OpenMesh::Vec2f selectedPoint = selectedPoint_;
+    
+    selectedPoint_ = OpenMesh::Vec2f(-std::numeric_limits<float>::max(),-std::numeric_limits<float>::max());
+    
+    slotChangeSelectedPoint(selectedPoint[0], selectedPoint[1]);
+}
+
 void TemplateExplorationWidget::slotManuallyChangeSelectedPoint()
 {
     double posx = lnPointX_->text().toDouble();
@@ -5764,7 +5846,126 @@ void TemplateExplorationWidget::slotChangeHoveredPoint(double _posx, double _pos
         return;
     }
     
-    slotDeformTemplate(_posx, _posy);
+    hoveredPoint_ = OpenMesh::Vec2f(_posx, _posy);
+    
+    // Moves that arrive before the timer fires only move the point
+    if (!hoverTimer_->isActive())
+    {
+        hoverTimer_->start();
+    }
+}
+
+void TemplateExplorationWidget::slotUpdateHoverPreview()
+{
+    // The engine is being rebuilt under t-SNE, the hover starts again with the next move after it
+    if (tsneRunning_ || (explorationMode_!= SHOW_CLUSTER && explorationMode_!= SHOW_CLUSTERS))
+    {
+        return;
+    }
+    
+    OpenMesh::Vec2f centre;
+    
+    long long cell = hoverCell(hoveredPoint_, centre);
+    
+    const std::vector<Match::Part>* parts = hoverCache_.find(cell);
+    
+    if (parts)
+    {
+        showHoverTemplate(*parts);
+        return;
+    }
+    
+    // slotHoverTemplateReady comes back here for the latest point once the running deformation is done
+    if (hoverWatcher_->isRunning())
+    {
+        return;
+    }
+    
+    hoverWatcher_->setFuture(QtConcurrent::run(this, &TemplateExplorationWidget::runHoverJob, (double)centre[0], (double)centre[1], cell, hoverGeneration_, engine_.templateMatch().parts()));
+}
+
+void TemplateExplorationWidget::slotHoverTemplateReady()
+{
+    std::shared_ptr<HoverJob> job = hoverWatcher_->result();
+    
+    if (!job || tsneRunning_)
+    {
+        return;
+    }
+    
+    // The point may have moved on while the job ran, and slotUpdateHoverPreview skipped it then
+    if (job->generation_ != hoverGeneration_)
+    {
+        slotUpdateHoverPreview();
+        return;
+    }
+    
+    if (!job->ok_)
+    {
+        // Same as deforming on the GUI thread, the engine has already said why, only a different cell is worth another try
+        OpenMesh::Vec2f centre;
+        
+        if (hoverCell(hoveredPoint_, centre) != job->cell_)
+        {
+            slotUpdateHoverPreview();
+        }
+        
+        return;
+    }
+    
+    hoverCache_.insert(job->cell_, job->parts_);
+    
+    slotUpdateHoverPreview();
+}
+
+long long TemplateExplorationWidget::hoverCell(const OpenMesh::Vec2f& _point, OpenMesh::Vec2f& _centre) const
+{
+    const OpenMesh::Vec2d& pcaMin = engine_.pcaMin();
+    const OpenMesh::Vec2d& pcaMax = engine_.pcaMax();
+    
+    long long index[2];
+    
+    for (int d=0; d<2; ++d)
+    {
+        double cellSize = (pcaMax[d] - pcaMin[d]) / HOVER_GRID_RESOLUTION;
+        
+        if (cellSize <= 0.0)
+        {
+            cellSize = 1.0;
+        }
+        
+        // Points outside the embedding share the cells of its border
+        index[d] = std::max(0LL, std::min<long long>(HOVER_GRID_RESOLUTION - 1, (long long)floor((_point[d] - pcaMin[d]) / cellSize)));
+        
+        _centre[d] = pcaMin[d] + (index[d] + 0.5) * cellSize;
+    }
+    
+    return index[0] * HOVER_GRID_RESOLUTION + index[1];
+}
+
+std::shared_ptr<TemplateExplorationWidget::HoverJob> TemplateExplorationWidget::runHoverJob(double _x, double _y, long long _cell, int _generation, const std::vector<Match::Part>& _parts) const
+{
+    std::shared_ptr<HoverJob> job(new HoverJob);
+    
+    job->generation_ = _generation;
+    job->cell_ = _cell;
+    
+    Match tm;
+    
+    tm.setParts(_parts);
+    tm.setNparts(_parts.size());
+    
+    job->ok_ = engine_.deformTemplate(_x, _y, tm);
+    
+    job->parts_ = tm.parts();
+    
+    return job;
+}
+
+void TemplateExplorationWidget::showHoverTemplate(const std::vector<Match::Part>& _parts)
+{
+    templateMatch_.setParts(_parts);
+    templateMatch_.setNparts(_parts.size());
     
     std::vector<Shape*> shapes;
     
@@ -5779,7 +5980,15 @@ void TemplateExplorationWidget::slotChangeHoveredPoint(double _posx, double _pos
     {
         emit selectedShapesChanged(shapes,0);
     }
+}
+
+void TemplateExplorationWidget::invalidateHoverCache()
+{
+    hoverGeneration_++;
+    
+    hoverWatcher_->waitForFinished();
     
+    hoverCache_.clear();
 }
 
 
@@ -5908,6 +6117,9 @@ void TemplateExplorationWidget::slotJoinMatchesInSingleGroup()
         }
         
         (**matchesIt).setNparts(cMatchParts.size());
+        
+        // Parts were inserted, so the part signature used for grouping is stale
+        (**matchesIt).updateGroupingKeys();
     }
     
     matchesIt = matches_.begin();
@@ -5931,255 +6143,9 @@ void TemplateExplorationWidget::slotJoinMatchesInSingleGroup()
 
 void TemplateExplorationWidget::slotOptimizeTemplate()
 {
-    std::vector<Match::Part>& tmParts = templateMatch_.parts();
-    
-    std::vector<Match::Constraint>& tmConstraints = templateMatch_.constraints();
-
-    std::vector<Match::Part>::iterator tmPartsIt (tmParts.begin()), tmPartsEnd(tmParts.end());
-    
-    std::vector<Match::Constraint>::iterator tmConstraintsIt(tmConstraints.begin()), tmConstraintsEnd(tmConstraints.end());
-    
-    int N = tmParts.size() * NUM_PARAMS_BOX;
-    
-    double _x[N];
-    
-    for (int i=0; tmPartsIt!=tmPartsEnd; ++tmPartsIt, i+=NUM_PARAMS_BOX)
-    {
-        _x[i] = tmPartsIt->pos_[0];
-        _x[i+1] = tmPartsIt->pos_[1];
-        _x[i+2] = tmPartsIt->pos_[2];
-        
-        _x[i+3] = tmPartsIt->scale_[0];
-        _x[i+4] = tmPartsIt->scale_[1];
-        _x[i+5] = tmPartsIt->scale_[2];
-    }
-    
-    // prepare array data for the optimizer, the optimizer solves for the quadratic function:
-    // f(x) = 1/2*x^tAx + b*x^t, subject to Cx = d;
-    // A is a N*N matrix, b is a 1*N vector,
-    // C is a M*N matrix, d is a M*1 vector
-    double A[N][N];
-    
-    double b[N];
-
-    for (int i=0; i<N; ++i)
-    {
-        // init A 
-        for (int j=0; j<N; ++j)
-        {
-            A[i][j] = 0.0;
-        }
-        
-        // Then set A to diagonal matrix
-        A[i][i] = 2.0; // factor 0.5 is multiplied before, so instead of A being identity, we make it 2I
-        
-        b[i] = -2.0 * _x[i];
-    }
-    
-    
-    int M = 0;
-    int J = 0;
+    TRACE_SPAN("TemplateExplorationWidget::slotOptimizeTemplate");
     
-    // Unfortunately we don't know how many symmetry or contact or whatever type of constraints we have, so we need to go over the constraints vector once to discover them and increase M which is the number of constraint equations based on the number of equations we need per constraint
-    for (; tmConstraintsIt!=tmConstraintsEnd; ++tmConstraintsIt)
-    {
-        // each symmetry imposes 7 equations, each contact imposes 3 equations
-        if (tmConstraintsIt->type_ == SYMMETRY)
-        {
-            M+=NUM_EQUATIONS_SYMMETRY; 
-        }
-        if (tmConstraintsIt->type_ == CONTACT)
-        {
-            M+=NUM_EQUATIONS_CONTACT;
-        }
-    }
-    
-    double C[M][N+1]; // the N+1'th column is to store the values of d
-    
-    // init C matrix
-    for (int i = 0; i<M; ++i)
-    {
-        for (int j=0; j<N+1; ++j)
-        {
-            C[i][j] = 0.0;
-        }
-    }
-    OpenMesh::Vec3d o(0.0,0.0,0.0); // reflectional symmetry plane center -- to be defined
-    
-    OpenMesh::Vec3d n(1.0,0.0,0.0); // reflectional symmetry plane normal
-    
-    if (LOADED_DATASET == PLANES)
-    {
-        n[0] = 0.0;
-        n[1] = 1.0;
-        n[2] = 0.0;
-    }
-    
-    tmConstraintsIt = tmConstraints.begin();
-    
-    
-    int Q[8][3] =
-    {
-        {1,1,1},
-        {1,-1,1},
-        {-1,-1,1},
-        {-1,1,1},
-        {1,1,-1},
-        {1,-1,-1},
-        {-1,-1,-1},
-        {-1,1,-1}
-    };
-    
-
-    for (; tmConstraintsIt!=tmConstraintsEnd; ++tmConstraintsIt)
-    {
-        // Get the starting indices of the two parts involved in the constraint
-        int _index1 = tmConstraintsIt->partIndices_.first * NUM_PARAMS_BOX;
-        int _index2 = tmConstraintsIt->partIndices_.second * NUM_PARAMS_BOX;
-        
-        // each symmetry imposes 7 equations, each contact imposes 3 equations
-        if (tmConstraintsIt->type_ == SYMMETRY)
-        {
-            // centers
-			// 1. n*(c_i+c_j) = 2o*n
-			C[J][_index1 + 0] = n[0]; C[J][_index2 + 0] = n[0];
-			C[J][_index1 + 1] = n[1]; C[J][_index2 + 1] = n[1];
-			C[J][_index1 + 2] = n[2]; C[J][_index2 + 2] = n[2];
-            
-			C[J][N] = 2 * (n|o);
-			J++;
-            
-			// 2. nx(c_i-c_j) = 0
-			C[J][_index1 + 0] = n[2]; C[J][_index2 + 0] = -n[2]; C[J][_index1 + 2] = -n[0]; C[J][_index2 + 2] = n[0]; // the N+1 term is already 0
-			J++;
-			C[J][_index1 + 1] = n[0]; C[J][_index2 + 1] = -n[0]; C[J][_index1 + 0] = -n[1]; C[J][_index2 + 0] = n[1]; // the N+1 term is already 0
-			J++;
-			C[J][_index1 + 2] = n[1]; C[J][_index2 + 2] = -n[1]; C[J][_index1 + 1] = -n[2]; C[J][_index2 + 1] = n[2]; // the N+1 term is already 0
-			J++;
-            
-			// scales
-			C[J][_index1 + 3] = 1.0; C[J][_index2 + 3] = -1.0; // the N+1 term is already 0
-			J++;
-			C[J][_index1 + 4] = 1.0; C[J][_index2 + 4] = -1.0;
-			J++;
-			C[J][_index1 + 5] = 1.0; C[J][_index2 + 5] = -1.0;
-			J++;
-        }
-        
-        if (tmConstraintsIt->type_ == CONTACT)
-        {
-            xform T, R;
-            
-            double minDist = std::numeric_limits<double>::max();
-            
-            for (int j=0; j < 8; ++j)
-            {
-                xform _T;
-                _T[0] = Q[j][0];
-				_T[5] = Q[j][1];
-				_T[10] = Q[j][2];
-                
-				OpenMesh::Vec3f p = tmParts[ tmConstraintsIt->partIndices_.first ].pos_ + mv(_T, tmParts[ tmConstraintsIt->partIndices_.first ].scale_);
-                
-				for (int k = 0; k < 8; ++k)
-				{
-					xform _R;
-					_R[0] = Q[k][0];
-					_R[5] = Q[k][1];
-					_R[10] = Q[k][2];
-					OpenMesh::Vec3f q = tmParts[ tmConstraintsIt->partIndices_.second ].pos_ + mv(_R,  tmParts[ tmConstraintsIt->partIndices_.second ].scale_);
-					double dis = (q - p).norm();
-                    
-					if (dis < minDist)
-					{
-						minDist = dis;
-						T = _T;
-						R = _R;
-					}
-				}
-            }
-            C[J][_index1 + 0] = 1.0; C[J][_index2 + 0] = -1.0; C[J][_index1 + 3] = T[0]; C[J][_index2 + 3] = -R[0]; // the N+1 term is already 0
-            J++;
-            C[J][_index1 + 1] = 1.0; C[J][_index2 + 1] = -1.0; C[J][_index1 + 4] = T[5]; C[J][_index2 + 4] = -R[5]; // the N+1 term is already 0
-            J++;
-            C[J][_index1 + 2] = 1.0; C[J][_index2 + 2] = -1.0; C[J][_index1 + 5] = T[10]; C[J][_index2 + 5] = -R[10]; // the N+1 term is already 0
-            J++;
-        }
-    }
-    
-    // -- feed to the optimizer
-    long int ct[M];
-    double x[N];
-    
-    for (int i=0; i<M; ++i)
-    {
-        ct[i] = 0;
-    }
-    for (int i=0; i<N; ++i)
-    {
-        x[i] = 0.0;
-    }
-    minqpstate state;
-    minqpreport rep;
-    
-    real_2d_array A_alglib;
-    A_alglib.setcontent(N, N, &A[0][0]);
-    
-    real_1d_array b_alglib;
-    b_alglib.setcontent(N, &b[0]);
-    
-    real_2d_array C_alglib;
-    
-    C_alglib.setcontent(M, N+1, &C[0][0]);
-    
-    integer_1d_array ct_alglib;
-    
-    ct_alglib.setcontent(M, &ct[0]);
-    
-    real_1d_array x_alglib;
-    
-    x_alglib.setcontent(N, &x[0]);
-    
-    // create solver, set quadratic/linear terms
-    minqpcreate(N,state);
-    minqpsetquadraticterm(state, A_alglib);
-    minqpsetlinearterm(state, b_alglib);
-    minqpsetlc(state, C_alglib, ct_alglib); // set linear constraints
-    
-    // Set scale of the parameters.
-    // It is strongly recommended that you set scale of your variables.
-    // Knowing their scales is essential for evaluation of stopping criteria
-    // and for preconditioning of the algorithm steps.
-    // You can find more information on scaling at http://www.alglib.net/optimization/scaling.php
-    //double[] s = new double[N]; for (int i = 0; i < N; ++i) s[i] = 1.0;
-    //alglib.minqpsetscale(state, s);
-    
-    
-    // solve problem with Cholesky-based QP solver
-    minqpsetalgocholesky(state);
-    minqpoptimize(state);
-    minqpresults(state,x_alglib,rep);
-    
-    
-    //// solve problem with BLEIC-based QP solver
-    //// default stopping criteria are used.
-    //alglib.minqpsetalgobleic(state, 0.0, 0.0, 0.0, 0);
-    //alglib.minqpoptimize(state);
-    //alglib.minqpresults(state, out x, out rep);
-
-    tmPartsIt = tmParts.begin();
-    
-    for (int i=0; tmPartsIt!=tmPartsEnd; ++tmPartsIt, i+=NUM_PARAMS_BOX)
-    {
-        tmPartsIt->pos_[0] = x_alglib[i];
-        tmPartsIt->pos_[1] = x_alglib[i+1];
-        tmPartsIt->pos_[2] = x_alglib[i+2];
-        
-        tmPartsIt->scale_[0] = x_alglib[i+3];
-        tmPartsIt->scale_[1] = x_alglib[i+4];
-        tmPartsIt->scale_[2] = x_alglib[i+5];
-    }
-
+    engine_.optimizeTemplate(templateMatch_);
 }
 
 void TemplateExplorationWidget::updateExplorationView()
@@ -6291,286 +6257,6 @@ void TemplateExplorationWidget::slotChangeSelectedMatches()
     updateExplorationView();
 }
 
-void TemplateExplorationWidget::initChairConstraints()
-{
-    std::vector<Match::Constraint>& tmConstraints = templateMatch_.constraints();
-    
-    //CHAIR CONSTRAINTS
-    Match::Constraint sym1;
-    sym1.type_ = SYMMETRY;
-    sym1.partIndices_ = std::pair<int, int>(2,5);
-    sym1.partIDs_ = std::pair<int, int>(4,7);
-    
-    Match::Constraint sym2;
-    sym2.type_ = SYMMETRY;
-    sym2.partIndices_ = std::pair<int, int>(3,4);
-    sym2.partIDs_ = std::pair<int, int>(5,6);
-    
-    Match::Constraint con1;
-    con1.type_ = CONTACT;
-    con1.partIndices_ = std::pair<int, int>(1,0);
-    con1.partIDs_ = std::pair<int, int>(3,2);
-    
-    Match::Constraint con2;
-    con2.type_ = CONTACT;
-    con2.partIndices_ = std::pair<int, int>(2,0);
-    con2.partIDs_ = std::pair<int, int>(4,2);
-    
-    Match::Constraint con3;
-    con3.type_ = CONTACT;
-    con3.partIndices_ = std::pair<int, int>(3,0);
-    con3.partIDs_ = std::pair<int, int>(5,2);
-    
-    Match::Constraint con4;
-    con4.type_ = CONTACT;
-    con4.partIndices_ = std::pair<int, int>(4,0);
-    con4.partIDs_ = std::pair<int, int>(6,2);
-    
-    Match::Constraint con5;
-    con5.type_ = CONTACT;
-    con5.partIndices_ = std::pair<int, int>(5,0);
-    con5.partIDs_ = std::pair<int, int>(7,2);
-    
-    
-    tmConstraints.push_back(sym1);
-    tmConstraints.push_back(sym2);
-    tmConstraints.push_back(con1);
-    tmConstraints.push_back(con2);
-    tmConstraints.push_back(con3);
-    tmConstraints.push_back(con4);
-    tmConstraints.push_back(con5);
-    
-    nSymmetryConstraints_ = 2;
-    
-}
-
-void TemplateExplorationWidget::initBikeConstraints()
-{
-    std::vector<Match::Constraint>& tmConstraints = templateMatch_.constraints();
-    
-    // BIKE CONSTRAINTS
-    Match::Constraint sym1;
-    sym1.type_ = SYMMETRY;
-    sym1.partIndices_ = std::pair<int, int>(2,3);
-    sym1.partIDs_ = std::pair<int, int>(4,5);
-
-    Match::Constraint sym2;
-    sym2.type_ = SYMMETRY;
-    sym2.partIndices_ = std::pair<int, int>(3,4);
-    sym2.partIDs_ = std::pair<int, int>(5,6);
-
-    Match::Constraint sym3;
-    sym3.type_ = SYMMETRY;
-    sym3.partIndices_ = std::pair<int, int>(1,2);
-    sym3.partIDs_ = std::pair<int, int>(3,4);
-
-    Match::Constraint con1;
-    con1.type_ = CONTACT;
-    con1.partIndices_ = std::pair<int, int>(5,0);
-    con1.partIDs_ = std::pair<int, int>(7,2);
-
-    Match::Constraint con2;
-    con2.type_ = CONTACT;
-    con2.partIndices_ = std::pair<int, int>(6,0);
-    con2.partIDs_ = std::pair<int, int>(8,2);
-
-    Match::Constraint con3;
-    con3.type_ = CONTACT;
-    con3.partIndices_ = std::pair<int, int>(7,0);
-    con3.partIDs_ = std::pair<int, int>(9,2);
-
-    Match::Constraint con4;
-    con4.type_ = CONTACT;
-    con4.partIndices_ = std::pair<int, int>(3,7);
-    con4.partIDs_ = std::pair<int, int>(5,9);
-
-    Match::Constraint con5;
-    con5.type_ = CONTACT;
-    con5.partIndices_ = std::pair<int, int>(4,7);
-    con5.partIDs_ = std::pair<int, int>(6,9);
-
-    Match::Constraint con6;
-    con6.type_ = CONTACT;
-    con6.partIndices_ = std::pair<int, int>(1,5);
-    con6.partIDs_ = std::pair<int, int>(3,7);
-
-    Match::Constraint con7;
-    con7.type_ = CONTACT;
-    con7.partIndices_ = std::pair<int, int>(2,6);
-    con7.partIDs_ = std::pair<int, int>(4,8);
-
-    tmConstraints.push_back(sym1);
-//    tmConstraints.push_back(sym2);
-//    tmConstraints.push_back(sym3);
-//    tmConstraints.push_back(con1);
-//    tmConstraints.push_back(con2);
-//    tmConstraints.push_back(con3);
-//    tmConstraints.push_back(con4);
-//    tmConstraints.push_back(con5);
-//    tmConstraints.push_back(con6);
-//    tmConstraints.push_back(con7);
-    
-    nSymmetryConstraints_ = 1;
-    
-
-}
-
-void TemplateExplorationWidget::initHelicopterConstraints()
-{
-    
-}
-
-void TemplateExplorationWidget::initPlaneConstraints()
-{
-    std::vector<Match::Constraint>& tmConstraints = templateMatch_.constraints();
-    
-    //PLANE CONSTRAINTS
-    Match::Constraint sym1;
-    sym1.type_ = SYMMETRY;
-    sym1.partIndices_ = std::pair<int, int>(1,2);
-    sym1.partIDs_ = std::pair<int, int>(3,4);
-    
-    Match::Constraint sym2;
-    sym2.type_ = SYMMETRY;
-    sym2.partIndices_ = std::pair<int, int>(4,5);
-    sym2.partIDs_ = std::pair<int, int>(6,7);
-    
-    tmConstraints.push_back(sym1);
-    tmConstraints.push_back(sym2);
-    
-}
-
-void TemplateExplorationWidget::initPlaneSidConstraints()
-{
-    std::vector<Match::Constraint>& tmConstraints = templateMatch_.constraints();
-    
-    //PLANE CONSTRAINTS
-    Match::Constraint sym1;
-    sym1.type_ = SYMMETRY;
-    sym1.partIndices_ = std::pair<int, int>(5,6);
-    sym1.partIDs_ = std::pair<int, int>(7,8);
-
-    Match::Constraint sym2;
-    sym2.type_ = SYMMETRY;
-    sym2.partIndices_ = std::pair<int, int>(3,4);
-    sym2.partIDs_ = std::pair<int, int>(5,6);
-
-    Match::Constraint sym3;
-    sym3.type_ = SYMMETRY;
-    sym3.partIndices_ = std::pair<int, int>(1,2);
-    sym3.partIDs_ = std::pair<int, int>(3,4);
-
-    Match::Constraint sym4;
-    sym4.type_ = SYMMETRY;
-    sym4.partIndices_ = std::pair<int, int>(7,8);
-    sym4.partIDs_ = std::pair<int, int>(9,10);
-    
-    Match::Constraint sym5;
-    sym5.type_ = SYMMETRY;
-    sym5.partIndices_ = std::pair<int, int>(9,10);
-    sym5.partIDs_ = std::pair<int, int>(11,12);
-    
-    Match::Constraint sym6;
-    sym6.type_ = SYMMETRY;
-    sym6.partIndices_ = std::pair<int, int>(11,12);
-    sym6.partIDs_ = std::pair<int, int>(13,14);
-    
-    Match::Constraint sym7;
-    sym7.type_ = SYMMETRY;
-    sym7.partIndices_ = std::pair<int, int>(14,15);
-    sym7.partIDs_ = std::pair<int, int>(16,17);
-    
-    Match::Constraint sym8;
-    sym8.type_ = SYMMETRY;
-    sym8.partIndices_ = std::pair<int, int>(16,17);
-    sym8.partIDs_ = std::pair<int, int>(18,19);
-    
-    Match::Constraint sym9;
-    sym9.type_ = SYMMETRY;
-    sym9.partIndices_ = std::pair<int, int>(18,19);
-    sym9.partIDs_ = std::pair<int, int>(20,21);
-    
-    Match::Constraint sym10;
-    sym10.type_ = SYMMETRY;
-    sym10.partIndices_ = std::pair<int, int>(20,21);
-    sym10.partIDs_ = std::pair<int, int>(22,23);
-    
-    Match::Constraint sym11;
-    sym11.type_ = SYMMETRY;
-    sym11.partIndices_ = std::pair<int, int>(22,23);
-    sym11.partIDs_ = std::pair<int, int>(24,25);
-    
-    Match::Constraint sym12;
-    sym12.type_ = SYMMETRY;
-    sym12.partIndices_ = std::pair<int, int>(24,25);
-    sym12.partIDs_ = std::pair<int, int>(26,27);
-    
-    Match::Constraint sym13;
-    sym13.type_ = SYMMETRY;
-    sym13.partIndices_ = std::pair<int, int>(26,27);
-    sym13.partIDs_ = std::pair<int, int>(28,29);
-    
-    
-    Match::Constraint con1;
-    con1.type_ = CONTACT;
-    con1.partIndices_ = std::pair<int, int>(5,0);
-    con1.partIDs_ = std::pair<int, int>(7,2);
-
-    Match::Constraint con2;
-    con2.type_ = CONTACT;
-    con2.partIndices_ = std::pair<int, int>(6,0);
-    con2.partIDs_ = std::pair<int, int>(8,2);
-
-    Match::Constraint con3;
-    con3.type_ = CONTACT;
-    con3.partIndices_ = std::pair<int, int>(7,0);
-    con3.partIDs_ = std::pair<int, int>(9,2);
-
-    Match::Constraint con4;
-    con4.type_ = CONTACT;
-    con4.partIndices_ = std::pair<int, int>(3,7);
-    con4.partIDs_ = std::pair<int, int>(5,9);
-
-    Match::Constraint con5;
-    con5.type_ = CONTACT;
-    con5.partIndices_ = std::pair<int, int>(4,7);
-    con5.partIDs_ = std::pair<int, int>(6,9);
-
-    Match::Constraint con6;
-    con6.type_ = CONTACT;
-    con6.partIndices_ = std::pair<int, int>(1,5);
-    con6.partIDs_ = std::pair<int, int>(3,7);
-
-    Match::Constraint con7;
-    con7.type_ = CONTACT;
-    con7.partIndices_ = std::pair<int, int>(2,6);
-    con7.partIDs_ = std::pair<int, int>(4,8);
-
-    tmConstraints.push_back(sym1);
-    tmConstraints.push_back(sym2);
-    tmConstraints.push_back(sym3);
-    tmConstraints.push_back(sym4);
-    tmConstraints.push_back(sym5);
-    tmConstraints.push_back(sym6);
-    tmConstraints.push_back(sym7);
-    tmConstraints.push_back(sym8);
-    tmConstraints.push_back(sym9);
-    tmConstraints.push_back(sym10);
-    tmConstraints.push_back(sym11);
-    tmConstraints.push_back(sym12);
-    tmConstraints.push_back(sym13);
-//    tmConstraints.push_back(con1);
-//    tmConstraints.push_back(con2);
-//    tmConstraints.push_back(con3);
-//    tmConstraints.push_back(con4);
-//    tmConstraints.push_back(con5);
-//    tmConstraints.push_back(con6);
-//    tmConstraints.push_back(con7);
-    
-    nSymmetryConstraints_ = 13;
-    
-}
-
 void TemplateExplorationWidget::slotToggleConstraints()
 {
     preserveConstraints_ = !preserveConstraints_;
@@ -6662,7 +6348,7 @@ void TemplateExplorationWidget::slotSaveSynthesizedModel()
     
     QString logname = name;
     
-    name += ".off";
+    name += SynthesisEngine::modelExtension(SAVED_MODEL_FORMAT);
     
     logname += ".log.txt";
     
@@ -6684,54 +6370,34 @@ void TemplateExplorationWidget::slotSaveSynthesizedModel()
     out << "Number of independent parts: " << nIndependentParts_ << "\n";
     out << "Location: " << selectedPoint_[0] << " , " << selectedPoint_[1] << "\n";
     
-    Shape::Mesh cMesh;
-    
     std::vector<Match::Part>& cParts = deformedNearestOption_.parts();
     
     std::vector<Match::Part>::iterator partIt(cParts.begin()), partEnd(cParts.end());
     
-    int vertexOffset = 0;
-    
     for (; partIt!=partEnd; ++partIt)
     {
-        Shape::Mesh& cPartMesh = partIt->partShape_.mesh();
+        int row = nnRanking_.row(partIt->partID_);
         
-        typename Shape::Mesh::ConstVertexIter vIt(cPartMesh.vertices_begin()), vEnd(cPartMesh.vertices_end());
+        int rank = nnPartScoreVectorIndex_[partIt->partID_];
         
-        for (; vIt!=vEnd; ++vIt)
+        if (row < 0 || rank < 0 || rank >= nnRanking_.depth_)
         {
-            cMesh.add_vertex(cPartMesh.point(vIt));
-        }
-        
-        typename Shape::Mesh::ConstFaceIter fIt(cPartMesh.faces_begin()), fEnd(cPartMesh.faces_end());
-        
-        for (; fIt!=fEnd; ++fIt)
-        {
-            typename Shape::Mesh::ConstFaceVertexIter fvIt = cPartMesh.cfv_iter(fIt.handle());
-            
-            typename Shape::Mesh::VertexHandle v0 = fvIt;
-            ++fvIt;
-            typename Shape::Mesh::VertexHandle v1 = fvIt;
-            ++fvIt;
-            typename Shape::Mesh::VertexHandle v2 = fvIt;
-            ++fvIt;
-            
-            cMesh.add_face(Shape::Mesh::VertexHandle(v0.idx()+vertexOffset),Shape::Mesh::VertexHandle(v1.idx()+vertexOffset),Shape::Mesh::VertexHandle(v2.idx()+vertexOffset));
+            qCritical() << "CANNOT SAVE STATS FOR Part id: " << partIt->partID_ << " it has no ranked neighbor!!";
+            continue;
         }
         
-        vertexOffset+=cPartMesh.n_vertices();
+        int nearestMatchIndex = nnRanking_.matchIndex(row, rank);
         
-        std::vector< std::pair<int, double> >& partRank = nnIndexPartScoreSorted_[partIt->partID_];
+        double finalScore = nnRanking_.score(row, rank);
         
         if (preserveConstraints_)
         {
-            // Check if the part is involved in any symmetry constraints
+            // Check if the part is involved in any symmetry constraints, if it is the part was taken from whichever of the two neighbors has the smaller score
             std::vector<Match::Constraint>& tmConstraints = templateMatch_.constraints();
             
             std::vector<Match::Constraint>::iterator tmConstraintsIt(tmConstraints.begin()), tmConstraintsEnd(tmConstraints.end());
-
-            int tmConstraintsSize = tmConstraints.size();
-            int i=0;
+            
+            int symmetricPartID = -1;
             
             for (; tmConstraintsIt!= tmConstraintsEnd; ++tmConstraintsIt)
             {
@@ -6739,111 +6405,41 @@ void TemplateExplorationWidget::slotSaveSynthesizedModel()
                 {
                     if( tmConstraintsIt->partIDs_.first == partIt->partID_)
                     {
-                        std::vector< std::pair<int, double> >& symmetricPartRank = nnIndexPartScoreSorted_[tmConstraintsIt->partIDs_.second];
-                        
-                        double score1 = partRank.at(nnPartScoreVectorIndex_[partIt->partID_]).second;
-                        
-                        double score2 = symmetricPartRank.at(nnPartScoreVectorIndex_[tmConstraintsIt->partIDs_.second]).second;
-                        
-                        double finalScore = 0;
-                        
-                        int nearestMatchIndex = -1;
-                        
-                        if (score1 <= score2)
-                        {
-                            nearestMatchIndex = partRank.at(nnPartScoreVectorIndex_[partIt->partID_]).first;
-                            finalScore = score1;
-                        }
-                        else
-                        {
-                            nearestMatchIndex = symmetricPartRank.at(nnPartScoreVectorIndex_[tmConstraintsIt->partIDs_.second]).first;
-                            finalScore = score2;
-                        }
-                        
-                        if (nearestMatchIndex<0 || nearestMatchIndex>=filteredMatches_.size())
-                        {
-                            qCritical() << "CANNOT SAVE STATS FOR Part id: " << partIt->partID_ << " nearest neighbor index is invalid!!";
-                        }
-                        else
-                        {
-                            Match* nMatch = filteredMatches_.at(nearestMatchIndex);
-                            out << "Part ID: " << partIt->partID_ << " , " << nMatch->filename().split("/").last() << " , " << finalScore << " , " << partClicks_[partIt->partID_] << "\n";
-                        }
+                        symmetricPartID = tmConstraintsIt->partIDs_.second;
                         break;
                     }
-                        
+                    
                     if(tmConstraintsIt->partIDs_.second == partIt->partID_)
                     {
-                        std::vector< std::pair<int, double> >& symmetricPartRank = nnIndexPartScoreSorted_[tmConstraintsIt->partIDs_.first];
-                        
-                        double score1 = partRank.at(nnPartScoreVectorIndex_[partIt->partID_]).second;
-                        
-                        double score2 = symmetricPartRank.at(nnPartScoreVectorIndex_[tmConstraintsIt->partIDs_.first]).second;
-                        
-                        double finalScore = 0;
-                        
-                        int nearestMatchIndex = -1;
-                        
-                        if (score1 <= score2)
-                        {
-                            nearestMatchIndex = partRank.at(nnPartScoreVectorIndex_[partIt->partID_]).first;
-                            finalScore = score1;
-                        }
-                        else
-                        {
-                            nearestMatchIndex = symmetricPartRank.at(nnPartScoreVectorIndex_[tmConstraintsIt->partIDs_.first]).first;
-                            finalScore = score2;
-                        }
-                        
-                        if (nearestMatchIndex<0 || nearestMatchIndex>=filteredMatches_.size())
-                        {
-                            qCritical() << "CANNOT SAVE STATS FOR Part id: " << partIt->partID_ << " nearest neighbor index is invalid!!";
-                        }
-                        else
-                        {
-                            Match* nMatch = filteredMatches_.at(nearestMatchIndex);
-                            out << "Part ID: " << partIt->partID_ << " , " << nMatch->filename().split("/").last() << " , " << finalScore << " , " << partClicks_[partIt->partID_] << "\n";
-                        }
+                        symmetricPartID = tmConstraintsIt->partIDs_.first;
                         break;
                     }
                 }
-                i++;
             }
             
-            if (i == tmConstraintsSize)
+            int symmetricRow = nnRanking_.row(symmetricPartID);
+            
+            int symmetricRank = symmetricRow >= 0 ? nnPartScoreVectorIndex_[symmetricPartID] : -1;
+            
+            if (symmetricRank >= 0 && symmetricRank < nnRanking_.depth_ && nnRanking_.score(symmetricRow, symmetricRank) < finalScore)
             {
-                int nearestMatchIndex = partRank.at(nnPartScoreVectorIndex_[partIt->partID_]).first;
-                
-                if (nearestMatchIndex<0 || nearestMatchIndex>=filteredMatches_.size())
-                {
-                    qCritical() << "CANNOT SAVE STATS FOR Part id: " << partIt->partID_ << " nearest neighbor index is invalid!!";
-                }
-                else
-                {
-                    Match* nMatch = filteredMatches_.at(nearestMatchIndex);
-                    out << "Part ID: " << partIt->partID_ << " , " << nMatch->filename().split("/").last() << " , " << partRank.at(nnPartScoreVectorIndex_[partIt->partID_]).second << " , " << partClicks_[partIt->partID_] << "\n";
-                }
+                nearestMatchIndex = nnRanking_.matchIndex(symmetricRow, symmetricRank);
+                finalScore = nnRanking_.score(symmetricRow, symmetricRank);
             }
-
+        }
+        
+        if (nearestMatchIndex<0 || nearestMatchIndex>=filteredMatches_.size())
+        {
+            qCritical() << "CANNOT SAVE STATS FOR Part id: " << partIt->partID_ << " nearest neighbor index is invalid!!";
         }
         else
         {
-            int nearestMatchIndex = partRank.at(nnPartScoreVectorIndex_[partIt->partID_]).first;
-            
-            if (nearestMatchIndex<0 || nearestMatchIndex>=filteredMatches_.size())
-            {
-                qCritical() << "CANNOT SAVE STATS FOR Part id: " << partIt->partID_ << " nearest neighbor index is invalid!!";
-            }
-            else
-            {
-                Match* nMatch = filteredMatches_.at(nearestMatchIndex);
-                out << "Part ID: " << partIt->partID_ << " , " << nMatch->filename().split("/").last() << " , " << partRank.at(nnPartScoreVectorIndex_[partIt->partID_]).second << " , " << partClicks_[partIt->partID_] << "\n";
-            }
-
+            Match* nMatch = filteredMatches_.at(nearestMatchIndex);
+            out << "Part ID: " << partIt->partID_ << " , " << nMatch->filename().split("/").last() << " , " << finalScore << " , " << partClicks_[partIt->partID_] << "\n";
         }
     }
 
-    OpenMesh::IO::write_mesh(cMesh, name.toStdString());
+    SynthesisEngine::saveModel(deformedNearestOption_, name, SAVED_MODEL_FORMAT);
     
     TIMELOG->append(QString("%1 : saved_synthesized_model").arg((qlonglong)QDateTime::currentMSecsSinceEpoch()));
 }
@@ -6927,12 +6523,12 @@ void TemplateExplorationWidget::slotSaveSelectedMatches()
     
     QTextStream out2(&file2);
     
-    std::vector< std::vector<double> >::iterator pcaBasisIt(pcaBasis_.begin()), pcaBasisEnd(pcaBasis_.end());
+    std::vector< std::vector<double> >::const_iterator pcaBasisIt(engine_.pcaBasis().begin()), pcaBasisEnd(engine_.pcaBasis().end());
     
     for (; pcaBasisIt!= pcaBasisEnd; ++pcaBasisIt)
     {
-        std::vector<double>& cBasis = *pcaBasisIt;
-        std::vector<double>::iterator cBasisIt(cBasis.begin()), cBasisEnd(cBasis.end());
+        const std::vector<double>& cBasis = *pcaBasisIt;
+        std::vector<double>::const_iterator cBasisIt(cBasis.begin()), cBasisEnd(cBasis.end());
         
         for (; cBasisIt!=cBasisEnd; ++cBasisIt)
         {
@@ -6941,7 +6537,7 @@ void TemplateExplorationWidget::slotSaveSelectedMatches()
         out2 << "\n";
     }
     
-    std::vector<double>::iterator pcaOriginIt(pcaOrigin_.begin()), pcaOriginEnd(pcaOrigin_.end());
+    std::vector<double>::const_iterator pcaOriginIt(engine_.pcaOrigin().begin()), pcaOriginEnd(engine_.pcaOrigin().end());
     
     for (; pcaOriginIt!= pcaOriginEnd; ++pcaOriginIt)
     {
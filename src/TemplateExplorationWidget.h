@@ -7,6 +7,8 @@
 #define WIDGETLEFTPANE_HH
 
 #include <unordered_map>
+#include <memory>
+#include <atomic>
 
 #include <QComboBox>
 #include <QVBoxLayout>
@@ -30,6 +32,10 @@
 #include <QToolButton>
 #include <QSplitter>
 #include <QDateTime>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QMutex>
+#include <QProgressDialog>
 
 #include "nanoflann.h"
 
@@ -51,7 +57,11 @@
 
 
 #include "MatchT.h"
-#include "Matlab.h"
+#include "ComputeBackend.h"
+#include "SpectralEmbedding.h"
+#include "TSNE.h"
+#include "SynthesisEngine.h"
+#include "LRUCache.h"
 #include "TemplateExplorationViewItem.h"
 
 using namespace alglib;
@@ -102,19 +112,6 @@ public:
         
     } ComparePartScoresFunctor;
     
-    struct MatchFunctor
-    {
-        
-        bool operator() (const Match* i,const Match* j)
-        {
-            QString iName = i->filename().split("/").last().split(".").first();
-            QString jName = j->filename().split("/").last().split(".").first();
-            
-            return iName < jName;
-        }
-            
-    } CompareMatchesFunctor;
-
     struct MatchLabelFunctor
     {
         bool operator() (Match* cMatch)
@@ -275,11 +272,30 @@ private slots:
     void slotSetNofNN(const QString& _nofNN);
 
     void slotChangeRecalculateBoxes(int state);
+    
+    void slotToggleFullDescriptorNN(bool _checked);
         
     void slotManuallyChangeSelectedPoint();
     
     void slotOptimizeTemplate();
 
+    // Apply the background synthesis if it is still for the latest selected point, or start one for the latest point if it is not
+    void slotExplorationDataReady();
+
+    // Show the deformed template for the latest hovered point, from the cache or by deforming it on a worker thread
+    void slotUpdateHoverPreview();
+
+    void slotHoverTemplateReady();
+
+    // Move the plot points to the latest layout of the running t-SNE
+    void slotShowTSNEProgress();
+    
+    // The running t-SNE stops at its next progress report and the embedding is not changed
+    void slotCancelTSNE();
+    
+    // Matches that arrived while t-SNE was running, added once it is done
+    void slotAddDeferredMatches();
+
 signals:
     
 //#if defined (APPLE)
@@ -335,6 +351,9 @@ signals:
     void nnUsedChanged(const QString& _nn);
       
     void nIndependentPartsChanged(const QString& _nn);
+
+    // Emitted from the t-SNE worker whenever it has a new layout in tsneLayout_
+    void tsneLayoutChanged();
             
 protected:
     
@@ -402,6 +421,8 @@ protected:
     QCheckBox* chkConstraints_;
             
     QCheckBox* chkColorOverride_;
+    
+    QCheckBox* chkFullDescriptorNN_;
          
     QLineEdit* lnEdtForceNeighbor_;
             
@@ -420,6 +441,56 @@ private:
     void updateViewport( int _explorationMode);
             
     void computeExplorationData(int _explorationMode);
+
+    // Result of synthesising the part options for one selected point on a worker thread
+    struct ExplorationJob
+    {
+        int generation_ = -1;
+        bool ok_ = false;
+        SynthesisEngine::Synthesis synthesis_;
+    };
+
+    // The part option modes are synthesised on a worker thread, so dragging the selected point does not block the GUI
+    bool isExplorationModeAsync(int _explorationMode) const;
+
+    // Start synthesising for the selected point, if a synthesis is already running it is superseded and the latest point is picked up once it finishes
+    void requestExplorationData();
+
+    void startExplorationJob();
+
+    // Runs on the worker thread, loads the part meshes first if asked and afterwards only reads the engine
+    std::shared_ptr<ExplorationJob> runExplorationJob(double _x, double _y, int _generation, bool _preparePartMeshes);
+
+    // The GUI thread may only load part meshes before they are prepared and while no exploration worker could be preparing or reading them
+    bool mayLoadPartMeshes() const;
+
+    // Drop any result that is still to come and wait for the worker, call before changing the engine or computing on the GUI thread
+    void waitForExplorationData();
+
+    void applySynthesis(const SynthesisEngine::Synthesis& _synthesis);
+
+    // Copy the widget's synthesis settings to the engine, waits for the worker if any of them changed
+    void syncEngineOptions();
+
+    // Deformed template boxes for a hovered cell of the embedding
+    struct HoverJob
+    {
+        int generation_ = -1;
+        long long cell_ = 0;
+        bool ok_ = false;
+        std::vector<Match::Part> parts_;
+    };
+
+    // Cell of the hover grid the point falls in, _centre is set to the centre of the cell
+    long long hoverCell(const OpenMesh::Vec2f& _point, OpenMesh::Vec2f& _centre) const;
+
+    // Runs on the worker thread, only reads the engine
+    std::shared_ptr<HoverJob> runHoverJob(double _x, double _y, long long _cell, int _generation, const std::vector<Match::Part>& _parts) const;
+
+    void showHoverTemplate(const std::vector<Match::Part>& _parts);
+
+    // Wait for the hover worker and forget the cached templates, call before changing the embedding or the deformation options
+    void invalidateHoverCache();
        
     void readNormalizationFile(const QString& _filename);
 
@@ -427,25 +498,43 @@ private:
 
     bool filterMatches(int _templateID=-1, int _groupID=-1, int _partID = -1, double _errorThreshold = std::numeric_limits<double>::max(), int _labelID = -1);
 
+    // The template, group, part and fit error tests of filterMatches for a single match
+    bool matchPassesFilter(const Match& _match, int _templateID, int _groupID, int _partID, double _errorThreshold) const;
+
+    // Place the new matches that pass the current filter in the shown embedding without recalculating it, the points already shown do not move
+    void addMatchesToEmbedding(const std::vector<Match*>& _matches);
+
+    // The "mds" routine of the backend, MDS has no deformation basis so the engine only gets the points
     bool calculateMDS();
 
     bool calculatePCA();
 
+    // The backend named by COMPUTE_BACKEND, created on first use
+    ComputeBackend& computeBackend();
+
+    // PCA: the "pca" routine of the backend on the descriptors of _ins[0], its projected_descriptors and deformation_basis are added to _ins
+    bool calculatePrincipalComponents(std::vector<ComputeMatrix>& _ins, int _numMatches, int _numParameters);
+
+    // FAST_SPECTRAL: embed the descriptors of _ins[0] and add the embedding and the linear basis that best explains it as projected_descriptors and deformation_basis
+    bool calculateSpectralEmbedding(std::vector<ComputeMatrix>& _ins, int _numMatches, int _numParameters);
+
+    // TSNE: the same for a t-SNE embedding, which runs on a worker thread while the plot shows the layout forming
+    bool calculateTSNEEmbedding(std::vector<ComputeMatrix>& _ins, int _numMatches, int _numParameters);
+
+    // Runs on the worker thread, hands every intermediate layout to the GUI thread through tsneLayout_
+    bool runTSNE(const std::vector<double>* _descriptors, int _numMatches, int _numParameters, std::vector<double>* _embedding);
+
     void groupMatches();
 
     void setPlotPoints();
 
-    int getNearestPoint(int _level, double _x, double _y);
-
     NEAREST_POINT* getNearestPoint(double _x, double _y, int _numNeighbors);
             
-    void deformNearestMatches(int _numNeighbors);
-    
-    bool deformNearestPart(Match::Part& tmcPart, Match& nearestMatch);
-            
-    void rankNeighborPartsUnary(unsigned int _partID);
+    // Take every part from the nearest neighbour at _neighbourLevel, or from a random one of the first _numNeighbors if _neighbourLevel is negative
+    void deformNearestMatches(int _numNeighbors, int _neighbourLevel = -1);
             
-    double partUnaryScore(const Match::Part& tmPart, const Match::Part& nmcPart);
+    // Rank the nearest neighbours for every template part once per selected point, the part option buttons then only look up nnRanking_
+    void rankNeighborParts();
     
     void showPartDeformationOption(unsigned int _partID, int _symmetricPartID,bool isForward);
     
@@ -456,16 +545,6 @@ private:
     void updateExplorationView();
             
     QToolBar* createMenu();
-    
-    void initChairConstraints();
-    
-    void initBikeConstraints();
-    
-    void initHelicopterConstraints();
-    
-    void initPlaneConstraints();
-    
-    void initPlaneSidConstraints();
             
     ////////////////////////////////////////////////////////////////
     
@@ -483,15 +562,54 @@ private:
     
     Match                  deformedNearestOption_;
     
-    std::vector< std::vector<double> >    pcaBasis_;
+    // Holds the embedding of filteredMatches_ and does the template deformation and part selection, the widget only keeps what it displays
+    SynthesisEngine engine_;
+
+    QFutureWatcher< std::shared_ptr<ExplorationJob> >* explorationWatcher_;
+
+    // Bumped for every selected point, a finished synthesis is only applied if its generation is still the latest
+    int explorationGeneration_ = 0;
+    
+    // A point was selected while the worker was busy, start it once the worker is done
+    bool explorationPending_ = false;
+
+    bool recalculateBoxes_ = false;
+    
+    bool fullDescriptorNN_ = false;
+    
+    // Mouse moves over the plot only record the point, the preview is updated at most once per refresh interval
+    QTimer* hoverTimer_;
+    
+    OpenMesh::Vec2f hoveredPoint_;
     
-    std::vector<double>    pcaOrigin_;
+    QFutureWatcher< std::shared_ptr<HoverJob> >* hoverWatcher_;
+    
+    // Deformed template parts per hover cell
+    LRUCache< long long, std::vector<Match::Part> > hoverCache_;
+    
+    // Bumped whenever the cache is invalidated, results of older generations are not cached
+    int hoverGeneration_ = 0;
+    
+    // Latest layout of the running t-SNE, written by the worker and taken by slotShowTSNEProgress
+    QMutex tsneMutex_;
+    std::vector<double> tsneLayout_;
+    int tsneIteration_ = 0;
+    bool tsneRunning_ = false;
+    
+    std::atomic<bool> tsneCancelled_{false};
+    
+    // Shown while t-SNE runs, modal so that its cancel button is the only input that gets through
+    QProgressDialog* tsneProgress_ = 0;
+    
+    // The folder watch must not change matches_ under the running t-SNE, its matches wait here
+    std::vector<Match*> tsneDeferredMatches_;
+    
+    // Runs PCA, MDS and the clustering of the embedding, see computeBackend()
+    std::unique_ptr<ComputeBackend> computeBackend_;
     
     OpenMesh::Vec2d pcaMin_;
     OpenMesh::Vec2d pcaMax_;
     
-    std::vector<double> avgMatchScale_;
-    
     //unsigned int numMatches_ = 0;
     //int numParameters_ = 0;
     
@@ -530,7 +648,7 @@ private:
     
     int nofNN_ =  NUM_OF_NEAREST_NEIGHBOURS;
     
-    std::unordered_map< int , std::vector< std::pair< int, double> > > nnIndexPartScoreSorted_;
+    SynthesisEngine::PartRanking nnRanking_;
     
     std::unordered_map< int , int > nnPartScoreVectorIndex_;
     
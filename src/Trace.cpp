@@ -0,0 +1,273 @@
+//
+//  Trace.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+#include "Trace.h"
+
+namespace Trace
+{
+    std::atomic<bool> enabled_(false);
+
+    // A trace of a long session stops growing at this many events per thread rather than eating the memory
+    static const size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+    struct Event
+    {
+        const char* name_;
+        long long start_;
+
+        // -1 for an instant event
+        long long duration_;
+    };
+
+    // The mutex is only ever contended while the trace is written
+    struct ThreadBuffer
+    {
+        std::mutex mutex_;
+        std::vector<Event> events_;
+        QString name_;
+        int id_ = 0;
+        size_t nDropped_ = 0;
+
+        // False once its thread has ended
+        bool attached_ = true;
+    };
+
+    // Buffers stay registered after their thread ends, so the pool threads of earlier runs are still in the file
+    // A later thread of the same name takes the buffer over rather than registering one more
+    static std::mutex registryMutex;
+    static std::vector< std::shared_ptr<ThreadBuffer> > registry;
+    static int nextId = 1;
+
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    // Detaches the buffer of a thread when the thread ends
+    struct BufferHandle
+    {
+        ~BufferHandle()
+        {
+            if (buffer_)
+            {
+                std::lock_guard<std::mutex> lock(buffer_->mutex_);
+
+                buffer_->attached_ = false;
+            }
+        }
+
+        std::shared_ptr<ThreadBuffer> buffer_;
+    };
+
+    static BufferHandle& threadHandle()
+    {
+        thread_local BufferHandle handle;
+
+        return handle;
+    }
+
+    // registryMutex has to be held
+    static std::shared_ptr<ThreadBuffer> registerBuffer()
+    {
+        std::shared_ptr<ThreadBuffer> buffer = std::make_shared<ThreadBuffer>();
+
+        buffer->id_ = nextId++;
+
+        registry.push_back(buffer);
+
+        return buffer;
+    }
+
+    static ThreadBuffer& threadBuffer()
+    {
+        BufferHandle& handle = threadHandle();
+
+        if (!handle.buffer_)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+
+            handle.buffer_ = registerBuffer();
+        }
+
+        return *handle.buffer_;
+    }
+
+    static void record(const Event& _event)
+    {
+        ThreadBuffer& buffer = threadBuffer();
+
+        std::lock_guard<std::mutex> lock(buffer.mutex_);
+
+        if (buffer.events_.size() < MAX_EVENTS_PER_THREAD)
+        {
+            buffer.events_.push_back(_event);
+        }
+        else
+        {
+            buffer.nDropped_++;
+        }
+    }
+
+    void setEnabled(bool _enabled)
+    {
+        enabled_.store(_enabled, std::memory_order_relaxed);
+    }
+
+    long long now()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void complete(const char* _name, long long _start, long long _duration)
+    {
+        Event event = { _name, _start, _duration };
+
+        record(event);
+    }
+
+    void instant(const char* _name)
+    {
+        Event event = { _name, now(), -1 };
+
+        record(event);
+    }
+
+    void setThreadName(const QString& _name)
+    {
+        BufferHandle& handle = threadHandle();
+
+        std::lock_guard<std::mutex> registryLock(registryMutex);
+
+        // Worker N of every pool run continues the row of the earlier ones, so the registry stays as small as the pool
+        std::vector< std::shared_ptr<ThreadBuffer> >::iterator itBuffer(registry.begin()), registryEnd(registry.end());
+
+        for (; itBuffer!=registryEnd; ++itBuffer)
+        {
+            std::shared_ptr<ThreadBuffer> buffer = *itBuffer;
+
+            if (buffer == handle.buffer_)
+            {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(buffer->mutex_);
+
+            if (buffer->attached_ || buffer->name_ != _name)
+            {
+                continue;
+            }
+
+            buffer->attached_ = true;
+
+            // Events recorded before the thread was named move along with it
+            if (handle.buffer_)
+            {
+                std::lock_guard<std::mutex> ownLock(handle.buffer_->mutex_);
+
+                buffer->events_.insert(buffer->events_.end(), handle.buffer_->events_.begin(), handle.buffer_->events_.end());
+                buffer->nDropped_ += handle.buffer_->nDropped_;
+
+                handle.buffer_->attached_ = false;
+
+                registry.erase(std::find(registry.begin(), registry.end(), handle.buffer_));
+            }
+
+            handle.buffer_ = buffer;
+
+            return;
+        }
+
+        if (!handle.buffer_)
+        {
+            handle.buffer_ = registerBuffer();
+        }
+
+        std::lock_guard<std::mutex> lock(handle.buffer_->mutex_);
+
+        handle.buffer_->name_ = _name;
+    }
+
+    // Names are literals or set by us, only quotes and backslashes need escaping
+    static QString escaped(const QString& _name)
+    {
+        QString name(_name);
+
+        name.replace("\\", "\\\\");
+        name.replace("\"", "\\\"");
+
+        return name;
+    }
+
+    bool write(const QString& _filename)
+    {
+        std::vector< std::shared_ptr<ThreadBuffer> > buffers;
+
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+
+            buffers = registry;
+        }
+
+        QFile file(_filename);
+
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+            qCritical() << "Could not open file " << _filename;
+            return false;
+        }
+
+        QTextStream out(&file);
+
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+        bool first = true;
+
+        for (size_t b=0; b<buffers.size(); ++b)
+        {
+            ThreadBuffer& buffer = *buffers[b];
+
+            std::lock_guard<std::mutex> lock(buffer.mutex_);
+
+            if (!buffer.name_.isEmpty())
+            {
+                out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer.id_ << ", \"args\": {\"name\": \"" << escaped(buffer.name_) << "\"}}";
+                first = false;
+            }
+
+            std::vector<Event>::const_iterator itEvent(buffer.events_.begin()), eventsEnd(buffer.events_.end());
+
+            for (; itEvent!=eventsEnd; ++itEvent)
+            {
+                out << (first ? "" : ",\n") << "{\"name\": \"" << escaped(itEvent->name_) << "\", \"pid\": 1, \"tid\": " << buffer.id_ << ", \"ts\": " << itEvent->start_;
+
+                if (itEvent->duration_ < 0)
+                {
+                    out << ", \"ph\": \"i\", \"s\": \"t\"}";
+                }
+                else
+                {
+                    out << ", \"ph\": \"X\", \"dur\": " << itEvent->duration_ << "}";
+                }
+
+                first = false;
+            }
+
+            if (buffer.nDropped_ > 0)
+            {
+                qWarning() << "The trace of thread " << buffer.id_ << " is missing its last " << (qulonglong)buffer.nDropped_ << " events";
+            }
+        }
+
+        out << "\n]}\n";
+
+        return out.status() == QTextStream::Ok;
+    }
+}
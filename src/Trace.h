@@ -0,0 +1,83 @@
+//
+//  Trace.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+
+#include <QString>
+
+// Scoped spans of the hot paths, written as a Chrome trace (chrome://tracing, ui.perfetto.dev) on exit
+// Every thread records into its own buffer, so spans cost a clock read on either side and no locking between threads
+// Switched on with TRACE_EVENTS in the config, when off a span is a single relaxed load; building with NO_TRACING removes them altogether
+namespace Trace
+{
+    extern std::atomic<bool> enabled_;
+
+    inline bool enabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool _enabled);
+
+    // Microseconds since the first use of the trace, the time base of all events
+    long long now();
+
+    // _name has to outlive the trace, spans are named with string literals
+    void complete(const char* _name, long long _start, long long _duration);
+
+    void instant(const char* _name);
+
+    // Shown in place of the thread number, copied
+    void setThreadName(const QString& _name);
+
+    // Events of all threads so far, threads still recording may miss the file
+    bool write(const QString& _filename);
+
+    class Span
+    {
+    public:
+
+        explicit Span(const char* _name) : name_(enabled() ? _name : 0)
+        {
+            if (name_)
+            {
+                start_ = now();
+            }
+        }
+
+        ~Span()
+        {
+            if (name_)
+            {
+                complete(name_, start_, now() - start_);
+            }
+        }
+
+    private:
+
+        Span(const Span&);
+        Span& operator=(const Span&);
+
+        const char* name_;
+        long long start_ = 0;
+    };
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef NO_TRACING
+#define TRACE_SPAN(name)
+#define TRACE_INSTANT(name)
+#else
+#define TRACE_SPAN(name) Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#define TRACE_INSTANT(name) do { if (Trace::enabled()) { Trace::instant(name); } } while (0)
+#endif
+
+#endif
@@ -0,0 +1,223 @@
+//
+//  WorkStealingPool.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include "WorkStealingPool.h"
+#include "Trace.h"
+
+WorkStealingPool::WorkStealingPool(int _nThreads)
+{
+    nThreads_ = _nThreads;
+
+    if (nThreads_ <= 0)
+    {
+        nThreads_ = std::thread::hardware_concurrency();
+    }
+
+    if (nThreads_ <= 0)
+    {
+        nThreads_ = 1;
+    }
+
+    std::vector<WorkerQueue>(nThreads_).swap(queues_);
+
+    // The calling thread is worker 0, the others are started once and wait for runs
+    for (int w=1; w<nThreads_; ++w)
+    {
+        threads_.push_back(std::thread(&WorkStealingPool::workerLoop, this, w));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    wake_.notify_all();
+
+    std::vector<std::thread>::iterator it(threads_.begin()), end(threads_.end());
+
+    for (; it!=end; ++it)
+    {
+        it->join();
+    }
+}
+
+int WorkStealingPool::nThreads() const
+{
+    return nThreads_;
+}
+
+WorkStealingPool::Stats WorkStealingPool::run(int _nTasks, const Task& _task)
+{
+    Stats stats;
+
+    stats.tasksPerWorker_.assign(nThreads_, 0);
+
+    if (_nTasks <= 0)
+    {
+        return stats;
+    }
+
+    // Contiguous blocks keep neighbouring samples, which mostly share their nearest matches, on the same thread
+    for (int w=0; w<nThreads_; ++w)
+    {
+        int begin = (long long)_nTasks * w / nThreads_;
+        int end = (long long)_nTasks * (w + 1) / nThreads_;
+
+        for (int t=begin; t<end; ++t)
+        {
+            queues_[w].tasks_.push_back(t);
+        }
+    }
+
+    task_ = &_task;
+    stats_ = &stats;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        nRunning_ = nThreads_ - 1;
+        generation_++;
+    }
+
+    wake_.notify_all();
+
+    work(0);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return nRunning_ == 0; });
+    }
+
+    task_ = 0;
+    stats_ = 0;
+
+    return stats;
+}
+
+void WorkStealingPool::workerLoop(int _worker)
+{
+    int generation = 0;
+
+    bool named = false;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this, generation]() { return stopping_ || generation_ != generation; });
+
+            if (stopping_)
+            {
+                return;
+            }
+
+            generation = generation_;
+        }
+
+        // Named once per thread, on the first run with tracing on
+        if (!named && Trace::enabled())
+        {
+            Trace::setThreadName(QString("Pool worker %1").arg(_worker));
+            named = true;
+        }
+
+        work(_worker);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (--nRunning_ == 0)
+        {
+            done_.notify_one();
+        }
+    }
+}
+
+void WorkStealingPool::work(int _worker)
+{
+    int nDone = 0;
+    int nSteals = 0;
+
+    int taskIndex = -1;
+
+    while (true)
+    {
+        if (!popOwn(queues_[_worker], taskIndex))
+        {
+            if (!steal(_worker, taskIndex))
+            {
+                break;
+            }
+
+            nSteals++;
+        }
+
+        (*task_)(taskIndex, _worker);
+
+        nDone++;
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+
+    stats_->tasksPerWorker_[_worker] = nDone;
+    stats_->steals_ += nSteals;
+}
+
+bool WorkStealingPool::popOwn(WorkerQueue& _queue, int& _taskIndex)
+{
+    std::lock_guard<std::mutex> lock(_queue.mutex_);
+
+    if (_queue.tasks_.empty())
+    {
+        return false;
+    }
+
+    _taskIndex = _queue.tasks_.front();
+    _queue.tasks_.pop_front();
+
+    return true;
+}
+
+bool WorkStealingPool::steal(int _worker, int& _taskIndex)
+{
+    // Tasks are never added once the run has started, so when every other queue looks empty the work is done
+    while (true)
+    {
+        int victim = -1;
+        size_t victimSize = 0;
+
+        for (int w=0; w<queues_.size(); ++w)
+        {
+            if (w == _worker)
+            {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(queues_[w].mutex_);
+
+            if (queues_[w].tasks_.size() > victimSize)
+            {
+                victimSize = queues_[w].tasks_.size();
+                victim = w;
+            }
+        }
+
+        if (victim < 0)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(queues_[victim].mutex_);
+
+        // The victim may have drained its queue since we looked, in which case look again
+        if (!queues_[victim].tasks_.empty())
+        {
+            _taskIndex = queues_[victim].tasks_.back();
+            queues_[victim].tasks_.pop_back();
+            return true;
+        }
+    }
+}
@@ -0,0 +1,86 @@
+//
+//  WorkStealingPool.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+// Runs a range of independent tasks on a fixed number of threads
+// Every worker starts with a contiguous block of the range in its own deque and takes tasks from the front of it, a worker that runs out steals from the back of the busiest other deque, so slow samples do not leave the other threads idle
+// The worker threads live as long as the pool and wait between runs, so a pool can be run in a tight loop
+class WorkStealingPool
+{
+public:
+
+    // _task is called with the task index and the index of the worker that runs it
+    typedef std::function<void(int, int)> Task;
+
+    struct Stats
+    {
+        std::vector<int> tasksPerWorker_;
+        int steals_ = 0;
+    };
+
+    // 0 threads means one per hardware thread
+    explicit WorkStealingPool(int _nThreads = 0);
+
+    ~WorkStealingPool();
+
+    int nThreads() const;
+
+    // Run tasks [0, _nTasks) and return once all of them are done
+    // The calling thread is worker 0, run must not be called from two threads at once
+    Stats run(int _nTasks, const Task& _task);
+
+private:
+
+    struct WorkerQueue
+    {
+        std::mutex mutex_;
+        std::deque<int> tasks_;
+    };
+
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+
+    // Waits for every run and works on it until the pool is destroyed
+    void workerLoop(int _worker);
+
+    void work(int _worker);
+
+    bool popOwn(WorkerQueue& _queue, int& _taskIndex);
+
+    bool steal(int _worker, int& _taskIndex);
+
+
+    // DATA
+    int nThreads_;
+
+    std::vector<std::thread> threads_;
+
+    std::vector<WorkerQueue> queues_;
+
+    // Guards the run state below, the workers wait on wake_ for a new generation and run waits on done_ for them to finish
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+
+    int generation_ = 0;
+    int nRunning_ = 0;
+    bool stopping_ = false;
+
+    // Only valid during a run
+    const Task* task_ = 0;
+    Stats* stats_ = 0;
+    std::mutex statsMutex_;
+};
+
+#endif
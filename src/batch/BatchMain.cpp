@@ -0,0 +1,567 @@
+//
+// BatchMain.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+// Headless synthesis: loads a match collection, embeds every requested group and writes one synthesised model per requested point, without creating any window or GL context
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <chrono>
+
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QDateTime>
+#include <QDebug>
+
+#include "SynthesisEngine.h"
+#include "WorkStealingPool.h"
+#include "global.h"
+
+typedef SynthesisEngine::Match Match;
+
+static bool verbose = false;
+
+// The pool workers log too, a message is written whole before the next one starts
+static std::mutex printMutex;
+
+void printMessage(QtMsgType type, const char *msg)
+{
+    if (type == QtDebugMsg && !verbose)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(printMutex);
+
+    std::cerr << msg << std::endl;
+}
+
+void usage(const char* _name)
+{
+    std::cerr << "Usage: " << _name << " [options] [points file]" << std::endl
+              << std::endl
+              << "Every line of the points file is \"group x y\", x and y are coordinates in the 2D embedding of the group" << std::endl
+              << "Points can also be sampled on a grid with --grid, at least one of the two is needed" << std::endl
+              << "With --split the part meshes of the collection are written instead and no points are needed" << std::endl
+              << std::endl
+              << "Options:" << std::endl
+              << "  -c <file>           config file (default ./config.txt)" << std::endl
+              << "  -i <file>           match collection (default COLLECTION_FILE_PATH of the config file)" << std::endl
+              << "  -o <dir>            output directory (default RESULTS_PATH of the config file)" << std::endl
+              << "  -k <n>              number of nearest neighbours to take parts from (default NUM_OF_NEAREST_NEIGHBOURS)" << std::endl
+              << "  -e <error>          fit error threshold of the matches (default FIT_ERROR)" << std::endl
+              << "  --no-constraints    do not optimise the template to preserve its constraints" << std::endl
+              << "  --format <off|ply>  format of the synthesised models (default SAVED_MODEL_FORMAT of the config file)" << std::endl
+              << "  --grid <g> <nx> <ny>  sample an nx by ny grid over the embedding bounds of group g, can be repeated" << std::endl
+              << "  -j <n>              number of threads (default one per hardware thread)" << std::endl
+              << "  --split             split the mesh of every match and write its part meshes next to it" << std::endl
+              << "  --split-all         same as --split, also for matches whose part meshes are newer than their mesh" << std::endl
+              << "  --max-memory <MB>   with --split, mesh files held in memory at once (default 512)" << std::endl
+              << "  -v                  print debug output" << std::endl;
+}
+
+struct SynthesisPoint
+{
+    int group_;
+    double x_;
+    double y_;
+};
+
+struct GridRequest
+{
+    int nx_;
+    int ny_;
+};
+
+// Sample the embedding bounds of a group on a regular grid, the samples include both bounds
+void appendGridPoints(int _groupID, const GridRequest& _grid, const OpenMesh::Vec2d& _min, const OpenMesh::Vec2d& _max, std::vector<SynthesisPoint>& _points)
+{
+    for (int j=0; j<_grid.ny_; ++j)
+    {
+        double ty = (_grid.ny_ > 1) ? (double)j / (_grid.ny_ - 1) : 0.5;
+
+        for (int i=0; i<_grid.nx_; ++i)
+        {
+            double tx = (_grid.nx_ > 1) ? (double)i / (_grid.nx_ - 1) : 0.5;
+
+            SynthesisPoint p;
+            p.group_ = _groupID;
+            p.x_ = _min[0] + tx * (_max[0] - _min[0]);
+            p.y_ = _min[1] + ty * (_max[1] - _min[1]);
+
+            _points.push_back(p);
+        }
+    }
+}
+
+double percentile(std::vector<double>& _values, double _p)
+{
+    if (_values.empty())
+    {
+        return 0.0;
+    }
+
+    int k = std::min<int>(_values.size() - 1, (int)(_p * _values.size()));
+
+    std::nth_element(_values.begin(), _values.begin() + k, _values.end());
+
+    return _values[k];
+}
+
+bool readPoints(const QString& _filename, std::map<int, std::vector<SynthesisPoint> >& _points)
+{
+    QFile file(_filename);
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qCritical() << "Could not open file " << _filename ;
+        return false;
+    }
+
+    QTextStream in(&file);
+
+    int lineNumber = 0;
+
+    while (!in.atEnd())
+    {
+        QString line = in.readLine().trimmed();
+
+        lineNumber++;
+
+        if (line.isEmpty() || line.startsWith("#"))
+        {
+            continue;
+        }
+
+        QStringList values = line.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+
+        bool okGroup = false, okX = false, okY = false;
+
+        SynthesisPoint p;
+
+        if (values.size() == 3)
+        {
+            p.group_ = values[0].toInt(&okGroup);
+            p.x_ = values[1].toDouble(&okX);
+            p.y_ = values[2].toDouble(&okY);
+        }
+
+        if (!okGroup || !okX || !okY)
+        {
+            qCritical() << "Ignoring malformed line " << lineNumber << " of " << _filename << " : " << line;
+            continue;
+        }
+
+        _points[p.group_].push_back(p);
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    QString configFile("./config.txt");
+    QString collectionFile;
+    QString outputDir;
+    QString pointsFile;
+
+    int nofNN = -1;
+    double errorThreshold = -1.0;
+    bool preserveConstraints = true;
+    int nThreads = 0;
+    QString formatName;
+
+    bool split = false;
+    SynthesisEngine::SegmentationOptions segmentationOptions;
+
+    std::map<int, std::vector<GridRequest> > grids;
+
+    for (int i=1; i<argc; ++i)
+    {
+        QString arg(argv[i]);
+
+        bool hasValue = (i+1 < argc);
+
+        if (arg == "-c" && hasValue)
+        {
+            configFile = argv[++i];
+        }
+        else if (arg == "-i" && hasValue)
+        {
+            collectionFile = argv[++i];
+        }
+        else if (arg == "-o" && hasValue)
+        {
+            outputDir = argv[++i];
+        }
+        else if (arg == "-k" && hasValue)
+        {
+            nofNN = QString(argv[++i]).toInt();
+        }
+        else if (arg == "-e" && hasValue)
+        {
+            errorThreshold = QString(argv[++i]).toDouble();
+        }
+        else if (arg == "--no-constraints")
+        {
+            preserveConstraints = false;
+        }
+        else if (arg == "--format" && hasValue)
+        {
+            formatName = QString(argv[++i]).toLower();
+
+            if (formatName != "off" && formatName != "ply")
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--split" || arg == "--split-all")
+        {
+            split = true;
+            segmentationOptions.skipUpToDate_ = (arg == "--split");
+        }
+        else if (arg == "--max-memory" && hasValue)
+        {
+            segmentationOptions.maxInFlightBytes_ = QString(argv[++i]).toLongLong() << 20;
+        }
+        else if (arg == "-j" && hasValue)
+        {
+            nThreads = QString(argv[++i]).toInt();
+        }
+        else if (arg == "--grid" && i+3 < argc)
+        {
+            int groupID = QString(argv[++i]).toInt();
+
+            GridRequest grid;
+            grid.nx_ = QString(argv[++i]).toInt();
+            grid.ny_ = QString(argv[++i]).toInt();
+
+            if (grid.nx_ <= 0 || grid.ny_ <= 0)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+
+            grids[groupID].push_back(grid);
+        }
+        else if (arg == "-v")
+        {
+            verbose = true;
+        }
+        else if (arg == "-h" || arg == "--help")
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if (!arg.startsWith("-") && pointsFile.isEmpty())
+        {
+            pointsFile = arg;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (pointsFile.isEmpty() && grids.empty() && !split)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    qInstallMsgHandler(printMessage);
+
+    if (!readConfigFile(configFile))
+    {
+        return 1;
+    }
+
+    if (collectionFile.isEmpty())
+    {
+        collectionFile = COLLECTION_FILE_PATH;
+    }
+
+    if (outputDir.isEmpty())
+    {
+        outputDir = RESULTS_PATH;
+    }
+
+    if (!outputDir.endsWith("/"))
+    {
+        outputDir += "/";
+    }
+
+    if (errorThreshold < 0.0)
+    {
+        errorThreshold = FIT_ERROR;
+    }
+
+    MODEL_FORMAT modelFormat = SAVED_MODEL_FORMAT;
+
+    if (!formatName.isEmpty())
+    {
+        modelFormat = (formatName == "ply") ? MODEL_FORMAT_PLY : MODEL_FORMAT_OFF;
+    }
+
+    const QString modelExtension = SynthesisEngine::modelExtension(modelFormat);
+
+    if (split)
+    {
+        std::vector<Match*> matches;
+
+        if (!SynthesisEngine::openMatchCollection(collectionFile, matches))
+        {
+            return 1;
+        }
+
+        segmentationOptions.nThreads_ = nThreads;
+
+        SynthesisEngine::SegmentationStats stats;
+
+        SynthesisEngine::segmentMatches(matches, segmentationOptions, stats);
+
+        QTextStream out(stdout);
+
+        SynthesisEngine::printSegmentationStats(stats, out);
+
+        std::vector<Match*>::iterator itMatch(matches.begin()), matchesEnd(matches.end());
+
+        for (; itMatch!=matchesEnd; ++itMatch)
+        {
+            delete *itMatch;
+        }
+
+        return stats.nFailed_ == 0 ? 0 : 1;
+    }
+
+    std::map<int, std::vector<SynthesisPoint> > points;
+
+    if (!pointsFile.isEmpty() && !readPoints(pointsFile, points))
+    {
+        return 1;
+    }
+
+    // Grid points are only known once the group is embedded, make sure the group gets visited
+    std::map<int, std::vector<GridRequest> >::const_iterator gridIt(grids.begin()), gridEnd(grids.end());
+
+    for (; gridIt!=gridEnd; ++gridIt)
+    {
+        points[gridIt->first];
+    }
+
+    if (points.empty())
+    {
+        qCritical() << "No points to synthesise";
+        return 1;
+    }
+
+    std::vector<Match*> matches;
+
+    if (!SynthesisEngine::openMatchCollection(collectionFile, matches))
+    {
+        return 1;
+    }
+
+    int nGroups = SynthesisEngine::groupMatches(matches);
+
+    QDir().mkpath(outputDir);
+
+    // Every finished model gets a line here as soon as it is written, so a long run can be followed or resumed from it
+    QFile indexFile(outputDir + "synthesis-index.csv");
+
+    if (!indexFile.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        qCritical() << "Could not open file " << indexFile.fileName();
+        return 1;
+    }
+
+    QTextStream index(&indexFile);
+
+    index << "group,sample,x,y,file,neighbors_used,ms\n";
+
+    WorkStealingPool pool(nThreads);
+
+    std::cout << "Synthesising on " << pool.nThreads() << " threads" << std::endl;
+
+    int nSynthesised = 0;
+    int nFailed = 0;
+
+    std::vector<double> sampleTimes;
+
+    std::mutex outputMutex;
+
+    qint64 startTime = QDateTime::currentMSecsSinceEpoch();
+
+    std::map<int, std::vector<SynthesisPoint> >::iterator groupIt(points.begin()), groupEnd(points.end());
+
+    for (; groupIt!=groupEnd; ++groupIt)
+    {
+        int groupID = groupIt->first;
+
+        std::vector<SynthesisPoint>& groupPoints = groupIt->second;
+
+        if (groupID < 0 || groupID >= nGroups)
+        {
+            qCritical() << "Group " << groupID << " does not exist, the collection has " << nGroups << " groups";
+            nFailed += groupPoints.size();
+            continue;
+        }
+
+        std::vector<Match*> groupMatches;
+
+        if (!SynthesisEngine::filterMatches(matches, groupID, errorThreshold, groupMatches))
+        {
+            nFailed += groupPoints.size();
+            continue;
+        }
+
+        SynthesisEngine engine;
+
+        engine.options().preserveConstraints_ = preserveConstraints;
+
+        if (nofNN > 0)
+        {
+            engine.options().nofNN_ = nofNN;
+        }
+
+        engine.setMatches(groupMatches);
+
+        if (!engine.calculatePCA())
+        {
+            nFailed += groupPoints.size();
+            continue;
+        }
+
+        if (grids.count(groupID))
+        {
+            const std::vector<GridRequest>& groupGrids = grids[groupID];
+
+            for (int g=0; g<groupGrids.size(); ++g)
+            {
+                appendGridPoints(groupID, groupGrids[g], engine.pcaMin(), engine.pcaMax(), groupPoints);
+            }
+        }
+
+        // Load everything the workers will read before they start, after this the matches are shared read-only
+        engine.preparePartMeshes();
+
+        std::vector<double> groupTimes(groupPoints.size(), -1.0);
+
+        qint64 groupStartTime = QDateTime::currentMSecsSinceEpoch();
+
+        WorkStealingPool::Stats stats = pool.run(groupPoints.size(), [&](int _sample, int _worker)
+        {
+            const SynthesisPoint& cPoint = groupPoints[_sample];
+
+            std::chrono::steady_clock::time_point sampleStart = std::chrono::steady_clock::now();
+
+            // Each sample has its own template and model, nothing computed here is shared with the other workers
+            SynthesisEngine::Synthesis synthesis;
+
+            QString name = QString("syn-g%1-%2").arg(groupID).arg(_sample);
+
+            if (!engine.synthesize(cPoint.x_, cPoint.y_, synthesis))
+            {
+                qCritical() << "Could not synthesise a model for group " << groupID << " at " << cPoint.x_ << " , " << cPoint.y_;
+                return;
+            }
+
+            QString log;
+            QTextStream logStream(&log);
+
+            engine.saveSynthesisLog(synthesis, logStream);
+
+            logStream.flush();
+
+            // Every sample writes its own files, only the index is shared
+            if (!SynthesisEngine::saveModel(synthesis.model_, outputDir + name + modelExtension, modelFormat))
+            {
+                return;
+            }
+
+            QFile logFile(outputDir + name + ".log.txt");
+
+            if (logFile.open(QIODevice::WriteOnly | QIODevice::Text))
+            {
+                QTextStream out(&logFile);
+                out << log;
+            }
+            else
+            {
+                qCritical() << "Could not open file " << logFile.fileName();
+            }
+
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sampleStart).count();
+
+            groupTimes[_sample] = ms;
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+
+            index << groupID << "," << _sample << "," << cPoint.x_ << "," << cPoint.y_ << "," << name << modelExtension << "," << synthesis.nnUsed_ << "," << ms << "\n";
+            index.flush();
+        });
+
+        qint64 groupElapsed = QDateTime::currentMSecsSinceEpoch() - groupStartTime;
+
+        int groupDone = 0;
+
+        for (int p=0; p<groupTimes.size(); ++p)
+        {
+            if (groupTimes[p] >= 0.0)
+            {
+                sampleTimes.push_back(groupTimes[p]);
+                groupDone++;
+            }
+        }
+
+        nSynthesised += groupDone;
+        nFailed += groupTimes.size() - groupDone;
+
+        std::cout << "Group " << groupID << ": " << groupDone << "/" << groupTimes.size() << " models in " << groupElapsed << " ms";
+
+        if (groupElapsed > 0)
+        {
+            std::cout << " (" << 1000.0 * groupDone / groupElapsed << " models/s)";
+        }
+
+        std::cout << ", " << stats.steals_ << " steals, per thread:";
+
+        for (int w=0; w<stats.tasksPerWorker_.size(); ++w)
+        {
+            std::cout << " " << stats.tasksPerWorker_[w];
+        }
+
+        std::cout << std::endl;
+    }
+
+    qint64 elapsed = QDateTime::currentMSecsSinceEpoch() - startTime;
+
+    std::cout << "Synthesised " << nSynthesised << " models (" << nFailed << " failed) in " << elapsed << " ms";
+
+    if (elapsed > 0)
+    {
+        std::cout << ", " << 1000.0 * nSynthesised / elapsed << " models/s";
+    }
+
+    std::cout << std::endl;
+
+    if (!sampleTimes.empty())
+    {
+        std::cout << "Per model latency: median " << percentile(sampleTimes, 0.5) << " ms, p90 " << percentile(sampleTimes, 0.9) << " ms, max " << percentile(sampleTimes, 1.0) << " ms" << std::endl;
+    }
+
+    std::vector<Match*>::iterator itMatch(matches.begin()), matchesEnd(matches.end());
+
+    for (; itMatch!=matchesEnd; ++itMatch)
+    {
+        delete *itMatch;
+    }
+
+    return nFailed == 0 ? 0 : 2;
+}
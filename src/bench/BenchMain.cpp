@@ -0,0 +1,1185 @@
+//
+// BenchMain.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+// Timings of the synthesis engine on synthetic groups, so changes to its hot paths can be measured without a dataset or a window
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+
+#include <QString>
+#include <QStringList>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+#include "stdafx.h"
+#include "dataanalysis.h"
+
+#include <OpenMesh/Core/IO/MeshIO.hh>
+
+#include "SynthesisEngine.h"
+#include "SyntheticCollection.h"
+#include "OffReader.h"
+#include "MDS.h"
+#include "RandomisedSVD.h"
+#include "LinearAlgebra.h"
+#include "SpectralEmbedding.h"
+#include "TSNE.h"
+#include "MeanShift.h"
+#include "global.h"
+
+typedef SynthesisEngine::Match Match;
+typedef SynthesisEngine::Shape Shape;
+
+static bool verbose = false;
+
+void printMessage(QtMsgType type, const char *msg)
+{
+    if (type == QtDebugMsg && !verbose)
+    {
+        return;
+    }
+
+    std::cerr << msg << std::endl;
+}
+
+void usage(const char* _name)
+{
+    std::cerr << "Usage: " << _name << " <benchmark> [options]" << std::endl
+              << std::endl
+              << "Benchmarks:" << std::endl
+              << "  knn                 nearest neighbour query latency in the 2D embedding and in the full descriptor space, exhaustive and kd-tree 2D search" << std::endl
+              << "  off                 OFF mesh reading throughput, the OpenMesh reader against the memory mapped one" << std::endl
+              << "  mds                 MDS of the synthetic matches, classical (up to 4000 matches) and with landmarks" << std::endl
+              << "  spectral            FAST_SPECTRAL embedding of the synthetic matches, -k sets the neighbours of the graph" << std::endl
+              << "  pca                 randomised PCA of the synthetic matches against the full one of alglib, time, variance error and subspace angle" << std::endl
+              << "  tsne                Barnes-Hut t-SNE of the synthetic matches with the TSNE_PERPLEXITY and TSNE_ITERATIONS of the config" << std::endl
+              << "  pipeline            every stage from opening a synthetic collection written to disk to saving synthesised models, each timed on its own" << std::endl
+              << std::endl
+              << "Options:" << std::endl
+              << "  -c <file>           config file, the defaults of config.txt are used without one" << std::endl
+              << "  -n <n>              number of synthetic matches (default 10000)" << std::endl
+              << "  -p <n>              number of parts per match (default 6)" << std::endl
+              << "  -m <n>              number of mesh points per match in the collection (default 100)" << std::endl
+              << "  -t <n>              number of triangles per part mesh in the collection (default 500)" << std::endl
+              << "  -g <n>              number of groups in the collection (default 1)" << std::endl
+              << "  -k <n>              number of nearest neighbours (default 10)" << std::endl
+              << "  -q <n>              number of queries (default 1000)" << std::endl
+              << "  -s <n>              random seed (default 1)" << std::endl
+              << "  -f <file>           mesh file to read, can be repeated, a synthetic grid is written to the temporary directory without one" << std::endl
+              << "  -r <n>              number of times every file is read and every whole collection stage is run (default 5)" << std::endl
+              << "  -d <dir>            directory the collection is written to, the temporary directory without one" << std::endl
+              << "  -j <file>           also write the pipeline timings to a JSON file" << std::endl
+              << "  -v                  print debug output" << std::endl;
+}
+
+struct BenchOptions
+{
+    SyntheticCollectionParams collection_;
+    int nofNN_ = 10;
+    int nQueries_ = 1000;
+    QStringList meshFiles_;
+    int nRepeats_ = 5;
+    QString directory_;
+    QString jsonFile_;
+};
+
+double percentile(std::vector<double>& _values, double _p)
+{
+    if (_values.empty())
+    {
+        return 0.0;
+    }
+
+    int k = std::min<int>(_values.size() - 1, (int)(_p * _values.size()));
+
+    std::nth_element(_values.begin(), _values.begin() + k, _values.end());
+
+    return _values[k];
+}
+
+void printLatencies(const char* _name, std::vector<double>& _us)
+{
+    std::cout << _name << ": median " << percentile(_us, 0.5) << " us, p90 " << percentile(_us, 0.9) << " us, p99 " << percentile(_us, 0.99) << " us, max " << percentile(_us, 1.0) << " us" << std::endl;
+}
+
+double elapsedUs(const std::chrono::steady_clock::time_point& _start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - _start).count();
+}
+
+// The config file would set these, the values are those of config.txt
+void setDefaultGlobals()
+{
+    LOADED_DATASET = CHAIRS;
+    NUM_OF_NEAREST_NEIGHBOURS = 10;
+    NUM_PARAMS_BOX = 6;
+    NUM_PARAMS_POS = 3;
+    NUM_EQUATIONS_SYMMETRY = 7;
+    NUM_EQUATIONS_CONTACT = 3;
+    MESH_PATH = "meshes-segmented-aligned";
+    FIT_ERROR = 30;
+    SAVED_MODEL_FORMAT = MODEL_FORMAT_OFF;
+}
+
+void deleteMatches(std::vector<Match*>& _matches)
+{
+    std::vector<Match*>::iterator itMatch(_matches.begin()), matchesEnd(_matches.end());
+
+    for (; itMatch!=matchesEnd; ++itMatch)
+    {
+        delete *itMatch;
+    }
+
+    _matches.clear();
+}
+
+// Deletes the matches however the benchmark returns
+struct MatchesGuard
+{
+    explicit MatchesGuard(std::vector<Match*>& _matches) : matches_(_matches) {}
+    ~MatchesGuard() { deleteMatches(matches_); }
+
+    std::vector<Match*>& matches_;
+};
+
+int benchKnn(const BenchOptions& _options)
+{
+    std::vector<Match*> matches;
+    MatchesGuard matchesGuard(matches);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    generateSyntheticMatches(_options.collection_, matches);
+
+    std::cout << "Generated " << matches.size() << " matches with " << _options.collection_.nParts_ << " parts in " << elapsedUs(start) / 1000.0 << " ms" << std::endl;
+
+    SynthesisEngine engine;
+
+    // The constraints of the configured dataset do not refer to the synthetic parts
+    engine.options().preserveConstraints_ = false;
+    engine.options().nofNN_ = _options.nofNN_;
+
+    engine.setMatches(matches);
+
+    start = std::chrono::steady_clock::now();
+
+    // Builds both the 2D and the full descriptor trees
+    if (!engine.calculatePCA())
+    {
+        return 1;
+    }
+
+    std::cout << "PCA and indices in " << elapsedUs(start) / 1000.0 << " ms, full descriptor has " << engine.descriptorSize() << " dimensions" << std::endl;
+
+    std::mt19937 rng(_options.collection_.seed_ + 1);
+
+    std::uniform_real_distribution<double> ux(engine.pcaMin()[0], engine.pcaMax()[0]);
+    std::uniform_real_distribution<double> uy(engine.pcaMin()[1], engine.pcaMax()[1]);
+
+    std::vector<double> times2D, timesFull, timesFullWithDeform;
+
+    // Queries that pass the deformed template, so the deformation is not part of the full descriptor timing
+    Match tm;
+
+    tm.setParts(engine.templateMatch().parts());
+    tm.setNparts(tm.parts().size());
+
+    double checksum = 0.0;
+
+    for (int q=0; q<_options.nQueries_; ++q)
+    {
+        double x = ux(rng);
+        double y = uy(rng);
+
+        engine.options().fullDescriptorSearch_ = false;
+
+        start = std::chrono::steady_clock::now();
+
+        std::vector<NEAREST_POINT> nearest = engine.nearestPoints(x, y, _options.nofNN_);
+
+        times2D.push_back(elapsedUs(start));
+
+        checksum += nearest[0].distance_;
+
+        engine.deformTemplate(x, y, tm);
+
+        start = std::chrono::steady_clock::now();
+
+        nearest = engine.nearestPoints(tm, _options.nofNN_);
+
+        timesFull.push_back(elapsedUs(start));
+
+        checksum += nearest[0].distance_;
+
+        engine.options().fullDescriptorSearch_ = true;
+
+        start = std::chrono::steady_clock::now();
+
+        nearest = engine.nearestPoints(x, y, _options.nofNN_);
+
+        timesFullWithDeform.push_back(elapsedUs(start));
+
+        checksum += nearest[0].distance_;
+    }
+
+    std::cout << _options.nQueries_ << " queries for " << _options.nofNN_ << " neighbours (checksum " << checksum << ")" << std::endl;
+
+    printLatencies("2D embedding", times2D);
+    printLatencies("Full descriptor", timesFull);
+    printLatencies("Full descriptor, deforming the template", timesFullWithDeform);
+
+    // The same 2D queries with the search forced to one side of the threshold
+    std::cout << "Exhaustive search below " << SynthesisEngine::bruteForceThreshold() << " points, measured on this machine: KNN_BRUTE_FORCE_THRESHOLD = " << SynthesisEngine::calibrateBruteForceThreshold() << std::endl;
+
+    engine.options().fullDescriptorSearch_ = false;
+
+    std::vector<OpenMesh::Vec2f> points2D = engine.points2D();
+
+    const int thresholds[2] = { std::numeric_limits<int>::max(), 0 };
+    const char* names[2] = { "2D embedding, exhaustive", "2D embedding, kd-tree" };
+
+    for (int t=0; t<2; ++t)
+    {
+        SynthesisEngine::setBruteForceThreshold(thresholds[t]);
+
+        start = std::chrono::steady_clock::now();
+
+        engine.setPoints2D(points2D);
+
+        std::cout << names[t] << " index in " << elapsedUs(start) / 1000.0 << " ms" << std::endl;
+
+        rng.seed(_options.collection_.seed_ + 1);
+
+        std::vector<double> times;
+
+        for (int q=0; q<_options.nQueries_; ++q)
+        {
+            double x = ux(rng);
+            double y = uy(rng);
+
+            start = std::chrono::steady_clock::now();
+
+            std::vector<NEAREST_POINT> nearest = engine.nearestPoints(x, y, _options.nofNN_);
+
+            times.push_back(elapsedUs(start));
+
+            checksum += nearest[0].distance_;
+        }
+
+        printLatencies(names[t], times);
+    }
+
+    SynthesisEngine::setBruteForceThreshold(-1);
+
+    return 0;
+}
+
+// Height field of _resolution x _resolution vertices, about the size of a large part mesh
+QString writeSyntheticOffMesh(int _resolution)
+{
+    TriangleMesh mesh;
+
+    std::vector<TriangleMesh::VertexHandle> vertices(_resolution * _resolution);
+
+    for (int i=0; i<_resolution; ++i)
+    {
+        for (int j=0; j<_resolution; ++j)
+        {
+            float x = (float)i / (_resolution - 1);
+            float z = (float)j / (_resolution - 1);
+
+            vertices[i * _resolution + j] = mesh.add_vertex(TriangleMesh::Point(x, 0.1f * std::sin(10.0f * x) * std::cos(7.0f * z), z));
+        }
+    }
+
+    for (int i=0; i+1<_resolution; ++i)
+    {
+        for (int j=0; j+1<_resolution; ++j)
+        {
+            mesh.add_face(vertices[i * _resolution + j], vertices[(i + 1) * _resolution + j], vertices[(i + 1) * _resolution + j + 1]);
+            mesh.add_face(vertices[i * _resolution + j], vertices[(i + 1) * _resolution + j + 1], vertices[i * _resolution + j + 1]);
+        }
+    }
+
+    QString filename = QDir::temp().filePath("shapesynth-bench-grid.off");
+
+    if (!OpenMesh::IO::write_mesh(mesh, filename.toStdString()))
+    {
+        qCritical() << "Cannot write " << filename;
+        return QString();
+    }
+
+    return filename;
+}
+
+int benchOff(const BenchOptions& _options)
+{
+    QStringList files = _options.meshFiles_;
+
+    if (files.isEmpty())
+    {
+        QString filename = writeSyntheticOffMesh(512);
+
+        if (filename.isEmpty())
+        {
+            return 1;
+        }
+
+        files << filename;
+    }
+
+    QStringList::const_iterator itFile(files.begin()), filesEnd(files.end());
+
+    for (; itFile!=filesEnd; ++itFile)
+    {
+        QByteArray filename = itFile->toLocal8Bit();
+
+        double megabytes = QFileInfo(*itFile).size() / (1024.0 * 1024.0);
+
+        std::vector<double> timesOpenMesh, timesParse, timesShape;
+
+        size_t nFaces = 0;
+
+        for (int r=0; r<_options.nRepeats_; ++r)
+        {
+            // What ShapeT::openMesh did before it had its own reader
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            TriangleMesh mesh;
+
+            mesh.request_face_normals();
+            mesh.request_vertex_normals();
+
+            OpenMesh::IO::Options opt;
+
+            opt += OpenMesh::IO::Options::VertexNormal;
+            opt += OpenMesh::IO::Options::FaceNormal;
+
+            if (!OpenMesh::IO::read_mesh(mesh, filename.constData(), opt, false))
+            {
+                qCritical() << "Cannot read " << *itFile;
+                return 1;
+            }
+
+            mesh.update_face_normals();
+            mesh.update_vertex_normals();
+
+            timesOpenMesh.push_back(elapsedUs(start));
+
+            start = std::chrono::steady_clock::now();
+
+            OffData data;
+
+            if (!readOffFile(filename.constData(), data))
+            {
+                qCritical() << "The fast reader cannot read " << *itFile;
+                return 1;
+            }
+
+            timesParse.push_back(elapsedUs(start));
+
+            start = std::chrono::steady_clock::now();
+
+            Shape shape;
+
+            shape.openMesh(filename.constData());
+
+            timesShape.push_back(elapsedUs(start));
+
+            nFaces = shape.mesh().n_faces();
+
+            if (nFaces != mesh.n_faces())
+            {
+                qWarning() << "The readers disagree on the faces of " << *itFile << ": " << mesh.n_faces() << " and " << nFaces;
+            }
+        }
+
+        std::cout << itFile->toStdString() << ": " << megabytes << " MB, " << nFaces << " faces" << std::endl;
+
+        const char* names[3] = { "OpenMesh reader", "Memory mapped parse", "Memory mapped parse and mesh build" };
+        std::vector<double>* times[3] = { &timesOpenMesh, &timesParse, &timesShape };
+
+        for (int i=0; i<3; ++i)
+        {
+            double medianUs = percentile(*times[i], 0.5);
+
+            std::cout << names[i] << ": median " << medianUs / 1000.0 << " ms, " << megabytes / (medianUs * 1e-6) << " MB/s" << std::endl;
+        }
+    }
+
+    return 0;
+}
+
+// The bounding box descriptors of TemplateExplorationWidget for the synthetic matches, row after row
+bool syntheticBoxDescriptors(const BenchOptions& _options, std::vector<double>& _descriptors)
+{
+    std::vector<Match*> matches;
+
+    generateSyntheticMatches(_options.collection_, matches);
+
+    const int nMatches = matches.size();
+    const int nColumns = 6 * _options.collection_.nParts_;
+
+    _descriptors.clear();
+    _descriptors.reserve((size_t)nMatches * nColumns);
+
+    for (int i=0; i<nMatches; ++i)
+    {
+        const std::vector<Match::Part>& mParts = matches[i]->parts();
+
+        for (int p=0; p<mParts.size(); ++p)
+        {
+            OpenMesh::Vec3f min = mParts[p].pos_ - mParts[p].scale_;
+            OpenMesh::Vec3f max = mParts[p].pos_ + mParts[p].scale_;
+
+            _descriptors.insert(_descriptors.end(), min.data(), min.data() + 3);
+            _descriptors.insert(_descriptors.end(), max.data(), max.data() + 3);
+        }
+
+        delete matches[i];
+    }
+
+    if (_descriptors.size() != (size_t)nMatches * nColumns)
+    {
+        qCritical() << "The synthetic matches do not all have " << _options.collection_.nParts_ << " parts";
+        return false;
+    }
+
+    return true;
+}
+
+int benchMds(const BenchOptions& _options)
+{
+    std::vector<double> descriptors;
+
+    if (!syntheticBoxDescriptors(_options, descriptors))
+    {
+        return 1;
+    }
+
+    const int nMatches = _options.collection_.nMatches_;
+    const int nColumns = 6 * _options.collection_.nParts_;
+
+    const int landmarks[4] = { 0, 64, 256, 1024 };
+
+    for (int l=0; l<4; ++l)
+    {
+        MDSOptions mdsOptions;
+
+        // Classical MDS keeps the whole distance matrix
+        if (landmarks[l] == 0)
+        {
+            if (nMatches > 4000)
+            {
+                continue;
+            }
+
+            mdsOptions.maxClassical_ = nMatches;
+        }
+        else
+        {
+            mdsOptions.maxClassical_ = 0;
+            mdsOptions.nLandmarks_ = landmarks[l];
+        }
+
+        std::vector<double> times;
+        std::vector<double> embedding;
+
+        for (int r=0; r<_options.nRepeats_; ++r)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            if (!computeMDS(descriptors, nMatches, nColumns, embedding, mdsOptions))
+            {
+                return 1;
+            }
+
+            times.push_back(elapsedUs(start));
+        }
+
+        if (landmarks[l] == 0)
+        {
+            std::cout << "Classical MDS of " << nMatches << " matches: median " << percentile(times, 0.5) / 1000.0 << " ms" << std::endl;
+        }
+        else
+        {
+            std::cout << "Landmark MDS of " << nMatches << " matches with " << landmarks[l] << " landmarks: median " << percentile(times, 0.5) / 1000.0 << " ms" << std::endl;
+        }
+    }
+
+    return 0;
+}
+
+int benchSpectral(const BenchOptions& _options)
+{
+    std::vector<double> descriptors;
+
+    if (!syntheticBoxDescriptors(_options, descriptors))
+    {
+        return 1;
+    }
+
+    const int nMatches = _options.collection_.nMatches_;
+    const int nColumns = 6 * _options.collection_.nParts_;
+
+    SpectralOptions spectralOptions;
+    spectralOptions.nNeighbours_ = _options.nofNN_;
+
+    std::vector<double> times;
+    std::vector<double> embedding;
+
+    for (int r=0; r<_options.nRepeats_; ++r)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if (!computeSpectralEmbedding(descriptors, nMatches, nColumns, embedding, spectralOptions))
+        {
+            return 1;
+        }
+
+        times.push_back(elapsedUs(start));
+    }
+
+    std::cout << "Spectral embedding of " << nMatches << " matches with " << spectralOptions.nNeighbours_ << " neighbours: median " << percentile(times, 0.5) / 1000.0 << " ms" << std::endl;
+
+    return 0;
+}
+
+// Largest principal angle in degrees between the spans of the _k orthonormal rows of _a and _b
+double subspaceAngle(const std::vector<double>& _a, const std::vector<double>& _b, int _k, int _nColumns)
+{
+    // The cosines of the principal angles are the singular values of A B'
+    std::vector<double> m(_k * _k, 0.0);
+
+    for (int r=0; r<_k; ++r)
+    {
+        for (int c=0; c<_k; ++c)
+        {
+            for (int j=0; j<_nColumns; ++j)
+            {
+                m[r * _k + c] += _a[(size_t)r * _nColumns + j] * _b[(size_t)c * _nColumns + j];
+            }
+        }
+    }
+
+    std::vector<double> mmt(_k * _k, 0.0);
+
+    for (int r=0; r<_k; ++r)
+    {
+        for (int c=0; c<_k; ++c)
+        {
+            for (int l=0; l<_k; ++l)
+            {
+                mmt[r * _k + c] += m[r * _k + l] * m[c * _k + l];
+            }
+        }
+    }
+
+    std::vector<double> values, vectors;
+
+    symmetricEigen(_k, mmt, values, vectors);
+
+    double cosine = std::sqrt(std::max(0.0, std::min(1.0, values[_k - 1])));
+
+    return std::acos(cosine) * 180.0 / std::acos(-1.0);
+}
+
+int benchPca(const BenchOptions& _options)
+{
+    std::vector<double> descriptors;
+
+    if (!syntheticBoxDescriptors(_options, descriptors))
+    {
+        return 1;
+    }
+
+    const int nMatches = _options.collection_.nMatches_;
+    const int nColumns = 6 * _options.collection_.nParts_;
+
+    // The embedding shows two components, a few more check that the ones after them are found as well
+    const int k = std::min(4, nColumns);
+
+    // Reference: the full SVD of alglib, as SynthesisEngine::calculatePCA used to do it
+    alglib::real_2d_array data;
+    data.setlength(nMatches, nColumns);
+
+    for (int i=0; i<nMatches; ++i)
+    {
+        for (int j=0; j<nColumns; ++j)
+        {
+            data[i][j] = descriptors[(size_t)i * nColumns + j];
+        }
+    }
+
+    std::vector<double> times;
+
+    alglib::ae_int_t info = 0;
+    alglib::real_1d_array exactVariances;
+    alglib::real_2d_array basis;
+
+    for (int r=0; r<_options.nRepeats_; ++r)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        alglib::pcabuildbasis(data, nMatches, nColumns, info, exactVariances, basis);
+
+        times.push_back(elapsedUs(start));
+    }
+
+    if (info != 1)
+    {
+        std::cerr << "Full PCA failed with code " << (int)info << std::endl;
+        return 1;
+    }
+
+    std::cout << "Full PCA of " << nMatches << " matches with " << nColumns << " parameters: median " << percentile(times, 0.5) / 1000.0 << " ms" << std::endl;
+
+    std::vector<double> exactComponents((size_t)k * nColumns);
+
+    for (int c=0; c<k; ++c)
+    {
+        for (int j=0; j<nColumns; ++j)
+        {
+            exactComponents[(size_t)c * nColumns + j] = basis[j][c];
+        }
+    }
+
+    bool accurate = true;
+
+    for (int powerIterations=0; powerIterations<=2; ++powerIterations)
+    {
+        SVDOptions svdOptions;
+        svdOptions.nPowerIterations_ = powerIterations;
+        svdOptions.seed_ = _options.collection_.seed_;
+
+        std::vector<double> mean, components, variances;
+
+        times.clear();
+
+        for (int r=0; r<_options.nRepeats_; ++r)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            if (!principalComponents(descriptors, nMatches, nColumns, k, mean, components, variances, svdOptions))
+            {
+                return 1;
+            }
+
+            times.push_back(elapsedUs(start));
+        }
+
+        double varianceError = 0.0;
+
+        for (int c=0; c<k; ++c)
+        {
+            varianceError = std::max(varianceError, std::fabs(variances[c] - exactVariances[c]) / std::max(exactVariances[c], std::numeric_limits<double>::min()));
+        }
+
+        const double angle2 = subspaceAngle(components, exactComponents, std::min(2, k), nColumns);
+        const double anglek = subspaceAngle(components, exactComponents, k, nColumns);
+
+        std::cout << "Randomised PCA of " << k << " components with " << powerIterations << " power iterations: median " << percentile(times, 0.5) / 1000.0 << " ms, "
+                  << "variance error " << varianceError << ", angle to the full PCA " << angle2 << " degrees for the shown plane and " << anglek << " for all " << k << std::endl;
+
+        // The default number of power iterations is the one the application runs with
+        if (powerIterations == SVDOptions().nPowerIterations_ && (varianceError > 1e-3 || angle2 > 1.0))
+        {
+            accurate = false;
+        }
+    }
+
+    if (!accurate)
+    {
+        std::cerr << "The randomised PCA does not match the full one!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int benchTsne(const BenchOptions& _options)
+{
+    std::vector<double> descriptors;
+
+    if (!syntheticBoxDescriptors(_options, descriptors))
+    {
+        return 1;
+    }
+
+    const int nMatches = _options.collection_.nMatches_;
+    const int nColumns = 6 * _options.collection_.nParts_;
+
+    TSNEOptions tsneOptions;
+    tsneOptions.perplexity_ = TSNE_PERPLEXITY;
+    tsneOptions.nIterations_ = TSNE_ITERATIONS;
+
+    std::vector<double> times;
+    std::vector<double> embedding;
+
+    for (int r=0; r<_options.nRepeats_; ++r)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if (!computeTSNE(descriptors, nMatches, nColumns, embedding, tsneOptions))
+        {
+            return 1;
+        }
+
+        times.push_back(elapsedUs(start));
+    }
+
+    std::cout << "t-SNE of " << nMatches << " matches with perplexity " << tsneOptions.perplexity_ << " and " << tsneOptions.nIterations_ << " iterations: median " << percentile(times, 0.5) / 1000.0 << " ms" << std::endl;
+
+    return 0;
+}
+
+typedef std::vector< std::pair<std::string, std::vector<double> > > StageTimes;
+
+// Count, mean and percentiles of every stage, for scripts comparing runs
+bool writeStageTimes(const QString& _filename, const BenchOptions& _options, StageTimes& _stages)
+{
+    std::ofstream out(_filename.toLocal8Bit().constData());
+
+    if (!out)
+    {
+        qCritical() << "Cannot write " << _filename;
+        return false;
+    }
+
+    const SyntheticCollectionParams& params = _options.collection_;
+
+    out << "{" << std::endl
+        << "  \"benchmark\": \"pipeline\"," << std::endl
+        << "  \"matches\": " << params.nMatches_ << "," << std::endl
+        << "  \"parts\": " << params.nParts_ << "," << std::endl
+        << "  \"points\": " << params.nPoints_ << "," << std::endl
+        << "  \"triangles_per_part\": " << params.nTrianglesPerPart_ << "," << std::endl
+        << "  \"groups\": " << params.nGroups_ << "," << std::endl
+        << "  \"seed\": " << params.seed_ << "," << std::endl
+        << "  \"neighbours\": " << _options.nofNN_ << "," << std::endl
+        << "  \"queries\": " << _options.nQueries_ << "," << std::endl
+        << "  \"repeats\": " << _options.nRepeats_ << "," << std::endl
+        << "  \"stages\": [" << std::endl;
+
+    for (size_t s=0; s<_stages.size(); ++s)
+    {
+        std::vector<double>& us = _stages[s].second;
+
+        double mean = us.empty() ? 0.0 : std::accumulate(us.begin(), us.end(), 0.0) / us.size();
+
+        out << "    { \"name\": \"" << _stages[s].first << "\", \"count\": " << us.size() << ", \"mean_us\": " << mean
+            << ", \"median_us\": " << percentile(us, 0.5) << ", \"p90_us\": " << percentile(us, 0.9) << ", \"p99_us\": " << percentile(us, 0.99)
+            << ", \"max_us\": " << percentile(us, 1.0) << " }" << (s+1 < _stages.size() ? "," : "") << std::endl;
+    }
+
+    out << "  ]" << std::endl
+        << "}" << std::endl;
+
+    return out.good();
+}
+
+// The stages of the exploration in the order the application runs them, on a collection read back from disk
+// Stages over the whole collection run -r times, those of a point in the embedding once per query, part loading once per match
+int benchPipeline(const BenchOptions& _options)
+{
+    const SyntheticCollectionParams& params = _options.collection_;
+
+    QDir dir(_options.directory_.isEmpty() ? QDir::tempPath() : _options.directory_);
+
+    QString collectionFile = dir.filePath("shapesynth-bench.match_coll");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (!writeSyntheticCollection(params, collectionFile))
+    {
+        return 1;
+    }
+
+    std::cout << "Wrote " << params.nMatches_ << " matches with " << params.nParts_ << " part meshes of " << params.nTrianglesPerPart_ << " triangles to " << collectionFile.toStdString() << " in " << elapsedUs(start) / 1000.0 << " ms" << std::endl;
+
+    StageTimes stages;
+
+    std::vector<double> times;
+
+    std::vector<Match*> matches;
+    MatchesGuard matchesGuard(matches);
+
+    for (int r=0; r<_options.nRepeats_; ++r)
+    {
+        deleteMatches(matches);
+
+        start = std::chrono::steady_clock::now();
+
+        if (!SynthesisEngine::openMatchCollection(collectionFile, matches))
+        {
+            return 1;
+        }
+
+        times.push_back(elapsedUs(start));
+    }
+
+    stages.push_back(std::make_pair(std::string("collection parse"), times));
+
+    times.clear();
+
+    for (int r=0; r<_options.nRepeats_; ++r)
+    {
+        start = std::chrono::steady_clock::now();
+
+        SynthesisEngine::groupMatches(matches);
+
+        times.push_back(elapsedUs(start));
+    }
+
+    stages.push_back(std::make_pair(std::string("grouping"), times));
+
+    // Grouping sorts by name, so this is the group of synthetic-0, generated with the part IDs syntheticConstraints refers to
+    int groupID = matches.front()->groupID();
+
+    std::vector<Match*> filtered;
+
+    times.clear();
+
+    for (int r=0; r<_options.nRepeats_; ++r)
+    {
+        start = std::chrono::steady_clock::now();
+
+        SynthesisEngine::filterMatches(matches, groupID, FIT_ERROR, filtered);
+
+        times.push_back(elapsedUs(start));
+    }
+
+    stages.push_back(std::make_pair(std::string("filtering"), times));
+
+    if ((int)filtered.size() < _options.nofNN_)
+    {
+        qCritical() << "Only " << (int)filtered.size() << " matches of group " << groupID << " have a fit error below " << FIT_ERROR;
+        return 1;
+    }
+
+    std::cout << filtered.size() << " of " << matches.size() << " matches in group " << groupID << " below the fit error threshold" << std::endl;
+
+    SynthesisEngine engine;
+
+    engine.options().nofNN_ = _options.nofNN_;
+
+    syntheticConstraints(params, engine.templateMatch().constraints());
+
+    times.clear();
+
+    for (int r=0; r<_options.nRepeats_; ++r)
+    {
+        start = std::chrono::steady_clock::now();
+
+        engine.setMatches(filtered);
+
+        if (!engine.calculatePCA())
+        {
+            return 1;
+        }
+
+        times.push_back(elapsedUs(start));
+    }
+
+    stages.push_back(std::make_pair(std::string("embedding"), times));
+
+    const std::vector<OpenMesh::Vec2f>& points2D = engine.points2D();
+
+    std::vector<double> embedding(points2D.size() * 2);
+
+    for (size_t i=0; i<points2D.size(); ++i)
+    {
+        embedding[2 * i] = points2D[i][0];
+        embedding[2 * i + 1] = points2D[i][1];
+    }
+
+    std::vector<double> centres;
+    std::vector<int> labels;
+
+    times.clear();
+
+    for (int r=0; r<_options.nRepeats_; ++r)
+    {
+        start = std::chrono::steady_clock::now();
+
+        if (!clusterEmbedding(embedding, points2D.size(), 2, centres, labels))
+        {
+            return 1;
+        }
+
+        times.push_back(elapsedUs(start));
+    }
+
+    stages.push_back(std::make_pair(std::string("clustering"), times));
+
+    std::mt19937 rng(params.seed_ + 2);
+
+    std::uniform_real_distribution<double> ux(engine.pcaMin()[0], engine.pcaMax()[0]);
+    std::uniform_real_distribution<double> uy(engine.pcaMin()[1], engine.pcaMax()[1]);
+
+    std::vector<double> timesKnn, timesDeform, timesOptimise;
+
+    Match tm;
+
+    double checksum = 0.0;
+
+    for (int q=0; q<_options.nQueries_; ++q)
+    {
+        double x = ux(rng);
+        double y = uy(rng);
+
+        start = std::chrono::steady_clock::now();
+
+        std::vector<NEAREST_POINT> nearest = engine.nearestPoints(x, y, _options.nofNN_);
+
+        timesKnn.push_back(elapsedUs(start));
+
+        checksum += nearest[0].distance_;
+
+        tm.setParts(engine.templateMatch().parts());
+        tm.setNparts(tm.parts().size());
+
+        start = std::chrono::steady_clock::now();
+
+        engine.deformTemplate(x, y, tm);
+
+        timesDeform.push_back(elapsedUs(start));
+
+        start = std::chrono::steady_clock::now();
+
+        engine.optimizeTemplate(tm);
+
+        timesOptimise.push_back(elapsedUs(start));
+
+        checksum += tm.parts()[0].pos_[0];
+    }
+
+    stages.push_back(std::make_pair(std::string("knn"), timesKnn));
+    stages.push_back(std::make_pair(std::string("template deformation"), timesDeform));
+    stages.push_back(std::make_pair(std::string("constraint optimisation"), timesOptimise));
+
+    times.clear();
+
+    std::vector<Match*>::iterator itMatch(filtered.begin()), filteredEnd(filtered.end());
+
+    for (; itMatch!=filteredEnd; ++itMatch)
+    {
+        start = std::chrono::steady_clock::now();
+
+        (**itMatch).openPartMeshes();
+
+        times.push_back(elapsedUs(start));
+    }
+
+    stages.push_back(std::make_pair(std::string("part loading"), times));
+
+    // Everything is loaded, so the synthesis below does not read any mesh
+    engine.preparePartMeshes();
+
+    QString modelFile = dir.filePath("shapesynth-bench-model" + SynthesisEngine::modelExtension(SAVED_MODEL_FORMAT));
+
+    std::vector<double> timesPart, timesSynthesis, timesSave;
+
+    SynthesisEngine::Synthesis synthesis;
+
+    for (int q=0; q<_options.nQueries_; ++q)
+    {
+        double x = ux(rng);
+        double y = uy(rng);
+
+        start = std::chrono::steady_clock::now();
+
+        if (!engine.synthesize(x, y, synthesis))
+        {
+            return 1;
+        }
+
+        timesSynthesis.push_back(elapsedUs(start));
+
+        // The deformation of every part on its own, from the nearest neighbour
+        Match& nearestMatch = *engine.matches()[synthesis.nearestPoints_[0].index_];
+
+        const std::vector<Match::Part>& tmParts = synthesis.templateMatch_.parts();
+
+        for (size_t p=0; p<tmParts.size(); ++p)
+        {
+            Match::Part part = tmParts[p];
+
+            start = std::chrono::steady_clock::now();
+
+            SynthesisEngine::deformNearestPart(part, nearestMatch, false);
+
+            timesPart.push_back(elapsedUs(start));
+
+            checksum += part.partShape_.mesh().n_vertices();
+        }
+
+        start = std::chrono::steady_clock::now();
+
+        if (!SynthesisEngine::saveModel(synthesis.model_, modelFile, SAVED_MODEL_FORMAT))
+        {
+            return 1;
+        }
+
+        timesSave.push_back(elapsedUs(start));
+    }
+
+    stages.push_back(std::make_pair(std::string("part deformation"), timesPart));
+    stages.push_back(std::make_pair(std::string("synthesis"), timesSynthesis));
+    stages.push_back(std::make_pair(std::string("model saving"), timesSave));
+
+    std::cout << "Checksum " << checksum << std::endl;
+
+    for (size_t s=0; s<stages.size(); ++s)
+    {
+        printLatencies(stages[s].first.c_str(), stages[s].second);
+    }
+
+    if (!_options.jsonFile_.isEmpty() && !writeStageTimes(_options.jsonFile_, _options, stages))
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    QString benchmark(argv[1]);
+
+    QString configFile;
+
+    BenchOptions options;
+
+    for (int i=2; i<argc; ++i)
+    {
+        QString arg(argv[i]);
+
+        bool hasValue = (i+1 < argc);
+
+        if (arg == "-c" && hasValue)
+        {
+            configFile = argv[++i];
+        }
+        else if (arg == "-n" && hasValue)
+        {
+            options.collection_.nMatches_ = QString(argv[++i]).toInt();
+        }
+        else if (arg == "-p" && hasValue)
+        {
+            options.collection_.nParts_ = QString(argv[++i]).toInt();
+        }
+        else if (arg == "-k" && hasValue)
+        {
+            options.nofNN_ = QString(argv[++i]).toInt();
+        }
+        else if (arg == "-q" && hasValue)
+        {
+            options.nQueries_ = QString(argv[++i]).toInt();
+        }
+        else if (arg == "-s" && hasValue)
+        {
+            options.collection_.seed_ = QString(argv[++i]).toUInt();
+        }
+        else if (arg == "-f" && hasValue)
+        {
+            options.meshFiles_ << QString::fromLocal8Bit(argv[++i]);
+        }
+        else if (arg == "-r" && hasValue)
+        {
+            options.nRepeats_ = QString(argv[++i]).toInt();
+        }
+        else if (arg == "-m" && hasValue)
+        {
+            options.collection_.nPoints_ = QString(argv[++i]).toInt();
+        }
+        else if (arg == "-t" && hasValue)
+        {
+            options.collection_.nTrianglesPerPart_ = QString(argv[++i]).toInt();
+        }
+        else if (arg == "-g" && hasValue)
+        {
+            options.collection_.nGroups_ = QString(argv[++i]).toInt();
+        }
+        else if (arg == "-d" && hasValue)
+        {
+            options.directory_ = QString::fromLocal8Bit(argv[++i]);
+        }
+        else if (arg == "-j" && hasValue)
+        {
+            options.jsonFile_ = QString::fromLocal8Bit(argv[++i]);
+        }
+        else if (arg == "-v")
+        {
+            verbose = true;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.collection_.nMatches_ < options.nofNN_ || options.collection_.nParts_ <= 0 || options.nofNN_ <= 0 || options.nQueries_ <= 0 || options.nRepeats_ <= 0
+        || options.collection_.nPoints_ < 0 || options.collection_.nTrianglesPerPart_ <= 0 || options.collection_.nGroups_ <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    qInstallMsgHandler(printMessage);
+
+    setDefaultGlobals();
+
+    if (!configFile.isEmpty() && !readConfigFile(configFile))
+    {
+        return 1;
+    }
+
+    if (benchmark == "knn")
+    {
+        return benchKnn(options);
+    }
+    else if (benchmark == "off")
+    {
+        return benchOff(options);
+    }
+    else if (benchmark == "mds")
+    {
+        return benchMds(options);
+    }
+    else if (benchmark == "spectral")
+    {
+        return benchSpectral(options);
+    }
+    else if (benchmark == "pca")
+    {
+        return benchPca(options);
+    }
+    else if (benchmark == "tsne")
+    {
+        return benchTsne(options);
+    }
+    else if (benchmark == "pipeline")
+    {
+        return benchPipeline(options);
+    }
+
+    usage(argv[0]);
+    return 1;
+}
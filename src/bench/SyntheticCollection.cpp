@@ -0,0 +1,300 @@
+//
+//  SyntheticCollection.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+#include <QDebug>
+
+#include "SyntheticCollection.h"
+#include "global.h"
+
+typedef SynthesisEngine::Match Match;
+
+void generateSyntheticMatches(const SyntheticCollectionParams& _params, std::vector<Match*>& _matches)
+{
+    std::mt19937 rng(_params.seed_);
+
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    std::mt19937 detailRng(_params.seed_ + 1);
+    std::uniform_real_distribution<double> uniformDetail(0.0, 1.0);
+
+    int nValues = _params.nParts_ * 6;
+
+    // Mean layout: part centres in the unit cube, half sizes between 0.05 and 0.3
+    std::vector<double> mean(nValues);
+
+    for (int p=0; p<_params.nParts_; ++p)
+    {
+        for (int k=0; k<3; ++k)
+        {
+            mean[p*6 + k] = 2.0 * uniform(rng) - 1.0;
+            mean[p*6 + 3 + k] = 0.05 + 0.25 * uniform(rng);
+        }
+    }
+
+    // Each mode moves and resizes all parts together, with decreasing strength
+    std::vector< std::vector<double> > modes(_params.nModes_, std::vector<double>(nValues));
+
+    for (int m=0; m<_params.nModes_; ++m)
+    {
+        double strength = 0.2 / (m + 1);
+
+        for (int v=0; v<nValues; ++v)
+        {
+            modes[m][v] = strength * normal(rng);
+        }
+    }
+
+    _matches.reserve(_matches.size() + _params.nMatches_);
+
+    std::vector<double> values(nValues);
+
+    for (int i=0; i<_params.nMatches_; ++i)
+    {
+        values = mean;
+
+        for (int m=0; m<_params.nModes_; ++m)
+        {
+            double c = normal(rng);
+
+            for (int v=0; v<nValues; ++v)
+            {
+                values[v] += c * modes[m][v];
+            }
+        }
+
+        Match* match = new Match;
+
+        int groupID = i % _params.nGroups_;
+
+        for (int p=0; p<_params.nParts_; ++p)
+        {
+            Match::Part part;
+
+            part.partID_ = groupID * _params.nParts_ + p + 1;
+            part.partType_ = 1;
+
+            for (int k=0; k<3; ++k)
+            {
+                part.pos_[k] = values[p*6 + k] + _params.noise_ * normal(rng);
+                part.scale_[k] = std::max(0.01, values[p*6 + 3 + k] + _params.noise_ * normal(rng));
+            }
+
+            match->parts().push_back(part);
+        }
+
+        match->setNparts(_params.nParts_);
+        match->setTemplateID(groupID);
+        match->setGroupID(groupID);
+        match->setFilename(QString("synthetic-%1").arg(i));
+
+        // The rest comes from its own generator, so the boxes are the same whatever the number of points
+        std::vector<Match::MeshPoint>& points = match->points();
+
+        const std::vector<Match::Part>& parts = match->parts();
+
+        OpenMesh::Vec3f centroid(0, 0, 0);
+
+        for (int p=0; p<_params.nParts_; ++p)
+        {
+            centroid += parts[p].pos_;
+        }
+
+        centroid /= (float)_params.nParts_;
+
+        double radius = 0.0;
+
+        points.reserve(_params.nPoints_);
+
+        for (int k=0; k<_params.nPoints_; ++k)
+        {
+            const Match::Part& part = parts[k % _params.nParts_];
+
+            Match::MeshPoint point;
+
+            point.partID_ = part.partID_;
+
+            for (int c=0; c<3; ++c)
+            {
+                point.pos_[c] = part.pos_[c] + part.scale_[c] * (2.0 * uniformDetail(detailRng) - 1.0);
+            }
+
+            radius += (point.pos_ - centroid).norm();
+
+            points.push_back(point);
+        }
+
+        match->setNpnts(_params.nPoints_);
+        match->setFitError(_params.maxFitError_ * uniformDetail(detailRng));
+        match->setMeshCentroid(centroid);
+        match->setMeshAvgRadius(_params.nPoints_ > 0 ? radius / _params.nPoints_ : 1.0);
+
+        _matches.push_back(match);
+    }
+}
+
+int syntheticConstraints(const SyntheticCollectionParams& _params, std::vector<Match::Constraint>& _constraints)
+{
+    _constraints.clear();
+
+    int nSymmetries = 0;
+
+    for (int p=0; p+1<_params.nParts_; ++p)
+    {
+        Match::Constraint constraint;
+
+        constraint.type_ = (p % 2 == 0) ? SYMMETRY : CONTACT;
+        constraint.partIndices_ = std::make_pair(p, p + 1);
+        constraint.partIDs_ = std::make_pair(p + 1, p + 2);
+
+        if (constraint.type_ == SYMMETRY)
+        {
+            nSymmetries++;
+        }
+
+        _constraints.push_back(constraint);
+    }
+
+    return nSymmetries;
+}
+
+// Surface of the box _pos +- _scale, every face a grid of _resolution x _resolution quads split in two triangles
+// Written directly rather than through OpenMesh, a collection has a few tens of thousands of these
+static bool writeBoxMesh(const OpenMesh::Vec3f& _pos, const OpenMesh::Vec3f& _scale, int _resolution, const QString& _filename)
+{
+    QFile file(_filename);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        qCritical() << "Cannot write " << _filename;
+        return false;
+    }
+
+    QTextStream out(&file);
+
+    const int nFaceVertices = (_resolution + 1) * (_resolution + 1);
+
+    out << "OFF\n" << 6 * nFaceVertices << " " << 12 * _resolution * _resolution << " 0\n";
+
+    for (int axis=0; axis<3; ++axis)
+    {
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+
+        for (int side=-1; side<=1; side+=2)
+        {
+            for (int i=0; i<=_resolution; ++i)
+            {
+                for (int j=0; j<=_resolution; ++j)
+                {
+                    OpenMesh::Vec3f point;
+
+                    point[axis] = _pos[axis] + side * _scale[axis];
+                    point[u] = _pos[u] + _scale[u] * (2.0f * i / _resolution - 1.0f);
+                    point[v] = _pos[v] + _scale[v] * (2.0f * j / _resolution - 1.0f);
+
+                    out << point[0] << " " << point[1] << " " << point[2] << "\n";
+                }
+            }
+        }
+    }
+
+    for (int face=0; face<6; ++face)
+    {
+        // Faces on the negative side are wound the other way, so all normals point outwards
+        bool flip = (face % 2 == 0);
+
+        int base = face * nFaceVertices;
+
+        for (int i=0; i<_resolution; ++i)
+        {
+            for (int j=0; j<_resolution; ++j)
+            {
+                int v00 = base + i * (_resolution + 1) + j;
+                int v10 = v00 + _resolution + 1;
+                int v01 = v00 + 1;
+                int v11 = v10 + 1;
+
+                if (flip)
+                {
+                    out << "3 " << v00 << " " << v01 << " " << v11 << "\n";
+                    out << "3 " << v00 << " " << v11 << " " << v10 << "\n";
+                }
+                else
+                {
+                    out << "3 " << v00 << " " << v10 << " " << v11 << "\n";
+                    out << "3 " << v00 << " " << v11 << " " << v01 << "\n";
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool writeSyntheticCollection(const SyntheticCollectionParams& _params, const QString& _collectionFile)
+{
+    QFileInfo info(_collectionFile);
+
+    // The layout openMatchCollection expects
+    QDir collDir(info.absolutePath() + "/" + info.fileName().split(".").first());
+
+    if (!collDir.mkpath("matches") || !collDir.mkpath(MESH_PATH))
+    {
+        qCritical() << "Cannot create the directories of the collection in " << collDir.path();
+        return false;
+    }
+
+    QFile file(_collectionFile);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        qCritical() << "Cannot write " << _collectionFile;
+        return false;
+    }
+
+    QTextStream out(&file);
+
+    std::vector<Match*> matches;
+
+    generateSyntheticMatches(_params, matches);
+
+    // 2 r^2 triangles on each of the 6 faces
+    int resolution = std::max(1, (int)std::ceil(std::sqrt(_params.nTrianglesPerPart_ / 12.0)));
+
+    QDir meshDir(collDir.filePath(MESH_PATH));
+
+    bool ok = true;
+
+    std::vector<Match*>::iterator itMatch(matches.begin()), matchesEnd(matches.end());
+
+    for (; itMatch!=matchesEnd; ++itMatch)
+    {
+        Match& match = **itMatch;
+
+        match.save(out);
+
+        QString meshFilename = meshDir.filePath(match.filename() + ".off");
+
+        const std::vector<Match::Part>& parts = match.parts();
+
+        for (size_t p=0; ok && p<parts.size(); ++p)
+        {
+            ok = writeBoxMesh(parts[p].pos_, parts[p].scale_, resolution, meshFilename + QString(".p%1.off").arg(parts[p].partID_));
+        }
+
+        delete *itMatch;
+    }
+
+    return ok && out.status() == QTextStream::Ok;
+}
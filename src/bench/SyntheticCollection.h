@@ -0,0 +1,50 @@
+//
+//  SyntheticCollection.h
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#ifndef SYNTHETICCOLLECTION_H
+#define SYNTHETICCOLLECTION_H
+
+#include <vector>
+
+#include <QString>
+
+#include "SynthesisEngine.h"
+
+// Matches made up in memory with the structure of a real group: every match has the same parts, whose boxes vary along a few modes shared by the whole group plus some noise
+// Used to time the engine on groups much larger than the datasets we have
+struct SyntheticCollectionParams
+{
+    int nMatches_ = 10000;
+    int nParts_ = 6;
+    int nModes_ = 3;
+    double noise_ = 0.02;
+    unsigned int seed_ = 1;
+
+    // Mesh points of every match, sampled inside its part boxes
+    int nPoints_ = 100;
+
+    // Triangles of every part mesh written by writeSyntheticCollection, rounded up to a whole tessellation of the box
+    int nTrianglesPerPart_ = 500;
+
+    // Match i goes to group i % nGroups_, each group has its own part IDs
+    int nGroups_ = 1;
+
+    // Fit errors are uniform in [0, maxFitError_), so FIT_ERROR filters out part of the group
+    double maxFitError_ = 60.0;
+};
+
+// The matches are allocated with new, the caller deletes them
+void generateSyntheticMatches(const SyntheticCollectionParams& _params, std::vector<SynthesisEngine::Match*>& _matches);
+
+// Symmetries between the parts 0-1, 2-3, ... and contacts between 1-2, 3-4, ... of the first group, in place of those of the configured dataset
+// Returns the number of symmetry constraints
+int syntheticConstraints(const SyntheticCollectionParams& _params, std::vector<SynthesisEngine::Match::Constraint>& _constraints);
+
+// Write the synthetic matches as a collection the engine opens like a real one: _collectionFile with a line per match and, next to it,
+// a directory named after the collection with the box of every part as a mesh under MESH_PATH
+// Lines are written by Match::save, so ALIGN_MATCH_POINTS_BEFORE_SAVING, RECOMPUTE_BOXES_BEFORE_SAVING and SAVE_DESCRIPTOR should be off
+bool writeSyntheticCollection(const SyntheticCollectionParams& _params, const QString& _collectionFile);
+
+#endif
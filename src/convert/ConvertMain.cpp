@@ -0,0 +1,183 @@
+//
+// ConvertMain.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+// Writes a binary copy "<mesh>.pN.bin" next to every part mesh "<mesh>.pN.off" of a directory, MatchT picks the binary copies up instead of the OFF files once they exist
+
+#include <iostream>
+#include <chrono>
+
+#include <QDir>
+#include <QStringList>
+#include <QDebug>
+
+#include "SynthesisEngine.h"
+#include "PartMeshFile.h"
+#include "global.h"
+
+typedef SynthesisEngine::Shape Shape;
+
+static bool verbose = false;
+
+void printMessage(QtMsgType type, const char *msg)
+{
+    if (type == QtDebugMsg && !verbose)
+    {
+        return;
+    }
+
+    std::cerr << msg << std::endl;
+}
+
+void usage(const char* _name)
+{
+    std::cerr << "Usage: " << _name << " [options] [directory]" << std::endl
+              << std::endl
+              << "Converts the part meshes of the directory, the MESH_PATH of COLLECTION_FILE_PATH of the config file without one" << std::endl
+              << std::endl
+              << "Options:" << std::endl
+              << "  -c <file>           config file (default ./config.txt)" << std::endl
+              << "  -n                  store the vertex normals as well" << std::endl
+              << "  -f                  convert all part meshes, not only those whose binary copy is missing or stale" << std::endl
+              << "  -v                  print debug output" << std::endl;
+}
+
+bool convertPartMesh(const QString& _offFilename, bool _withNormals)
+{
+    qint64 sourceSize = 0;
+    qint64 sourceModified = 0;
+
+    PartMeshFile::sourceStamp(_offFilename, sourceSize, sourceModified);
+
+    Shape shape;
+
+    if (!shape.openMesh(_offFilename.toLocal8Bit()))
+    {
+        qCritical() << "Cannot read " << _offFilename;
+        return false;
+    }
+
+    const TriangleMesh& mesh = shape.mesh();
+
+    std::vector<unsigned int> triangles;
+    triangles.reserve(3 * mesh.n_faces());
+
+    TriangleMesh::ConstFaceIter fIt(mesh.faces_begin()), fEnd(mesh.faces_end());
+
+    for (; fIt!=fEnd; ++fIt)
+    {
+        TriangleMesh::ConstFaceVertexIter fvIt = mesh.cfv_iter(fIt.handle());
+
+        for (int i=0; i<3; ++i, ++fvIt)
+        {
+            triangles.push_back(fvIt.handle().idx());
+        }
+    }
+
+    const float* points = mesh.n_vertices() ? &mesh.points()[0][0] : 0;
+    const float* normals = (_withNormals && mesh.n_vertices()) ? &mesh.vertex_normals()[0][0] : 0;
+
+    return PartMeshFile::write(PartMeshFile::binaryFilename(_offFilename), points, mesh.n_vertices(), triangles.data(), mesh.n_faces(), normals, sourceSize, sourceModified);
+}
+
+int main(int argc, char **argv)
+{
+    QString configFile("./config.txt");
+    QString directory;
+
+    bool withNormals = false;
+    bool force = false;
+
+    for (int i=1; i<argc; ++i)
+    {
+        QString arg(argv[i]);
+
+        bool hasValue = (i+1 < argc);
+
+        if (arg == "-c" && hasValue)
+        {
+            configFile = argv[++i];
+        }
+        else if (arg == "-n")
+        {
+            withNormals = true;
+        }
+        else if (arg == "-f")
+        {
+            force = true;
+        }
+        else if (arg == "-v")
+        {
+            verbose = true;
+        }
+        else if (arg == "-h" || arg == "--help")
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if (!arg.startsWith("-") && directory.isEmpty())
+        {
+            directory = arg;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    qInstallMsgHandler(printMessage);
+
+    if (directory.isEmpty())
+    {
+        if (!readConfigFile(configFile))
+        {
+            return 1;
+        }
+
+        directory = SynthesisEngine::meshDirectory(COLLECTION_FILE_PATH);
+    }
+
+    QDir dir(directory);
+
+    if (!dir.exists())
+    {
+        qCritical() << "Directory " << directory << " does not exist";
+        return 1;
+    }
+
+    QStringList offFiles = dir.entryList(QStringList() << "*.p*.off", QDir::Files, QDir::Name);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    int nConverted = 0, nSkipped = 0, nFailed = 0;
+
+    QStringList::const_iterator itFile(offFiles.begin()), filesEnd(offFiles.end());
+
+    for (; itFile!=filesEnd; ++itFile)
+    {
+        QString offFilename = dir.filePath(*itFile);
+
+        if (!force && PartMeshFile::isUpToDate(offFilename))
+        {
+            ++nSkipped;
+            continue;
+        }
+
+        if (convertPartMesh(offFilename, withNormals))
+        {
+            ++nConverted;
+        }
+        else
+        {
+            ++nFailed;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Converted " << nConverted << " part meshes in " << seconds << " s, " << nSkipped << " were up to date, " << nFailed << " failed" << std::endl;
+
+    return nFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,475 @@
+//
+// global.cpp
+//
+// Copyright (c) 2013-2014 Melinos Averkiou <m.averkiou@cs.ucl.ac.uk>
+
+#include <QFile>
+#include <QTextStream>
+#include <QDateTime>
+#include <QDebug>
+
+#include "global.h"
+#include "Trace.h"
+#include "AsyncLog.h"
+
+QString COLLECTION_FILE_PATH;
+QString WATCH_MATCH_PATH;
+std::string MATLAB_FILE_PATH;
+std::string MATLAB_APP_PATH;
+std::string COMPUTE_BACKEND = "NATIVE";
+bool TRACE_EVENTS = false;
+int LOG_LEVEL = 0;
+
+QString MESH_PATH;
+QString TEMPLATE_ICON_PATH;
+QString MATCH_ICON_PATH;
+QString MODEL_ICON_PATH;
+
+QString RESULTS_PATH;
+MODEL_FORMAT SAVED_MODEL_FORMAT = MODEL_FORMAT_OFF;
+
+bool PRELOAD_MODELS;
+DATASET LOADED_DATASET;
+float FIT_ERROR;
+int MAX_NUM_CLUSTERS_TO_SHOW;
+int MIN_CLUSTER_POPULATION;
+
+int NUM_OF_NEAREST_NEIGHBOURS;
+int KNN_BRUTE_FORCE_THRESHOLD = 256;
+int NUM_PARAMS_BOX;
+int NUM_PARAMS_POS;
+EMBEDDING_TYPES EMBEDDING_MODE;
+int MDS_MAX_CLASSICAL = 2000;
+int MDS_LANDMARKS = 256;
+float TSNE_PERPLEXITY = 30.0f;
+int TSNE_ITERATIONS = 1000;
+
+int NUM_EQUATIONS_SYMMETRY;
+int NUM_EQUATIONS_CONTACT;
+
+DEBUG_TYPES DEBUG_MODE;
+bool CREATE_SLW;
+bool CREATE_TEW;
+bool CREATE_QWTPLOTW;
+bool CREATE_TEVW;
+bool CREATE_MVW;
+bool CREATE_LOGW;
+
+bool SHOW_SLW;
+bool SHOW_TEW;
+bool SHOW_QWTPLOTW;
+bool SHOW_TEVW;
+bool SHOW_MVW;
+bool SHOW_LOGW;
+int NOF_MVW;
+
+bool SAVE_DESCRIPTOR;
+
+bool ALIGN_MATCH_POINTS_BEFORE_SAVING;
+bool  ALIGN_MATCH_MESH_BEFORE_SAVING;
+bool  NORMALISE_MATCH_MESH_BEFORE_SAVING;
+bool  RECOMPUTE_BOXES_BEFORE_SAVING;
+
+bool OPEN_DESCRIPTOR;
+bool  ALIGN_MATCH_MESH_AFTER_OPENING;
+bool NORMALISE_MATCH_MESH_AFTER_OPENING;
+bool OPEN_ORIGINAL_MESH;
+bool  OPEN_PART_MESHES_AFTER_OPENING_MATCH_MESH;
+
+int APP_WINDOW_WIDTH;
+int APP_WINDOW_HEIGHT;
+
+int CLUSTER_VIEW_ICON_HEIGHT;
+int CLUSTER_VIEW_ICON_PADDING;
+int CLUSTER_VIEW_ICON_FRAME_THICKNESS;
+int CLUSTER_VIEW_ICON_SPACING;
+int EXPLORATION_VIEW_ICON_HEIGHT;
+
+int PART_DESC_SIZE_ROWS;
+int PART_DESC_SIZE_COLS;
+int PART_DESC_SIZE;
+
+// Setup some random colors to paint our objects
+GLfloat shapeColors[MAX_NUM_OF_COLORS][4];
+
+QColor tewColors[MAX_NUM_OF_COLORS];
+
+QTextBrowser* TIMELOG =0;
+
+void setupColors()
+{
+    srand(248504281);
+    
+    // Just as a precautionary measure, have say 100 random colors, so we never go out of bounds based on labels for coloring
+    for(int i=0; i<MAX_NUM_OF_COLORS; i++)
+    {
+        shapeColors[i][0] = ((float)(rand()%256))/255.f;
+        shapeColors[i][1] = ((float)(rand()%256))/255.f;
+        shapeColors[i][2] = ((float)(rand()%256))/255.f;
+        shapeColors[i][3] = 1.0f;
+        
+        tewColors[i].setRedF(((float)(rand()%256))/255.f);
+        tewColors[i].setGreenF(((float)(rand()%256))/255.f);
+        tewColors[i].setBlueF(((float)(rand()%256))/255.f);
+        tewColors[i].setAlphaF(1.0f);
+    }
+    
+    // Now actually set the two colormaps we want, one for shapes and one for the plot and gui for the exploration widget
+    // colormaps from colorbrewer2.org
+    
+    // shapeColors, assuming 8 different data classes, i.e. parts, of qualitative nature, so they are not related in any way and we need as distinguishing colors as possible, picked the Set1 color scheme which is also printer-friendly
+    
+    shapeColors[0][0] = 228.f / 255.f;
+    shapeColors[0][1] = 26.f / 255.f;
+    shapeColors[0][2] = 28.f /255.f;
+    shapeColors[0][3] = 1.0f;
+    
+    shapeColors[1][0] = 55.f / 255.f;
+    shapeColors[1][1] = 126.f / 255.f;
+    shapeColors[1][2] = 184.f /255.f;
+    shapeColors[1][3] = 1.0f;
+    
+    shapeColors[2][0] = 77.f / 255.f;
+    shapeColors[2][1] = 175.f / 255.f;
+    shapeColors[2][2] = 74.f /255.f;
+    shapeColors[2][3] = 1.0f;
+    
+    shapeColors[3][0] = 152.f / 255.f;
+    shapeColors[3][1] = 78.f / 255.f;
+    shapeColors[3][2] = 163.f /255.f;
+    shapeColors[3][3] = 1.0f;
+    
+    shapeColors[4][0] = 255.f / 255.f;
+    shapeColors[4][1] = 127.f / 255.f;
+    shapeColors[4][2] = 0.f /255.f;
+    shapeColors[4][3] = 1.0f;
+    
+    shapeColors[5][0] = 255.f / 255.f;
+    shapeColors[5][1] = 255.f / 255.f;
+    shapeColors[5][2] = 51.f /255.f;
+    shapeColors[5][3] = 1.0f;
+    
+    shapeColors[6][0] = 166.f / 255.f;
+    shapeColors[6][1] = 86.f / 255.f;
+    shapeColors[6][2] = 40.f /255.f;
+    shapeColors[6][3] = 1.0f;
+    
+    shapeColors[7][0] = 247.f / 255.f;
+    shapeColors[7][1] = 129.f / 255.f;
+    shapeColors[7][2] = 191.f /255.f;
+    shapeColors[7][3] = 1.0f;
+    
+    // exploration widget colors, assuming 5 different data classes, i.e. clusters, of qualitative nature, so they are not related in any way and we need as distinguishing colors as possible, picked the Dark2 scheme which is also printer-friendly
+    tewColors[0].setRed(27);
+    tewColors[0].setGreen(158);
+    tewColors[0].setBlue(119);
+    tewColors[0].setAlpha(255);
+    
+    tewColors[1].setRed(217);
+    tewColors[1].setGreen(95);
+    tewColors[1].setBlue(2);
+    tewColors[1].setAlpha(255);
+    
+    tewColors[2].setRed(117);
+    tewColors[2].setGreen(112);
+    tewColors[2].setBlue(179);
+    tewColors[2].setAlpha(255);
+    
+    tewColors[3].setRed(231);
+    tewColors[3].setGreen(41);
+    tewColors[3].setBlue(138);
+    tewColors[3].setAlpha(255);
+    
+    tewColors[4].setRed(102);
+    tewColors[4].setGreen(166);
+    tewColors[4].setBlue(30);
+    tewColors[4].setAlpha(255);
+    
+}
+
+bool readConfigFile(const QString& _filename)
+{
+    // Read config file
+    QFile file(_filename);
+    
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qCritical() << "Could not open file " << _filename;
+        return false;
+    }
+	else
+	{
+		QTextStream in(&file);
+        int lineno = 0;
+		while (!in.atEnd())
+		{
+			QString line = in.readLine();
+
+            QStringList splitLine = line.split(" = ");
+            QString varName = splitLine.first();
+            
+            QString varValueString = splitLine.last();
+            int varValueInt = varValueString.toInt();
+            float varValueFloat = varValueString.toFloat();
+            
+            if (varName == "COLLECTION_FILE_PATH")
+            {
+                COLLECTION_FILE_PATH = varValueString;
+            }
+            if (varName == "WATCH_MATCH_PATH")
+            {
+                WATCH_MATCH_PATH = varValueString;
+            }
+            if (varName == "MATLAB_FILE_PATH")
+            {
+                MATLAB_FILE_PATH = varValueString.toStdString();
+            }
+            if (varName == "MATLAB_APP_PATH")
+            {
+                MATLAB_APP_PATH = varValueString.toStdString();
+            }
+            if (varName == "COMPUTE_BACKEND")
+            {
+                COMPUTE_BACKEND = varValueString.toStdString();
+            }
+            if (varName == "TRACE_EVENTS")
+            {
+                TRACE_EVENTS = varValueInt>0 ? true: false;
+                Trace::setEnabled(TRACE_EVENTS);
+            }
+            if (varName == "LOG_LEVEL")
+            {
+                LOG_LEVEL = varValueInt;
+                AsyncLog::setLevel(LOG_LEVEL);
+            }
+            if (varName == "MESH_PATH")
+            {
+                MESH_PATH = varValueString;
+            }
+            if (varName == "TEMPLATE_ICON_PATH")
+            {
+                TEMPLATE_ICON_PATH = varValueString;
+            }
+            if (varName == "MATCH_ICON_PATH")
+            {
+                MATCH_ICON_PATH = varValueString;
+            }
+            if (varName == "MODEL_ICON_PATH")
+            {
+                MODEL_ICON_PATH = varValueString;
+            }
+            if (varName == "RESULTS_PATH")
+            {
+                RESULTS_PATH = varValueString;
+                RESULTS_PATH += QDateTime::currentDateTime().toString( "yyMMddhhmmss" );
+                RESULTS_PATH += "/";
+            }
+            if (varName == "SAVED_MODEL_FORMAT")
+            {
+                SAVED_MODEL_FORMAT = (MODEL_FORMAT)varValueInt;
+            }
+            if (varName == "PRELOAD_MODELS")
+            {
+                PRELOAD_MODELS = varValueInt>0 ? true: false;
+            }
+            if (varName == "DATASET")
+            {
+                LOADED_DATASET = (DATASET)varValueInt;
+            }
+            if (varName == "FIT_ERROR")
+            {
+                FIT_ERROR = varValueFloat;
+            }
+            if (varName == "MAX_NUM_CLUSTERS_TO_SHOW")
+            {
+                MAX_NUM_CLUSTERS_TO_SHOW = varValueInt;
+            }
+            if (varName == "MIN_CLUSTER_POPULATION")
+            {
+                MIN_CLUSTER_POPULATION = varValueInt;
+            }
+            if (varName == "NUM_NEAREST_NEIGHBOURS")
+            {
+                NUM_OF_NEAREST_NEIGHBOURS = varValueInt;
+            }
+            if (varName == "KNN_BRUTE_FORCE_THRESHOLD")
+            {
+                KNN_BRUTE_FORCE_THRESHOLD = varValueInt;
+            }
+            if (varName == "NUM_PARAMS_BOX")
+            {
+                NUM_PARAMS_BOX = varValueInt;
+            }
+            if (varName == "NUM_PARAMS_POS")
+            {
+                NUM_PARAMS_POS = varValueInt;
+            }
+            if (varName == "EMBEDDING_MODE")
+            {
+                EMBEDDING_MODE = (EMBEDDING_TYPES)varValueInt;
+            }
+            if (varName == "MDS_MAX_CLASSICAL")
+            {
+                MDS_MAX_CLASSICAL = varValueInt;
+            }
+            if (varName == "MDS_LANDMARKS")
+            {
+                MDS_LANDMARKS = varValueInt;
+            }
+            if (varName == "TSNE_PERPLEXITY")
+            {
+                TSNE_PERPLEXITY = varValueFloat;
+            }
+            if (varName == "TSNE_ITERATIONS")
+            {
+                TSNE_ITERATIONS = varValueInt;
+            }
+            if (varName == "NUM_EQUATIONS_SYMMETRY")
+            {
+                NUM_EQUATIONS_SYMMETRY = varValueInt;
+            }
+            if (varName == "NUM_EQUATIONS_CONTACT")
+            {
+                NUM_EQUATIONS_CONTACT = varValueInt;
+            }
+            if (varName == "DEBUG_MODE")
+            {
+                DEBUG_MODE = (DEBUG_TYPES)varValueInt;
+            }
+            if (varName == "CREATE_SLW")
+            {
+                CREATE_SLW = varValueInt>0 ? true: false;
+            }
+            if (varName == "CREATE_TEW")
+            {
+                CREATE_TEW = varValueInt>0 ? true: false;
+            }
+            if (varName == "CREATE_QWTPLOTW")
+            {
+                CREATE_QWTPLOTW = varValueInt>0 ? true: false;
+            }
+            if (varName == "CREATE_TEVW")
+            {
+                CREATE_TEVW = varValueInt>0 ? true: false;
+            }
+            if (varName == "CREATE_MVW")
+            {
+                CREATE_MVW = varValueInt>0 ? true: false;
+            }
+            if (varName == "CREATE_LOGW")
+            {
+                CREATE_LOGW = varValueInt>0 ? true: false;
+            }
+            if (varName == "SHOW_SLW")
+            {
+                SHOW_SLW = varValueInt>0 ? true: false;
+            }
+            if (varName == "SHOW_TEW")
+            {
+                SHOW_TEW = varValueInt>0 ? true: false;
+            }
+            if (varName == "SHOW_QWTPLOTW")
+            {
+                SHOW_QWTPLOTW = varValueInt>0 ? true: false;
+            }
+            if (varName == "SHOW_TEVW")
+            {
+                SHOW_TEVW = varValueInt>0 ? true: false;
+            }
+            if (varName == "SHOW_MVW")
+            {
+                SHOW_MVW = varValueInt>0 ? true: false;
+            }
+            if (varName == "SHOW_LOGW")
+            {
+                SHOW_LOGW = varValueInt>0 ? true: false;
+            }
+            if (varName == "NOF_MVW")
+            {
+                NOF_MVW = varValueInt;
+            }
+            if (varName == "SAVE_DESCRIPTOR")
+            {
+                SAVE_DESCRIPTOR = varValueInt>0 ? true: false;
+            }
+            if (varName == "ALIGN_MATCH_POINTS_BEFORE_SAVING")
+            {
+                ALIGN_MATCH_POINTS_BEFORE_SAVING = varValueInt>0 ? true: false;
+            }
+            if (varName == "ALIGN_MATCH_MESH_BEFORE_SAVING")
+            {
+                ALIGN_MATCH_MESH_BEFORE_SAVING = varValueInt>0 ? true: false;
+            }
+            if (varName == "NORMALISE_MATCH_MESH_BEFORE_SAVING")
+            {
+                NORMALISE_MATCH_MESH_BEFORE_SAVING = varValueInt>0 ? true: false;
+            }
+            if (varName == "RECOMPUTE_BOXES_BEFORE_SAVING")
+            {
+                RECOMPUTE_BOXES_BEFORE_SAVING = varValueInt>0 ? true: false;
+            }
+            if (varName == "OPEN_DESCRIPTOR")
+            {
+                OPEN_DESCRIPTOR = varValueInt>0 ? true: false;
+            }
+            
+            if (varName == "ALIGN_MATCH_MESH_AFTER_OPENING")
+            {
+                ALIGN_MATCH_MESH_AFTER_OPENING = varValueInt>0 ? true: false;
+            }
+            if (varName == "NORMALISE_MATCH_MESH_AFTER_OPENING")
+            {
+                NORMALISE_MATCH_MESH_AFTER_OPENING = varValueInt>0 ? true: false;
+            }
+            if (varName == "OPEN_ORIGINAL_MESH")
+            {
+                OPEN_ORIGINAL_MESH = varValueInt>0 ? true: false;
+            }
+            if (varName == "OPEN_PART_MESHES_AFTER_OPENING_MATCH_MESH")
+            {
+                OPEN_PART_MESHES_AFTER_OPENING_MATCH_MESH = varValueInt>0 ? true: false;
+            }
+            if (varName == "APP_WINDOW_WIDTH")
+            {
+                APP_WINDOW_WIDTH = varValueInt;
+            }
+            if (varName == "APP_WINDOW_HEIGHT")
+            {
+                APP_WINDOW_HEIGHT = varValueInt;
+            }
+            if (varName == "CLUSTER_VIEW_ICON_HEIGHT")
+            {
+                CLUSTER_VIEW_ICON_HEIGHT = varValueInt;
+            }
+            if (varName == "CLUSTER_VIEW_ICON_PADDING")
+            {
+                CLUSTER_VIEW_ICON_PADDING = varValueInt;
+            }
+            if (varName == "CLUSTER_VIEW_ICON_FRAME_THICKNESS")
+            {
+                CLUSTER_VIEW_ICON_FRAME_THICKNESS = varValueInt;
+            }
+            if (varName == "CLUSTER_VIEW_ICON_SPACING")
+            {
+                CLUSTER_VIEW_ICON_SPACING = varValueInt;
+            }
+            if (varName == "EXPLORATION_VIEW_ICON_HEIGHT")
+            {
+                EXPLORATION_VIEW_ICON_HEIGHT = varValueInt;
+            }
+            if (varName == "PART_DESC_SIZE_ROWS")
+            {
+                PART_DESC_SIZE_ROWS = varValueInt;
+            }
+            if (varName == "PART_DESC_SIZE_COLS")
+            {
+                PART_DESC_SIZE_COLS = varValueInt;
+            }
+            if (varName == "PART_DESC_SIZE")
+            {
+                PART_DESC_SIZE = varValueInt;
+            }
+        }
+	}
+    return true;
+}
@@ -13,10 +13,6 @@
 #include <OpenMesh/Core/Mesh/TriMesh_ArrayKernelT.hh>
 #include <XForm.h>
 
-// MATLAB
-#include <engine.h>
-#include <matrix.h>
-
 struct MeshTraits : public OpenMesh::DefaultTraits
 {
   HalfedgeAttributes(OpenMesh::Attributes::PrevHalfedge);
@@ -96,7 +92,14 @@ typedef struct
 enum EMBEDDING_TYPES
 {
     PCA = 0,
-    FAST_SPECTRAL = 1
+    FAST_SPECTRAL = 1,
+    TSNE = 2
+};
+
+enum MODEL_FORMAT
+{
+    MODEL_FORMAT_OFF = 0,
+    MODEL_FORMAT_PLY = 1
 };
 
 //#define USE_SLOW_WRONG 1
@@ -106,8 +109,12 @@ enum EMBEDDING_TYPES
 static const int MAX_NUM_OF_COLORS = 100;
 
 extern QString COLLECTION_FILE_PATH;
+extern QString WATCH_MATCH_PATH;
 extern std::string MATLAB_FILE_PATH;
 extern std::string MATLAB_APP_PATH;
+extern std::string COMPUTE_BACKEND;
+extern bool TRACE_EVENTS;
+extern int LOG_LEVEL;
 
 extern QString MESH_PATH;
 extern QString TEMPLATE_ICON_PATH;
@@ -115,6 +122,7 @@ extern QString MATCH_ICON_PATH;
 extern QString MODEL_ICON_PATH;
 
 extern QString RESULTS_PATH;
+extern MODEL_FORMAT SAVED_MODEL_FORMAT;
 
 extern bool PRELOAD_MODELS;
 
@@ -124,9 +132,14 @@ extern int MAX_NUM_CLUSTERS_TO_SHOW;
 extern int MIN_CLUSTER_POPULATION;
 
 extern int NUM_OF_NEAREST_NEIGHBOURS;
+extern int KNN_BRUTE_FORCE_THRESHOLD;
 extern int NUM_PARAMS_BOX;
 extern int NUM_PARAMS_POS;
 extern EMBEDDING_TYPES EMBEDDING_MODE;
+extern int MDS_MAX_CLASSICAL;
+extern int MDS_LANDMARKS;
+extern float TSNE_PERPLEXITY;
+extern int TSNE_ITERATIONS;
 
 extern int NUM_EQUATIONS_SYMMETRY;
 extern int NUM_EQUATIONS_CONTACT;
@@ -180,4 +193,9 @@ extern QColor tewColors[MAX_NUM_OF_COLORS];
 
 extern QTextBrowser* TIMELOG;
 
+// Load the globals above from a config file, defined in global.cpp so the GUI and the batch tools share them
+bool readConfigFile(const QString& _filename = QString("./config.txt"));
+
+void setupColors();
+
 #endif